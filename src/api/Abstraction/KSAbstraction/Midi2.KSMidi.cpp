@@ -196,3 +196,34 @@ CMidi2KSMidi::SendMidiMessage(
     return E_ABORT;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidi2KSMidi::GetPipeStatistics(
+    PMIDI_PIPE_STATISTICS MidiIn,
+    PMIDI_PIPE_STATISTICS MidiOut
+)
+{
+    RETURN_HR_IF_NULL(E_POINTER, MidiIn);
+    RETURN_HR_IF_NULL(E_POINTER, MidiOut);
+
+    *MidiIn = {};
+    *MidiOut = {};
+
+    RETURN_HR_IF(E_ABORT, !m_MidiInDevice && !m_MidiOutDevice);
+
+    // Each device has one looped buffer, in its own direction
+    MIDI_PIPE_STATISTICS unused{};
+
+    if (m_MidiInDevice)
+    {
+        RETURN_IF_FAILED(m_MidiInDevice->GetStatistics(*MidiIn, unused));
+    }
+
+    if (m_MidiOutDevice)
+    {
+        RETURN_IF_FAILED(m_MidiOutDevice->GetStatistics(unused, *MidiOut));
+    }
+
+    return S_OK;
+}
+
@@ -14,6 +14,7 @@ public:
 
     HRESULT Initialize(_In_ LPCWSTR, _In_ MidiFlow, _In_ PABSTRACTIONCREATIONPARAMS, _In_ DWORD *, _In_opt_ IMidiCallback *, _In_ LONGLONG);
     HRESULT SendMidiMessage(_In_ PVOID , _In_ UINT , _In_ LONGLONG);
+    HRESULT GetPipeStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS);
     HRESULT Cleanup();
 
 private:
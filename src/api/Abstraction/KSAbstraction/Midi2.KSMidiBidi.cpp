@@ -79,3 +79,17 @@ CMidi2KSMidiBiDi::SendMidiMessage(
     return E_ABORT;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidi2KSMidiBiDi::GetPipeStatistics(
+    PMIDI_PIPE_STATISTICS MidiIn,
+    PMIDI_PIPE_STATISTICS MidiOut
+)
+{
+    if (m_MidiDevice)
+    {
+        return m_MidiDevice->GetPipeStatistics(MidiIn, MidiOut);
+    }
+
+    return E_ABORT;
+}
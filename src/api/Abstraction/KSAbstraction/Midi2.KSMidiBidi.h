@@ -11,12 +11,14 @@
 class CMidi2KSMidiBiDi : 
     public Microsoft::WRL::RuntimeClass<
         Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
-        IMidiBiDi>
+        IMidiBiDi,
+        IMidiPipeStatistics>
 {
 public:
 
     STDMETHOD(Initialize(_In_ LPCWSTR, _In_ PABSTRACTIONCREATIONPARAMS, _In_ DWORD *, _In_opt_ IMidiCallback *, _In_ LONGLONG, _In_ GUID));
     STDMETHOD(SendMidiMessage(_In_ PVOID , _In_ UINT , _In_ LONGLONG));
+    STDMETHOD(GetPipeStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS));
     STDMETHOD(Cleanup)();
 
 private:
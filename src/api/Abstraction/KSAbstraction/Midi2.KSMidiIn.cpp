@@ -64,3 +64,17 @@ CMidi2KSMidiIn::Cleanup()
     return S_OK;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidi2KSMidiIn::GetPipeStatistics(
+    PMIDI_PIPE_STATISTICS MidiIn,
+    PMIDI_PIPE_STATISTICS MidiOut
+)
+{
+    if (m_MidiDevice)
+    {
+        return m_MidiDevice->GetPipeStatistics(MidiIn, MidiOut);
+    }
+
+    return E_ABORT;
+}
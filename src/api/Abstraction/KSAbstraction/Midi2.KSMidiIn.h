@@ -11,11 +11,13 @@
 class CMidi2KSMidiIn : 
     public Microsoft::WRL::RuntimeClass<
         Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
-        IMidiIn>
+        IMidiIn,
+        IMidiPipeStatistics>
 {
 public:
 
     STDMETHOD(Initialize(_In_ LPCWSTR, _In_ PABSTRACTIONCREATIONPARAMS, _In_ DWORD *, _In_opt_ IMidiCallback *, _In_ LONGLONG, _In_ GUID));
+    STDMETHOD(GetPipeStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS));
     STDMETHOD(Cleanup)();
 
 private:
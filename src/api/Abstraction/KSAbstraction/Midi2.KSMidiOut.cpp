@@ -78,3 +78,17 @@ CMidi2KSMidiOut::SendMidiMessage(
     return E_ABORT;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidi2KSMidiOut::GetPipeStatistics(
+    PMIDI_PIPE_STATISTICS MidiIn,
+    PMIDI_PIPE_STATISTICS MidiOut
+)
+{
+    if (m_MidiDevice)
+    {
+        return m_MidiDevice->GetPipeStatistics(MidiIn, MidiOut);
+    }
+
+    return E_ABORT;
+}
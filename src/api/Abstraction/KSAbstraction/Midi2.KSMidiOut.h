@@ -12,12 +12,14 @@
 class CMidi2KSMidiOut : 
     public Microsoft::WRL::RuntimeClass<
         Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
-        IMidiOut>
+        IMidiOut,
+        IMidiPipeStatistics>
 {
 public:
 
     STDMETHOD(Initialize(_In_ LPCWSTR, _In_ PABSTRACTIONCREATIONPARAMS, _In_ DWORD *, _In_ GUID));
     STDMETHOD(SendMidiMessage(_In_ PVOID, _In_ UINT, _In_ LONGLONG));
+    STDMETHOD(GetPipeStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS));
     STDMETHOD(Cleanup)();
 
 private:
@@ -9,6 +9,9 @@
 #include "pch.h"
 #include "Midi2.MidiSrv.h"
 
+// how long a cancel waits for the service to pick up messages already sent
+#define MIDISRV_CANCEL_SEND_QUEUE_TIMEOUT_MS 2000
+
 _Use_decl_annotations_
 HRESULT
 CMidi2MidiSrv::Initialize(
@@ -44,9 +47,11 @@ CMidi2MidiSrv::Initialize(
             SAFE_CLOSEHANDLE(client->MidiInDataFileMapping);
             SAFE_CLOSEHANDLE(client->MidiInRegisterFileMapping);
             SAFE_CLOSEHANDLE(client->MidiInWriteEvent);
+            SAFE_CLOSEHANDLE(client->MidiInSpaceAvailableEvent);
             SAFE_CLOSEHANDLE(client->MidiOutDataFileMapping);
             SAFE_CLOSEHANDLE(client->MidiOutRegisterFileMapping);
             SAFE_CLOSEHANDLE(client->MidiOutWriteEvent);
+            SAFE_CLOSEHANDLE(client->MidiOutSpaceAvailableEvent);
 
             MIDL_user_free(client);
             client = nullptr;
@@ -55,6 +60,7 @@ CMidi2MidiSrv::Initialize(
 
     creationParams.Flow = Flow;
     creationParams.DataFormat = CreationParams->DataFormat;
+    creationParams.DeliveryOverflowPolicy = CreationParams->DeliveryOverflowPolicy;
 
     // Todo: client side buffering requests to come from some service setting?
     // - See https://github.com/microsoft/MIDI/issues/219 for details
@@ -96,9 +102,11 @@ CMidi2MidiSrv::Initialize(
         client->MidiInRegisterFileMapping = NULL;
         midiInPipe->WriteEvent.reset(client->MidiInWriteEvent);
         client->MidiInWriteEvent = NULL;
+        midiInPipe->SpaceAvailableEvent.reset(client->MidiInSpaceAvailableEvent);
+        client->MidiInSpaceAvailableEvent = NULL;
         midiInPipe->Data.BufferSize = client->MidiInBufferSize;
         RETURN_IF_FAILED(CreateMappedDataBuffer(0, midiInPipe->DataBuffer.get(), &midiInPipe->Data));
-        RETURN_IF_FAILED(CreateMappedRegisters(midiInPipe->RegistersBuffer.get(), &midiInPipe->Registers));
+        RETURN_IF_FAILED(CreateMappedRegisters(midiInPipe->RegistersBuffer.get(), midiInPipe->Data.BufferSize, &midiInPipe->Registers));
     }
 
     if (Flow == MidiFlowBidirectional || Flow == MidiFlowOut)
@@ -115,10 +123,12 @@ CMidi2MidiSrv::Initialize(
         client->MidiOutRegisterFileMapping = NULL;
         midiOutPipe->WriteEvent.reset(client->MidiOutWriteEvent);
         client->MidiOutWriteEvent = NULL;
+        midiOutPipe->SpaceAvailableEvent.reset(client->MidiOutSpaceAvailableEvent);
+        client->MidiOutSpaceAvailableEvent = NULL;
         midiOutPipe->Data.BufferSize = client->MidiOutBufferSize;
         // Midi out controls, buffering, and eventing
         RETURN_IF_FAILED(CreateMappedDataBuffer(0, midiOutPipe->DataBuffer.get(), &midiOutPipe->Data));
-        RETURN_IF_FAILED(CreateMappedRegisters(midiOutPipe->RegistersBuffer.get(), &midiOutPipe->Registers));
+        RETURN_IF_FAILED(CreateMappedRegisters(midiOutPipe->RegistersBuffer.get(), midiOutPipe->Data.BufferSize, &midiOutPipe->Registers));
     }
 
     MIDL_user_free(client);
@@ -189,3 +199,151 @@ CMidi2MidiSrv::SendMidiMessage(
     return E_ABORT;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrv::SendMidiMessages(
+    PMIDIMESSAGEBATCHENTRY Messages,
+    UINT32 MessageCount,
+    UINT32* SentCount
+)
+{
+    RETURN_HR_IF_NULL(E_POINTER, SentCount);
+
+    *SentCount = 0;
+
+    if (m_MidiPump)
+    {
+        return m_MidiPump->SendMidiMessages(Messages, MessageCount, MIDI_XPROC_DEFAULT_SEND_TIMEOUT_MS, *SentCount);
+    }
+
+    return E_ABORT;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrv::CancelScheduledMessages(
+    PMIDI_SCHEDULED_MESSAGE_FILTER Filter,
+    UINT32* RemovedCount
+)
+{
+    TraceLoggingWrite(
+        MidiSrvAbstractionTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingPointer(this, "this")
+        );
+
+    RETURN_HR_IF_NULL(E_INVALIDARG, Filter);
+    RETURN_HR_IF_NULL(E_POINTER, RemovedCount);
+
+    *RemovedCount = 0;
+
+    RETURN_HR_IF(E_ABORT, !m_MidiPump || 0 == m_ClientHandle);
+
+    // Messages we've sent but the service hasn't read yet would miss the cancel, and
+    // be scheduled after it. Once the service has read them, they're in the scheduler.
+    RETURN_IF_FAILED(m_MidiPump->WaitForMidiOutEmpty(MIDISRV_CANCEL_SEND_QUEUE_TIMEOUT_MS));
+
+    wil::unique_rpc_binding bindingHandle;
+
+    RETURN_IF_FAILED(GetMidiSrvBindingHandle(&bindingHandle));
+
+    RETURN_IF_FAILED([&]()
+    {
+        // RPC calls are placed in a lambda to work around compiler error C2712, limiting use of try/except blocks
+        // with structured exception handling.
+        RpcTryExcept RETURN_IF_FAILED(MidiSrvCancelScheduledMessages(bindingHandle.get(), m_ClientHandle, Filter, RemovedCount));
+        RpcExcept(I_RpcExceptionFilter(RpcExceptionCode())) RETURN_IF_FAILED(HRESULT_FROM_WIN32(RpcExceptionCode()));
+        RpcEndExcept
+        return S_OK;
+    }());
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrv::SetSubscriptionFilter(
+    PMIDI_SUBSCRIPTION_FILTER Filter
+)
+{
+    TraceLoggingWrite(
+        MidiSrvAbstractionTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingPointer(this, "this")
+        );
+
+    RETURN_HR_IF_NULL(E_INVALIDARG, Filter);
+    RETURN_HR_IF(E_ABORT, 0 == m_ClientHandle);
+
+    wil::unique_rpc_binding bindingHandle;
+
+    RETURN_IF_FAILED(GetMidiSrvBindingHandle(&bindingHandle));
+
+    RETURN_IF_FAILED([&]()
+    {
+        // RPC calls are placed in a lambda to work around compiler error C2712, limiting use of try/except blocks
+        // with structured exception handling.
+        RpcTryExcept RETURN_IF_FAILED(MidiSrvSetSubscriptionFilter(bindingHandle.get(), m_ClientHandle, Filter));
+        RpcExcept(I_RpcExceptionFilter(RpcExceptionCode())) RETURN_IF_FAILED(HRESULT_FROM_WIN32(RpcExceptionCode()));
+        RpcEndExcept
+        return S_OK;
+    }());
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrv::GetPipeStatistics(
+    PMIDI_PIPE_STATISTICS MidiIn,
+    PMIDI_PIPE_STATISTICS MidiOut
+)
+{
+    RETURN_HR_IF_NULL(E_POINTER, MidiIn);
+    RETURN_HR_IF_NULL(E_POINTER, MidiOut);
+    RETURN_HR_IF(E_ABORT, !m_MidiPump);
+
+    return m_MidiPump->GetStatistics(*MidiIn, *MidiOut);
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrv::GetServicePipeStatistics(
+    PMIDI_PIPE_STATISTICS ClientMidiIn,
+    PMIDI_PIPE_STATISTICS ClientMidiOut,
+    PMIDI_PIPE_STATISTICS DeviceMidiIn,
+    PMIDI_PIPE_STATISTICS DeviceMidiOut
+)
+{
+    TraceLoggingWrite(
+        MidiSrvAbstractionTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingPointer(this, "this")
+        );
+
+    RETURN_HR_IF_NULL(E_POINTER, ClientMidiIn);
+    RETURN_HR_IF_NULL(E_POINTER, ClientMidiOut);
+    RETURN_HR_IF_NULL(E_POINTER, DeviceMidiIn);
+    RETURN_HR_IF_NULL(E_POINTER, DeviceMidiOut);
+    RETURN_HR_IF(E_ABORT, 0 == m_ClientHandle);
+
+    wil::unique_rpc_binding bindingHandle;
+
+    RETURN_IF_FAILED(GetMidiSrvBindingHandle(&bindingHandle));
+
+    RETURN_IF_FAILED([&]()
+    {
+        // RPC calls are placed in a lambda to work around compiler error C2712, limiting use of try/except blocks
+        // with structured exception handling.
+        RpcTryExcept RETURN_IF_FAILED(MidiSrvGetPipeStatistics(bindingHandle.get(), m_ClientHandle, ClientMidiIn, ClientMidiOut, DeviceMidiIn, DeviceMidiOut));
+        RpcExcept(I_RpcExceptionFilter(RpcExceptionCode())) RETURN_IF_FAILED(HRESULT_FROM_WIN32(RpcExceptionCode()));
+        RpcEndExcept
+        return S_OK;
+    }());
+
+    return S_OK;
+}
+
@@ -14,6 +14,11 @@ public:
 
     STDMETHOD(Initialize(_In_ LPCWSTR, _In_ MidiFlow, _In_ PABSTRACTIONCREATIONPARAMS, _In_ DWORD *, _In_opt_ IMidiCallback *, _In_ LONGLONG, _In_ GUID SessionId));
     STDMETHOD(SendMidiMessage(_In_ PVOID message, _In_ UINT size, _In_ LONGLONG));
+    STDMETHOD(CancelScheduledMessages(_In_ PMIDI_SCHEDULED_MESSAGE_FILTER, _Out_ UINT32*));
+    STDMETHOD(SetSubscriptionFilter(_In_ PMIDI_SUBSCRIPTION_FILTER));
+    STDMETHOD(SendMidiMessages(_In_reads_(messageCount) PMIDIMESSAGEBATCHENTRY, _In_ UINT32 messageCount, _Out_ UINT32*));
+    STDMETHOD(GetPipeStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS));
+    STDMETHOD(GetServicePipeStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS));
     STDMETHOD(Cleanup)();
 
 private:
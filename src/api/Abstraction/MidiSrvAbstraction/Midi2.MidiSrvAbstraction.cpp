@@ -88,6 +88,20 @@ CMidi2MidiSrvAbstraction::Activate(
         RETURN_IF_FAILED(Microsoft::WRL::MakeAndInitialize<CMidi2MidiSrvSessionTracker>(&config));
         *Interface = config.detach();
     }
+    else if (__uuidof(IMidiEndpointMetrics) == Iid)
+    {
+        TraceLoggingWrite(
+            MidiSrvAbstractionTelemetryProvider::Provider(),
+            __FUNCTION__ "- IMidiEndpointMetrics",
+            TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+            TraceLoggingValue(__FUNCTION__),
+            TraceLoggingPointer(this, "this")
+        );
+
+        wil::com_ptr_nothrow<IMidiEndpointMetrics> metrics;
+        RETURN_IF_FAILED(Microsoft::WRL::MakeAndInitialize<CMidi2MidiSrvEndpointMetrics>(&metrics));
+        *Interface = metrics.detach();
+    }
     else
     {
         return E_NOINTERFACE;
@@ -76,3 +76,79 @@ CMidi2MidiSrvBiDi::SendMidiMessage(
     return E_ABORT;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvBiDi::CancelScheduledMessages(
+    PMIDI_SCHEDULED_MESSAGE_FILTER Filter,
+    UINT32* RemovedCount
+)
+{
+    if (m_MidiSrv)
+    {
+        return m_MidiSrv->CancelScheduledMessages(Filter, RemovedCount);
+    }
+
+    return E_ABORT;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvBiDi::SendMidiMessages(
+    PMIDIMESSAGEBATCHENTRY Messages,
+    UINT32 MessageCount,
+    UINT32* SentCount
+)
+{
+    if (m_MidiSrv)
+    {
+        return m_MidiSrv->SendMidiMessages(Messages, MessageCount, SentCount);
+    }
+
+    return E_ABORT;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvBiDi::GetPipeStatistics(
+    PMIDI_PIPE_STATISTICS MidiIn,
+    PMIDI_PIPE_STATISTICS MidiOut
+)
+{
+    if (m_MidiSrv)
+    {
+        return m_MidiSrv->GetPipeStatistics(MidiIn, MidiOut);
+    }
+
+    return E_ABORT;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvBiDi::GetServicePipeStatistics(
+    PMIDI_PIPE_STATISTICS ClientMidiIn,
+    PMIDI_PIPE_STATISTICS ClientMidiOut,
+    PMIDI_PIPE_STATISTICS DeviceMidiIn,
+    PMIDI_PIPE_STATISTICS DeviceMidiOut
+)
+{
+    if (m_MidiSrv)
+    {
+        return m_MidiSrv->GetServicePipeStatistics(ClientMidiIn, ClientMidiOut, DeviceMidiIn, DeviceMidiOut);
+    }
+
+    return E_ABORT;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvBiDi::SetSubscriptionFilter(
+    PMIDI_SUBSCRIPTION_FILTER Filter
+)
+{
+    if (m_MidiSrv)
+    {
+        return m_MidiSrv->SetSubscriptionFilter(Filter);
+    }
+
+    return E_ABORT;
+}
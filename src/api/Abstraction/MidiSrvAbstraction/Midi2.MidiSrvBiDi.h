@@ -11,11 +11,21 @@
 class CMidi2MidiSrvBiDi : 
     public Microsoft::WRL::RuntimeClass<
         Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
-        IMidiBiDi>
+        IMidiBiDi,
+        IMidiScheduledMessageControl,
+        IMidiBatchSend,
+        IMidiPipeStatistics,
+        IMidiServicePipeStatistics,
+        IMidiSubscriptionControl>
 {
 public:
     STDMETHOD(Initialize(_In_ LPCWSTR, _In_ PABSTRACTIONCREATIONPARAMS, _In_ DWORD *, _In_opt_ IMidiCallback *, _In_ LONGLONG, _In_ GUID));
     STDMETHOD(SendMidiMessage(_In_ PVOID message, _In_ UINT size, _In_ LONGLONG));
+    STDMETHOD(CancelScheduledMessages(_In_ PMIDI_SCHEDULED_MESSAGE_FILTER, _Out_ UINT32*));
+    STDMETHOD(SendMidiMessages(_In_reads_(messageCount) PMIDIMESSAGEBATCHENTRY, _In_ UINT32 messageCount, _Out_ UINT32*));
+    STDMETHOD(GetPipeStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS));
+    STDMETHOD(GetServicePipeStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS));
+    STDMETHOD(SetSubscriptionFilter(_In_ PMIDI_SUBSCRIPTION_FILTER));
     STDMETHOD(Cleanup)();
 
 private:
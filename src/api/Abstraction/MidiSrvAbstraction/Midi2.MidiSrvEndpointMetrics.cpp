@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#include "pch.h"
+
+
+HRESULT
+CMidi2MidiSrvEndpointMetrics::Initialize()
+{
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvEndpointMetrics::SetCalculatedOutputLatency(
+    LPCWSTR EndpointDeviceInterfaceId,
+    ULONGLONG LatencyTicks
+)
+{
+    TraceLoggingWrite(
+        MidiSrvAbstractionTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingPointer(this, "this")
+    );
+
+    wil::unique_rpc_binding bindingHandle;
+
+    RETURN_IF_FAILED(GetMidiSrvBindingHandle(&bindingHandle));
+    RETURN_HR_IF_NULL(E_INVALIDARG, EndpointDeviceInterfaceId);
+
+    RETURN_IF_FAILED([&]()
+        {
+            // RPC calls are placed in a lambda to work around compiler error C2712, limiting use of try/except blocks
+            // with structured exception handling.
+            RpcTryExcept RETURN_IF_FAILED(MidiSrvSetCalculatedOutputLatency(bindingHandle.get(), EndpointDeviceInterfaceId, LatencyTicks));
+            RpcExcept(I_RpcExceptionFilter(RpcExceptionCode())) RETURN_IF_FAILED(HRESULT_FROM_WIN32(RpcExceptionCode()));
+            RpcEndExcept
+
+            return S_OK;
+        }());
+
+    return S_OK;
+}
+
+HRESULT
+CMidi2MidiSrvEndpointMetrics::Cleanup()
+{
+    return S_OK;
+}
@@ -0,0 +1,26 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#pragma once
+
+class CMidi2MidiSrvEndpointMetrics :
+    public Microsoft::WRL::RuntimeClass<
+    Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+    IMidiEndpointMetrics>
+{
+public:
+    STDMETHOD(Initialize());
+
+    // This is called from the API after measuring the latency
+    STDMETHOD(SetCalculatedOutputLatency(_In_ LPCWSTR EndpointDeviceInterfaceId, _In_ ULONGLONG LatencyTicks));
+
+    STDMETHOD(Cleanup());
+
+private:
+
+};
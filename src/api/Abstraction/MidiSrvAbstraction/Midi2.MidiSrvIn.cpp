@@ -60,3 +60,48 @@ CMidi2MidiSrvIn::Cleanup()
     return S_OK;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvIn::GetPipeStatistics(
+    PMIDI_PIPE_STATISTICS MidiIn,
+    PMIDI_PIPE_STATISTICS MidiOut
+)
+{
+    if (m_MidiSrv)
+    {
+        return m_MidiSrv->GetPipeStatistics(MidiIn, MidiOut);
+    }
+
+    return E_ABORT;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvIn::GetServicePipeStatistics(
+    PMIDI_PIPE_STATISTICS ClientMidiIn,
+    PMIDI_PIPE_STATISTICS ClientMidiOut,
+    PMIDI_PIPE_STATISTICS DeviceMidiIn,
+    PMIDI_PIPE_STATISTICS DeviceMidiOut
+)
+{
+    if (m_MidiSrv)
+    {
+        return m_MidiSrv->GetServicePipeStatistics(ClientMidiIn, ClientMidiOut, DeviceMidiIn, DeviceMidiOut);
+    }
+
+    return E_ABORT;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvIn::SetSubscriptionFilter(
+    PMIDI_SUBSCRIPTION_FILTER Filter
+)
+{
+    if (m_MidiSrv)
+    {
+        return m_MidiSrv->SetSubscriptionFilter(Filter);
+    }
+
+    return E_ABORT;
+}
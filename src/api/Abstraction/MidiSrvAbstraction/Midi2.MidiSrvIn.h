@@ -4,10 +4,16 @@
 class CMidi2MidiSrvIn : 
     public Microsoft::WRL::RuntimeClass<
         Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
-        IMidiIn>
+        IMidiIn,
+        IMidiPipeStatistics,
+        IMidiServicePipeStatistics,
+        IMidiSubscriptionControl>
 {
 public:
     STDMETHOD(Initialize(_In_ LPCWSTR, _In_ PABSTRACTIONCREATIONPARAMS, _In_ DWORD *, _In_opt_ IMidiCallback *, _In_ LONGLONG, _In_ GUID));
+    STDMETHOD(GetPipeStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS));
+    STDMETHOD(GetServicePipeStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS));
+    STDMETHOD(SetSubscriptionFilter(_In_ PMIDI_SUBSCRIPTION_FILTER));
     STDMETHOD(Cleanup)();
 
 private:
@@ -73,3 +73,65 @@ CMidi2MidiSrvOut::SendMidiMessage(
     return E_ABORT;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvOut::CancelScheduledMessages(
+    PMIDI_SCHEDULED_MESSAGE_FILTER Filter,
+    UINT32* RemovedCount
+)
+{
+    if (m_MidiSrv)
+    {
+        return m_MidiSrv->CancelScheduledMessages(Filter, RemovedCount);
+    }
+
+    return E_ABORT;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvOut::SendMidiMessages(
+    PMIDIMESSAGEBATCHENTRY Messages,
+    UINT32 MessageCount,
+    UINT32* SentCount
+)
+{
+    if (m_MidiSrv)
+    {
+        return m_MidiSrv->SendMidiMessages(Messages, MessageCount, SentCount);
+    }
+
+    return E_ABORT;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvOut::GetPipeStatistics(
+    PMIDI_PIPE_STATISTICS MidiIn,
+    PMIDI_PIPE_STATISTICS MidiOut
+)
+{
+    if (m_MidiSrv)
+    {
+        return m_MidiSrv->GetPipeStatistics(MidiIn, MidiOut);
+    }
+
+    return E_ABORT;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidi2MidiSrvOut::GetServicePipeStatistics(
+    PMIDI_PIPE_STATISTICS ClientMidiIn,
+    PMIDI_PIPE_STATISTICS ClientMidiOut,
+    PMIDI_PIPE_STATISTICS DeviceMidiIn,
+    PMIDI_PIPE_STATISTICS DeviceMidiOut
+)
+{
+    if (m_MidiSrv)
+    {
+        return m_MidiSrv->GetServicePipeStatistics(ClientMidiIn, ClientMidiOut, DeviceMidiIn, DeviceMidiOut);
+    }
+
+    return E_ABORT;
+}
@@ -4,11 +4,19 @@
 class CMidi2MidiSrvOut : 
     public Microsoft::WRL::RuntimeClass<
         Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
-        IMidiOut>
+        IMidiOut,
+        IMidiScheduledMessageControl,
+        IMidiBatchSend,
+        IMidiPipeStatistics,
+        IMidiServicePipeStatistics>
 {
 public:
     STDMETHOD(Initialize(_In_ LPCWSTR, _In_ PABSTRACTIONCREATIONPARAMS, _In_ DWORD *, _In_ GUID));
     STDMETHOD(SendMidiMessage(_In_ PVOID message, _In_ UINT size, _In_ LONGLONG));
+    STDMETHOD(CancelScheduledMessages(_In_ PMIDI_SCHEDULED_MESSAGE_FILTER, _Out_ UINT32*));
+    STDMETHOD(SendMidiMessages(_In_reads_(messageCount) PMIDIMESSAGEBATCHENTRY, _In_ UINT32 messageCount, _Out_ UINT32*));
+    STDMETHOD(GetPipeStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS));
+    STDMETHOD(GetServicePipeStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS));
     STDMETHOD(Cleanup)();
 
 private:
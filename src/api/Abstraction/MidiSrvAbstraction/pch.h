@@ -60,4 +60,5 @@ using namespace winrt;
 #include "Midi2.MidiSrvBiDi.h"
 #include "Midi2.MidiSrvConfigurationManager.h"
 #include "Midi2.MidiSrvSessionTracker.h"
+#include "Midi2.MidiSrvEndpointMetrics.h"
 
@@ -10,6 +10,8 @@
 #include "MidiEndpointConnection.h"
 #include "MidiEndpointConnection.g.cpp"
 
+#include "MidiEndpointConnectionStatistics.h"
+
 
 
 
@@ -195,6 +197,7 @@ namespace winrt::Windows::Devices::Midi2::implementation
 
                     DWORD mmcssTaskId{};  
                     ABSTRACTIONCREATIONPARAMS abstractionCreationParams{ MidiDataFormat_UMP };
+                    abstractionCreationParams.DeliveryOverflowPolicy = (MidiDeliveryOverflowPolicy)m_incomingMessageOverflowPolicy;
 
                     winrt::check_hresult(m_endpointAbstraction->Initialize(
                         (LPCWSTR)(EndpointDeviceId().c_str()),
@@ -208,6 +211,16 @@ namespace winrt::Windows::Devices::Midi2::implementation
                     // provide a copy to the output logic
                     m_isOpen = true;
 
+                    // a filter set before we were open. Not fatal if it fails, we just
+                    // get more messages than we asked for
+                    if (m_subscriptionFilter.GroupMask != MIDI_SUBSCRIPTION_FILTER_ALL ||
+                        m_subscriptionFilter.ChannelMask != MIDI_SUBSCRIPTION_FILTER_ALL ||
+                        m_subscriptionFilter.MessageTypeMask != MIDI_SUBSCRIPTION_FILTER_ALL ||
+                        !m_subscriptionFilter.IncludeStreamMessages)
+                    {
+                        ApplySubscriptionFilter();
+                    }
+
                     CallOnConnectionOpenedOnPlugins();
 
                     return true;
@@ -866,17 +879,154 @@ namespace winrt::Windows::Devices::Midi2::implementation
 
 
 
+    // Sends every UMP in the words, all with the same timestamp. The words are checked
+    // up front, so nothing is sent unless they split cleanly into whole messages. When
+    // the endpoint supports it, the messages all go to the service in one write.
+    // A send can still fail part way, for example when the buffer to the service stays
+    // full, so sentMessageCount is how many of the messages, from the start, went out.
+    _Use_decl_annotations_
+    midi2::MidiSendMessageResult MidiEndpointConnection::SendMessagesRaw(
+        internal::MidiTimestamp timestamp,
+        uint32_t const* words,
+        uint32_t wordCount,
+        uint32_t& sentMessageCount) noexcept
+    {
+        internal::LogInfo(__FUNCTION__, L"Sending multiple messages");
+
+        sentMessageCount = 0;
+
+        try
+        {
+            if (!m_isOpen || m_endpointAbstraction == nullptr)
+            {
+                internal::LogGeneralError(__FUNCTION__, L"Endpoint is not open. Did you forget to call Open()?");
+
+                // return failure if we're not open
+                return midi2::MidiSendMessageResult::Failed | midi2::MidiSendMessageResult::EndpointConnectionClosedOrInvalid;
+            }
+
+            if (timestamp != 0 && timestamp > ::Windows::Devices::Midi2::Internal::Shared::GetCurrentMidiTimestamp() + m_maxAllowedTimestampOffset)
+            {
+                internal::LogGeneralError(__FUNCTION__, L"Timestamp exceeds maximum future scheduling offset");
+
+                return midi2::MidiSendMessageResult::Failed | midi2::MidiSendMessageResult::TimestampOutOfRange;
+            }
+
+            // one pass over the words finds where every message starts
+            std::vector<uint32_t> boundaries(wordCount);
+            uint32_t scannedWordCount{ 0 };
+
+            uint32_t messageCount = internal::FindUmpBoundaries(words, wordCount, boundaries.data(), wordCount, scannedWordCount);
+
+            if (scannedWordCount != wordCount)
+            {
+                internal::LogUmpSizeValidationError(__FUNCTION__, L"Last message is missing words", wordCount - scannedWordCount, timestamp);
+
+                return midi2::MidiSendMessageResult::Failed | midi2::MidiSendMessageResult::InvalidMessageTypeForWordCount;
+            }
+
+            if (messageCount == 0)
+            {
+                return midi2::MidiSendMessageResult::Succeeded;
+            }
+
+            std::vector<MIDIMESSAGEBATCHENTRY> messages(messageCount);
+
+            for (uint32_t i = 0; i < messageCount; i++)
+            {
+                uint32_t messageEnd = (i + 1 < messageCount) ? boundaries[i + 1] : scannedWordCount;
+
+                messages[i] = MIDIMESSAGEBATCHENTRY{ (LONGLONG)timestamp, (PVOID)(words + boundaries[i]), (UINT)((messageEnd - boundaries[i]) * sizeof(uint32_t)) };
+            }
+
+            auto batchSend = m_endpointAbstraction.try_as<IMidiBatchSend>();
+
+            if (batchSend != nullptr)
+            {
+                UINT32 sentCount{ 0 };
+
+                auto hr = batchSend->SendMidiMessages(messages.data(), (UINT32)messages.size(), &sentCount);
+
+                sentMessageCount = sentCount;
+
+                return SendMessageResultFromHRESULT(hr);
+            }
+
+            // endpoint can only take one message at a time
+            for (auto const& message : messages)
+            {
+                auto hr = m_endpointAbstraction->SendMidiMessage(message.Data, message.ByteCount, message.Position);
+
+                if (FAILED(hr))
+                {
+                    return SendMessageResultFromHRESULT(hr);
+                }
+
+                sentMessageCount++;
+            }
+
+            return midi2::MidiSendMessageResult::Succeeded;
+        }
+        catch (winrt::hresult_error const& ex)
+        {
+            internal::LogHresultError(__FUNCTION__, L"hresult error sending messages. Is the service running?", ex);
+
+            return midi2::MidiSendMessageResult::Failed | midi2::MidiSendMessageResult::Other;
+        }
+        catch (std::bad_alloc const&)
+        {
+            internal::LogGeneralError(__FUNCTION__, L"Out of memory sending messages");
+
+            return midi2::MidiSendMessageResult::Failed | midi2::MidiSendMessageResult::Other;
+        }
+    }
+
+
     _Use_decl_annotations_
     midi2::MidiSendMessageResult MidiEndpointConnection::SendMessagesWordList(
         internal::MidiTimestamp timestamp,
         collections::IVectorView<uint32_t> const& words) noexcept
     {
-        UNREFERENCED_PARAMETER(timestamp);
-        UNREFERENCED_PARAMETER(words);
+        uint32_t sentMessageCount{ 0 };
+
+        return SendMessagesWordList(timestamp, words, sentMessageCount);
+    }
+
+    _Use_decl_annotations_
+    midi2::MidiSendMessageResult MidiEndpointConnection::SendMessagesWordList(
+        internal::MidiTimestamp timestamp,
+        collections::IVectorView<uint32_t> const& words,
+        uint32_t& sentMessageCount) noexcept
+    {
+        internal::LogInfo(__FUNCTION__, L"Sending messages word list");
 
-        // TODO: Implement SendMessagesWordList
+        sentMessageCount = 0;
+
+        try
+        {
+            // the list may live in another process or be computed on the fly, so pull
+            // all the words across in one call
+            std::vector<uint32_t> localWords(words.Size());
+
+            if (!localWords.empty())
+            {
+                words.GetMany(0, localWords);
+            }
+
+            return SendMessagesRaw(timestamp, localWords.data(), (uint32_t)localWords.size(), sentMessageCount);
+        }
+        catch (winrt::hresult_error const& ex)
+        {
+            internal::LogHresultError(__FUNCTION__, L"hresult exception reading word list", ex);
+
+            return midi2::MidiSendMessageResult::Failed | midi2::MidiSendMessageResult::Other;
+        }
+        catch (std::bad_alloc const&)
+        {
+            internal::LogGeneralError(__FUNCTION__, L"Out of memory copying word list");
 
-        return midi2::MidiSendMessageResult::Succeeded;
+            return midi2::MidiSendMessageResult::Failed | midi2::MidiSendMessageResult::Other;
+        }
     }
 
 
@@ -887,12 +1037,261 @@ namespace winrt::Windows::Devices::Midi2::implementation
         internal::MidiTimestamp timestamp,
         winrt::array_view<uint32_t const> words) noexcept
     {
-        UNREFERENCED_PARAMETER(timestamp);
-        UNREFERENCED_PARAMETER(words);
+        uint32_t sentMessageCount{ 0 };
+
+        return SendMessagesWordArray(timestamp, words, sentMessageCount);
+    }
+
+    _Use_decl_annotations_
+    midi2::MidiSendMessageResult MidiEndpointConnection::SendMessagesWordArray(
+        internal::MidiTimestamp timestamp,
+        winrt::array_view<uint32_t const> words,
+        uint32_t& sentMessageCount) noexcept
+    {
+        internal::LogInfo(__FUNCTION__, L"Sending messages word array");
+
+        return SendMessagesRaw(timestamp, words.data(), words.size(), sentMessageCount);
+    }
+
+
+
+    uint32_t MidiEndpointConnection::CancelScheduledMessages() noexcept
+    {
+        internal::LogInfo(__FUNCTION__, L"Cancelling all scheduled messages");
+
+        MIDI_SCHEDULED_MESSAGE_FILTER filter{};
+
+        filter.GroupMask = MIDI_SCHEDULED_MESSAGE_FILTER_ALL;
+        filter.ChannelMask = MIDI_SCHEDULED_MESSAGE_FILTER_ALL;
+        filter.MessageTypeMask = MIDI_SCHEDULED_MESSAGE_FILTER_ALL;
+        filter.EarliestTimestamp = 0;
+        filter.LatestTimestamp = UINT64_MAX;
+
+        return CancelScheduledMessagesInternal(filter);
+    }
+
+    _Use_decl_annotations_
+    uint32_t MidiEndpointConnection::CancelScheduledMessages(
+        midi2::MidiScheduledMessageFilter const& filter) noexcept
+    {
+        internal::LogInfo(__FUNCTION__, L"Cancelling filtered scheduled messages");
 
-        // TODO: Implement SendMessagesWordArray
+        try
+        {
+            MIDI_SCHEDULED_MESSAGE_FILTER serviceFilter{};
+
+            // an empty list means everything
+            for (auto const& group : filter.IncludeGroups())
+            {
+                serviceFilter.GroupMask |= (USHORT)(1 << group.Index());
+            }
 
-        return midi2::MidiSendMessageResult::Succeeded;
+            for (auto const& channel : filter.IncludeChannels())
+            {
+                serviceFilter.ChannelMask |= (USHORT)(1 << channel.Index());
+            }
+
+            for (auto const& messageType : filter.IncludeMessageTypes())
+            {
+                serviceFilter.MessageTypeMask |= (USHORT)(1 << ((uint8_t)messageType & 0x0F));
+            }
+
+            if (serviceFilter.GroupMask == 0) serviceFilter.GroupMask = MIDI_SCHEDULED_MESSAGE_FILTER_ALL;
+            if (serviceFilter.ChannelMask == 0) serviceFilter.ChannelMask = MIDI_SCHEDULED_MESSAGE_FILTER_ALL;
+            if (serviceFilter.MessageTypeMask == 0) serviceFilter.MessageTypeMask = MIDI_SCHEDULED_MESSAGE_FILTER_ALL;
+
+            serviceFilter.EarliestTimestamp = filter.EarliestTimestamp();
+            serviceFilter.LatestTimestamp = filter.LatestTimestamp();
+
+            return CancelScheduledMessagesInternal(serviceFilter);
+        }
+        catch (winrt::hresult_error const& ex)
+        {
+            internal::LogHresultError(__FUNCTION__, L"hresult exception reading filter", ex);
+
+            return 0;
+        }
+    }
+
+    _Use_decl_annotations_
+    uint32_t MidiEndpointConnection::CancelScheduledMessagesInternal(
+        MIDI_SCHEDULED_MESSAGE_FILTER& filter) noexcept
+    {
+        if (!m_isOpen)
+        {
+            internal::LogGeneralError(__FUNCTION__, L"Endpoint is not open. Did you forget to call Open()?");
+
+            return 0;
+        }
+
+        try
+        {
+            auto control = m_endpointAbstraction.try_as<IMidiScheduledMessageControl>();
+
+            if (control == nullptr)
+            {
+                internal::LogGeneralError(__FUNCTION__, L"Endpoint does not support cancelling scheduled messages");
+
+                return 0;
+            }
+
+            UINT32 removedCount{ 0 };
+
+            // this waits for the service to pick up everything we've already sent, so
+            // a message sent just before the cancel can't slip in behind it
+            winrt::check_hresult(control->CancelScheduledMessages(&filter, &removedCount));
+
+            return removedCount;
+        }
+        catch (winrt::hresult_error const& ex)
+        {
+            internal::LogHresultError(__FUNCTION__, L"hresult error cancelling scheduled messages. Is the service running?", ex);
+
+            return 0;
+        }
+    }
+
+    _Use_decl_annotations_
+    bool MidiEndpointConnection::SetSubscriptionFilter(
+        midi2::MidiSubscriptionFilter const& filter) noexcept
+    {
+        internal::LogInfo(__FUNCTION__, L"Setting subscription filter");
+
+        try
+        {
+            MIDI_SUBSCRIPTION_FILTER serviceFilter{};
+
+            // an empty list means everything
+            for (auto const& group : filter.IncludeGroups())
+            {
+                serviceFilter.GroupMask |= (USHORT)(1 << group.Index());
+            }
+
+            for (auto const& channel : filter.IncludeChannels())
+            {
+                serviceFilter.ChannelMask |= (USHORT)(1 << channel.Index());
+            }
+
+            for (auto const& messageType : filter.IncludeMessageTypes())
+            {
+                serviceFilter.MessageTypeMask |= (USHORT)(1 << ((uint8_t)messageType & 0x0F));
+            }
+
+            if (serviceFilter.GroupMask == 0) serviceFilter.GroupMask = MIDI_SUBSCRIPTION_FILTER_ALL;
+            if (serviceFilter.ChannelMask == 0) serviceFilter.ChannelMask = MIDI_SUBSCRIPTION_FILTER_ALL;
+            if (serviceFilter.MessageTypeMask == 0) serviceFilter.MessageTypeMask = MIDI_SUBSCRIPTION_FILTER_ALL;
+
+            serviceFilter.IncludeStreamMessages = filter.IncludeStreamMessages();
+
+            m_subscriptionFilter = serviceFilter;
+        }
+        catch (winrt::hresult_error const& ex)
+        {
+            internal::LogHresultError(__FUNCTION__, L"hresult exception reading filter", ex);
+
+            return false;
+        }
+
+        // otherwise, Open() passes it on
+        return m_isOpen ? ApplySubscriptionFilter() : true;
+    }
+
+    bool MidiEndpointConnection::ClearSubscriptionFilter() noexcept
+    {
+        internal::LogInfo(__FUNCTION__, L"Clearing subscription filter");
+
+        m_subscriptionFilter.GroupMask = MIDI_SUBSCRIPTION_FILTER_ALL;
+        m_subscriptionFilter.ChannelMask = MIDI_SUBSCRIPTION_FILTER_ALL;
+        m_subscriptionFilter.MessageTypeMask = MIDI_SUBSCRIPTION_FILTER_ALL;
+        m_subscriptionFilter.IncludeStreamMessages = TRUE;
+
+        return m_isOpen ? ApplySubscriptionFilter() : true;
+    }
+
+    bool MidiEndpointConnection::ApplySubscriptionFilter() noexcept
+    {
+        try
+        {
+            auto control = m_endpointAbstraction.try_as<IMidiSubscriptionControl>();
+
+            if (control == nullptr)
+            {
+                internal::LogGeneralError(__FUNCTION__, L"Endpoint does not support subscription filters");
+
+                return false;
+            }
+
+            winrt::check_hresult(control->SetSubscriptionFilter(&m_subscriptionFilter));
+
+            return true;
+        }
+        catch (winrt::hresult_error const& ex)
+        {
+            internal::LogHresultError(__FUNCTION__, L"hresult error setting subscription filter. Is the service running?", ex);
+
+            return false;
+        }
+    }
+
+    midi2::MidiEndpointConnectionStatistics MidiEndpointConnection::GetStatistics() noexcept
+    {
+        MIDI_PIPE_STATISTICS clientMidiIn{};
+        MIDI_PIPE_STATISTICS clientMidiOut{};
+        MIDI_PIPE_STATISTICS serviceMidiIn{};
+        MIDI_PIPE_STATISTICS serviceMidiOut{};
+        MIDI_PIPE_STATISTICS endpointMidiIn{};
+        MIDI_PIPE_STATISTICS endpointMidiOut{};
+
+        try
+        {
+            auto statistics = winrt::make_self<implementation::MidiEndpointConnectionStatistics>();
+
+            if (!m_isOpen)
+            {
+                internal::LogGeneralError(__FUNCTION__, L"Endpoint is not open. Did you forget to call Open()?");
+            }
+            else
+            {
+                // our own ends of the buffers to the service
+                auto local = m_endpointAbstraction.try_as<IMidiPipeStatistics>();
+
+                if (local == nullptr || FAILED(local->GetPipeStatistics(&clientMidiIn, &clientMidiOut)))
+                {
+                    clientMidiIn = {};
+                    clientMidiOut = {};
+                }
+
+                // and the service's ends, along with the buffers to the device
+                auto service = m_endpointAbstraction.try_as<IMidiServicePipeStatistics>();
+
+                if (service == nullptr || FAILED(service->GetServicePipeStatistics(&serviceMidiIn, &serviceMidiOut, &endpointMidiIn, &endpointMidiOut)))
+                {
+                    internal::LogGeneralError(__FUNCTION__, L"Unable to get statistics from the service");
+
+                    serviceMidiIn = {};
+                    serviceMidiOut = {};
+                    endpointMidiIn = {};
+                    endpointMidiOut = {};
+                }
+            }
+
+            statistics->InternalInitialize(
+                clientMidiIn, 
+                clientMidiOut, 
+                serviceMidiIn, 
+                serviceMidiOut, 
+                endpointMidiIn, 
+                endpointMidiOut, 
+                ::Windows::Devices::Midi2::Internal::Shared::GetCurrentMidiTimestamp());
+
+            return *statistics;
+        }
+        catch (winrt::hresult_error const& ex)
+        {
+            internal::LogHresultError(__FUNCTION__, L"hresult error getting statistics", ex);
+
+            return nullptr;
+        }
     }
 
 
@@ -46,6 +46,9 @@ namespace winrt::Windows::Devices::Midi2::implementation
         foundation::IInspectable Tag() const noexcept { return m_tag; }
         void Tag(_In_ foundation::IInspectable value) noexcept { m_tag = value; }
 
+        midi2::MidiIncomingMessageOverflowPolicy IncomingMessageOverflowPolicy() const noexcept { return m_incomingMessageOverflowPolicy; }
+        void IncomingMessageOverflowPolicy(_In_ midi2::MidiIncomingMessageOverflowPolicy const value) noexcept { m_incomingMessageOverflowPolicy = value; }
+
 
         bool InternalInitialize(
             _In_ winrt::guid sessionId,
@@ -107,6 +110,29 @@ namespace winrt::Windows::Devices::Midi2::implementation
             _In_ internal::MidiTimestamp timestamp, 
             _In_ winrt::array_view<uint32_t const> words) noexcept;
 
+        midi2::MidiSendMessageResult SendMessagesWordList(
+            _In_ internal::MidiTimestamp timestamp,
+            _In_ collections::IVectorView<uint32_t> const& words,
+            _Out_ uint32_t& sentMessageCount) noexcept;
+
+        midi2::MidiSendMessageResult SendMessagesWordArray(
+            _In_ internal::MidiTimestamp timestamp,
+            _In_ winrt::array_view<uint32_t const> words,
+            _Out_ uint32_t& sentMessageCount) noexcept;
+
+
+        uint32_t CancelScheduledMessages() noexcept;
+
+        uint32_t CancelScheduledMessages(
+            _In_ midi2::MidiScheduledMessageFilter const& filter) noexcept;
+
+        bool SetSubscriptionFilter(
+            _In_ midi2::MidiSubscriptionFilter const& filter) noexcept;
+
+        bool ClearSubscriptionFilter() noexcept;
+
+        midi2::MidiEndpointConnectionStatistics GetStatistics() noexcept;
+
 
         _Success_(return == true)
         bool Open();
@@ -143,6 +169,7 @@ namespace winrt::Windows::Devices::Midi2::implementation
         winrt::guid m_connectionId{};
         winrt::hstring m_endpointDeviceId{};
         winrt::Windows::Foundation::IInspectable m_tag{ nullptr };
+        midi2::MidiIncomingMessageOverflowPolicy m_incomingMessageOverflowPolicy{ midi2::MidiIncomingMessageOverflowPolicy::Default };
 
         bool m_isOpen{ false };
         bool m_closeHasBeenCalled{ false };
@@ -176,6 +203,12 @@ namespace winrt::Windows::Devices::Midi2::implementation
             _In_ uint8_t sizeInBytes,
             _In_ internal::MidiTimestamp timestamp);
 
+        midi2::MidiSendMessageResult SendMessagesRaw(
+            _In_ internal::MidiTimestamp timestamp,
+            _In_reads_(wordCount) uint32_t const* words,
+            _In_ uint32_t wordCount,
+            _Out_ uint32_t& sentMessageCount) noexcept;
+
         _Success_(return != nullptr)
         void* GetUmpDataPointer(
             _In_ midi2::IMidiUniversalPacket const& ump,
@@ -194,6 +227,15 @@ namespace winrt::Windows::Devices::Midi2::implementation
 
         midi2::MidiSendMessageResult SendMessageResultFromHRESULT(_In_ HRESULT hr);
 
+        uint32_t CancelScheduledMessagesInternal(
+            _In_ MIDI_SCHEDULED_MESSAGE_FILTER& filter) noexcept;
+
+        bool ApplySubscriptionFilter() noexcept;
+
+        // what SetSubscriptionFilter last asked for, so Open() can pass it on
+        MIDI_SUBSCRIPTION_FILTER m_subscriptionFilter
+            { MIDI_SUBSCRIPTION_FILTER_ALL, MIDI_SUBSCRIPTION_FILTER_ALL, MIDI_SUBSCRIPTION_FILTER_ALL, TRUE };
+
 
     };
 }
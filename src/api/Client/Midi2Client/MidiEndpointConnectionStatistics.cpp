@@ -0,0 +1,83 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#include "pch.h"
+#include "MidiEndpointConnectionStatistics.h"
+#include "MidiEndpointConnectionStatistics.g.cpp"
+
+
+namespace winrt::Windows::Devices::Midi2::implementation
+{
+    _Use_decl_annotations_
+    midi2::MidiEndpointPipeStatistics MidiEndpointConnectionStatistics::CombinePipeStatistics(
+        MIDI_PIPE_STATISTICS const& writer,
+        MIDI_PIPE_STATISTICS const& reader
+    ) noexcept
+    {
+        midi2::MidiEndpointPipeStatistics statistics{};
+
+        statistics.BufferSize = (std::max)(writer.BufferSize, reader.BufferSize);
+
+        // each end only sees the buffer when it reads the other end's position, so
+        // between them they get closer to the real high water mark
+        statistics.HighWaterMark = (std::max)(writer.HighWaterMark, reader.HighWaterMark);
+
+        // what actually made it through, unless we couldn't hear from the reader
+        MIDI_PIPE_STATISTICS const& counted = (reader.ElapsedTicks != 0) ? reader : writer;
+
+        statistics.MessageCount = counted.MessageCount;
+        statistics.ByteCount = counted.ByteCount;
+
+        if (counted.ElapsedTicks != 0)
+        {
+            double seconds = (double)counted.ElapsedTicks / ::Windows::Devices::Midi2::Internal::Shared::GetMidiTimestampFrequency();
+
+            statistics.MessagesPerSecond = counted.MessageCount / seconds;
+            statistics.BytesPerSecond = counted.ByteCount / seconds;
+        }
+
+        statistics.BufferFullCount = writer.BufferFullCount;
+        statistics.RetryCount = writer.RetryCount;
+        statistics.TimeoutCount = writer.TimeoutCount;
+
+        statistics.MaximumConsumerLag = reader.MaximumConsumerLag;
+
+        statistics.QueuedCount = writer.QueuedCount;
+        statistics.DroppedCount = writer.DroppedOldestCount + writer.DroppedNewestCount;
+        statistics.DeliveryStopped = writer.DeliveryStoppedCount != 0;
+        statistics.FilteredCount = writer.FilteredCount;
+
+        return statistics;
+    }
+
+    _Use_decl_annotations_
+    void MidiEndpointConnectionStatistics::InternalInitialize(
+        MIDI_PIPE_STATISTICS const& clientMidiIn,
+        MIDI_PIPE_STATISTICS const& clientMidiOut,
+        MIDI_PIPE_STATISTICS const& serviceMidiIn,
+        MIDI_PIPE_STATISTICS const& serviceMidiOut,
+        MIDI_PIPE_STATISTICS const& endpointMidiIn,
+        MIDI_PIPE_STATISTICS const& endpointMidiOut,
+        internal::MidiTimestamp const timestamp
+    ) noexcept
+    {
+        // The service writes our midi in and reads our midi out
+        m_midiIn = CombinePipeStatistics(serviceMidiIn, clientMidiIn);
+        m_midiOut = CombinePipeStatistics(clientMidiOut, serviceMidiOut);
+
+        // The service reads the endpoint's midi in and writes its midi out. The
+        // other end of those is the driver, which doesn't count anything.
+        MIDI_PIPE_STATISTICS const none{};
+
+        m_endpointMidiIn = CombinePipeStatistics(none, endpointMidiIn);
+        m_endpointMidiOut = CombinePipeStatistics(endpointMidiOut, none);
+
+        m_timestamp = timestamp;
+    }
+
+}
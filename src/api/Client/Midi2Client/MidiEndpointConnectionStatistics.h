@@ -0,0 +1,52 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#pragma once
+#include "MidiEndpointConnectionStatistics.g.h"
+
+#include "midi_service_interface.h"
+
+
+namespace winrt::Windows::Devices::Midi2::implementation
+{
+    struct MidiEndpointConnectionStatistics : MidiEndpointConnectionStatisticsT<MidiEndpointConnectionStatistics>
+    {
+        MidiEndpointConnectionStatistics() = default;
+
+        midi2::MidiEndpointPipeStatistics MidiIn() const noexcept { return m_midiIn; }
+        midi2::MidiEndpointPipeStatistics MidiOut() const noexcept { return m_midiOut; }
+        midi2::MidiEndpointPipeStatistics EndpointMidiIn() const noexcept { return m_endpointMidiIn; }
+        midi2::MidiEndpointPipeStatistics EndpointMidiOut() const noexcept { return m_endpointMidiOut; }
+        internal::MidiTimestamp Timestamp() const noexcept { return m_timestamp; }
+
+        // Each buffer between the client and the service is counted at both ends. The
+        // writer's end knows about full buffers and the reader's end about lag, so the
+        // two are combined. A side which couldn't be read is all zeros.
+        void InternalInitialize(
+            _In_ MIDI_PIPE_STATISTICS const& clientMidiIn,
+            _In_ MIDI_PIPE_STATISTICS const& clientMidiOut,
+            _In_ MIDI_PIPE_STATISTICS const& serviceMidiIn,
+            _In_ MIDI_PIPE_STATISTICS const& serviceMidiOut,
+            _In_ MIDI_PIPE_STATISTICS const& endpointMidiIn,
+            _In_ MIDI_PIPE_STATISTICS const& endpointMidiOut,
+            _In_ internal::MidiTimestamp const timestamp
+        ) noexcept;
+
+    private:
+        static midi2::MidiEndpointPipeStatistics CombinePipeStatistics(
+            _In_ MIDI_PIPE_STATISTICS const& writer,
+            _In_ MIDI_PIPE_STATISTICS const& reader
+        ) noexcept;
+
+        midi2::MidiEndpointPipeStatistics m_midiIn{};
+        midi2::MidiEndpointPipeStatistics m_midiOut{};
+        midi2::MidiEndpointPipeStatistics m_endpointMidiIn{};
+        midi2::MidiEndpointPipeStatistics m_endpointMidiOut{};
+        internal::MidiTimestamp m_timestamp{ 0 };
+    };
+}
@@ -10,61 +10,132 @@
 #include "MidiMessageTranslator.h"
 #include "MidiMessageTranslator.g.cpp"
 
+#include "midi_message_translation.h"
+
 namespace winrt::Windows::Devices::Midi2::implementation
 {
-    // TODO: Ref the same code being used in the service and usb driver, and just wrap that
+    // The translation itself is in midi_message_translation.h, shared with the SDK
 
     _Use_decl_annotations_
     midi2::MidiMessage64 MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2(
-        midi2::MidiMessage32 const& /*originalMessage*/
+        midi2::MidiMessage32 const& originalMessage
     ) noexcept
     {
-        // TODO MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2
-        return nullptr;
+        if (originalMessage == nullptr) return nullptr;
+
+        uint32_t word0{ 0 };
+        uint32_t word1{ 0 };
+
+        if (!internal::UpscaleMidi1ChannelVoiceMessage(originalMessage.Word0(), word0, word1))
+        {
+            return nullptr;
+        }
+
+        return midi2::MidiMessage64(originalMessage.Timestamp(), word0, word1);
     }
 
     _Use_decl_annotations_
     midi2::MidiMessage64 MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2(
-        internal::MidiTimestamp /*timestamp*/,
-        uint8_t /*groupIndex*/,
-        uint8_t /*statusByte*/
+        internal::MidiTimestamp timestamp,
+        uint8_t groupIndex,
+        uint8_t statusByte
     ) noexcept
     {
-        // TODO MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2
-        return nullptr;
+        return UpscaleMidi1ChannelVoiceMessageToMidi2(timestamp, groupIndex, statusByte, 0, 0);
     }
 
     _Use_decl_annotations_
     midi2::MidiMessage64 MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2(
-        internal::MidiTimestamp /*timestamp*/,
-        uint8_t /*groupIndex*/,
-        uint8_t /*statusByte*/,
-        uint8_t /*dataByte1*/
+        internal::MidiTimestamp timestamp,
+        uint8_t groupIndex,
+        uint8_t statusByte,
+        uint8_t dataByte1
     ) noexcept
     {
-        // TODO MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2
-        return nullptr;
+        return UpscaleMidi1ChannelVoiceMessageToMidi2(timestamp, groupIndex, statusByte, dataByte1, 0);
     }
 
     _Use_decl_annotations_
     midi2::MidiMessage64 MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2(
-        internal::MidiTimestamp /*timestamp*/,
-        uint8_t /*groupIndex*/,
-        uint8_t /*statusByte*/,
-        uint8_t /*dataByte1*/,
-        uint8_t /*dataByte2*/
+        internal::MidiTimestamp timestamp,
+        uint8_t groupIndex,
+        uint8_t statusByte,
+        uint8_t dataByte1,
+        uint8_t dataByte2
     ) noexcept
     {
-        // TODO MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2
-        return nullptr;
+        uint32_t word0{ 0 };
+        uint32_t word1{ 0 };
+
+        uint32_t midi1Word = (uint32_t)(
+            0x2 << 28 |
+            internal::CleanupNibble(groupIndex) << 24 |
+            statusByte << 16 |
+            internal::CleanupByte7(dataByte1) << 8 |
+            internal::CleanupByte7(dataByte2));
+
+        if (!internal::UpscaleMidi1ChannelVoiceMessage(midi1Word, word0, word1))
+        {
+            return nullptr;
+        }
+
+        return midi2::MidiMessage64(timestamp, word0, word1);
     }
 
     _Use_decl_annotations_
     midi2::MidiMessage32 MidiMessageTranslator::DownscaleMidi2ChannelVoiceMessageToMidi1(
-        midi2::MidiMessage64 const& /*originalMessage*/
+        midi2::MidiMessage64 const& originalMessage
         ) noexcept
     {
-        // TODO MidiMessageTranslator::DownscaleMidi2ChannelVoiceMessageToMidi1
-        return nullptr;
+        if (originalMessage == nullptr) return nullptr;
+
+        uint32_t word{ 0 };
+
+        if (!internal::DownscaleMidi2ChannelVoiceMessage(originalMessage.Word0(), originalMessage.Word1(), word))
+        {
+            return nullptr;
+        }
+
+        return midi2::MidiMessage32(originalMessage.Timestamp(), word);
+    }
+
+    _Use_decl_annotations_
+    uint32_t MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessagesToMidi2(
+        winrt::array_view<uint32_t const> sourceWords,
+        uint32_t const sourceStartIndex,
+        winrt::array_view<uint32_t> destinationWords,
+        uint32_t& destinationWordCount
+    ) noexcept
+    {
+        destinationWordCount = 0;
+
+        if (sourceStartIndex >= sourceWords.size()) return 0;
+
+        return internal::UpscaleMidi1ChannelVoiceMessages(
+            sourceWords.data() + sourceStartIndex,
+            sourceWords.size() - sourceStartIndex,
+            destinationWords.data(),
+            destinationWords.size(),
+            destinationWordCount);
+    }
+
+    _Use_decl_annotations_
+    uint32_t MidiMessageTranslator::DownscaleMidi2ChannelVoiceMessagesToMidi1(
+        winrt::array_view<uint32_t const> sourceWords,
+        uint32_t const sourceStartIndex,
+        winrt::array_view<uint32_t> destinationWords,
+        uint32_t& destinationWordCount
+    ) noexcept
+    {
+        destinationWordCount = 0;
+
+        if (sourceStartIndex >= sourceWords.size()) return 0;
+
+        return internal::DownscaleMidi2ChannelVoiceMessages(
+            sourceWords.data() + sourceStartIndex,
+            sourceWords.size() - sourceStartIndex,
+            destinationWords.data(),
+            destinationWords.size(),
+            destinationWordCount);
     }
 }
@@ -44,6 +44,20 @@ namespace winrt::Windows::Devices::Midi2::implementation
             _In_ midi2::MidiMessage64 const& originalMessage
         ) noexcept;
 
+        static uint32_t UpscaleMidi1ChannelVoiceMessagesToMidi2(
+            _In_ winrt::array_view<uint32_t const> sourceWords,
+            _In_ uint32_t const sourceStartIndex,
+            _In_ winrt::array_view<uint32_t> destinationWords,
+            _Out_ uint32_t& destinationWordCount
+        ) noexcept;
+
+        static uint32_t DownscaleMidi2ChannelVoiceMessagesToMidi1(
+            _In_ winrt::array_view<uint32_t const> sourceWords,
+            _In_ uint32_t const sourceStartIndex,
+            _In_ winrt::array_view<uint32_t> destinationWords,
+            _Out_ uint32_t& destinationWordCount
+        ) noexcept;
+
     };
 }
 namespace winrt::Windows::Devices::Midi2::factory_implementation
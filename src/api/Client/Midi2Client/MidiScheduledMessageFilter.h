@@ -0,0 +1,48 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#pragma once
+#include "MidiScheduledMessageFilter.g.h"
+
+
+namespace winrt::Windows::Devices::Midi2::implementation
+{
+    struct MidiScheduledMessageFilter : MidiScheduledMessageFilterT<MidiScheduledMessageFilter>
+    {
+        MidiScheduledMessageFilter() = default;
+
+        collections::IVector<midi2::MidiGroup> IncludeGroups() { return m_includedGroups; }
+        collections::IVector<midi2::MidiChannel> IncludeChannels() { return m_includedChannels; }
+        collections::IVector<midi2::MidiMessageType> IncludeMessageTypes() { return m_includedMessageTypes; }
+
+        internal::MidiTimestamp EarliestTimestamp() const noexcept { return m_earliestTimestamp; }
+        void EarliestTimestamp(_In_ internal::MidiTimestamp const value) noexcept { m_earliestTimestamp = value; }
+
+        internal::MidiTimestamp LatestTimestamp() const noexcept { return m_latestTimestamp; }
+        void LatestTimestamp(_In_ internal::MidiTimestamp const value) noexcept { m_latestTimestamp = value; }
+
+    private:
+        collections::IVector<midi2::MidiGroup> m_includedGroups
+            { winrt::multi_threaded_vector<midi2::MidiGroup>() };
+
+        collections::IVector<midi2::MidiChannel> m_includedChannels
+            { winrt::multi_threaded_vector<midi2::MidiChannel>() };
+
+        collections::IVector<midi2::MidiMessageType> m_includedMessageTypes
+            { winrt::multi_threaded_vector<midi2::MidiMessageType>() };
+
+        internal::MidiTimestamp m_earliestTimestamp{ 0 };
+        internal::MidiTimestamp m_latestTimestamp{ UINT64_MAX };
+    };
+}
+namespace winrt::Windows::Devices::Midi2::factory_implementation
+{
+    struct MidiScheduledMessageFilter : MidiScheduledMessageFilterT<MidiScheduledMessageFilter, implementation::MidiScheduledMessageFilter>
+    {
+    };
+}
@@ -15,6 +15,7 @@
 
 #include <Windows.h>
 #include <wil\resource.h>
+#include <atomic>
 
 namespace winrt::Windows::Devices::Midi2::implementation
 {
@@ -210,6 +211,213 @@ namespace winrt::Windows::Devices::Midi2::implementation
     }
 
 
+    _Use_decl_annotations_
+    midi2::MidiServicePingResponseSummary MidiService::CalibrateEndpointOutputLatency(
+        winrt::hstring const& endpointDeviceId,
+        uint8_t const pingCount,
+        uint32_t const timeoutMilliseconds) noexcept
+    {
+        internal::LogInfo(__FUNCTION__, L"Enter");
+
+        auto responseSummary = winrt::make_self<implementation::MidiServicePingResponseSummary>();
+
+        if (responseSummary == nullptr)
+        {
+            // just need to fail
+            return nullptr;
+        }
+
+        if (pingCount == 0)
+        {
+            responseSummary->InternalSetFailed(L"Ping count is zero.");
+            return *responseSummary;
+        }
+
+        if (timeoutMilliseconds == 0)
+        {
+            responseSummary->InternalSetFailed(L"Timeout milliseconds is zero.");
+            return *responseSummary;
+        }
+
+        std::vector<winrt::com_ptr<implementation::MidiServicePingResponse>> pings{};
+        pings.resize(pingCount);
+
+        try
+        {
+            auto session = midi2::MidiSession::CreateSession(L"Output Latency Calibration");
+
+            if (session == nullptr)
+            {
+                responseSummary->InternalSetFailed(L"Unable to create session.");
+                return *responseSummary;
+            }
+
+            auto endpoint = session.CreateEndpointConnection(endpointDeviceId);
+
+            if (endpoint == nullptr)
+            {
+                responseSummary->InternalSetFailed(L"Unable to create endpoint connection.");
+                session.Close();
+
+                return *responseSummary;
+            }
+
+            uint32_t pingSourceId = (uint32_t)(MidiClock::Now() & 0x00000000FFFFFFFF);
+
+            wil::unique_event_nothrow allMessagesReceived;
+            allMessagesReceived.create();
+
+            std::atomic<uint8_t> receivedCount{ 0 };
+
+            // The endpoint is expected to send back what it receives. A physical or virtual loopback
+            // will send back the ping request unchanged, and an endpoint which understands the internal
+            // ping message will send back a response, so we accept either one as long as it is ours.
+            auto MessageReceivedHandler = [&](foundation::IInspectable const& /*sender*/, midi2::MidiMessageReceivedEventArgs const& args)
+                {
+                    internal::MidiTimestamp actualReceiveEventTimestamp = MidiClock::Now();
+
+                    uint32_t word0;
+                    uint32_t word1;
+                    uint32_t word2;
+                    uint32_t word3;
+
+                    args.FillWords(word0, word1, word2, word3);
+
+                    if ((word0 == INTERNAL_PING_RESPONSE_UMP_WORD0 || word0 == INTERNAL_PING_REQUEST_UMP_WORD0) &&
+                        word1 == pingSourceId &&
+                        word2 < pings.size() &&
+                        pings[word2] != nullptr &&
+                        pings[word2]->ClientReceiveMidiTimestamp() == 0)
+                    {
+                        pings[word2]->InternalSetReceiveInfo(args.Timestamp(), actualReceiveEventTimestamp);
+
+                        if (++receivedCount == pingCount)
+                        {
+                            allMessagesReceived.SetEvent();
+                        }
+                    }
+                };
+
+            auto eventRevokeToken = endpoint.MessageReceived(MessageReceivedHandler);
+
+            if (!endpoint.Open())
+            {
+                internal::LogGeneralError(__FUNCTION__, L"Could not open endpoint for latency calibration.");
+
+                responseSummary->InternalSetFailed(L"Endpoint open failed. The service may be unavailable.");
+                endpoint.MessageReceived(eventRevokeToken);
+
+                session.DisconnectEndpointConnection(endpoint.ConnectionId());
+                session.Close();
+
+                return *responseSummary;
+            }
+
+            // Pings are sent one at a time so one ping never waits in the queue behind another,
+            // which would add to its measured round trip.
+            double perPingTimeoutMilliseconds = (double)(std::max)(timeoutMilliseconds / pingCount, (uint32_t)1);
+
+            for (uint32_t pingIndex = 0; pingIndex < pingCount; pingIndex++)
+            {
+                internal::PackedPingRequestUmp request;
+
+                auto response = winrt::make_self<implementation::MidiServicePingResponse>();
+
+                internal::MidiTimestamp timestamp = MidiClock::Now();
+                response->InternalSetSendInfo(pingSourceId, pingIndex, timestamp);
+
+                pings[pingIndex] = response;
+
+                uint8_t expectedCount = (uint8_t)(pingIndex + 1);
+
+                endpoint.SendMessageWords(timestamp, request.Word0, pingSourceId, pingIndex, request.Padding);
+
+                // wait for this ping to come back before sending the next. Any which don't come
+                // back are caught by the overall wait below.
+                auto waitStart = MidiClock::Now();
+                while (receivedCount < expectedCount &&
+                    MidiClock::ConvertTimestampToMilliseconds(MidiClock::Now() - waitStart) < perPingTimeoutMilliseconds)
+                {
+                    Sleep(1);
+                }
+            }
+
+            if (!allMessagesReceived.wait(timeoutMilliseconds))
+            {
+                responseSummary->InternalSetFailed(L"Not all ping messages were echoed back by the endpoint within the time window. The endpoint may not be a loopback.");
+                internal::LogGeneralError(__FUNCTION__, L"Not all ping messages were echoed back within appropriate time window.");
+            }
+            else
+            {
+                uint64_t totalPing{ 0 };
+                std::vector<uint64_t> roundTrips{};
+                roundTrips.reserve(pingCount);
+
+                for (const auto& response : pings)
+                {
+                    totalPing += response->ClientDeltaTimestamp();
+
+                    // the service receive timestamp is taken when the echo comes back in from the
+                    // device, so this leaves out the hop back up to this process
+                    if (response->ServiceReportedMidiTimestamp() > response->ClientSendMidiTimestamp())
+                    {
+                        roundTrips.push_back(response->ServiceReportedMidiTimestamp() - response->ClientSendMidiTimestamp());
+                    }
+                    else
+                    {
+                        roundTrips.push_back(response->ClientDeltaTimestamp());
+                    }
+
+                    responseSummary->InternalAddResponse(*response);
+                }
+
+                responseSummary->InternalSetTotals(totalPing, totalPing / pingCount);
+
+                // median, so a single late ping doesn't skew the result. The output latency is
+                // taken to be half of the round trip.
+                std::nth_element(roundTrips.begin(), roundTrips.begin() + roundTrips.size() / 2, roundTrips.end());
+                uint64_t latencyTicks = roundTrips[roundTrips.size() / 2] / 2;
+
+                winrt::com_ptr<IMidiAbstraction> serviceAbstraction;
+                winrt::com_ptr<IMidiEndpointMetrics> endpointMetrics;
+
+                serviceAbstraction = winrt::create_instance<IMidiAbstraction>(__uuidof(Midi2MidiSrvAbstraction), CLSCTX_ALL);
+
+                if (serviceAbstraction != nullptr &&
+                    SUCCEEDED(serviceAbstraction->Activate(__uuidof(IMidiEndpointMetrics), (void**)&endpointMetrics)) &&
+                    SUCCEEDED(endpointMetrics->Initialize()) &&
+                    SUCCEEDED(endpointMetrics->SetCalculatedOutputLatency(endpointDeviceId.c_str(), latencyTicks)))
+                {
+                    responseSummary->InternalSetSucceeded();
+                }
+                else
+                {
+                    responseSummary->InternalSetFailed(L"Unable to store the calculated latency for the endpoint.");
+                    internal::LogGeneralError(__FUNCTION__, L"Unable to store the calculated latency for the endpoint.");
+                }
+
+                if (endpointMetrics != nullptr)
+                {
+                    endpointMetrics->Cleanup();
+                }
+            }
+
+            endpoint.MessageReceived(eventRevokeToken);
+
+            session.DisconnectEndpointConnection(endpoint.ConnectionId());
+            session.Close();
+        }
+        catch (...)
+        {
+            internal::LogGeneralError(__FUNCTION__, L"Exception calibrating endpoint output latency.");
+
+            responseSummary->InternalSetFailed(L"Exception calibrating endpoint output latency.");
+        }
+
+        return *responseSummary;
+    }
+
+
 
     foundation::Collections::IVectorView<midi2::MidiServiceTransportPluginInformation> MidiService::GetInstalledTransportPlugins()
     {
@@ -24,6 +24,12 @@ namespace winrt::Windows::Devices::Midi2::implementation
             _In_ uint32_t const timeoutMilliseconds
             ) noexcept;
 
+        static midi2::MidiServicePingResponseSummary CalibrateEndpointOutputLatency(
+            _In_ winrt::hstring const& endpointDeviceId,
+            _In_ uint8_t const pingCount,
+            _In_ uint32_t const timeoutMilliseconds
+            ) noexcept;
+
         static foundation::Collections::IVectorView<midi2::MidiServiceTransportPluginInformation> GetInstalledTransportPlugins();
         static foundation::Collections::IVectorView<midi2::MidiServiceMessageProcessingPluginInformation> GetInstalledMessageProcessingPlugins();
 
@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#pragma once
+#include "MidiSubscriptionFilter.g.h"
+
+
+namespace winrt::Windows::Devices::Midi2::implementation
+{
+    struct MidiSubscriptionFilter : MidiSubscriptionFilterT<MidiSubscriptionFilter>
+    {
+        MidiSubscriptionFilter() = default;
+
+        collections::IVector<midi2::MidiGroup> IncludeGroups() { return m_includedGroups; }
+        collections::IVector<midi2::MidiChannel> IncludeChannels() { return m_includedChannels; }
+        collections::IVector<midi2::MidiMessageType> IncludeMessageTypes() { return m_includedMessageTypes; }
+
+        bool IncludeStreamMessages() const noexcept { return m_includeStreamMessages; }
+        void IncludeStreamMessages(_In_ bool const value) noexcept { m_includeStreamMessages = value; }
+
+    private:
+        collections::IVector<midi2::MidiGroup> m_includedGroups
+            { winrt::multi_threaded_vector<midi2::MidiGroup>() };
+
+        collections::IVector<midi2::MidiChannel> m_includedChannels
+            { winrt::multi_threaded_vector<midi2::MidiChannel>() };
+
+        collections::IVector<midi2::MidiMessageType> m_includedMessageTypes
+            { winrt::multi_threaded_vector<midi2::MidiMessageType>() };
+
+        bool m_includeStreamMessages{ true };
+    };
+}
+namespace winrt::Windows::Devices::Midi2::factory_implementation
+{
+    struct MidiSubscriptionFilter : MidiSubscriptionFilterT<MidiSubscriptionFilter, implementation::MidiSubscriptionFilter>
+    {
+    };
+}
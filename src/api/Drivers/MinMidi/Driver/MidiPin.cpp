@@ -1359,6 +1359,9 @@ MidiPin::GetLoopedStreamingRegisters
     // registers already created, can't create again.
     NT_RETURN_NTSTATUS_IF(STATUS_ALREADY_INITIALIZED, nullptr != This->m_ReadRegister);
 
+    // the register page says how big the buffer is, so the buffer comes first.
+    NT_RETURN_NTSTATUS_IF(STATUS_INVALID_DEVICE_STATE, 0 == This->m_BufferSize);
+
     // a different process created the buffer mapping, registers must be created by the
     // same process
     NT_RETURN_NTSTATUS_IF(STATUS_ALREADY_INITIALIZED, IoGetRequestorProcess(Irp) != This->m_Process);
@@ -1393,11 +1396,16 @@ MidiPin::GetLoopedStreamingRegisters
     // from being mapped into user)
     NT_RETURN_IF_NTSTATUS_FAILED(This->GetSingleBufferMapping(PAGE_SIZE, UserMode, TRUE, nullptr, &This->m_Registers));
 
-    This->m_ReadRegister = (PULONG) This->m_Registers.m_BufferAddress;
-    This->m_WriteRegister = This->m_ReadRegister + 1;
+    // header first, then a cache line for each register. See KSMIDILOOPED_REGISTERS_HEADER.
+    PKSMIDILOOPED_REGISTERS_HEADER header = (PKSMIDILOOPED_REGISTERS_HEADER) This->m_Registers.m_BufferAddress;
+    header->LayoutVersion = KSMIDILOOPED_REGISTERS_LAYOUT_VERSION;
+    header->BufferSize = This->m_BufferSize;
+
+    This->m_ReadRegister = (PULONG) (((PBYTE) This->m_Registers.m_BufferAddress) + KSMIDILOOPED_REGISTERS_READ_OFFSET);
+    This->m_WriteRegister = (PULONG) (((PBYTE) This->m_Registers.m_BufferAddress) + KSMIDILOOPED_REGISTERS_WRITE_OFFSET);
 
-    Buffer->ReadPosition = (PULONG) This->m_Registers.m_BufferClientAddress;
-    Buffer->WritePosition = ((PULONG) This->m_Registers.m_BufferClientAddress) + 1;
+    Buffer->ReadPosition = (PULONG) (((PBYTE) This->m_Registers.m_BufferClientAddress) + KSMIDILOOPED_REGISTERS_READ_OFFSET);
+    Buffer->WritePosition = (PULONG) (((PBYTE) This->m_Registers.m_BufferClientAddress) + KSMIDILOOPED_REGISTERS_WRITE_OFFSET);
 
     // success, so do not perform a failure clean up when the function exits.
     cleanupOnFailure.release();
@@ -889,6 +889,9 @@ StreamEngine::GetLoopedStreamingRegisters(
     // this is only applicable if this is a looped pin instance.
     NT_RETURN_NTSTATUS_IF(STATUS_NOT_IMPLEMENTED, FALSE == m_IsLooped);
 
+    // the register page says how big the buffer is, so the buffer comes first.
+    NT_RETURN_NTSTATUS_IF(STATUS_INVALID_DEVICE_STATE, 0 == m_BufferSize);
+
     // in the event of failure, clean up any partial mappings.
     auto cleanupOnFailure = wil::scope_exit([&]() {
             CleanupSingleBufferMapping(&m_Registers);
@@ -902,11 +905,16 @@ StreamEngine::GetLoopedStreamingRegisters(
     // from being mapped into user)
     NT_RETURN_IF_NTSTATUS_FAILED(GetSingleBufferMapping(PAGE_SIZE, UserMode, TRUE, nullptr, &m_Registers));
 
-    m_ReadRegister = (PULONG) m_Registers.m_BufferAddress;
-    m_WriteRegister = m_ReadRegister + 1;
+    // header first, then a cache line for each register. See KSMIDILOOPED_REGISTERS_HEADER.
+    PKSMIDILOOPED_REGISTERS_HEADER header = (PKSMIDILOOPED_REGISTERS_HEADER) m_Registers.m_BufferAddress;
+    header->LayoutVersion = KSMIDILOOPED_REGISTERS_LAYOUT_VERSION;
+    header->BufferSize = m_BufferSize;
+
+    m_ReadRegister = (PULONG) (((PBYTE) m_Registers.m_BufferAddress) + KSMIDILOOPED_REGISTERS_READ_OFFSET);
+    m_WriteRegister = (PULONG) (((PBYTE) m_Registers.m_BufferAddress) + KSMIDILOOPED_REGISTERS_WRITE_OFFSET);
 
-    Buffer->ReadPosition = (PULONG) m_Registers.m_BufferClientAddress;
-    Buffer->WritePosition = ((PULONG) m_Registers.m_BufferClientAddress) + 1;
+    Buffer->ReadPosition = (PULONG) (((PBYTE) m_Registers.m_BufferClientAddress) + KSMIDILOOPED_REGISTERS_READ_OFFSET);
+    Buffer->WritePosition = (PULONG) (((PBYTE) m_Registers.m_BufferClientAddress) + KSMIDILOOPED_REGISTERS_WRITE_OFFSET);
 
     // success, so do not perform a failure clean up when the function exits.
     cleanupOnFailure.release();
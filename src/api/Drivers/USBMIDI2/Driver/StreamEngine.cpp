@@ -62,6 +62,27 @@ StreamEngine* g_MidiInStreamEngine {nullptr};
 // UMP 128 is 16 bytes
 #define MAXIMUM_UMP_DATASIZE 16
 
+// Amount of data between the read and write positions, taking into
+// account the looping buffer.
+inline ULONG GetBytesAvailableToRead(
+    _In_ ULONG ReadPosition,
+    _In_ ULONG WritePosition,
+    _In_ ULONG BufferSize
+    )
+{
+    if (ReadPosition <= WritePosition)
+    {
+        // we haven't looped around, so the difference between the
+        // read and write position is the amount of data to read.
+        return WritePosition - ReadPosition;
+    }
+
+    // the write position is behind the read position, so we looped
+    // around. The difference between the two is the free space, so
+    // the buffer size minus that is the amount of data to read.
+    return BufferSize - (ReadPosition - WritePosition);
+}
+
 _Use_decl_annotations_
 StreamEngine::StreamEngine(
     _In_ ACXPIN Pin
@@ -197,26 +218,24 @@ StreamEngine::HandleIo()
                         // Retrieve the midi out position for the buffer we are reading from. The data between the read position
                         // and write position is valid. (read position is our last read position, write position is their last written).
                         // Retrieve our read position first since we know it won't be changing, get their last write position second,
-                        // so we can get as much data as possible.
+                        // so we can get as much data as possible. Their write position comes from our copy of it,
+                        // which is only read again when the copy says the next message isn't all there yet.
                         ULONG midiOutReadPosition = (ULONG) InterlockedCompareExchange((LONG *)m_ReadRegister, 0, 0);
-                        ULONG midiOutWritePosition = (ULONG) InterlockedCompareExchange((LONG *)m_WriteRegister, 0, 0);
+                        ULONG midiOutWritePosition = m_CachedWritePosition;
 
                         // first figure out how much data there is to read, taking
                         // into account the looping buffer.
-                        if (midiOutReadPosition <= midiOutWritePosition)
-                        {
-                            // if the read position is less than the write position, 
-                            // then we haven't looped around so the difference between
-                            // the read and write position is the amount of data to read.
-                            bytesAvailableToRead = midiOutWritePosition - midiOutReadPosition;
-                        }
-                        else
+                        bytesAvailableToRead = GetBytesAvailableToRead(midiOutReadPosition, midiOutWritePosition, m_BufferSize);
+
+                        PVOID startingReadAddress = (PVOID)(((PBYTE)m_KernelBufferMapping.Buffer1.m_BufferClientAddress) + midiOutReadPosition);
+                        PUMPDATAFORMAT header = (PUMPDATAFORMAT)(startingReadAddress);
+
+                        if (bytesAvailableToRead < sizeof(UMPDATAFORMAT) ||
+                            bytesAvailableToRead < sizeof(UMPDATAFORMAT) + header->ByteCount)
                         {
-                            // the write position is behind the read position, so
-                            // we looped around. The difference between the read position and 
-                            // the write position is the available space, so the total buffer
-                            // size minus the available space gives us the amount of data to read.
-                            bytesAvailableToRead = m_BufferSize - (midiOutReadPosition - midiOutWritePosition);
+                            midiOutWritePosition = (ULONG) InterlockedCompareExchange((LONG *)m_WriteRegister, 0, 0);
+                            m_CachedWritePosition = midiOutWritePosition;
+                            bytesAvailableToRead = GetBytesAvailableToRead(midiOutReadPosition, midiOutWritePosition, m_BufferSize);
                         }
 
                         if (bytesAvailableToRead == 0)
@@ -225,8 +244,6 @@ StreamEngine::HandleIo()
                             break;
                         }
 
-                        PVOID startingReadAddress = (PVOID)(((PBYTE)m_KernelBufferMapping.Buffer1.m_BufferClientAddress) + midiOutReadPosition);
-                        PUMPDATAFORMAT header = (PUMPDATAFORMAT)(startingReadAddress);
                         UINT32 dataSize = header->ByteCount;
 
                         if (dataSize < MINIMUM_UMP_DATASIZE || dataSize > MAXIMUM_UMP_DATASIZE)
@@ -326,30 +343,21 @@ Return Value:
         // so we can have as much free space as possible.
 //        ULONG midiInWritePosition = (ULONG)InterlockedCompareExchange((LONG*)pDevCtx->pMidiStreamEngine->m_WriteRegister, 0, 0);
 //        ULONG midiInReadPosition = (ULONG)InterlockedCompareExchange((LONG*)pDevCtx->pMidiStreamEngine->m_ReadRegister, 0, 0);
+        // Their read position is our copy of it, which is only read again when the copy
+        // says there isn't enough space.
         ULONG midiInWritePosition = (ULONG)InterlockedCompareExchange((LONG*)g_MidiInStreamEngine->m_WriteRegister, 0, 0);
-        ULONG midiInReadPosition = (ULONG)InterlockedCompareExchange((LONG*)g_MidiInStreamEngine->m_ReadRegister, 0, 0);
+        ULONG midiInReadPosition = g_MidiInStreamEngine->m_CachedReadPosition;
 
+        // Check enough space to write into, taking into account the looping buffer.
+        ULONG bytesAvailable = g_MidiInStreamEngine->m_BufferSize - GetBytesAvailableToRead(midiInReadPosition, midiInWritePosition, g_MidiInStreamEngine->m_BufferSize);
 
-        // Check enough space to write into
-        ULONG bytesAvailable = 0;
-
-        // Now we need to calculate the available space, taking into account the looping
-        // buffer.
-        if (midiInReadPosition <= midiInWritePosition)
-        {
-            // if the read position is less than the write position, then the difference between
-            // the read and write position is the buffer in use, same as above. So, the total
-            // buffer size minus the used buffer gives us the available space.
-//            bytesAvailable = pDevCtx->pMidiStreamEngine->m_BufferSize - (midiInWritePosition - midiInReadPosition);
-            bytesAvailable = g_MidiInStreamEngine->m_BufferSize - (midiInWritePosition - midiInReadPosition);
-        }
-        else
+        if (bufferSize > bytesAvailable)
         {
-            // we looped around, the write position is behind the read position.
-            // The difference between the read position and the write position
-            // is the available space, which is exactly what we want.
-            bytesAvailable = midiInReadPosition - midiInWritePosition;
+            midiInReadPosition = (ULONG)InterlockedCompareExchange((LONG*)g_MidiInStreamEngine->m_ReadRegister, 0, 0);
+            g_MidiInStreamEngine->m_CachedReadPosition = midiInReadPosition;
+            bytesAvailable = g_MidiInStreamEngine->m_BufferSize - GetBytesAvailableToRead(midiInReadPosition, midiInWritePosition, g_MidiInStreamEngine->m_BufferSize);
         }
+
         if (bufferSize > bytesAvailable)
         {
             // We have a problem. We have data to move, but there
@@ -1017,6 +1025,9 @@ StreamEngine::GetLoopedStreamingRegisters(
     // this is only applicable if this is a looped pin instance.
     NT_RETURN_NTSTATUS_IF(STATUS_NOT_IMPLEMENTED, FALSE == m_IsLooped);
 
+    // the register page says how big the buffer is, so the buffer comes first.
+    NT_RETURN_NTSTATUS_IF(STATUS_INVALID_DEVICE_STATE, 0 == m_BufferSize);
+
     // in the event of failure, clean up any partial mappings.
     auto cleanupOnFailure = wil::scope_exit([&]() {
             CleanupSingleBufferMapping(&m_Registers);
@@ -1030,11 +1041,21 @@ StreamEngine::GetLoopedStreamingRegisters(
     // from being mapped into user)
     NT_RETURN_IF_NTSTATUS_FAILED(GetSingleBufferMapping(PAGE_SIZE, UserMode, TRUE, nullptr, &m_Registers));
 
-    m_ReadRegister = (PULONG) m_Registers.m_BufferAddress;
-    m_WriteRegister = m_ReadRegister + 1;
-
-    Buffer->ReadPosition = (PULONG) m_Registers.m_BufferClientAddress;
-    Buffer->WritePosition = ((PULONG) m_Registers.m_BufferClientAddress) + 1;
+    // The page starts with a header which user mode checks before using the registers,
+    // and each register gets a cache line to itself after that, so the reader advancing
+    // the read position doesn't take the line the writer is using away from it, and
+    // vice versa. See KSMIDILOOPED_REGISTERS_HEADER.
+    PKSMIDILOOPED_REGISTERS_HEADER header = (PKSMIDILOOPED_REGISTERS_HEADER) m_Registers.m_BufferAddress;
+    header->LayoutVersion = KSMIDILOOPED_REGISTERS_LAYOUT_VERSION;
+    header->BufferSize = m_BufferSize;
+
+    m_ReadRegister = (PULONG) (((PBYTE) m_Registers.m_BufferAddress) + KSMIDILOOPED_REGISTERS_READ_OFFSET);
+    m_WriteRegister = (PULONG) (((PBYTE) m_Registers.m_BufferAddress) + KSMIDILOOPED_REGISTERS_WRITE_OFFSET);
+    m_CachedWritePosition = 0;
+    m_CachedReadPosition = 0;
+
+    Buffer->ReadPosition = (PULONG) (((PBYTE) m_Registers.m_BufferClientAddress) + KSMIDILOOPED_REGISTERS_READ_OFFSET);
+    Buffer->WritePosition = (PULONG) (((PBYTE) m_Registers.m_BufferClientAddress) + KSMIDILOOPED_REGISTERS_WRITE_OFFSET);
 
     // success, so do not perform a failure clean up when the function exits.
     cleanupOnFailure.release();
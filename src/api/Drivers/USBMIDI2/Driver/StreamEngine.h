@@ -224,6 +224,11 @@ private:
     PULONG      m_ReadRegister {nullptr};
     PULONG      m_WriteRegister {nullptr};
 
+    // our copy of the position register the other side writes. It's only read
+    // again when our copy says there isn't enough data (midi out) or space (midi in).
+    ULONG       m_CachedWritePosition {0};
+    ULONG       m_CachedReadPosition {0};
+
     // event shared with user mode that is signaled whenever
     // data is written into the cyclic buffer by either the driver
     // sending to user mode, or user mode sending to the driver
@@ -22,6 +22,73 @@
 // we'll reuse that for the largest bytestream
 #define MAXIMUM_LOOPED_DATASIZE 16
 
+// Between stages which use the UMP data format, every buffer is a UMP batch: one or
+// more whole UMPs, packed back to back, which all share the buffer's timestamp. This
+// is the most a stage passes on in one call. Stages which need the UMPs one at a time
+// walk the batch with ForEachUmpInBatch, and never see part of a message. Byte
+// stream buffers come with no such promise.
+#define MIDI_UMP_BATCH_MAXIMUM_SIZE 512
+
+// most messages the cross process pipe hands to the receiver in one callback.
+// The space they use isn't released to the sender until the callback returns.
+#define MIDI_XPROC_MAXIMUM_BATCH_MESSAGE_COUNT 64
+
+// how long the cross process pipe waits for space in a full buffer before
+// failing a send, unless the caller gives its own timeout
+#define MIDI_XPROC_DEFAULT_SEND_TIMEOUT_MS 10000
+
+// a writer waiting on a full buffer is woken once at least this much of the
+// buffer is free, so it can write a run of messages rather than one at a time
+#define MIDI_XPROC_SPACE_AVAILABLE_WATERMARK_PERCENT 25
+
+// once the midi in buffer runs dry, the worker can poll it for up to this long before
+// going back to waiting on the event, trading CPU for wake up latency. 0, off, unless
+// the MIDI_XPROC_POLLING_WINDOW_REG_VALUE registry value says otherwise.
+#define MIDI_XPROC_DEFAULT_POLLING_WINDOW_MICROSECONDS 0
+#define MIDI_XPROC_MAXIMUM_POLLING_WINDOW_MICROSECONDS 2000
+
+// messages the service holds for a client whose midi in buffer is full, before the
+// client's overflow policy kicks in. The registry value can change the default, up
+// to the maximum.
+#define MIDI_CLIENT_DELIVERY_DEFAULT_QUEUE_SIZE 4096
+#define MIDI_CLIENT_DELIVERY_MAXIMUM_QUEUE_SIZE 65536
+
+// used for clients which ask for MidiDeliveryOverflowPolicy_Default, unless the
+// registry value says otherwise
+#define MIDI_CLIENT_DELIVERY_DEFAULT_OVERFLOW_POLICY MidiDeliveryOverflowPolicy_DropOldest
+
+// worker threads shared by all clients, for delivering queued messages. A worker
+// never waits for a client to make room, so this doesn't limit how many can stall.
+#define MIDI_CLIENT_DELIVERY_MAXIMUM_THREAD_COUNT 4
+
+// Outgoing messages the device pipe sends ahead of everything else. Bits 0-15 are UMP
+// utility messages (type 0) by status, and bits 16-31 are UMP system messages (type 1)
+// by the low nibble of the status byte.
+#define MIDI_PRIORITY_MESSAGE_UTILITY(status) (1u << ((status) & 0x0F))
+#define MIDI_PRIORITY_MESSAGE_SYSTEM(status) (1u << (16 + ((status) & 0x0F)))
+
+// JR clock and the system real-time messages, unless the registry value says otherwise.
+// JR timestamps aren't included. They have to stay in front of the message they belong to.
+#define MIDI_DEVICE_DEFAULT_PRIORITY_MESSAGE_MASK ( \
+    MIDI_PRIORITY_MESSAGE_UTILITY(0x1) |    /* JR clock */ \
+    MIDI_PRIORITY_MESSAGE_SYSTEM(0xF8) |    /* timing clock */ \
+    MIDI_PRIORITY_MESSAGE_SYSTEM(0xFA) |    /* start */ \
+    MIDI_PRIORITY_MESSAGE_SYSTEM(0xFB) |    /* continue */ \
+    MIDI_PRIORITY_MESSAGE_SYSTEM(0xFC) |    /* stop */ \
+    MIDI_PRIORITY_MESSAGE_SYSTEM(0xFE) |    /* active sensing */ \
+    MIDI_PRIORITY_MESSAGE_SYSTEM(0xFF))     /* reset */
+
+// priority messages which can wait for another thread to finish sending to the device
+#define MIDI_DEVICE_PRIORITY_LANE_SIZE 64
+
+// Messages the device pipe holds back while another client is part way through a SysEx7
+// message on the same group, across all groups. When this fills up, messages are dropped.
+#define MIDI_DEVICE_SYSEX7_PARKED_QUEUE_SIZE 1024
+
+// How long a client's SysEx7 transfer can go quiet while others wait for the group,
+// before it's treated as abandoned, unless the registry value says otherwise
+#define MIDI_DEVICE_DEFAULT_SYSEX7_TIMEOUT_MS 1000
+
 
 #define MIDI_TIMESTAMP_SEND_IMMEDIATELY 0
 
@@ -30,6 +97,11 @@
 // used by the scheduler and then also by the client API
 #define MIDI_OUTGOING_MESSAGE_QUEUE_MAX_MESSAGE_COUNT 10000
 
+// Most output latency, calculated or user supplied, the service accepts for an endpoint.
+// The scheduler sends this far ahead of every message's timestamp, so the service
+// refuses to store anything larger, and the scheduler clamps to it when reading.
+#define MIDI_MAXIMUM_OUTPUT_LATENCY_MICROSECONDS 500000
+
 
 #define MIDI_PROTOCOL_MANAGER_ENDPOINT_CREATION_CONTEXT (LONGLONG)3263827
 
@@ -45,6 +117,32 @@
 
 #define MIDI_CONFIG_FILE_REG_VALUE L"CurrentConfig"
 
+// DWORD. How close to a message's send time, in microseconds, the scheduler stops sleeping and spins
+#define MIDI_SCHEDULER_SPIN_WINDOW_REG_VALUE L"SchedulerSpinWindowMicroseconds"
+
+// DWORD. 0 to have the scheduler send each message on its own, rather than sending messages with the same timestamp together
+#define MIDI_SCHEDULER_COALESCE_REG_VALUE L"SchedulerCoalesceSameTimestamp"
+
+// DWORD. Longest time, in microseconds, the cross process midi in worker polls for more messages before waiting. 0 to turn polling off
+#define MIDI_XPROC_POLLING_WINDOW_REG_VALUE L"MidiInPollingWindowMicroseconds"
+
+// Holds a DWORD for each byte stream endpoint whose incoming MIDI 1.0 channel voice messages
+// the service upscales to MIDI 2.0. The value name is the endpoint device interface id. Non-zero
+// to upscale. Read when the endpoint is opened
+#define MIDI_BYTESTREAM_UPSCALE_REG_KEY MIDI_ROOT_REG_KEY L"\\Byte Stream Upscaling"
+
+// DWORD. Messages the service queues for each client which isn't keeping up
+#define MIDI_CLIENT_DELIVERY_QUEUE_SIZE_REG_VALUE L"ClientDeliveryQueueSize"
+
+// DWORD. A MidiDeliveryOverflowPolicy, used for clients which don't pick one
+#define MIDI_CLIENT_DELIVERY_OVERFLOW_POLICY_REG_VALUE L"ClientDeliveryOverflowPolicy"
+
+// DWORD. Which outgoing messages skip ahead, see MIDI_DEVICE_DEFAULT_PRIORITY_MESSAGE_MASK. 0 turns it off
+#define MIDI_DEVICE_PRIORITY_MESSAGE_MASK_REG_VALUE L"DevicePriorityMessageMask"
+
+// DWORD. Milliseconds before a quiet SysEx7 transfer is abandoned, see MIDI_DEVICE_DEFAULT_SYSEX7_TIMEOUT_MS. 0 turns SysEx7 arbitration off
+#define MIDI_DEVICE_SYSEX7_TIMEOUT_REG_VALUE L"DeviceSysEx7TimeoutMs"
+
 // we force this root so the service can't be told to open some other random file on the system
 // note that this is a restricted folder. The installer has to create this folder for us and
 // give rights to the users in the system so the service *and* the setup applications can 
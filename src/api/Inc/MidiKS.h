@@ -21,6 +21,12 @@ public:
     virtual HRESULT Cleanup();
     virtual ~KSMidiDevice();
 
+    // Counts for the looped buffer shared with the driver. Fails for a
+    // device using the standard streaming transport, which has no such buffer.
+    HRESULT GetStatistics(
+        _Out_ MIDI_PIPE_STATISTICS&,
+        _Out_ MIDI_PIPE_STATISTICS&);
+
 protected:
     KSMidiDevice() {}
 
@@ -75,6 +75,21 @@ typedef struct {
     PVOID ReadPosition;
 } KSMIDILOOPED_REGISTERS, *PKSMIDILOOPED_REGISTERS;
 
+// The page KSPROPERTY_MIDILOOPEDSTREAMING_REGISTERS maps. It starts with this header,
+// saying which layout the page has and how big the data buffer is, and then the read
+// and write registers each have a cache line to themselves. This is the layout of
+// MidiSharedRingRegisters in midi_shared_ring.h, which the client checks the header
+// against before it uses the registers.
+#define KSMIDILOOPED_REGISTERS_LAYOUT_VERSION 2
+#define KSMIDILOOPED_REGISTERS_CACHE_LINE_SIZE 64
+#define KSMIDILOOPED_REGISTERS_READ_OFFSET (1 * KSMIDILOOPED_REGISTERS_CACHE_LINE_SIZE)
+#define KSMIDILOOPED_REGISTERS_WRITE_OFFSET (2 * KSMIDILOOPED_REGISTERS_CACHE_LINE_SIZE)
+
+typedef struct {
+    ULONG   LayoutVersion;
+    ULONG   BufferSize;
+} KSMIDILOOPED_REGISTERS_HEADER, *PKSMIDILOOPED_REGISTERS_HEADER;
+
 typedef struct {
     HANDLE WriteEvent;
 } KSMIDILOOPED_EVENT, *PKSMIDILOOPED_EVENT;
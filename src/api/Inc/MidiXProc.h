@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <atomic>
+
 using unique_mmcss_handle = wil::unique_any<HANDLE, decltype(&::AvRevertMmThreadCharacteristics), AvRevertMmThreadCharacteristics>;
 using unique_viewoffile = wil::unique_any<LPVOID, decltype(&::UnmapViewOfFile), UnmapViewOfFile>;
 
@@ -28,6 +30,10 @@ typedef struct MEMORY_MAPPED_REGISTERS
 {
     PULONG WritePosition{ nullptr };
     PULONG ReadPosition{ nullptr };
+
+    // nonzero while the writer is waiting for the reader to free up space. Only
+    // present when both sides are CMidiXProc, not when the other side is a driver.
+    PULONG WriterWaiting{ nullptr };
 } MEMORY_MAPPED_REGISTERS, * PMEMORY_MAPPED_REGISTERS;
 
 typedef struct MEMORY_MAPPED_PIPE
@@ -38,8 +44,28 @@ typedef struct MEMORY_MAPPED_PIPE
     MEMORY_MAPPED_DATA Data;
     MEMORY_MAPPED_REGISTERS Registers;
     wil::unique_event_nothrow WriteEvent;
+
+    // optional, set by the reader when it frees space for a waiting writer
+    wil::unique_event_nothrow SpaceAvailableEvent;
 } MEMORY_MAPPED_PIPE, *PMEMORY_MAPPED_PIPE;
 
+// The running counts behind MIDI_PIPE_STATISTICS, for one direction. They're only
+// statistics, and nothing else depends on them, so relaxed atomics are enough.
+typedef struct MIDI_XPROC_PIPE_COUNTERS
+{
+    std::atomic<ULONG> HighWaterMark{ 0 };
+    std::atomic<ULONGLONG> MessageCount{ 0 };
+    std::atomic<ULONGLONG> ByteCount{ 0 };
+    std::atomic<ULONGLONG> BatchCount{ 0 };
+    std::atomic<ULONGLONG> BufferFullCount{ 0 };
+    std::atomic<ULONGLONG> RetryCount{ 0 };
+    std::atomic<ULONGLONG> TimeoutCount{ 0 };
+    std::atomic<ULONGLONG> WakeupCount{ 0 };
+    std::atomic<ULONGLONG> PollCount{ 0 };
+    std::atomic<ULONGLONG> PollHitCount{ 0 };
+    std::atomic<ULONGLONG> MaximumConsumerLag{ 0 };
+} MIDI_XPROC_PIPE_COUNTERS, *PMIDI_XPROC_PIPE_COUNTERS;
+
 HRESULT GetRequiredBufferSize(_In_ ULONG&);
 
 HRESULT MapBuffer(_In_ BOOL,
@@ -52,6 +78,7 @@ HRESULT CreateMappedDataBuffer(_In_ ULONG,
                                 _In_ PMEMORY_MAPPED_BUFFER,
                                 _In_ PMEMORY_MAPPED_DATA);
 HRESULT CreateMappedRegisters(_In_ PMEMORY_MAPPED_BUFFER,
+                                _In_ ULONG,
                                 _In_ PMEMORY_MAPPED_REGISTERS);
 
 HRESULT DisableMmcss(_In_ unique_mmcss_handle& MmcssHandle);
@@ -78,19 +105,69 @@ public:
         _In_ UINT32,
         _In_ LONGLONG);
 
+    HRESULT SendMidiMessage(
+        _In_ void *,
+        _In_ UINT32,
+        _In_ LONGLONG,
+        _In_ DWORD);
+
+    HRESULT SendMidiMessages(
+        _In_reads_(MessageCount) PMIDIMESSAGEBATCHENTRY,
+        _In_ UINT32 MessageCount,
+        _In_ DWORD,
+        _Out_ UINT32&);
+
+    HRESULT GetMidiOutBytesAvailable(
+        _Out_ UINT32&);
+
+    HRESULT ArmMidiOutSpaceAvailable(
+        _In_ UINT32,
+        _Out_ HANDLE&);
+
+    HRESULT WaitForMidiOutEmpty(
+        _In_ DWORD);
+
+    HRESULT SetMidiInPollingWindow(
+        _In_ DWORD);
+
+    HRESULT GetStatistics(
+        _Out_ MIDI_PIPE_STATISTICS&,
+        _Out_ MIDI_PIPE_STATISTICS&);
+
 private:
 
     BOOL m_OverwriteZeroTimestamp{ true };
 
     wil::com_ptr_nothrow<IMidiCallback> m_MidiInCallback;
+    wil::com_ptr_nothrow<IMidiBatchCallback> m_MidiInBatchCallback;
     LONGLONG m_MidiInCallbackContext{};
 
+    // messages collected by the worker for one pass over the midi in buffer
+    MIDIMESSAGEBATCHENTRY m_MidiInBatch[MIDI_XPROC_MAXIMUM_BATCH_MESSAGE_COUNT]{};
+
     std::unique_ptr<MEMORY_MAPPED_PIPE> m_MidiIn;
     std::unique_ptr<MEMORY_MAPPED_PIPE> m_MidiOut;
 
+    // our copies of the other side's position registers. The other side's register
+    // is only read when our copy says there isn't enough data, or space.
+    ULONG m_MidiInCachedWritePosition{ 0 };
+    ULONG m_MidiOutCachedReadPosition{ 0 };
+
     static DWORD WINAPI MidiInWorker(_In_ LPVOID);
 
     HRESULT ProcessMidiIn();
+    BOOL PollMidiIn(_In_ LONGLONG);
+
+    // Polling state. The window is in QPC ticks, and is 0 when polling is off. The
+    // average gap between bursts of midi in is only used by the worker.
+    LONGLONG m_QpcFrequency{ 0 };
+    LONGLONG m_MidiInPollingWindow{ 0 };
+    LONGLONG m_MidiInAverageGap{ 0 };
+
+    // for GetStatistics
+    LONGLONG m_StartTime{ 0 };
+    MIDI_XPROC_PIPE_COUNTERS m_MidiInCounters;
+    MIDI_XPROC_PIPE_COUNTERS m_MidiOutCounters;
 
     unique_mmcss_handle m_MmcssHandle;
     DWORD m_MmcssTaskId {0};
@@ -0,0 +1,473 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#pragma once
+
+#include <stdint.h>
+
+#include "ump_stream_scanner.h"
+
+// MIDI 1.0 to MIDI 2.0 channel voice translation on UMP words, and the value scaling
+// it uses. Everything here works a word at a time with no state and no allocation, so
+// it can be used from the client, the SDK and the service alike.
+//
+// Upscaling uses the min-center-max scheme from the MIDI 2.0 specification (the same
+// one as M2Utils::scaleUp in AM_MIDI2). The 7 bit and 14 bit conversions are table
+// lookups, with the tables built at compile time from ScaleUpMidiValue. Downscaling
+// is a shift.
+//
+// These translate single messages. Anything which needs state across messages, like
+// pairing Bank Select with Program Change or RPN with Data Entry, is passed through
+// as the plain controller. The byte stream transform does the stateful version.
+
+namespace Windows::Devices::Midi2::Internal
+{
+    constexpr uint32_t ScaleUpMidiValue(
+        _In_ uint32_t const value,
+        _In_ uint8_t const sourceBits,
+        _In_ uint8_t const destinationBits
+    ) noexcept
+    {
+        if (value == 0)
+        {
+            return 0;
+        }
+
+        if (sourceBits == 1)
+        {
+            return (uint32_t)((1ull << destinationBits) - 1);
+        }
+
+        uint8_t scaleBits = destinationBits - sourceBits;
+        uint32_t bitShiftedValue = value << scaleBits;
+
+        // anything up to the center is a plain shift, so the center stays the center
+        if (value <= (1u << (sourceBits - 1)))
+        {
+            return bitShiftedValue;
+        }
+
+        // above the center, the bits below the top bit are repeated to fill the lower
+        // bits, so the maximum goes to the maximum
+        uint8_t repeatBits = sourceBits - 1;
+        uint32_t repeatValue = value & ((1u << repeatBits) - 1);
+
+        if (scaleBits > repeatBits)
+        {
+            repeatValue <<= scaleBits - repeatBits;
+        }
+        else
+        {
+            repeatValue >>= repeatBits - scaleBits;
+        }
+
+        while (repeatValue != 0)
+        {
+            bitShiftedValue |= repeatValue;
+            repeatValue >>= repeatBits;
+        }
+
+        return bitShiftedValue;
+    }
+
+    constexpr uint32_t ScaleDownMidiValue(
+        _In_ uint32_t const value,
+        _In_ uint8_t const sourceBits,
+        _In_ uint8_t const destinationBits
+    ) noexcept
+    {
+        return value >> (sourceBits - destinationBits);
+    }
+
+    template <typename TValue>
+    struct MidiScalingTable
+    {
+        TValue Values[128];
+    };
+
+    constexpr MidiScalingTable<uint16_t> BuildMidi7BitTo16BitScalingTable() noexcept
+    {
+        MidiScalingTable<uint16_t> table{};
+
+        for (uint32_t i = 0; i < 128; i++)
+        {
+            table.Values[i] = (uint16_t)ScaleUpMidiValue(i, 7, 16);
+        }
+
+        return table;
+    }
+
+    constexpr MidiScalingTable<uint32_t> BuildMidi7BitTo32BitScalingTable() noexcept
+    {
+        MidiScalingTable<uint32_t> table{};
+
+        for (uint32_t i = 0; i < 128; i++)
+        {
+            table.Values[i] = ScaleUpMidiValue(i, 7, 32);
+        }
+
+        return table;
+    }
+
+    // A 14 bit value scaled to 32 bits is the scaled MSB (with an LSB of 0), ORed with
+    // the LSB shifted into place. Above the center, the LSB also shows up in the repeated
+    // bits. So three 128 entry tables cover all 16384 values.
+    constexpr MidiScalingTable<uint32_t> BuildMidi14BitMsbTo32BitScalingTable() noexcept
+    {
+        MidiScalingTable<uint32_t> table{};
+
+        for (uint32_t i = 0; i < 128; i++)
+        {
+            table.Values[i] = ScaleUpMidiValue(i << 7, 14, 32);
+        }
+
+        return table;
+    }
+
+    constexpr MidiScalingTable<uint32_t> BuildMidi14BitLsbTo32BitScalingTable(_In_ bool const aboveCenter) noexcept
+    {
+        MidiScalingTable<uint32_t> table{};
+
+        for (uint32_t i = 0; i < 128; i++)
+        {
+            table.Values[i] = (i << 18) | (aboveCenter ? (i << 5) : 0);
+        }
+
+        return table;
+    }
+
+    inline constexpr MidiScalingTable<uint16_t> c_Midi7BitTo16BitScalingTable = BuildMidi7BitTo16BitScalingTable();
+    inline constexpr MidiScalingTable<uint32_t> c_Midi7BitTo32BitScalingTable = BuildMidi7BitTo32BitScalingTable();
+    inline constexpr MidiScalingTable<uint32_t> c_Midi14BitMsbTo32BitScalingTable = BuildMidi14BitMsbTo32BitScalingTable();
+    inline constexpr MidiScalingTable<uint32_t> c_Midi14BitLsbTo32BitScalingTable = BuildMidi14BitLsbTo32BitScalingTable(false);
+    inline constexpr MidiScalingTable<uint32_t> c_Midi14BitLsbAboveCenterTo32BitScalingTable = BuildMidi14BitLsbTo32BitScalingTable(true);
+
+    constexpr uint16_t ScaleMidi7BitValueTo16Bit(_In_ uint8_t const value) noexcept
+    {
+        return c_Midi7BitTo16BitScalingTable.Values[value & 0x7F];
+    }
+
+    constexpr uint32_t ScaleMidi7BitValueTo32Bit(_In_ uint8_t const value) noexcept
+    {
+        return c_Midi7BitTo32BitScalingTable.Values[value & 0x7F];
+    }
+
+    constexpr uint32_t ScaleMidi14BitValueTo32Bit(_In_ uint16_t const value) noexcept
+    {
+        uint8_t msb = (uint8_t)((value >> 7) & 0x7F);
+        uint8_t lsb = (uint8_t)(value & 0x7F);
+
+        // an MSB of 64 with an LSB of 0 is the center, and the repeated bits are 0 anyway
+        return c_Midi14BitMsbTo32BitScalingTable.Values[msb] |
+            (msb >= 64 ? c_Midi14BitLsbAboveCenterTo32BitScalingTable.Values[lsb] : c_Midi14BitLsbTo32BitScalingTable.Values[lsb]);
+    }
+
+    static_assert(ScaleMidi7BitValueTo16Bit(0x00) == 0x0000);
+    static_assert(ScaleMidi7BitValueTo16Bit(0x40) == 0x8000);
+    static_assert(ScaleMidi7BitValueTo16Bit(0x7F) == 0xFFFF);
+    static_assert(ScaleMidi7BitValueTo32Bit(0x40) == 0x80000000);
+    static_assert(ScaleMidi7BitValueTo32Bit(0x7F) == 0xFFFFFFFF);
+    static_assert(ScaleMidi14BitValueTo32Bit(0x0000) == 0x00000000);
+    static_assert(ScaleMidi14BitValueTo32Bit(0x2000) == 0x80000000);
+    static_assert(ScaleMidi14BitValueTo32Bit(0x3FFF) == 0xFFFFFFFF);
+    static_assert(ScaleMidi14BitValueTo32Bit(0x2001) == ScaleUpMidiValue(0x2001, 14, 32));
+    static_assert(ScaleMidi14BitValueTo32Bit(0x1FFF) == ScaleUpMidiValue(0x1FFF, 14, 32));
+    static_assert(ScaleMidi14BitValueTo32Bit(0x3C55) == ScaleUpMidiValue(0x3C55, 14, 32));
+
+    // MIDI 1.0 channel voice message (type 2) to MIDI 2.0 channel voice message (type 4).
+    // Returns false, and leaves the output alone, if the word isn't a MIDI 1.0 channel
+    // voice message.
+    inline bool UpscaleMidi1ChannelVoiceMessage(
+        _In_ uint32_t const word,
+        _Out_ uint32_t& midi2Word0,
+        _Out_ uint32_t& midi2Word1
+    ) noexcept
+    {
+        if ((word >> 28) != 0x2)
+        {
+            return false;
+        }
+
+        uint8_t status = (uint8_t)((word >> 20) & 0x0F);
+        uint8_t index = (uint8_t)((word >> 8) & 0x7F);
+        uint8_t data = (uint8_t)(word & 0x7F);
+
+        // Note On with a velocity of 0 is a Note Off with the default velocity
+        if (status == 0x9 && data == 0)
+        {
+            status = 0x8;
+            data = 0x40;
+        }
+
+        // group and channel stay where they are
+        uint32_t word0 = 0x40000000 | (word & 0x0F0F0000) | ((uint32_t)status << 20);
+        uint32_t word1{ 0 };
+
+        switch (status)
+        {
+        case 0x8:   // Note Off
+        case 0x9:   // Note On
+            word0 |= (uint32_t)index << 8;
+            word1 = (uint32_t)ScaleMidi7BitValueTo16Bit(data) << 16;
+            break;
+
+        case 0xA:   // Poly Pressure
+        case 0xB:   // Control Change
+            word0 |= (uint32_t)index << 8;
+            word1 = ScaleMidi7BitValueTo32Bit(data);
+            break;
+
+        case 0xC:   // Program Change, with no bank
+            word1 = (uint32_t)index << 24;
+            break;
+
+        case 0xD:   // Channel Pressure
+            word1 = ScaleMidi7BitValueTo32Bit(index);
+            break;
+
+        case 0xE:   // Pitch Bend, LSB first
+            word1 = ScaleMidi14BitValueTo32Bit((uint16_t)(((uint16_t)data << 7) | index));
+            break;
+
+        default:
+            return false;
+        }
+
+        midi2Word0 = word0;
+        midi2Word1 = word1;
+
+        return true;
+    }
+
+    // MIDI 2.0 channel voice message (type 4) to MIDI 1.0 channel voice message (type 2).
+    // Returns false, and leaves the output alone, for anything which isn't a MIDI 2.0
+    // channel voice message with a single MIDI 1.0 equivalent. That's the per-note and
+    // relative messages, and RPN / NRPN which need several MIDI 1.0 messages. The bank
+    // in a Program Change is dropped.
+    inline bool DownscaleMidi2ChannelVoiceMessage(
+        _In_ uint32_t const midi2Word0,
+        _In_ uint32_t const midi2Word1,
+        _Out_ uint32_t& word
+    ) noexcept
+    {
+        if ((midi2Word0 >> 28) != 0x4)
+        {
+            return false;
+        }
+
+        uint8_t status = (uint8_t)((midi2Word0 >> 20) & 0x0F);
+        uint8_t index = (uint8_t)((midi2Word0 >> 8) & 0x7F);
+
+        uint32_t midi1Word = 0x20000000 | (midi2Word0 & 0x0FFF0000);
+
+        switch (status)
+        {
+        case 0x8:   // Note Off
+            midi1Word |= ((uint32_t)index << 8) | ScaleDownMidiValue(midi2Word1 >> 16, 16, 7);
+            break;
+
+        case 0x9:   // Note On. A velocity of 0 would be a Note Off in MIDI 1.0, so it's 1 instead
+        {
+            uint32_t velocity = ScaleDownMidiValue(midi2Word1 >> 16, 16, 7);
+            midi1Word |= ((uint32_t)index << 8) | (velocity == 0 ? 1 : velocity);
+            break;
+        }
+
+        case 0xA:   // Poly Pressure
+        case 0xB:   // Control Change
+            midi1Word |= ((uint32_t)index << 8) | ScaleDownMidiValue(midi2Word1, 32, 7);
+            break;
+
+        case 0xC:   // Program Change
+            midi1Word |= ((midi2Word1 >> 24) & 0x7F) << 8;
+            break;
+
+        case 0xD:   // Channel Pressure
+            midi1Word |= ScaleDownMidiValue(midi2Word1, 32, 7) << 8;
+            break;
+
+        case 0xE:   // Pitch Bend, LSB first
+        {
+            uint32_t value = ScaleDownMidiValue(midi2Word1, 32, 14);
+            midi1Word |= ((value & 0x7F) << 8) | (value >> 7);
+            break;
+        }
+
+        default:
+            return false;
+        }
+
+        word = midi1Word;
+
+        return true;
+    }
+
+    // Upscales every MIDI 1.0 channel voice message in a buffer of whole UMPs, copying
+    // everything else across unchanged. The destination needs up to twice as many words
+    // as the source. Stops at the first message which doesn't fit in the destination, or
+    // which is cut off at the end of the source. Returns the number of source words
+    // translated, and sets destinationWordsWritten.
+    inline uint32_t UpscaleMidi1ChannelVoiceMessages(
+        _In_reads_(sourceWordCount) uint32_t const* sourceWords,
+        _In_ uint32_t const sourceWordCount,
+        _Out_writes_to_(destinationWordCount, destinationWordsWritten) uint32_t* destinationWords,
+        _In_ uint32_t const destinationWordCount,
+        _Out_ uint32_t& destinationWordsWritten
+    ) noexcept
+    {
+        uint32_t sourceIndex{ 0 };
+        uint32_t destinationIndex{ 0 };
+
+        while (sourceIndex < sourceWordCount)
+        {
+            uint32_t word = sourceWords[sourceIndex];
+
+            if ((word >> 28) == 0x2)
+            {
+                if (destinationWordCount - destinationIndex < 2)
+                {
+                    break;
+                }
+
+                if (!UpscaleMidi1ChannelVoiceMessage(word, destinationWords[destinationIndex], destinationWords[destinationIndex + 1]))
+                {
+                    // system messages can't be in type 2, so this is a status we don't know
+                    destinationWords[destinationIndex] = word;
+                    destinationIndex += 1;
+                }
+                else
+                {
+                    destinationIndex += 2;
+                }
+
+                sourceIndex += 1;
+            }
+            else
+            {
+                uint32_t wordCount = c_UmpWordCountByMessageType[word >> 28];
+
+                if (sourceWordCount - sourceIndex < wordCount || destinationWordCount - destinationIndex < wordCount)
+                {
+                    break;
+                }
+
+                for (uint32_t i = 0; i < wordCount; i++)
+                {
+                    destinationWords[destinationIndex + i] = sourceWords[sourceIndex + i];
+                }
+
+                sourceIndex += wordCount;
+                destinationIndex += wordCount;
+            }
+        }
+
+        destinationWordsWritten = destinationIndex;
+
+        return sourceIndex;
+    }
+
+    // Downscales every MIDI 2.0 channel voice message in a buffer of whole UMPs, copying
+    // everything else across unchanged. Unlike the single message version, a Program
+    // Change with a bank becomes Bank Select MSB, LSB and Program Change, and RPN / NRPN
+    // become the four Control Change messages which select and set them. The per-note
+    // and relative messages have no MIDI 1.0 equivalent, and are dropped. The destination
+    // needs up to twice as many words as the source. Stops at the first message which
+    // doesn't fit in the destination, or which is cut off at the end of the source.
+    // Returns the number of source words translated, and sets destinationWordsWritten.
+    inline uint32_t DownscaleMidi2ChannelVoiceMessages(
+        _In_reads_(sourceWordCount) uint32_t const* sourceWords,
+        _In_ uint32_t const sourceWordCount,
+        _Out_writes_to_(destinationWordCount, destinationWordsWritten) uint32_t* destinationWords,
+        _In_ uint32_t const destinationWordCount,
+        _Out_ uint32_t& destinationWordsWritten
+    ) noexcept
+    {
+        uint32_t sourceIndex{ 0 };
+        uint32_t destinationIndex{ 0 };
+
+        while (sourceIndex < sourceWordCount)
+        {
+            uint32_t word0 = sourceWords[sourceIndex];
+            uint32_t wordCount = c_UmpWordCountByMessageType[word0 >> 28];
+
+            if (sourceWordCount - sourceIndex < wordCount)
+            {
+                break;
+            }
+
+            if ((word0 >> 28) == 0x4)
+            {
+                uint32_t word1 = sourceWords[sourceIndex + 1];
+                uint8_t status = (uint8_t)((word0 >> 20) & 0x0F);
+
+                // Control Change messages on the same group and channel
+                uint32_t controlChange = 0x20B00000 | (word0 & 0x0F0F0000);
+
+                if (status == 0xC && (word0 & 0x01) != 0)
+                {
+                    if (destinationWordCount - destinationIndex < 3)
+                    {
+                        break;
+                    }
+
+                    destinationWords[destinationIndex++] = controlChange | (0x00 << 8) | ((word1 >> 8) & 0x7F);
+                    destinationWords[destinationIndex++] = controlChange | (0x20 << 8) | (word1 & 0x7F);
+                    DownscaleMidi2ChannelVoiceMessage(word0, word1, destinationWords[destinationIndex++]);
+                }
+                else if (status == 0x2 || status == 0x3)
+                {
+                    if (destinationWordCount - destinationIndex < 4)
+                    {
+                        break;
+                    }
+
+                    // RPN is controllers 101 / 100, NRPN is 99 / 98
+                    uint32_t parameterMsbController = (status == 0x2) ? 101 : 99;
+                    uint32_t value = ScaleDownMidiValue(word1, 32, 14);
+
+                    destinationWords[destinationIndex++] = controlChange | (parameterMsbController << 8) | ((word0 >> 8) & 0x7F);
+                    destinationWords[destinationIndex++] = controlChange | ((parameterMsbController - 1) << 8) | (word0 & 0x7F);
+                    destinationWords[destinationIndex++] = controlChange | (6 << 8) | (value >> 7);
+                    destinationWords[destinationIndex++] = controlChange | (38 << 8) | (value & 0x7F);
+                }
+                else
+                {
+                    if (destinationWordCount - destinationIndex < 1)
+                    {
+                        break;
+                    }
+
+                    if (DownscaleMidi2ChannelVoiceMessage(word0, word1, destinationWords[destinationIndex]))
+                    {
+                        destinationIndex += 1;
+                    }
+                }
+            }
+            else
+            {
+                if (destinationWordCount - destinationIndex < wordCount)
+                {
+                    break;
+                }
+
+                for (uint32_t i = 0; i < wordCount; i++)
+                {
+                    destinationWords[destinationIndex + i] = sourceWords[sourceIndex + i];
+                }
+
+                destinationIndex += wordCount;
+            }
+
+            sourceIndex += wordCount;
+        }
+
+        destinationWordsWritten = destinationIndex;
+
+        return sourceIndex;
+    }
+}
@@ -0,0 +1,340 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#pragma once
+
+// Shared memory ring used to pass timestamped messages from one process to another.
+//
+// CMidiXProc implements this on top of Windows file mappings, with the data buffer
+// mapped twice back to back so a message which wraps around the end is contiguous.
+// The reader and writer here implement the same ring on plain memory, mapped once,
+// and use only the standard library, so the protocol can be exercised and measured
+// anywhere. The two can be used on either end of the same ring.
+//
+// The registers and the data buffer are separate blocks of memory. The registers
+// start with a header saying which layout this is and how big the data buffer is,
+// and then each position register has a cache line to itself, so the reader
+// advancing the read position doesn't take the cache line the writer is using
+// away from it, and vice versa.
+//
+// Each message in the data buffer is a MidiSharedRingEntryHeader (the same as the
+// LOOPEDDATAFORMAT used by the KS looped streaming), followed by its data. One
+// byte of the buffer is always left unused, so a full ring can be told apart from
+// an empty one.
+//
+// Both sides keep a copy of the other's position, and only read the other side's
+// register once their copy says there isn't enough data, or space, for the next
+// message.
+//
+// There's a single reader and a single writer. Neither class is thread safe.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#define MIDI_SHARED_RING_CACHE_LINE_SIZE 64
+
+// layout 1 was ReadPosition and WritePosition in adjacent ULONGs with no header
+#define MIDI_SHARED_RING_LAYOUT_VERSION 2
+
+// largest message the ring carries. Same as MAXIMUM_LOOPED_DATASIZE
+#define MIDI_SHARED_RING_MAXIMUM_MESSAGE_SIZE 16
+
+namespace Windows::Devices::Midi2::Internal
+{
+    // Written once by whichever side creates the registers, before the other side
+    // maps them.
+    struct MidiSharedRingHeader
+    {
+        uint32_t LayoutVersion;
+        uint32_t Capacity;          // size of the data buffer, in bytes
+    };
+
+    // CMidiXProc works on the registers with the Interlocked functions, so they
+    // need to be laid out exactly like the ULONGs they are on that side.
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "ring registers must be plain 32 bit values");
+
+    struct MidiSharedRingRegisters
+    {
+        alignas(MIDI_SHARED_RING_CACHE_LINE_SIZE) MidiSharedRingHeader Header;
+
+        // written by the reader
+        alignas(MIDI_SHARED_RING_CACHE_LINE_SIZE) std::atomic<uint32_t> ReadPosition;
+
+        // written by the writer
+        alignas(MIDI_SHARED_RING_CACHE_LINE_SIZE) std::atomic<uint32_t> WritePosition;
+
+        // set by the writer when it is waiting for space, cleared by the reader when
+        // it wakes the writer. How the writer waits is up to the implementation.
+        alignas(MIDI_SHARED_RING_CACHE_LINE_SIZE) std::atomic<uint32_t> WriterWaiting;
+    };
+
+    static_assert(sizeof(MidiSharedRingRegisters) == 4 * MIDI_SHARED_RING_CACHE_LINE_SIZE, "unexpected ring register layout");
+
+    struct MidiSharedRingEntryHeader
+    {
+        int64_t Position;
+        uint32_t ByteCount;
+    };
+
+    static_assert(sizeof(MidiSharedRingEntryHeader) == 16, "ring entry header must match LOOPEDDATAFORMAT");
+
+    // Call on newly created, zeroed registers, before the other side sees them.
+    inline void InitializeMidiSharedRingRegisters(MidiSharedRingRegisters& registers, uint32_t capacity) noexcept
+    {
+        registers.Header.LayoutVersion = MIDI_SHARED_RING_LAYOUT_VERSION;
+        registers.Header.Capacity = capacity;
+        registers.ReadPosition.store(0, std::memory_order_relaxed);
+        registers.WritePosition.store(0, std::memory_order_relaxed);
+        registers.WriterWaiting.store(0, std::memory_order_release);
+    }
+
+    // True if registers created by the other side are ones we can use with a data
+    // buffer of the given size.
+    inline bool IsMidiSharedRingRegistersCompatible(MidiSharedRingRegisters const& registers, uint32_t capacity) noexcept
+    {
+        return registers.Header.LayoutVersion == MIDI_SHARED_RING_LAYOUT_VERSION &&
+            registers.Header.Capacity == capacity;
+    }
+
+    // bytes between the read and write positions
+    inline uint32_t GetMidiSharedRingReadableByteCount(uint32_t readPosition, uint32_t writePosition, uint32_t capacity) noexcept
+    {
+        return readPosition <= writePosition ? writePosition - readPosition : capacity - (readPosition - writePosition);
+    }
+
+    // free bytes, less the one which is always left unused
+    inline uint32_t GetMidiSharedRingWritableByteCount(uint32_t readPosition, uint32_t writePosition, uint32_t capacity) noexcept
+    {
+        return capacity - GetMidiSharedRingReadableByteCount(readPosition, writePosition, capacity) - 1;
+    }
+
+    class MidiSharedRingWriter
+    {
+    public:
+        MidiSharedRingWriter(MidiSharedRingRegisters& registers, uint8_t* buffer, uint32_t capacity) noexcept :
+            m_registers(registers),
+            m_buffer(buffer),
+            m_capacity(capacity)
+        {
+            m_writePosition = m_registers.WritePosition.load(std::memory_order_relaxed);
+            m_cachedReadPosition = m_registers.ReadPosition.load(std::memory_order_acquire);
+        }
+
+        // Exact free space, in bytes. Each message also takes up a header.
+        uint32_t GetBytesAvailable() noexcept
+        {
+            RefreshReadPosition();
+
+            return GetMidiSharedRingWritableByteCount(m_cachedReadPosition, m_writePosition, m_capacity);
+        }
+
+        // Writes and publishes one message. False if it doesn't fit right now, or is
+        // too big or too small for the ring.
+        bool TryWrite(int64_t position, void const* data, uint32_t byteCount) noexcept
+        {
+            if (!Append(position, data, byteCount))
+            {
+                return false;
+            }
+
+            Publish();
+
+            return true;
+        }
+
+        // Writes as many of the messages as fit, in order, and publishes them all
+        // with one update of the write position. Returns how many were written.
+        // TMessage needs Position, Data and ByteCount members.
+        template <typename TMessage>
+        uint32_t TryWriteMany(TMessage const* messages, uint32_t messageCount) noexcept
+        {
+            uint32_t writtenCount{ 0 };
+
+            while (writtenCount < messageCount &&
+                Append(messages[writtenCount].Position, messages[writtenCount].Data, messages[writtenCount].ByteCount))
+            {
+                writtenCount++;
+            }
+
+            if (writtenCount > 0)
+            {
+                Publish();
+            }
+
+            return writtenCount;
+        }
+
+        // how many times the reader's register has been read. For tests and tuning
+        uint64_t PeerReadCount() const noexcept { return m_peerReadCount; }
+
+    private:
+        // copies a message in after the last one, without publishing it
+        bool Append(int64_t position, void const* data, uint32_t byteCount) noexcept
+        {
+            if (byteCount == 0 || byteCount > MIDI_SHARED_RING_MAXIMUM_MESSAGE_SIZE)
+            {
+                return false;
+            }
+
+            uint32_t requiredByteCount = (uint32_t)sizeof(MidiSharedRingEntryHeader) + byteCount;
+
+            // only look at the reader's register when our copy of it says we're full
+            if (GetMidiSharedRingWritableByteCount(m_cachedReadPosition, m_writePosition, m_capacity) < requiredByteCount)
+            {
+                RefreshReadPosition();
+
+                if (GetMidiSharedRingWritableByteCount(m_cachedReadPosition, m_writePosition, m_capacity) < requiredByteCount)
+                {
+                    return false;
+                }
+            }
+
+            MidiSharedRingEntryHeader header{};
+            header.Position = position;
+            header.ByteCount = byteCount;
+
+            CopyIn(m_writePosition, &header, sizeof(header));
+            CopyIn((m_writePosition + (uint32_t)sizeof(header)) % m_capacity, data, byteCount);
+
+            m_writePosition = (m_writePosition + requiredByteCount) % m_capacity;
+
+            return true;
+        }
+
+        void Publish() noexcept
+        {
+            m_registers.WritePosition.store(m_writePosition, std::memory_order_release);
+        }
+
+        void RefreshReadPosition() noexcept
+        {
+            m_cachedReadPosition = m_registers.ReadPosition.load(std::memory_order_acquire);
+            m_peerReadCount++;
+        }
+
+        void CopyIn(uint32_t offset, void const* source, uint32_t byteCount) noexcept
+        {
+            uint32_t firstPart = (m_capacity - offset) < byteCount ? (m_capacity - offset) : byteCount;
+
+            memcpy(m_buffer + offset, source, firstPart);
+            memcpy(m_buffer, (uint8_t const*)source + firstPart, byteCount - firstPart);
+        }
+
+        MidiSharedRingRegisters& m_registers;
+        uint8_t* m_buffer;
+        uint32_t m_capacity;
+
+        uint32_t m_writePosition{ 0 };
+        uint32_t m_cachedReadPosition{ 0 };
+        uint64_t m_peerReadCount{ 0 };
+    };
+
+    class MidiSharedRingReader
+    {
+    public:
+        MidiSharedRingReader(MidiSharedRingRegisters& registers, uint8_t* buffer, uint32_t capacity) noexcept :
+            m_registers(registers),
+            m_buffer(buffer),
+            m_capacity(capacity)
+        {
+            m_readPosition = m_registers.ReadPosition.load(std::memory_order_relaxed);
+            m_cachedWritePosition = m_registers.WritePosition.load(std::memory_order_acquire);
+        }
+
+        // Reads up to maximumMessageCount complete messages, calling
+        //
+        //   void visitor(int64_t position, uint8_t const* data, uint32_t byteCount)
+        //
+        // for each one in order, then releases their space to the writer with one
+        // update of the read position. Returns how many were read.
+        template <typename TVisitor>
+        uint32_t Read(uint32_t maximumMessageCount, TVisitor&& visitor)
+        {
+            uint32_t readCount{ 0 };
+            bool writePositionRefreshed{ false };
+
+            while (readCount < maximumMessageCount)
+            {
+                MidiSharedRingEntryHeader header{};
+                uint32_t bytesAvailable = GetMidiSharedRingReadableByteCount(m_readPosition, m_cachedWritePosition, m_capacity);
+
+                if (bytesAvailable >= sizeof(header))
+                {
+                    CopyOut(m_readPosition, &header, sizeof(header));
+
+                    if (header.ByteCount > MIDI_SHARED_RING_MAXIMUM_MESSAGE_SIZE)
+                    {
+                        // the writer didn't put this here. Nothing after it can be trusted
+                        break;
+                    }
+                }
+
+                if (bytesAvailable < sizeof(header) || bytesAvailable < sizeof(header) + header.ByteCount)
+                {
+                    // only look at the writer's register when our copy of it says
+                    // there's nothing more, and only once per call
+                    if (writePositionRefreshed)
+                    {
+                        break;
+                    }
+
+                    m_cachedWritePosition = m_registers.WritePosition.load(std::memory_order_acquire);
+                    m_peerReadCount++;
+                    writePositionRefreshed = true;
+
+                    continue;
+                }
+
+                uint32_t dataPosition = (m_readPosition + (uint32_t)sizeof(header)) % m_capacity;
+                uint8_t const* data = m_buffer + dataPosition;
+
+                // the ring is only mapped once, so a message which wraps is copied out
+                if (header.ByteCount > m_capacity - dataPosition)
+                {
+                    CopyOut(dataPosition, m_wrapped, header.ByteCount);
+                    data = m_wrapped;
+                }
+
+                visitor(header.Position, data, header.ByteCount);
+
+                m_readPosition = (dataPosition + header.ByteCount) % m_capacity;
+                readCount++;
+            }
+
+            if (readCount > 0)
+            {
+                m_registers.ReadPosition.store(m_readPosition, std::memory_order_release);
+            }
+
+            return readCount;
+        }
+
+        // how many times the writer's register has been read. For tests and tuning
+        uint64_t PeerReadCount() const noexcept { return m_peerReadCount; }
+
+    private:
+        void CopyOut(uint32_t offset, void* destination, uint32_t byteCount) const noexcept
+        {
+            uint32_t firstPart = (m_capacity - offset) < byteCount ? (m_capacity - offset) : byteCount;
+
+            memcpy(destination, m_buffer + offset, firstPart);
+            memcpy((uint8_t*)destination + firstPart, m_buffer, byteCount - firstPart);
+        }
+
+        MidiSharedRingRegisters& m_registers;
+        uint8_t* m_buffer;
+        uint32_t m_capacity;
+
+        uint32_t m_readPosition{ 0 };
+        uint32_t m_cachedWritePosition{ 0 };
+        uint64_t m_peerReadCount{ 0 };
+
+        uint8_t m_wrapped[MIDI_SHARED_RING_MAXIMUM_MESSAGE_SIZE]{};
+    };
+}
@@ -11,6 +11,9 @@
 #include <Windows.h>
 #include <profileapi.h>
 
+#include <atomic>
+#include <cstdint>
+
 // Info on high resolution counters/timestamps in Windows
 // https://learn.microsoft.com/en-us/windows/win32/sysinfo/acquiring-high-resolution-time-stamps
 
@@ -37,7 +40,9 @@ namespace Windows::Devices::Midi2::Internal::Shared
 		return frequency.QuadPart;
 	}
 #else
-	inline std::uint64_t GetCurrentMidiTimestamp()
+	// The hardware counter. Only the system clock source should call these. Everything
+	// else goes through GetCurrentMidiTimestamp and GetMidiTimestampFrequency below.
+	inline std::uint64_t QueryMidiPerformanceCounter()
 	{
 		LARGE_INTEGER timestamp;
 
@@ -47,7 +52,7 @@ namespace Windows::Devices::Midi2::Internal::Shared
 	}
 
 
-	inline std::uint64_t GetMidiTimestampFrequency()
+	inline std::uint64_t QueryMidiPerformanceFrequency()
 	{
 		LARGE_INTEGER frequency;
 
@@ -57,6 +62,107 @@ namespace Windows::Devices::Midi2::Internal::Shared
 	}
 
 
+	// Where timestamps come from. GetCurrentMidiTimestamp reads the module's current clock
+	// source, so everything which stamps or schedules messages can be run against a
+	// simulated clock. Components which need their own clock (like the scheduler) can hold
+	// one of these directly.
+	class MidiClockSource
+	{
+	public:
+		virtual ~MidiClockSource() = default;
+
+		virtual std::uint64_t GetCurrentTimestamp() noexcept = 0;
+		virtual std::uint64_t GetTimestampFrequency() noexcept = 0;
+	};
+
+	// the real clock, the performance counter
+	class MidiSystemClockSource final : public MidiClockSource
+	{
+	public:
+		static MidiSystemClockSource& Instance() noexcept
+		{
+			static MidiSystemClockSource instance;
+
+			return instance;
+		}
+
+		std::uint64_t GetCurrentTimestamp() noexcept override { return QueryMidiPerformanceCounter(); }
+		std::uint64_t GetTimestampFrequency() noexcept override { return m_frequency; }
+
+	private:
+		std::uint64_t m_frequency{ QueryMidiPerformanceFrequency() };
+	};
+
+	// A clock which only moves when told to. Lets tests and benchmarks push hours of
+	// scheduled traffic through in however long it takes to process, and get the same
+	// result every run. Reads and writes are atomic, so one thread can drive the clock
+	// while others read it.
+	class MidiSimulatedClockSource final : public MidiClockSource
+	{
+	public:
+		MidiSimulatedClockSource(_In_ std::uint64_t frequency, _In_ std::uint64_t startTimestamp = 0) noexcept
+		{
+			m_frequency = frequency;
+			m_current.store(startTimestamp, std::memory_order_relaxed);
+		}
+
+		std::uint64_t GetCurrentTimestamp() noexcept override { return m_current.load(std::memory_order_acquire); }
+		std::uint64_t GetTimestampFrequency() noexcept override { return m_frequency; }
+
+		// the simulated clock doesn't go backwards, so an earlier timestamp is ignored
+		void SetCurrentTimestamp(_In_ std::uint64_t timestamp) noexcept
+		{
+			std::uint64_t current = m_current.load(std::memory_order_relaxed);
+
+			while (timestamp > current && !m_current.compare_exchange_weak(current, timestamp, std::memory_order_release, std::memory_order_relaxed))
+			{
+			}
+		}
+
+		void Advance(_In_ std::uint64_t ticks) noexcept
+		{
+			m_current.fetch_add(ticks, std::memory_order_release);
+		}
+
+	private:
+		std::uint64_t m_frequency{ 0 };
+		std::atomic<std::uint64_t> m_current{ 0 };
+	};
+
+
+	// The clock source GetCurrentMidiTimestamp reads. This is per module (each DLL or EXE
+	// which includes this header has its own), and is the system clock unless replaced.
+	inline std::atomic<MidiClockSource*>& CurrentMidiClockSource() noexcept
+	{
+		static std::atomic<MidiClockSource*> current{ &MidiSystemClockSource::Instance() };
+
+		return current;
+	}
+
+	inline MidiClockSource& GetMidiClockSource() noexcept
+	{
+		return *CurrentMidiClockSource().load(std::memory_order_acquire);
+	}
+
+	// For tests and simulations. The clock must outlive everything which reads it. Pass
+	// nullptr to go back to the system clock.
+	inline void SetMidiClockSource(_In_opt_ MidiClockSource* clock) noexcept
+	{
+		CurrentMidiClockSource().store(clock != nullptr ? clock : &MidiSystemClockSource::Instance(), std::memory_order_release);
+	}
+
+	inline std::uint64_t GetCurrentMidiTimestamp()
+	{
+		return GetMidiClockSource().GetCurrentTimestamp();
+	}
+
+
+	inline std::uint64_t GetMidiTimestampFrequency()
+	{
+		return GetMidiClockSource().GetTimestampFrequency();
+	}
+
+
 	// TODO: Consider adding in GetSystemTimePreciseAsFileTime for jitter measurements (KeQuerySystemTimePrecise for driver code)
 	// https://learn.microsoft.com/windows/win32/sysinfo/acquiring-high-resolution-time-stamps
 
@@ -9,6 +9,9 @@
 #pragma once
 
 #include <stdint.h>
+#include <string.h>
+
+#include "ump_stream_scanner.h"
 
 #define MIDIWORDNIBBLE1(x) ((uint8_t)((x & 0xF0000000) >> 28))
 #define MIDIWORDNIBBLE2(x) ((uint8_t)((x & 0x0F000000) >> 24))
@@ -75,36 +78,7 @@ namespace Windows::Devices::Midi2::Internal
 {
     inline std::uint8_t GetUmpLengthInMidiWordsFromMessageType(_In_ const std::uint8_t messageType) noexcept
     {
-        switch (messageType & 0x0F)
-        {
-        case 0x0:
-        case 0x1:
-        case 0x2:
-        case 0x6:
-        case 0x7:
-            return 1;
-
-        case 0x3:
-        case 0x4:
-        case 0x8:
-        case 0x9:
-        case 0xA:
-            return 2;
-
-        case 0xB:
-        case 0xC:
-            return 3;
-
-        case 0x5:
-        case 0xD:
-        case 0xE:
-        case 0xF:
-            return 4;
-
-        default:
-            return 0;   // with the mask, shouldn't happen. Here only due to the compiler warning
-        };
-
+        return c_UmpWordCountByMessageType[messageType & 0x0F];
     }
     
     inline std::uint8_t GetUmpLengthInBytesFromMessageType(_In_ const std::uint8_t messageType) noexcept
@@ -153,6 +127,51 @@ namespace Windows::Devices::Midi2::Internal
         return (uint8_t)(GetUmpLengthInMidiWordsFromFirstWord(firstWord) * sizeof(uint32_t));
     }
 
+    // Calls onMessage(message, byteCount) for each UMP in a UMP batch (see
+    // MIDI_UMP_BATCH_MAXIMUM_SIZE), in order, until it returns false. Returns the number
+    // of bytes walked, which is less than byteCount if onMessage stopped early, or the
+    // buffer wasn't a whole number of UMPs. The boundaries are found with the stream
+    // scanner ahead of the calls, a batch's worth at a time.
+    template <typename TOnMessage>
+    inline std::uint32_t ForEachUmpInBatch(
+        _In_reads_bytes_(byteCount) const void* data,
+        _In_ std::uint32_t const byteCount,
+        _In_ TOnMessage&& onMessage)
+    {
+        auto words = (const std::uint32_t*)data;
+        std::uint32_t wordCount = byteCount / sizeof(std::uint32_t);
+        std::uint32_t offset{ 0 };
+
+        // enough for a MIDI_UMP_BATCH_MAXIMUM_SIZE batch of UMP32s. Anything bigger is
+        // walked in more than one scan
+        std::uint32_t boundaries[128];
+
+        while (offset < wordCount)
+        {
+            std::uint32_t scannedWordCount{ 0 };
+            std::uint32_t messageCount = FindUmpBoundaries(words + offset, wordCount - offset, boundaries, (std::uint32_t)(sizeof(boundaries) / sizeof(boundaries[0])), scannedWordCount);
+
+            if (messageCount == 0)
+            {
+                break;
+            }
+
+            for (std::uint32_t i = 0; i < messageCount; i++)
+            {
+                std::uint32_t messageEnd = (i + 1 < messageCount) ? boundaries[i + 1] : scannedWordCount;
+
+                if (!onMessage((const std::uint8_t*)(words + offset + boundaries[i]), (std::uint32_t)((messageEnd - boundaries[i]) * sizeof(std::uint32_t))))
+                {
+                    return (offset + boundaries[i]) * sizeof(std::uint32_t);
+                }
+            }
+
+            offset += scannedWordCount;
+        }
+
+        return offset * sizeof(std::uint32_t);
+    }
+
     inline std::uint8_t GetGroupIndexFromFirstWord(_In_ const std::uint32_t firstWord) noexcept
     {
         return (uint8_t)((firstWord & MIDI_MESSAGE_GROUP_WORD_DATA_MASK) >> MIDI_MESSAGE_GROUP_BITSHIFT);
@@ -722,45 +741,39 @@ namespace Windows::Devices::Midi2::Internal
     }
 
 
+    // SysEx7 is message type 0x3, with the status in the third nibble
     inline bool IsSysEx7StartMessage(_In_ uint32_t const word0) noexcept
     {
-        UNREFERENCED_PARAMETER(word0);
-
-        // TODO
-        return false;
+        return MIDIWORDNIBBLE1(word0) == 0x3 && MIDIWORDNIBBLE3(word0) == 0x1;
     }
 
     inline bool IsSysEx7ContinueMessage(_In_ uint32_t const word0) noexcept
     {
-        UNREFERENCED_PARAMETER(word0);
-
-        // TODO
-        return false;
+        return MIDIWORDNIBBLE1(word0) == 0x3 && MIDIWORDNIBBLE3(word0) == 0x2;
     }
 
+    // the end packet, which completes a multi-packet SysEx7 message
     inline bool IsSysEx7CompleteMessage(_In_ uint32_t const word0) noexcept
     {
-        UNREFERENCED_PARAMETER(word0);
-
-        // TODO
-        return false;
+        return MIDIWORDNIBBLE1(word0) == 0x3 && MIDIWORDNIBBLE3(word0) == 0x3;
     }
 
     inline bool IsSysEx7SelfContainedMessage(_In_ uint32_t const word0) noexcept
     {
-        UNREFERENCED_PARAMETER(word0);
-
-        // TODO
-        return false;
+        return MIDIWORDNIBBLE1(word0) == 0x3 && MIDIWORDNIBBLE3(word0) == 0x0;
     }
 
 
+    // message type 0x5 statuses 0-3. The rest of the type is mixed data sets
     inline bool IsSysEx8Message(_In_ uint32_t const word0) noexcept
     {
-        UNREFERENCED_PARAMETER(word0);
+        return MIDIWORDNIBBLE1(word0) == 0x5 && MIDIWORDNIBBLE3(word0) <= 0x3;
+    }
 
-        // TODO
-        return false;
+    // timing clock, start, continue, stop, active sensing and reset
+    inline bool IsSystemRealTimeMessage(_In_ uint32_t const word0) noexcept
+    {
+        return MIDIWORDNIBBLE1(word0) == 0x1 && MIDIWORDBYTE2(word0) >= 0xF8;
     }
 
     // To preserve robust connection to all MIDI devices and systems, Senders shall obey the following data rules of the
@@ -799,6 +812,12 @@ namespace Windows::Devices::Midi2::Internal
             return true;
         }
 
+        // and keep timing going
+        if (IsSystemRealTimeMessage(word0))
+        {
+            return true;
+        }
+
 
         return false;
     }
@@ -0,0 +1,224 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Splits a buffer of UMP words into messages. The length of each message comes from a
+// 16 entry table indexed by the message type, and runs of single word messages (MIDI
+// 1.0 channel voice, system common and utility, the bulk of most streams) are found
+// four words at a time with SSE2 or NEON where the compiler targets them. Other builds
+// use the table alone and give the same results.
+//
+// Nothing here allocates or keeps state, so it can be used from the client, the SDK
+// and the service alike. Words needn't be 4-byte aligned.
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UMP_STREAM_SCANNER_SSE2
+#elif defined(_M_ARM64) || defined(_M_ARM64EC) || defined(__aarch64__)
+#include <arm_neon.h>
+#define UMP_STREAM_SCANNER_NEON
+#endif
+
+namespace Windows::Devices::Midi2::Internal
+{
+    // Words in a UMP, indexed by message type (the top nibble of the first word)
+    inline constexpr uint8_t c_UmpWordCountByMessageType[16]{ 1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4 };
+
+    inline uint32_t LoadUmpWord(_In_ const uint32_t* word) noexcept
+    {
+        uint32_t value;
+        memcpy(&value, word, sizeof(value));
+
+        return value;
+    }
+
+#if defined(UMP_STREAM_SCANNER_SSE2) || defined(UMP_STREAM_SCANNER_NEON)
+    // True when all four words have a single word message type (0, 1, 2, 6 or 7), which
+    // makes each of them a whole message
+    inline bool AreFourSingleWordUmps(_In_reads_(4) const uint32_t* words) noexcept
+    {
+#if defined(UMP_STREAM_SCANNER_SSE2)
+        __m128i types = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)words), 28);
+
+        __m128i single = _mm_or_si128(
+            _mm_cmplt_epi32(types, _mm_set1_epi32(3)),
+            _mm_cmpeq_epi32(_mm_or_si128(types, _mm_set1_epi32(1)), _mm_set1_epi32(7)));
+
+        return _mm_movemask_epi8(single) == 0xFFFF;
+#else
+        uint32x4_t types = vshrq_n_u32(vld1q_u32(words), 28);
+
+        uint32x4_t single = vorrq_u32(
+            vcltq_u32(types, vdupq_n_u32(3)),
+            vceqq_u32(vorrq_u32(types, vdupq_n_u32(1)), vdupq_n_u32(7)));
+
+        return vminvq_u32(single) != 0;
+#endif
+    }
+
+    // boundaries[0..3] = index, index + 1, index + 2, index + 3
+    inline void StoreFourUmpBoundaries(_Out_writes_(4) uint32_t* boundaries, _In_ uint32_t const index) noexcept
+    {
+#if defined(UMP_STREAM_SCANNER_SSE2)
+        _mm_storeu_si128((__m128i*)boundaries, _mm_add_epi32(_mm_set1_epi32((int)index), _mm_setr_epi32(0, 1, 2, 3)));
+#else
+        static const uint32_t laneOffsets[4]{ 0, 1, 2, 3 };
+
+        vst1q_u32(boundaries, vaddq_u32(vdupq_n_u32(index), vld1q_u32(laneOffsets)));
+#endif
+    }
+#endif
+
+    template <bool RecordBoundaries>
+    inline uint32_t ScanUmpStream(
+        _In_reads_(wordCount) const uint32_t* words,
+        _In_ uint32_t const wordCount,
+        _Out_writes_to_opt_(maximumBoundaryCount, return) uint32_t* boundaries,
+        _In_ uint32_t const maximumBoundaryCount,
+        _Out_ uint32_t& scannedWordCount) noexcept
+    {
+        uint32_t index{ 0 };
+        uint32_t boundaryCount{ 0 };
+
+        // Any message which starts at least four words from the end fits, so up to there
+        // the length is just the table lookup, with no check and no branch on the type
+        if (wordCount >= 4)
+        {
+            while (index <= wordCount - 4 && boundaryCount < maximumBoundaryCount)
+            {
+#if defined(UMP_STREAM_SCANNER_SSE2) || defined(UMP_STREAM_SCANNER_NEON)
+                if (maximumBoundaryCount - boundaryCount >= 4 && AreFourSingleWordUmps(words + index))
+                {
+                    if constexpr (RecordBoundaries)
+                    {
+                        StoreFourUmpBoundaries(boundaries + boundaryCount, index);
+                    }
+
+                    boundaryCount += 4;
+                    index += 4;
+
+                    continue;
+                }
+#endif
+
+                if constexpr (RecordBoundaries)
+                {
+                    boundaries[boundaryCount] = index;
+                }
+
+                boundaryCount++;
+                index += c_UmpWordCountByMessageType[LoadUmpWord(words + index) >> 28];
+            }
+        }
+
+        while (index < wordCount && boundaryCount < maximumBoundaryCount)
+        {
+            uint32_t messageWordCount = c_UmpWordCountByMessageType[LoadUmpWord(words + index) >> 28];
+
+            if (messageWordCount > wordCount - index)
+            {
+                // the last message is missing words
+                break;
+            }
+
+            if constexpr (RecordBoundaries)
+            {
+                boundaries[boundaryCount] = index;
+            }
+
+            boundaryCount++;
+            index += messageWordCount;
+        }
+
+        scannedWordCount = index;
+
+        return boundaryCount;
+    }
+
+    // Finds the index of the first word of each UMP in words, in one pass. Stops after
+    // maximumBoundaryCount messages, or at a last message which is missing words.
+    // Returns the number of messages found, and scannedWordCount is the number of words
+    // they cover. Message n is from boundaries[n] up to boundaries[n + 1], or up to
+    // scannedWordCount for the last one.
+    //
+    // When fewer than maximumBoundaryCount messages are found and scannedWordCount is
+    // less than wordCount, the words didn't split cleanly into whole messages.
+    inline uint32_t FindUmpBoundaries(
+        _In_reads_(wordCount) const uint32_t* words,
+        _In_ uint32_t const wordCount,
+        _Out_writes_to_(maximumBoundaryCount, return) uint32_t* boundaries,
+        _In_ uint32_t const maximumBoundaryCount,
+        _Out_ uint32_t& scannedWordCount) noexcept
+    {
+        return ScanUmpStream<true>(words, wordCount, boundaries, maximumBoundaryCount, scannedWordCount);
+    }
+
+    // Number of words, from the start, which make up whole UMPs. This is wordCount when
+    // the words split cleanly into messages.
+    inline uint32_t GetWholeUmpWordCount(
+        _In_reads_(wordCount) const uint32_t* words,
+        _In_ uint32_t const wordCount) noexcept
+    {
+        uint32_t scannedWordCount{ 0 };
+
+        ScanUmpStream<false>(words, wordCount, nullptr, UINT32_MAX, scannedWordCount);
+
+        return scannedWordCount;
+    }
+
+    // False when no word has this message type in its top nibble, so the words can't hold
+    // a message of that type. True doesn't mean there is one, since data words are looked
+    // at as well. This is a quick check for listeners which only want one message type.
+    inline bool UmpWordsMayContainMessageType(
+        _In_reads_(wordCount) const uint32_t* words,
+        _In_ uint32_t const wordCount,
+        _In_ uint8_t const messageType) noexcept
+    {
+        uint32_t index{ 0 };
+
+#if defined(UMP_STREAM_SCANNER_SSE2)
+        __m128i type = _mm_set1_epi32(messageType & 0x0F);
+
+        for (; wordCount - index >= 4; index += 4)
+        {
+            __m128i types = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(words + index)), 28);
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(types, type)) != 0)
+            {
+                return true;
+            }
+        }
+#elif defined(UMP_STREAM_SCANNER_NEON)
+        uint32x4_t type = vdupq_n_u32(messageType & 0x0F);
+
+        for (; wordCount - index >= 4; index += 4)
+        {
+            uint32x4_t types = vshrq_n_u32(vld1q_u32(words + index), 28);
+
+            if (vmaxvq_u32(vceqq_u32(types, type)) != 0)
+            {
+                return true;
+            }
+        }
+#endif
+
+        for (; index < wordCount; index++)
+        {
+            if ((LoadUmpWord(words + index) >> 28) == (uint32_t)(messageType & 0x0F))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
@@ -23,6 +23,7 @@
 
 
 #include <cstdint>
+#include <cstddef>
 
 class bytestreamToUMP{
 
@@ -44,8 +45,10 @@ class bytestreamToUMP{
 		uint8_t rpnMsbValue[16];
 		uint8_t rpnMsb[16];
 		uint8_t rpnLsb[16];
+		uint8_t ccMsb[16][32];
 	    	
 		void bsToUMP(uint8_t b0, uint8_t b1, uint8_t b2);
+		void setRpnParameter(uint8_t channel, bool registered, bool msb, uint8_t value);
 
 
 	public:
@@ -60,6 +63,10 @@ class bytestreamToUMP{
 		
 		void bytestreamParse(uint8_t midi1Byte);
 
+		//Batch version. Parses as many bytes as fit in umpOut, writing whole UMPs only.
+		//Returns the number of bytes consumed and sets umpWritten to the number of words written.
+		size_t bytestreamParse(const uint8_t *midi1Bytes, size_t length, uint32_t *umpOut, size_t umpOutLength, size_t &umpWritten);
+
 	
 };
 
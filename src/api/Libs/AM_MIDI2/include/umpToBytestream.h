@@ -23,6 +23,7 @@
 
 
 #include <cstdint>
+#include <cstddef>
 
 class umpToBytestream{
 
@@ -41,6 +42,10 @@ class umpToBytestream{
         bool availableBS();
         uint8_t readBS();
         void UMPStreamParse(uint32_t UMP);
+
+        //Batch version. Parses as many words as fit in bsOutBuffer, writing whole messages only.
+        //Returns the number of words consumed and sets bsWritten to the number of bytes written.
+        size_t UMPStreamParse(const uint32_t *umps, size_t length, uint8_t *bsOutBuffer, size_t bsOutBufferLength, size_t &bsWritten);
 };
 
 #endif
@@ -32,12 +32,16 @@ bytestreamToUMP::bytestreamToUMP(){
     clear(rpnMsbValue, 255, sizeof(rpnMsbValue));
     clear(rpnMsb, 255, sizeof(rpnMsb));
     clear(rpnLsb, 255, sizeof(rpnLsb));
+    clear(rpnMode, false, sizeof(rpnMode));
+    for(uint8_t channel = 0; channel < 16; channel++){
+        clear(ccMsb[channel], 255, sizeof(ccMsb[channel]));
+    }
 }
 	 
 void bytestreamToUMP::bsToUMP(uint8_t b0, uint8_t b1, uint8_t b2){
   uint8_t status = b0 & 0xF0;
  
-   if(d0 >= TIMING_CODE){
+   if(b0 >= TIMING_CODE){
 	  umpMess[messPos] = ((UMP_SYSTEM << 4) + defaultGroup + 0L) << 24;
 	  umpMess[messPos] +=  (b0 + 0L) << 16;
 	  umpMess[messPos] +=  b1  << 8;
@@ -47,6 +51,7 @@ void bytestreamToUMP::bsToUMP(uint8_t b0, uint8_t b1, uint8_t b2){
 	  if(outputMIDI2){
 		  uint8_t channel = b0 & 0xF;
 		  
+		  //MIDI 1.0 Note On with a velocity of 0 is a Note Off with the default velocity
 		  if(status==NOTE_ON && b2==0){
 			 status=NOTE_OFF;
              b2 = 0x40;
@@ -54,23 +59,27 @@ void bytestreamToUMP::bsToUMP(uint8_t b0, uint8_t b1, uint8_t b2){
 		  
 		  umpMess[messPos] = ((UMP_M2CVM << 4) + defaultGroup + 0L) << 24;
 		  umpMess[messPos] += (status + channel + 0L)<<16;
+		  umpMess[messPos+1] = 0;
 		  
 		  if(status==NOTE_ON || status==NOTE_OFF){
 			umpMess[messPos] += (b1 + 0L) <<8;
-                        umpMess[messPos+1] = (M2Utils::scaleUp(b2,7,16) << 16);
+			umpMess[messPos+1] = (M2Utils::scaleUp(b2,7,16) << 16);
 		  } else if (status == KEY_PRESSURE){
 			umpMess[messPos] += (b1 + 0L) <<8;
-                        umpMess[messPos+1] = M2Utils::scaleUp(b2,7,32);
+			umpMess[messPos+1] = M2Utils::scaleUp(b2,7,32);
 		  } else if (status == PITCH_BEND){
-                        umpMess[messPos+1] = M2Utils::scaleUp((b1<<7) + b2,14,32);
+			//LSB first
+			umpMess[messPos+1] = M2Utils::scaleUp(((uint32_t)b2<<7) + b1,14,32);
 		  } else if (status == PROGRAM_CHANGE){
-			if(bankMSB[channel]!=255 && bankLSB[channel]!=255){
+			//Bank Select applies to the next Program Change. A missing half of the bank is 0
+			if(bankMSB[channel]!=255 || bankLSB[channel]!=255){
 				umpMess[messPos] += 1;
-				umpMess[messPos+1] += (bankMSB[channel] <<8) + bankLSB[channel ];
+				umpMess[messPos+1] += ((bankMSB[channel]==255 ? 0 : bankMSB[channel]) <<8)
+					+ (bankLSB[channel]==255 ? 0 : bankLSB[channel]);
 			}
-			umpMess[messPos+1] += (b2 + 0L) << 24;
+			umpMess[messPos+1] += (b1 + 0L) << 24;
 		  } else if (status == CHANNEL_PRESSURE){
-                        umpMess[messPos+1] = M2Utils::scaleUp(b1,7,32);
+			umpMess[messPos+1] = M2Utils::scaleUp(b1,7,32);
 		  }  else if (status == CC){
 			switch(b1){
 			 case 0:
@@ -81,55 +90,58 @@ void bytestreamToUMP::bsToUMP(uint8_t b0, uint8_t b1, uint8_t b2){
 				return; 
 			  
 			 case 6: //RPN MSB Value
+				//Sent straight away with an LSB of 0, as a lot of MIDI 1.0 devices never send
+				//the LSB. If it does turn up it is sent again with the full value.
 				if(rpnMsb[channel]==255 || rpnLsb[channel]==255){
 					return;
 				}
+				rpnMsbValue[channel] = b2;
 				
-				if(rpnMode[channel] && rpnMsb[channel] == 0 && (rpnLsb[channel] == 0 || rpnLsb[channel] == 6)){
-					status = rpnMode[channel]? RPN: NRPN;
-					
-					umpMess[messPos] = ((UMP_M2CVM << 4) + defaultGroup + 0L) << 24;
-					umpMess[messPos] += (status + channel + 0L)<<16;
-					umpMess[messPos] += ((int)rpnMsb[channel]<<7) + rpnLsb[channel] + 0L;
-                                    umpMess[messPos+1] = M2Utils::scaleUp(((int)b2<<7),14,32);
-
-				}else{
-					rpnMsbValue[channel] = b2;
-					return;
-				}
+				status = rpnMode[channel]? RPN: NRPN;
+				
+				umpMess[messPos] = ((UMP_M2CVM << 4) + defaultGroup + 0L) << 24;
+				umpMess[messPos] += (status + channel + 0L)<<16;
+				umpMess[messPos] += ((uint32_t)rpnMsb[channel]<<8) + rpnLsb[channel] + 0L;
+				umpMess[messPos+1] = M2Utils::scaleUp(((uint32_t)b2<<7),14,32);
 				break;
 			case 38: //RPN LSB Value
-				if(rpnMsb[channel]==255 || rpnLsb[channel]==255){
+				if(rpnMsb[channel]==255 || rpnLsb[channel]==255 || rpnMsbValue[channel]==255){
 					return;
 				}
 				status = rpnMode[channel]? RPN: NRPN;
 				
 				umpMess[messPos] = ((UMP_M2CVM << 4) + defaultGroup + 0L) << 24;
 				umpMess[messPos] += (status  + channel + 0L)<<16;
-				umpMess[messPos] += ((int)rpnMsb[channel]<<7) + rpnLsb[channel] + 0L;
-                                umpMess[messPos+1] = M2Utils::scaleUp(((int)rpnMsbValue[channel]<<7) + b2,14,32);
+				umpMess[messPos] += ((uint32_t)rpnMsb[channel]<<8) + rpnLsb[channel] + 0L;
+				umpMess[messPos+1] = M2Utils::scaleUp(((uint32_t)rpnMsbValue[channel]<<7) + b2,14,32);
 				break;
 			case 99:
-				rpnMode[channel] = false;
-				rpnMsb[channel] = b2;
+				setRpnParameter(channel, false, true, b2);
 				return;	
 			case 98:
-				rpnMode[channel] = false;
-				rpnLsb[channel] = b2;
+				setRpnParameter(channel, false, false, b2);
 				return;
 			case 101:
-				rpnMode[channel] = true;
-				rpnMsb[channel] = b2;
+				setRpnParameter(channel, true, true, b2);
 				return;	
-				
 			case 100:
-				rpnMode[channel] = true;
-				rpnLsb[channel] = b2;
+				setRpnParameter(channel, true, false, b2);
 				return;
 					
 			default:
-				umpMess[messPos] += (b1 + 0L) <<8;
-                                umpMess[messPos+1] = M2Utils::scaleUp(b2,7,32);
+				if(b1 < 32){
+					//14 bit Controller MSB. Sent straight away, the LSB refines it
+					ccMsb[channel][b1] = b2;
+					umpMess[messPos] += (b1 + 0L) <<8;
+					umpMess[messPos+1] = M2Utils::scaleUp(b2,7,32);
+				}else if(b1 < 64 && ccMsb[channel][b1 - 32] != 255){
+					//14 bit Controller LSB. Sent as the full value on the MSB's controller
+					umpMess[messPos] += (b1 - 32 + 0L) <<8;
+					umpMess[messPos+1] = M2Utils::scaleUp(((uint32_t)ccMsb[channel][b1 - 32]<<7) + b2,14,32);
+				}else{
+					umpMess[messPos] += (b1 + 0L) <<8;
+					umpMess[messPos+1] = M2Utils::scaleUp(b2,7,32);
+				}
 				break;
 			}					
 		  }
@@ -147,6 +159,30 @@ void bytestreamToUMP::bsToUMP(uint8_t b0, uint8_t b1, uint8_t b2){
   
 }
 
+void bytestreamToUMP::setRpnParameter(uint8_t channel, bool registered, bool msb, uint8_t value){
+	//Switching between RPN and NRPN starts a new parameter number
+	if(rpnMode[channel] != registered){
+		rpnMsb[channel] = 255;
+		rpnLsb[channel] = 255;
+	}
+	rpnMode[channel] = registered;
+	
+	if(msb){
+		rpnMsb[channel] = value;
+	}else{
+		rpnLsb[channel] = value;
+	}
+	
+	//A new parameter number needs a new Data Entry MSB before the LSB means anything
+	rpnMsbValue[channel] = 255;
+	
+	//RPN Null. Data Entry is ignored until another parameter is selected
+	if(registered && rpnMsb[channel] == 127 && rpnLsb[channel] == 127){
+		rpnMsb[channel] = 255;
+		rpnLsb[channel] = 255;
+	}
+}
+
 
 bool bytestreamToUMP::availableUMP(){
 	return messPos;
@@ -154,7 +190,7 @@ bool bytestreamToUMP::availableUMP(){
 
 uint32_t bytestreamToUMP::readUMP(){
 	uint32_t mess = umpMess[0];			
-	for(uint8_t i=0;i<messPos;i++){
+	for(uint8_t i=0;i+1<messPos;i++){
 		umpMess[i]=umpMess[i+1];
 	}
 	messPos--;			
@@ -211,9 +247,9 @@ void bytestreamToUMP::bytestreamParse(uint8_t midi1Byte){
 		d1 = 255;
   } else if (d0){ // status byte set
 	  if (
-		d0 == PROGRAM_CHANGE
+		(d0 & 0xF0) == PROGRAM_CHANGE
 		|| d0 == TIMING_CODE
-		|| d0 == CHANNEL_PRESSURE
+		|| (d0 & 0xF0) == CHANNEL_PRESSURE
 		|| d0 == SONG_SELECT
 	  ) { 
           bsToUMP(d0, midi1Byte, 0);
@@ -226,3 +262,33 @@ void bytestreamToUMP::bytestreamParse(uint8_t midi1Byte){
   }  
 }
 
+
+size_t bytestreamToUMP::bytestreamParse(const uint8_t *midi1Bytes, size_t length, uint32_t *umpOut, size_t umpOutLength, size_t &umpWritten){
+	size_t consumed = 0;
+	umpWritten = 0;
+
+	//Anything left over from the single byte parser goes out first
+	uint8_t pending = 0;
+	while(pending < messPos && umpWritten < umpOutLength){
+		umpOut[umpWritten++] = umpMess[pending++];
+	}
+	if(pending < messPos){
+		for(uint8_t i=pending;i<messPos;i++){
+			umpMess[i-pending]=umpMess[i];
+		}
+		messPos -= pending;
+		return 0;
+	}
+	messPos = 0;
+
+	//A single byte never produces more than one 64 bit UMP
+	while(consumed < length && umpOutLength - umpWritten >= 2){
+		bytestreamParse(midi1Bytes[consumed++]);
+		for(uint8_t i=0;i<messPos;i++){
+			umpOut[umpWritten++] = umpMess[i];
+		}
+		messPos = 0;
+	}
+
+	return consumed;
+}
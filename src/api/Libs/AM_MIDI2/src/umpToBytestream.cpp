@@ -30,7 +30,7 @@ bool umpToBytestream::availableBS(){
 
 uint8_t umpToBytestream::readBS(){
     uint8_t mess = bsOut[0];
-    for(uint8_t i=0;i<bsOutLength;i++){
+    for(uint8_t i=0;i+1<bsOutLength;i++){
         bsOut[i]=bsOut[i+1];
     }
     bsOutLength--;
@@ -264,3 +264,33 @@ void umpToBytestream::UMPStreamParse(uint32_t UMP){
     }
 
 }
+
+size_t umpToBytestream::UMPStreamParse(const uint32_t *umps, size_t length, uint8_t *bsOutBuffer, size_t bsOutBufferLength, size_t &bsWritten){
+    size_t consumed = 0;
+    bsWritten = 0;
+
+    //Anything left over from the single word parser goes out first
+    uint8_t pending = 0;
+    while(pending < bsOutLength && bsWritten < bsOutBufferLength){
+        bsOutBuffer[bsWritten++] = bsOut[pending++];
+    }
+    if(pending < bsOutLength){
+        for(uint8_t i=pending;i<bsOutLength;i++){
+            bsOut[i-pending]=bsOut[i];
+        }
+        bsOutLength -= pending;
+        return 0;
+    }
+    bsOutLength = 0;
+
+    //A single word never produces more than sizeof(bsOut) bytes
+    while(consumed < length && bsOutBufferLength - bsWritten >= sizeof(bsOut)){
+        UMPStreamParse(umps[consumed++]);
+        for(uint8_t i=0;i<bsOutLength;i++){
+            bsOutBuffer[bsWritten++] = bsOut[i];
+        }
+        bsOutLength = 0;
+    }
+
+    return consumed;
+}
@@ -21,8 +21,17 @@
 #include "MidiKsDef.h"
 #include "MidiKsCommon.h"
 #include "MidiXProc.h"
+#include "midi_shared_ring.h"
 #include "MidiKs.h"
 
+namespace internal = ::Windows::Devices::Midi2::Internal;
+
+// the drivers lay out the register page as KSMIDILOOPED_REGISTERS_HEADER describes
+static_assert(KSMIDILOOPED_REGISTERS_LAYOUT_VERSION == MIDI_SHARED_RING_LAYOUT_VERSION, "looped register layout mismatch");
+static_assert(offsetof(internal::MidiSharedRingRegisters, Header) == 0, "looped register layout mismatch");
+static_assert(offsetof(internal::MidiSharedRingRegisters, ReadPosition) == KSMIDILOOPED_REGISTERS_READ_OFFSET, "looped register layout mismatch");
+static_assert(offsetof(internal::MidiSharedRingRegisters, WritePosition) == KSMIDILOOPED_REGISTERS_WRITE_OFFSET, "looped register layout mismatch");
+
 KSMidiDevice::~KSMidiDevice()
 {
     Cleanup();
@@ -131,6 +140,21 @@ KSMidiDevice::Cleanup()
     return S_OK;
 }
 
+_Use_decl_annotations_
+HRESULT
+KSMidiDevice::GetStatistics(
+    MIDI_PIPE_STATISTICS& MidiIn,
+    MIDI_PIPE_STATISTICS& MidiOut
+)
+{
+    MidiIn = {};
+    MidiOut = {};
+
+    RETURN_HR_IF(E_NOTIMPL, !m_CrossProcessMidiPump);
+
+    return m_CrossProcessMidiPump->GetStatistics(MidiIn, MidiOut);
+}
+
 _Use_decl_annotations_
 HRESULT
 KSMidiDevice::PinSetState(
@@ -208,6 +232,17 @@ KSMidiDevice::ConfigureLoopedRegisters()
         sizeof(registers),
         nullptr));
 
+    // A driver with the original layout, the two registers next to each other and no
+    // header, is turned away before we look for a header it doesn't have.
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH),
+        (PBYTE) registers.WritePosition - (PBYTE) registers.ReadPosition != KSMIDILOOPED_REGISTERS_WRITE_OFFSET - KSMIDILOOPED_REGISTERS_READ_OFFSET);
+
+    auto sharedRegisters = (internal::MidiSharedRingRegisters*) ((PBYTE) registers.ReadPosition - KSMIDILOOPED_REGISTERS_READ_OFFSET);
+
+    // the driver has to be using our layout, for the buffer we were given
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH),
+        !internal::IsMidiSharedRingRegistersCompatible(*sharedRegisters, m_MidiPipe->Data.BufferSize));
+
     m_MidiPipe->Registers.ReadPosition = (PULONG) registers.ReadPosition;
     m_MidiPipe->Registers.WritePosition = (PULONG) registers.WritePosition;
 
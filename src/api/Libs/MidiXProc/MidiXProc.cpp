@@ -24,6 +24,10 @@
 #include "MidiKsDef.h"
 #include "MidiDefs.h"
 #include "MidiXProc.h"
+#include "midi_shared_ring.h"
+#include "midi_timestamp.h"
+
+using namespace Windows::Devices::Midi2::Internal;
 
 _Use_decl_annotations_
 HRESULT
@@ -111,12 +115,30 @@ CreateMappedDataBuffer(ULONG RequestedSize,
 _Use_decl_annotations_
 HRESULT
 CreateMappedRegisters(PMEMORY_MAPPED_BUFFER Buffer,
+                        ULONG DataBufferSize,
                         PMEMORY_MAPPED_REGISTERS Registers
 )
 {
-    RETURN_IF_FAILED(CreateMappedBuffer(FALSE, sizeof(ULONG) * 2, Buffer));
-    Registers->ReadPosition = (PULONG)Buffer->Map1.get();
-    Registers->WritePosition = Registers->ReadPosition + 1;
+    // if we don't have a file mapping yet, we're the side creating the registers
+    BOOL created = !Buffer->FileMapping;
+
+    RETURN_IF_FAILED(CreateMappedBuffer(FALSE, sizeof(MidiSharedRingRegisters), Buffer));
+
+    MidiSharedRingRegisters* sharedRegisters = (MidiSharedRingRegisters*)Buffer->Map1.get();
+
+    if (created)
+    {
+        InitializeMidiSharedRingRegisters(*sharedRegisters, DataBufferSize);
+    }
+    else
+    {
+        // the other side has to be using the same layout, with the same data buffer
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH), !IsMidiSharedRingRegistersCompatible(*sharedRegisters, DataBufferSize));
+    }
+
+    Registers->ReadPosition = (PULONG)&sharedRegisters->ReadPosition;
+    Registers->WritePosition = (PULONG)&sharedRegisters->WritePosition;
+    Registers->WriterWaiting = (PULONG)&sharedRegisters->WriterWaiting;
     return S_OK;
 }
 
@@ -172,6 +194,22 @@ EnableMmcss(
     return S_OK;
 }
 
+// raises a MIDI_XPROC_PIPE_COUNTERS maximum to Value, if it's bigger
+template <typename T>
+static
+void
+UpdateMaximum(
+    std::atomic<T>& Maximum,
+    T Value
+)
+{
+    T current = Maximum.load(std::memory_order_relaxed);
+
+    while (Value > current && !Maximum.compare_exchange_weak(current, Value, std::memory_order_relaxed))
+    {
+    }
+}
+
 CMidiXProc::~CMidiXProc()
 {
     Cleanup();
@@ -193,6 +231,13 @@ CMidiXProc::Initialize(DWORD* MmcssTaskId,
 
     m_MidiInCallback = MidiInCallback;
     m_MidiInCallbackContext = Context;
+
+    // callbacks which can take the messages in batches get them that way
+    if (m_MidiInCallback)
+    {
+        m_MidiInBatchCallback = m_MidiInCallback.try_query<IMidiBatchCallback>();
+    }
+
     m_ThreadTerminateEvent.create();
     m_ThreadStartedEvent.create();
     m_MmcssTaskId = *MmcssTaskId;
@@ -202,6 +247,16 @@ CMidiXProc::Initialize(DWORD* MmcssTaskId,
     m_MidiIn = std::move(MidiIn);
     m_MidiOut = std::move(MidiOut);
 
+    if (m_MidiIn)
+    {
+        m_MidiInCachedWritePosition = InterlockedCompareExchange((LONG*)m_MidiIn->Registers.WritePosition, 0, 0);
+    }
+
+    if (m_MidiOut)
+    {
+        m_MidiOutCachedReadPosition = InterlockedCompareExchange((LONG*)m_MidiOut->Registers.ReadPosition, 0, 0);
+    }
+
     // true if incoming messages from the device should get a timestamp
     // we never timestamp outgoing messages TO the device, because 0 has
     // "send immediately" semantics, similar to other operating systems.
@@ -210,6 +265,22 @@ CMidiXProc::Initialize(DWORD* MmcssTaskId,
     // enumeration time
     m_OverwriteZeroTimestamp = OverwriteZeroTimestamp;
 
+    // polling the midi in buffer is opt in, for machines which can spare the CPU
+    DWORD pollingWindowMicroseconds{ MIDI_XPROC_DEFAULT_POLLING_WINDOW_MICROSECONDS };
+
+    try
+    {
+        pollingWindowMicroseconds = wil::reg::get_value<DWORD>(HKEY_LOCAL_MACHINE, MIDI_ROOT_REG_KEY, MIDI_XPROC_POLLING_WINDOW_REG_VALUE);
+    }
+    catch (...)
+    {
+        // value is not present in the registry, so keep the default
+    }
+
+    RETURN_IF_FAILED(SetMidiInPollingWindow((std::min)(pollingWindowMicroseconds, (DWORD)MIDI_XPROC_MAXIMUM_POLLING_WINDOW_MICROSECONDS)));
+
+    m_StartTime = (LONGLONG)Shared::GetCurrentMidiTimestamp();
+
     // if we have midi in, create our worker.
     if (m_MidiIn)
     {
@@ -259,110 +330,427 @@ CMidiXProc::SendMidiMessage(
     LONGLONG Position
 )
 {
-    BOOL bufferSent {FALSE};
-    UINT32 requiredBufferSize = sizeof(LOOPEDDATAFORMAT) + Length;
-    UINT maxRetries{ 10000 };
+    return SendMidiMessage(MidiData, Length, Position, MIDI_XPROC_DEFAULT_SEND_TIMEOUT_MS);
+}
+
+// Sends the message, waiting up to TimeoutMs for the reader to make room if the
+// buffer is full. With a TimeoutMs of 0 this never waits, and fails right away
+// if the message doesn't fit. GetMidiOutBytesAvailable tells how much will.
+_Use_decl_annotations_
+HRESULT
+CMidiXProc::SendMidiMessage(
+    void * MidiData,
+    UINT32 Length,
+    LONGLONG Position,
+    DWORD TimeoutMs
+)
+{
+    MIDIMESSAGEBATCHENTRY message{ Position, MidiData, Length };
+    UINT32 sentCount{ 0 };
+
+    return SendMidiMessages(&message, 1, TimeoutMs, sentCount);
+}
+
+// Sends the messages in order. Each pass over the registers copies as many of
+// them as fit into the buffer, back to back, then publishes them with a single
+// update of the write position and a single event. If they don't all fit, this
+// waits for room as SendMidiMessage does. SentCount is how many were accepted,
+// which is less than MessageCount only if this fails.
+_Use_decl_annotations_
+HRESULT
+CMidiXProc::SendMidiMessages(
+    PMIDIMESSAGEBATCHENTRY Messages,
+    UINT32 MessageCount,
+    DWORD TimeoutMs,
+    UINT32& SentCount
+)
+{
+    SentCount = 0;
 
     RETURN_HR_IF(E_UNEXPECTED, !m_MidiOut);
-    RETURN_HR_IF(E_INVALIDARG, Length > MAXIMUM_LOOPED_DATASIZE);
-    RETURN_HR_IF(E_INVALIDARG, Length < MINIMUM_LOOPED_DATASIZE);
+    RETURN_HR_IF(E_INVALIDARG, nullptr == Messages && MessageCount > 0);
+
+    // check everything first, so we don't send half of an invalid batch
+    for (UINT32 i = 0; i < MessageCount; i++)
+    {
+        RETURN_HR_IF(E_INVALIDARG, Messages[i].ByteCount > MAXIMUM_LOOPED_DATASIZE);
+        RETURN_HR_IF(E_INVALIDARG, Messages[i].ByteCount < MINIMUM_LOOPED_DATASIZE);
+    }
 
     PMEMORY_MAPPED_REGISTERS Registers = &(m_MidiOut->Registers);
     PMEMORY_MAPPED_DATA Data = &(m_MidiOut->Data);
+    ULONGLONG startTime = GetTickCount64();
+    BOOL bufferWasFull{ FALSE };
 
-    do{
+    while (SentCount < MessageCount)
+    {
         // the write position is the last position we have written,
         // the read position is the last position the driver has read from
         ULONG writePosition = InterlockedCompareExchange((LONG*)Registers->WritePosition, 0, 0);
-        ULONG readPosition = InterlockedCompareExchange((LONG*)Registers->ReadPosition, 0, 0);
-        ULONG newWritePosition = (writePosition + requiredBufferSize) % Data->BufferSize;
-        ULONG bytesAvailable{ 0 };
+        ULONG readPosition = m_MidiOutCachedReadPosition;
+        ULONG bytesAvailable = GetMidiSharedRingWritableByteCount(readPosition, writePosition, Data->BufferSize);
 
-        // Calculate the available space in the buffer.
-        if (readPosition <= writePosition)
+        // only look at the reader's register when our copy of it says the next
+        // message doesn't fit
+        if (bytesAvailable < sizeof(LOOPEDDATAFORMAT) + Messages[SentCount].ByteCount)
         {
-            bytesAvailable = Data->BufferSize - (writePosition - readPosition);
-        }
-        else
-        {
-            bytesAvailable = (readPosition - writePosition);
+            readPosition = InterlockedCompareExchange((LONG*)Registers->ReadPosition, 0, 0);
+            m_MidiOutCachedReadPosition = readPosition;
+            bytesAvailable = GetMidiSharedRingWritableByteCount(readPosition, writePosition, Data->BufferSize);
+
+            UpdateMaximum(m_MidiOutCounters.HighWaterMark, Data->BufferSize - 1 - bytesAvailable);
         }
 
-        // Note, if we fill the buffer up 100%, then write position == read position,
-        // which is the same as when the buffer is empty and everything in the buffer
-        // would be lost.
-        // Reserve 1 byte so that when the buffer is full the write position will trail
-        // the read position.
-        // Because of this reserve, and the above calculation, the true bytesAvailable 
-        // count can never be 0.
-        assert(bytesAvailable != 0);
-        bytesAvailable--;
-
-        // if there is sufficient space to write the buffer, send it
-        if (bytesAvailable >= requiredBufferSize)
+        ULONG newWritePosition = writePosition;
+        UINT32 writtenCount{ 0 };
+        UINT32 writtenByteCount{ 0 };
+        LONGLONG qpc{ 0 };
+
+        // write as many of the remaining messages as there is space for
+        while (SentCount + writtenCount < MessageCount)
         {
-            PLOOPEDDATAFORMAT header = (PLOOPEDDATAFORMAT)(((BYTE*)Data->BufferAddress) + writePosition);
+            auto const& message = Messages[SentCount + writtenCount];
+            UINT32 requiredBufferSize = sizeof(LOOPEDDATAFORMAT) + message.ByteCount;
+
+            if (bytesAvailable < requiredBufferSize)
+            {
+                break;
+            }
 
-            header->ByteCount = Length;
-            CopyMemory((((BYTE*)header) + sizeof(LOOPEDDATAFORMAT)), MidiData, Length);
+            PLOOPEDDATAFORMAT header = (PLOOPEDDATAFORMAT)(((BYTE*)Data->BufferAddress) + newWritePosition);
+
+            header->ByteCount = message.ByteCount;
+            CopyMemory((((BYTE*)header) + sizeof(LOOPEDDATAFORMAT)), message.Data, message.ByteCount);
 
             // if a position provided is nonzero, use it, otherwise use the current QPC
-            if (Position)
+            if (message.Position)
             {
-                header->Position = Position;
+                header->Position = message.Position;
             }
             else if (m_OverwriteZeroTimestamp)
             {
-                LARGE_INTEGER qpc{ 0 };
-                QueryPerformanceCounter(&qpc);
-                header->Position = qpc.QuadPart;
+                if (qpc == 0)
+                {
+                    qpc = (LONGLONG)Shared::GetCurrentMidiTimestamp();
+                }
+
+                header->Position = qpc;
             }
 
+            newWritePosition = (newWritePosition + requiredBufferSize) % Data->BufferSize;
+            bytesAvailable -= requiredBufferSize;
+            writtenByteCount += message.ByteCount;
+            writtenCount++;
+        }
+
+        if (writtenCount > 0)
+        {
             // update the write position and notify the other side that data is available.
             InterlockedExchange((LONG*)Registers->WritePosition, newWritePosition);
             RETURN_LAST_ERROR_IF(FALSE == SetEvent(m_MidiOut->WriteEvent.get()));
 
-            //if (!SetEvent(m_MidiOut->WriteEvent.get()))
-            //{
-            //    LOG_LAST_ERROR();
-            //    RETURN_LAST_ERROR_IF(true);
-            //}
+            m_MidiOutCounters.MessageCount.fetch_add(writtenCount, std::memory_order_relaxed);
+            m_MidiOutCounters.ByteCount.fetch_add(writtenByteCount, std::memory_order_relaxed);
+            m_MidiOutCounters.BatchCount.fetch_add(1, std::memory_order_relaxed);
 
-            bufferSent = TRUE;
+            SentCount += writtenCount;
+            continue;
+        }
+
+        // not even the next message fits, so wait for the reader to make room
+        UINT32 requiredBufferSize = sizeof(LOOPEDDATAFORMAT) + Messages[SentCount].ByteCount;
+        ULONGLONG elapsed = GetTickCount64() - startTime;
+
+        if (!bufferWasFull)
+        {
+            m_MidiOutCounters.BufferFullCount.fetch_add(1, std::memory_order_relaxed);
+            bufferWasFull = TRUE;
+        }
+
+        if (elapsed >= TimeoutMs)
+        {
+            m_MidiOutCounters.TimeoutCount.fetch_add(1, std::memory_order_relaxed);
+
+            // Failed to send the buffer due to insufficient space. A caller which
+            // asked not to wait expects this, so only log when we did wait.
+            if (TimeoutMs != 0)
+            {
+                LOG_IF_FAILED(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER));
+            }
+
+            return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+        }
+
+        m_MidiOutCounters.RetryCount.fetch_add(1, std::memory_order_relaxed);
+
+        if (m_MidiOut->SpaceAvailableEvent && Registers->WriterWaiting)
+        {
+            // Reset the event and tell the reader we're waiting, then look at the read
+            // position once more. If the reader freed space before it saw the flag, we
+            // see that space here. Otherwise, it sees the flag and sets the event.
+            m_MidiOut->SpaceAvailableEvent.ResetEvent();
+            InterlockedExchange((LONG*)Registers->WriterWaiting, 1);
+
+            readPosition = InterlockedCompareExchange((LONG*)Registers->ReadPosition, 0, 0);
+            m_MidiOutCachedReadPosition = readPosition;
+
+            if (GetMidiSharedRingWritableByteCount(readPosition, writePosition, Data->BufferSize) < requiredBufferSize)
+            {
+                m_MidiOut->SpaceAvailableEvent.wait((DWORD)(TimeoutMs - elapsed));
+            }
         }
         else
         {
-            // relinquish the remainder of this processing slice and try again on the next
-            //Sleep(0);
-            
-            // if you remove this line, you will get additional send *and* receive failures
-            // if you set it to Sleep(0), you will end up with missing messages if we're 
-            // spammed heavily
-            // If you set it to Sleep(1), there's more jitter, but all messages arrive.
+            // The reader is a driver, which can't tell us when it has made room, so poll.
+            // Sleep(0) here ends up with missing messages if we're spammed heavily.
+            // Sleep(1) adds jitter, but all messages arrive.
             Sleep(1);
         }
+    }
+
+    return S_OK;
+}
+
+// For a writer which would rather not tie up a thread waiting for room. Returns S_FALSE
+// if a message of ByteCount bytes fits now. Otherwise tells the reader we're waiting,
+// and returns the event it sets once it has made room, for the caller to wait on
+// however suits it. Only the writer may call this.
+_Use_decl_annotations_
+HRESULT
+CMidiXProc::ArmMidiOutSpaceAvailable(
+    UINT32 ByteCount,
+    HANDLE& SpaceAvailableEvent
+)
+{
+    SpaceAvailableEvent = NULL;
 
-    }while (!bufferSent && --maxRetries > 0);
+    RETURN_HR_IF(E_UNEXPECTED, !m_MidiOut);
+
+    // a driver reader can't tell us when it has made room
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED), !m_MidiOut->SpaceAvailableEvent);
+
+    PMEMORY_MAPPED_REGISTERS Registers = &(m_MidiOut->Registers);
+    PMEMORY_MAPPED_DATA Data = &(m_MidiOut->Data);
+    UINT32 requiredBufferSize = sizeof(LOOPEDDATAFORMAT) + ByteCount;
+
+    // The same handshake as SendMidiMessages. If the reader freed space before it saw
+    // the flag, we see that space here. Otherwise, it sees the flag and sets the event.
+    m_MidiOut->SpaceAvailableEvent.ResetEvent();
+    InterlockedExchange((LONG*)Registers->WriterWaiting, 1);
+
+    ULONG writePosition = InterlockedCompareExchange((LONG*)Registers->WritePosition, 0, 0);
+    ULONG readPosition = InterlockedCompareExchange((LONG*)Registers->ReadPosition, 0, 0);
+    m_MidiOutCachedReadPosition = readPosition;
 
-    // Failed to send the buffer due to insufficient space,
-    // fail.
-    if (!bufferSent)
+    if (GetMidiSharedRingWritableByteCount(readPosition, writePosition, Data->BufferSize) >= requiredBufferSize)
     {
-        LOG_IF_FAILED(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER));
-        return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+        return S_FALSE;
     }
 
+    SpaceAvailableEvent = m_MidiOut->SpaceAvailableEvent.get();
+
     return S_OK;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidiXProc::GetMidiOutBytesAvailable(
+    UINT32& BytesAvailable
+)
+{
+    BytesAvailable = 0;
+
+    RETURN_HR_IF(E_UNEXPECTED, !m_MidiOut);
+
+    PMEMORY_MAPPED_REGISTERS Registers = &(m_MidiOut->Registers);
+
+    ULONG writePosition = InterlockedCompareExchange((LONG*)Registers->WritePosition, 0, 0);
+    ULONG readPosition = InterlockedCompareExchange((LONG*)Registers->ReadPosition, 0, 0);
+
+    // each message also takes up a LOOPEDDATAFORMAT header
+    BytesAvailable = GetMidiSharedRingWritableByteCount(readPosition, writePosition, m_MidiOut->Data.BufferSize);
+
+    return S_OK;
+}
+
+// Waits until the other side has read everything we've sent. The reader only
+// moves the read position once it has handed a message on, so when this
+// returns, every message sent before the call has been delivered.
+_Use_decl_annotations_
+HRESULT
+CMidiXProc::WaitForMidiOutEmpty(
+    DWORD TimeoutMs
+)
+{
+    RETURN_HR_IF(E_UNEXPECTED, !m_MidiOut);
+
+    PMEMORY_MAPPED_REGISTERS Registers = &(m_MidiOut->Registers);
+    ULONGLONG startTime = GetTickCount64();
+
+    for (;;)
+    {
+        ULONG writePosition = InterlockedCompareExchange((LONG*)Registers->WritePosition, 0, 0);
+        ULONG readPosition = InterlockedCompareExchange((LONG*)Registers->ReadPosition, 0, 0);
+
+        if (readPosition == writePosition)
+        {
+            return S_OK;
+        }
+
+        if (GetTickCount64() - startTime >= TimeoutMs)
+        {
+            return HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+        }
+
+        Sleep(1);
+    }
+}
+
+// Turns polling of the midi in buffer on, polling for at most PollingWindowMicroseconds
+// each time it runs dry, or off with 0. Overrides the registry setting, and can be
+// changed while the worker is running.
+_Use_decl_annotations_
+HRESULT
+CMidiXProc::SetMidiInPollingWindow(
+    DWORD PollingWindowMicroseconds
+)
+{
+    RETURN_HR_IF(E_INVALIDARG, PollingWindowMicroseconds > MIDI_XPROC_MAXIMUM_POLLING_WINDOW_MICROSECONDS);
+
+    if (0 == m_QpcFrequency)
+    {
+        LARGE_INTEGER frequency{ 0 };
+        QueryPerformanceFrequency(&frequency);
+        m_QpcFrequency = frequency.QuadPart;
+    }
+
+    InterlockedExchange64(&m_MidiInPollingWindow, ((LONGLONG)PollingWindowMicroseconds * m_QpcFrequency) / 1000000);
+
+    return S_OK;
+}
+
+// Counts for each direction since Initialize. A direction this doesn't have is all
+// zeros. Each count is read on its own, so they may be slightly out of step with each
+// other while messages are moving.
+_Use_decl_annotations_
+HRESULT
+CMidiXProc::GetStatistics(
+    MIDI_PIPE_STATISTICS& MidiIn,
+    MIDI_PIPE_STATISTICS& MidiOut
+)
+{
+    LONGLONG now = (LONGLONG)Shared::GetCurrentMidiTimestamp();
+
+    auto fill = [&](MIDI_XPROC_PIPE_COUNTERS const& Counters, std::unique_ptr<MEMORY_MAPPED_PIPE> const& Pipe, MIDI_PIPE_STATISTICS& Statistics)
+    {
+        Statistics = {};
+
+        if (!Pipe)
+        {
+            return;
+        }
+
+        Statistics.BufferSize = Pipe->Data.BufferSize;
+        Statistics.HighWaterMark = Counters.HighWaterMark.load(std::memory_order_relaxed);
+        Statistics.MessageCount = Counters.MessageCount.load(std::memory_order_relaxed);
+        Statistics.ByteCount = Counters.ByteCount.load(std::memory_order_relaxed);
+        Statistics.BatchCount = Counters.BatchCount.load(std::memory_order_relaxed);
+        Statistics.BufferFullCount = Counters.BufferFullCount.load(std::memory_order_relaxed);
+        Statistics.RetryCount = Counters.RetryCount.load(std::memory_order_relaxed);
+        Statistics.TimeoutCount = Counters.TimeoutCount.load(std::memory_order_relaxed);
+        Statistics.WakeupCount = Counters.WakeupCount.load(std::memory_order_relaxed);
+        Statistics.PollCount = Counters.PollCount.load(std::memory_order_relaxed);
+        Statistics.PollHitCount = Counters.PollHitCount.load(std::memory_order_relaxed);
+        Statistics.MaximumConsumerLag = Counters.MaximumConsumerLag.load(std::memory_order_relaxed);
+        Statistics.ElapsedTicks = now - m_StartTime;
+    };
+
+    fill(m_MidiInCounters, m_MidiIn, MidiIn);
+    fill(m_MidiOutCounters, m_MidiOut, MidiOut);
+
+    return S_OK;
+}
+
+// Called by the worker when the midi in buffer has just run dry, at IdleStart. If
+// polling is on, and bursts of messages have lately been arriving close enough together
+// for it to pay off, watches the write position for a while instead of going straight
+// back to waiting on the event. The window is twice the average gap between bursts, up
+// to the configured maximum. Returns TRUE if more messages arrived in that time.
+_Use_decl_annotations_
+BOOL
+CMidiXProc::PollMidiIn(
+    LONGLONG IdleStart
+)
+{
+    LONGLONG maximumWindow = InterlockedCompareExchange64(&m_MidiInPollingWindow, 0, 0);
+
+    // the gaps are longer than we're willing to poll for, so polling would only
+    // burn CPU. The average keeps being updated from the event wake ups, so we'll
+    // start polling again if the traffic picks up.
+    if (0 == maximumWindow || m_MidiInAverageGap > maximumWindow)
+    {
+        return FALSE;
+    }
+
+    LONGLONG window = (0 == m_MidiInAverageGap) ? maximumWindow : (std::min)(m_MidiInAverageGap * 2, maximumWindow);
+    PMEMORY_MAPPED_REGISTERS Registers = &(m_MidiIn->Registers);
+    ULONG readPosition = InterlockedCompareExchange((LONG*) Registers->ReadPosition, 0, 0);
+    LARGE_INTEGER now{ 0 };
+
+    m_MidiInCounters.PollCount.fetch_add(1, std::memory_order_relaxed);
+
+    // this is a real spin, so it's timed on the performance counter rather than the
+    // clock source the timestamps come from
+    do
+    {
+        ULONG writePosition = InterlockedCompareExchange((LONG*) Registers->WritePosition, 0, 0);
+
+        if (writePosition != readPosition)
+        {
+            m_MidiInCachedWritePosition = writePosition;
+            m_MidiInCounters.PollHitCount.fetch_add(1, std::memory_order_relaxed);
+            return TRUE;
+        }
+
+        YieldProcessor();
+        QueryPerformanceCounter(&now);
+    } while (now.QuadPart - IdleStart < window);
+
+    return FALSE;
+}
+
 HRESULT
 CMidiXProc::ProcessMidiIn()
 {
+    BOOL polled {FALSE};
+    LONGLONG idleStart {0};
+
     do
     {
-        // wait on write event or exit event
+        // wait on write event or exit event. If polling already found more messages,
+        // there's no need to wait, only to check that we aren't exiting.
         HANDLE handles[] = { m_ThreadTerminateEvent.get(), m_MidiIn->WriteEvent.get() };
-        DWORD ret = WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, INFINITE);
+        DWORD ret = WAIT_OBJECT_0 + 1;
+
+        if (polled)
+        {
+            if (WAIT_OBJECT_0 == WaitForSingleObject(m_ThreadTerminateEvent.get(), 0))
+            {
+                ret = WAIT_OBJECT_0;
+            }
+        }
+        else
+        {
+            ret = WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, INFINITE);
+
+            if (ret == (WAIT_OBJECT_0 + 1))
+            {
+                m_MidiInCounters.WakeupCount.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        polled = FALSE;
+
         if (ret == (WAIT_OBJECT_0 + 1))
         {
             PMEMORY_MAPPED_REGISTERS Registers = &(m_MidiIn->Registers);
@@ -377,58 +765,127 @@ CMidiXProc::ProcessMidiIn()
                 // the read position is the last position we have read,
                 // the write position is the last position written to
                 ULONG readPosition = InterlockedCompareExchange((LONG*) Registers->ReadPosition, 0, 0);
-                ULONG writePosition = InterlockedCompareExchange((LONG*) Registers->WritePosition, 0, 0);
-                ULONG bytesAvailable {0};
-
-                if (readPosition <= writePosition)
+                ULONG writePosition = m_MidiInCachedWritePosition;
+                BOOL writePositionRefreshed {FALSE};
+                UINT messageCount {0};
+                UINT byteCount {0};
+                LONGLONG qpc {0};
+
+                // collect every complete message which is available, up to a batch, so they
+                // can be handed over together and their space released with a single update
+                // of the read position.
+                while (messageCount < ARRAYSIZE(m_MidiInBatch))
                 {
-                    bytesAvailable = writePosition - readPosition;
-                }
-                else
-                {
-                    bytesAvailable = Data->BufferSize - (readPosition - writePosition);
+                    ULONG bytesAvailable = GetMidiSharedRingReadableByteCount(readPosition, writePosition, Data->BufferSize);
+                    PLOOPEDDATAFORMAT header = (PLOOPEDDATAFORMAT) (((BYTE *) Data->BufferAddress) + readPosition);
+
+                    // need at least the LOOPEDDATAFORMAT, and then the full contents of
+                    // the message, to move forward.
+                    if (bytesAvailable < sizeof(LOOPEDDATAFORMAT) ||
+                        bytesAvailable < sizeof(LOOPEDDATAFORMAT) + header->ByteCount)
+                    {
+                        // Our copy of the write position says there's nothing more. Only now
+                        // look at the writer's register, and only once per pass. The event
+                        // was reset before this, so anything written after we look will set
+                        // it again.
+                        if (writePositionRefreshed)
+                        {
+                            break;
+                        }
+
+                        writePosition = InterlockedCompareExchange((LONG*) Registers->WritePosition, 0, 0);
+                        m_MidiInCachedWritePosition = writePosition;
+                        writePositionRefreshed = TRUE;
+
+                        UpdateMaximum(m_MidiInCounters.HighWaterMark, GetMidiSharedRingReadableByteCount(readPosition, writePosition, Data->BufferSize));
+                        continue;
+                    }
+
+                    UINT32 dataSize = header->ByteCount;
+                    UINT32 totalSize = dataSize + sizeof(LOOPEDDATAFORMAT);
+
+                    // if a position provided is nonzero, use it, otherwise use the current QPC.
+                    // Messages which arrive together get the same timestamp.
+                    if (header->Position == 0 && m_OverwriteZeroTimestamp)
+                    {
+                        if (qpc == 0)
+                        {
+                            qpc = (LONGLONG)Shared::GetCurrentMidiTimestamp();
+                        }
+
+                        header->Position = qpc;
+                    }
+
+                    // the buffer is mapped twice, back to back, so a message which wraps
+                    // around the end of the buffer is still contiguous.
+                    m_MidiInBatch[messageCount].Position = header->Position;
+                    m_MidiInBatch[messageCount].Data = (PVOID) (((BYTE *) header) + sizeof(LOOPEDDATAFORMAT));
+                    m_MidiInBatch[messageCount].ByteCount = dataSize;
+                    messageCount++;
+                    byteCount += dataSize;
+
+                    readPosition = (readPosition + totalSize) % Data->BufferSize;
                 }
 
-                if (0 == bytesAvailable ||
-                    bytesAvailable < sizeof(LOOPEDDATAFORMAT))
+                if (0 == messageCount)
                 {
-                    // nothing to do, need at least the LOOPEDDATAFORMAT
-                    // to move forward. Driver will set the event when the
-                    // write position advances.
+                    // no complete message is available. Driver will set the event
+                    // when the write position advances, if we don't see it first.
+                    LARGE_INTEGER now{ 0 };
+                    QueryPerformanceCounter(&now);
+                    idleStart = now.QuadPart;
+
+                    polled = PollMidiIn(idleStart);
                     break;
                 }
 
-                PLOOPEDDATAFORMAT header = (PLOOPEDDATAFORMAT) (((BYTE *) Data->BufferAddress) + readPosition);
-                UINT32 dataSize = header->ByteCount;
-                UINT32 totalSize = dataSize + sizeof(LOOPEDDATAFORMAT);
-                ULONG newReadPosition = (readPosition + totalSize) % Data->BufferSize;
+                LARGE_INTEGER now{ 0 };
+                QueryPerformanceCounter(&now);
 
-                if (bytesAvailable < totalSize)
+                // the first batch after the buffer ran dry tells us how long it
+                // stayed dry. Keep a running average of that, for polling.
+                if (0 != idleStart)
                 {
-                    // if the full contents of this buffer isn't yet available,
-                    // stop processing and wait for data to come in.
-                    // Driver will set an event when the write position advances.
-                    break;
+                    m_MidiInAverageGap += ((now.QuadPart - idleStart) - m_MidiInAverageGap) / 8;
+                    idleStart = 0;
                 }
 
-                PVOID data = (PVOID) (((BYTE *) header) + sizeof(LOOPEDDATAFORMAT));
+                // The first message in the batch has waited the longest. Messages
+                // timestamped in the future were scheduled, not held up, so don't count.
+                if (m_MidiInBatch[0].Position != 0 && m_MidiInBatch[0].Position <= now.QuadPart)
+                {
+                    UpdateMaximum(m_MidiInCounters.MaximumConsumerLag, (ULONGLONG)(now.QuadPart - m_MidiInBatch[0].Position));
+                }
 
-                if (m_MidiInCallback)
+                if (m_MidiInBatchCallback)
                 {
-                    // if a position provided is nonzero, use it, otherwise use the current QPC
-                    if (header->Position == 0 && m_OverwriteZeroTimestamp)
+                    m_MidiInBatchCallback->BatchCallback(m_MidiInBatch, messageCount, m_MidiInCallbackContext);
+                }
+                else if (m_MidiInCallback)
+                {
+                    for (UINT i = 0; i < messageCount; i++)
                     {
-                        LARGE_INTEGER qpc{ 0 };
-                        QueryPerformanceCounter(&qpc);
-                        header->Position = qpc.QuadPart;
+                        m_MidiInCallback->Callback(m_MidiInBatch[i].Data, m_MidiInBatch[i].ByteCount, m_MidiInBatch[i].Position, m_MidiInCallbackContext);
                     }
-
-                    m_MidiInCallback->Callback(data, dataSize, header->Position, m_MidiInCallbackContext);
                 }
 
-                // advance to the next midi packet, we loop processing them one at a time
-                // until we have processed all that is available for this pass.
-                InterlockedExchange((LONG*) Registers->ReadPosition, newReadPosition);
+                m_MidiInCounters.MessageCount.fetch_add(messageCount, std::memory_order_relaxed);
+                m_MidiInCounters.ByteCount.fetch_add(byteCount, std::memory_order_relaxed);
+                m_MidiInCounters.BatchCount.fetch_add(1, std::memory_order_relaxed);
+
+                // release everything we just processed, then loop around to pick up
+                // anything which arrived in the meantime.
+                InterlockedExchange((LONG*) Registers->ReadPosition, readPosition);
+
+                // If the writer is waiting for room, wake it once there's a useful amount.
+                // The last batch before the buffer runs dry always frees enough, so a
+                // waiting writer is never left waiting on an empty buffer.
+                if (m_MidiIn->SpaceAvailableEvent && Registers->WriterWaiting &&
+                    GetMidiSharedRingWritableByteCount(readPosition, writePosition, Data->BufferSize) >= (Data->BufferSize / 100) * MIDI_XPROC_SPACE_AVAILABLE_WATERMARK_PERCENT &&
+                    1 == InterlockedCompareExchange((LONG*) Registers->WriterWaiting, 0, 1))
+                {
+                    m_MidiIn->SpaceAvailableEvent.SetEvent();
+                }
             } while(TRUE);
         }
         else
@@ -34,6 +34,60 @@ CMidiClientManager::Initialize(
     m_DeviceManager = DeviceManager;
     m_SessionTracker = SessionTracker;
 
+    try
+    {
+        m_DeliveryQueueSize = wil::reg::get_value<DWORD>(HKEY_LOCAL_MACHINE, MIDI_ROOT_REG_KEY, MIDI_CLIENT_DELIVERY_QUEUE_SIZE_REG_VALUE);
+    }
+    catch (...)
+    {
+        // value is not present in the registry, so keep the default
+    }
+
+    m_DeliveryQueueSize = (std::max)((UINT32)1, (std::min)(m_DeliveryQueueSize, (UINT32)MIDI_CLIENT_DELIVERY_MAXIMUM_QUEUE_SIZE));
+
+    try
+    {
+        auto policy = wil::reg::get_value<DWORD>(HKEY_LOCAL_MACHINE, MIDI_ROOT_REG_KEY, MIDI_CLIENT_DELIVERY_OVERFLOW_POLICY_REG_VALUE);
+
+        if (policy > (DWORD)MidiDeliveryOverflowPolicy_Default && policy <= (DWORD)MidiDeliveryOverflowPolicy_StopDelivery)
+        {
+            m_DefaultDeliveryOverflowPolicy = (MidiDeliveryOverflowPolicy)policy;
+        }
+    }
+    catch (...)
+    {
+        // value is not present in the registry, so keep the default
+    }
+
+    try
+    {
+        m_DevicePriorityMessageMask = wil::reg::get_value<DWORD>(HKEY_LOCAL_MACHINE, MIDI_ROOT_REG_KEY, MIDI_DEVICE_PRIORITY_MESSAGE_MASK_REG_VALUE);
+    }
+    catch (...)
+    {
+        // value is not present in the registry, so keep the default
+    }
+
+    try
+    {
+        m_DeviceSysEx7TimeoutMs = wil::reg::get_value<DWORD>(HKEY_LOCAL_MACHINE, MIDI_ROOT_REG_KEY, MIDI_DEVICE_SYSEX7_TIMEOUT_REG_VALUE);
+    }
+    catch (...)
+    {
+        // value is not present in the registry, so keep the default
+    }
+
+    // A few threads are plenty. They only run while a client is behind, and give the
+    // thread back whenever they have to wait on one.
+    m_DeliveryPool.reset(CreateThreadpool(nullptr));
+    RETURN_LAST_ERROR_IF_NULL(m_DeliveryPool);
+
+    SetThreadpoolThreadMaximum(m_DeliveryPool.get(), MIDI_CLIENT_DELIVERY_MAXIMUM_THREAD_COUNT);
+    RETURN_IF_WIN32_BOOL_FALSE(SetThreadpoolThreadMinimum(m_DeliveryPool.get(), 1));
+
+    InitializeThreadpoolEnvironment(&m_DeliveryEnvironment);
+    SetThreadpoolCallbackPool(&m_DeliveryEnvironment, m_DeliveryPool.get());
+
     return S_OK;
 }
 
@@ -58,11 +112,10 @@ CMidiClientManager::Cleanup()
     m_SessionTracker.reset();
 
     // tear down all transforms before we clean up the client/device
-    for (auto const& transform : m_TransformPipes)
+    for (auto const& routingGraph : m_RoutingGraphs)
     {
-        transform.second->Cleanup();
+        routingGraph.second->CleanupStages();
     }
-    m_TransformPipes.clear();
 
     for (auto const& client : m_ClientPipes)
     {
@@ -70,11 +123,18 @@ CMidiClientManager::Cleanup()
     }
     m_ClientPipes.clear();
 
-    for (auto const& device : m_DevicePipes)
+    for (auto const& routingGraph : m_RoutingGraphs)
+    {
+        routingGraph.second->Cleanup();
+    }
+    m_RoutingGraphs.clear();
+
+    // the client pipes have stopped their delivery work, so the threads can go
+    if (m_DeliveryPool)
     {
-        device.second->Cleanup();
+        DestroyThreadpoolEnvironment(&m_DeliveryEnvironment);
+        m_DeliveryPool.reset();
     }
-    m_DevicePipes.clear();
 
     OutputDebugString(L"" __FUNCTION__ " exit");
 
@@ -259,8 +319,14 @@ CMidiClientManager::GetMidiClient(
     // we have either a new device or an existing device, create the client pipe and connect to it.
     RETURN_IF_FAILED(Microsoft::WRL::MakeAndInitialize<CMidiClientPipe>(&clientPipe));
 
+    // a client which doesn't mind what happens when it falls behind gets the service's policy
+    if (CreationParams->DeliveryOverflowPolicy == MidiDeliveryOverflowPolicy_Default)
+    {
+        CreationParams->DeliveryOverflowPolicy = m_DefaultDeliveryOverflowPolicy;
+    }
+
     // Initialize our client
-    RETURN_IF_FAILED(clientPipe->Initialize(BindingHandle, ClientProcessHandle.get(), MidiDevice, SessionId, CreationParams, Client, &m_MmcssTaskId, OverwriteIncomingZeroTimestamps));
+    RETURN_IF_FAILED(clientPipe->Initialize(BindingHandle, ClientProcessHandle.get(), MidiDevice, SessionId, CreationParams, Client, &m_MmcssTaskId, OverwriteIncomingZeroTimestamps, &m_DeliveryEnvironment, m_DeliveryQueueSize));
 
     // Add this client to the client pipes list and set the output client handle
     Client->ClientHandle = (MidiClientHandle)clientPipe.get();
@@ -277,7 +343,7 @@ CMidiClientManager::GetMidiDevice(
     handle_t BindingHandle,
     LPCWSTR MidiDevice,
     PMIDISRV_CLIENTCREATION_PARAMS CreationParams,
-    wil::com_ptr_nothrow<CMidiPipe>& MidiDevicePipe
+    CMidiRoutingGraph** RoutingGraph
 )
 {
     TraceLoggingWrite(
@@ -288,12 +354,15 @@ CMidiClientManager::GetMidiDevice(
         TraceLoggingWideString(MidiDevice)
     );
 
-    // Get an existing device pipe if one exists, otherwise create a new pipe
-    auto device = m_DevicePipes.find(MidiDevice);
-    if (device != m_DevicePipes.end())
+    *RoutingGraph = nullptr;
+
+    // Get the routing graph for the device if it already has clients, otherwise create
+    // the device pipe and a new graph around it
+    auto existing = m_RoutingGraphs.find(MidiDevice);
+    if (existing != m_RoutingGraphs.end())
     {
-        RETURN_HR_IF(E_UNEXPECTED, device->second->Flow() != CreationParams->Flow);
-        MidiDevicePipe = device->second;
+        RETURN_HR_IF(E_UNEXPECTED, existing->second->DevicePipe()->Flow() != CreationParams->Flow);
+        *RoutingGraph = existing->second.get();
     }
     else
     {
@@ -311,17 +380,42 @@ CMidiClientManager::GetMidiDevice(
 
         deviceCreationParams.DataFormat = dataFormat;
         deviceCreationParams.Flow = CreationParams->Flow;
+        deviceCreationParams.PriorityMessageMask = m_DevicePriorityMessageMask;
+        deviceCreationParams.SysEx7TimeoutMs = m_DeviceSysEx7TimeoutMs;
 
         RETURN_IF_FAILED(Microsoft::WRL::MakeAndInitialize<CMidiDevicePipe>(&devicePipe));
         RETURN_IF_FAILED(devicePipe->Initialize(BindingHandle, MidiDevice, &deviceCreationParams, &m_MmcssTaskId));
 
-        MidiDevicePipe = devicePipe.get();
-        m_DevicePipes.emplace(MidiDevice, std::move(devicePipe));
+        wil::com_ptr_nothrow<CMidiPipe> midiDevicePipe = devicePipe.get();
+
+        auto routingGraph = std::make_unique<CMidiRoutingGraph>();
+        RETURN_IF_NULL_ALLOC(routingGraph);
+        RETURN_IF_FAILED(routingGraph->Initialize(midiDevicePipe));
+
+        *RoutingGraph = routingGraph.get();
+        m_RoutingGraphs.emplace(MidiDevice, std::move(routingGraph));
     }
 
     return S_OK;
 }
 
+_Use_decl_annotations_
+CMidiRoutingGraph*
+CMidiClientManager::FindRoutingGraph(
+    MidiClientHandle ClientHandle
+)
+{
+    for (auto const& routingGraph : m_RoutingGraphs)
+    {
+        if (routingGraph.second->HasClient(ClientHandle))
+        {
+            return routingGraph.second.get();
+        }
+    }
+
+    return nullptr;
+}
+
 // This function handles data format translation only
 _Use_decl_annotations_
 HRESULT 
@@ -330,7 +424,7 @@ CMidiClientManager::GetMidiTransform(
     MidiFlow Flow,
     MidiDataFormat DataFormatFrom,
     MidiDataFormat DataFormatTo,
-    wil::com_ptr_nothrow<CMidiPipe>& DevicePipe,
+    CMidiRoutingGraph& RoutingGraph,
     wil::com_ptr_nothrow<CMidiPipe>& ClientConnectionPipe
 )
 {
@@ -347,18 +441,16 @@ CMidiClientManager::GetMidiTransform(
     // no transform is required, this shouldn't have been called.
     RETURN_HR_IF(E_UNEXPECTED, DataFormatFrom == DataFormatTo);
 
-    // search existing transforms for this device for an output that supports
-    // the requested flow and data format.
-    auto transforms = m_TransformPipes.equal_range(DevicePipe->MidiDevice());
-    for (auto& transform = transforms.first; transform != transforms.second; ++transform)
+    wil::com_ptr_nothrow<CMidiPipe> devicePipe = RoutingGraph.DevicePipe();
+    MidiRouteStageRole role = (Flow == MidiFlowIn) ? MidiRouteStageRole_FormatIn : MidiRouteStageRole_FormatOut;
+
+    // The device only has one format, so every client needing translation in this
+    // direction needs the same one, and they share it.
+    auto existing = RoutingGraph.Stage(role);
+    if (existing)
     {
-        if (Flow == transform->second->Flow() &&
-            DataFormatFrom == transform->second->DataFormatIn() &&
-            DataFormatTo == transform->second->DataFormatOut())
-        {
-            RETURN_HR_IF(E_UNEXPECTED, transformPipe);
-            transformPipe = transform->second;
-        }
+        RETURN_HR_IF(E_UNEXPECTED, !RoutingGraph.IsStageFormat(role, DataFormatFrom, DataFormatTo));
+        transformPipe = existing.get();
     }
 
     // not found, instantiate the transform that is needed.
@@ -382,6 +474,12 @@ CMidiClientManager::GetMidiTransform(
             );
 
             creationParams.TransformGuid = __uuidof(Midi2UMP2BSTransform);
+
+            // the device pipe can't tell the clients apart after translation, so this does
+            if (Flow == MidiFlowOut)
+            {
+                creationParams.SysEx7TimeoutMs = m_DeviceSysEx7TimeoutMs;
+            }
         }
         else if (MidiDataFormat_ByteStream == DataFormatFrom &&
             MidiDataFormat_UMP == DataFormatTo)
@@ -413,21 +511,20 @@ CMidiClientManager::GetMidiTransform(
         // create the transform
         wil::com_ptr_nothrow<CMidiTransformPipe> transform;
         RETURN_IF_FAILED(Microsoft::WRL::MakeAndInitialize<CMidiTransformPipe>(&transform));
-        RETURN_IF_FAILED(transform->Initialize(BindingHandle, DevicePipe->MidiDevice().c_str(), &creationParams, &m_MmcssTaskId, (IUnknown*)&m_DeviceManager));
+        RETURN_IF_FAILED(transform->Initialize(BindingHandle, devicePipe->MidiDevice().c_str(), &creationParams, &m_MmcssTaskId, (IUnknown*)&m_DeviceManager));
         transformPipe = transform.get();
 
+        RETURN_IF_FAILED(RoutingGraph.AddStage(role, transform, DataFormatFrom, DataFormatTo));
+
         // connect the transform to the device
         if (Flow == MidiFlowIn)
         {
-            RETURN_IF_FAILED(DevicePipe->AddConnectedPipe(transformPipe));
+            RETURN_IF_FAILED(RoutingGraph.Connect(devicePipe, transformPipe));
         }
         else
         {
-            RETURN_IF_FAILED(transformPipe->AddConnectedPipe(DevicePipe));
+            RETURN_IF_FAILED(RoutingGraph.Connect(transformPipe, devicePipe));
         }
-
-        //m_TransformPipes.emplace(DevicePipe->MidiDevice(), transformPipe);
-        m_TransformPipes.emplace(DevicePipe->MidiDevice(), transform);
     }
 
     ClientConnectionPipe = transformPipe;
@@ -444,7 +541,7 @@ HRESULT
 CMidiClientManager::GetMidiScheduler(
     handle_t BindingHandle,
     MidiFlow Flow,
-    wil::com_ptr_nothrow<CMidiPipe>& DevicePipe,
+    CMidiRoutingGraph& RoutingGraph,
     wil::com_ptr_nothrow<CMidiPipe>& NextDeviceSidePipe,
     wil::com_ptr_nothrow<CMidiPipe>& ClientConnectionPipe
 )
@@ -472,16 +569,10 @@ CMidiClientManager::GetMidiScheduler(
 
     // See if we already have a scheduler attached for this device
     // if so, return that, because we only want a single scheduler per device
-    auto transforms = m_TransformPipes.equal_range(DevicePipe->MidiDevice());
-    for (auto& transform = transforms.first; transform != transforms.second; ++transform)
+    auto existing = RoutingGraph.Stage(MidiRouteStageRole_Scheduler);
+    if (existing)
     {
-        //wil::com_ptr_nothrow<CMidiTransformPipe> pipe = transform->second.get();
-
-        if (transform->second->TransformGuid() == __uuidof(Midi2SchedulerTransform))
-        {
-            transformPipe = transform->second;
-            break;
-        }
+        transformPipe = existing.get();
     }
 
     // not found, instantiate the transform that is needed.
@@ -501,10 +592,12 @@ CMidiClientManager::GetMidiScheduler(
         wil::com_ptr_nothrow<CMidiTransformPipe> transform;
         RETURN_IF_FAILED(Microsoft::WRL::MakeAndInitialize<CMidiTransformPipe>(&transform));
 
-        RETURN_IF_FAILED(transform->Initialize(BindingHandle, DevicePipe->MidiDevice().c_str(), &creationParams, &m_MmcssTaskId, (IUnknown*) & m_DeviceManager));
+        RETURN_IF_FAILED(transform->Initialize(BindingHandle, RoutingGraph.DevicePipe()->MidiDevice().c_str(), &creationParams, &m_MmcssTaskId, (IUnknown*) & m_DeviceManager));
 
         transformPipe = transform.get();
 
+        RETURN_IF_FAILED(RoutingGraph.AddStage(MidiRouteStageRole_Scheduler, transform, MidiDataFormat::MidiDataFormat_UMP, MidiDataFormat::MidiDataFormat_UMP));
+
         //// connect the transform to the device
         //if (Flow == MidiFlowIn)
         //{
@@ -512,11 +605,8 @@ CMidiClientManager::GetMidiScheduler(
         //}
         //else
         //{
-            RETURN_IF_FAILED(transformPipe->AddConnectedPipe(NextDeviceSidePipe));
+            RETURN_IF_FAILED(RoutingGraph.Connect(transformPipe, NextDeviceSidePipe));
         //}
-
-        //m_TransformPipes.emplace(DevicePipe->MidiDevice(), transformPipe);
-        m_TransformPipes.emplace(DevicePipe->MidiDevice(), transform);
     }
 
     ClientConnectionPipe = transformPipe;
@@ -529,7 +619,7 @@ HRESULT
 CMidiClientManager::GetMidiEndpointMetadataHandler(
     handle_t BindingHandle,
     MidiFlow Flow,
-    wil::com_ptr_nothrow<CMidiPipe>& DevicePipe,
+    CMidiRoutingGraph& RoutingGraph,
     wil::com_ptr_nothrow<CMidiPipe>& NextDeviceSidePipe,
     wil::com_ptr_nothrow<CMidiPipe>& ClientConnectionPipe
 )
@@ -547,16 +637,10 @@ CMidiClientManager::GetMidiEndpointMetadataHandler(
     RETURN_HR_IF(E_UNEXPECTED, Flow != MidiFlow::MidiFlowIn);
 
 
-    auto transforms = m_TransformPipes.equal_range(DevicePipe->MidiDevice());
-    for (auto& transform = transforms.first; transform != transforms.second; ++transform)
+    auto existing = RoutingGraph.Stage(MidiRouteStageRole_MetadataListener);
+    if (existing)
     {
-        //wil::com_ptr_nothrow<CMidiTransformPipe> pipe = transform->second.get();
-
-        if (transform->second->TransformGuid() == __uuidof(Midi2EndpointMetadataListenerTransform))
-        {
-            transformPipe = transform->second;
-            break;
-        }
+        transformPipe = existing.get();
     }
 
     // not found, instantiate the transform that is needed.
@@ -574,22 +658,22 @@ CMidiClientManager::GetMidiEndpointMetadataHandler(
         wil::com_ptr_nothrow<CMidiTransformPipe> transform;
         RETURN_IF_FAILED(Microsoft::WRL::MakeAndInitialize<CMidiTransformPipe>(&transform));
 
-        RETURN_IF_FAILED(transform->Initialize(BindingHandle, DevicePipe->MidiDevice().c_str(), &creationParams, &m_MmcssTaskId, (IUnknown*)m_DeviceManager.get()));
+        RETURN_IF_FAILED(transform->Initialize(BindingHandle, RoutingGraph.DevicePipe()->MidiDevice().c_str(), &creationParams, &m_MmcssTaskId, (IUnknown*)m_DeviceManager.get()));
 
         transformPipe = transform.get();
 
+        RETURN_IF_FAILED(RoutingGraph.AddStage(MidiRouteStageRole_MetadataListener, transform, MidiDataFormat::MidiDataFormat_UMP, MidiDataFormat::MidiDataFormat_UMP));
+
         // connect the transform to the device
 
         if (Flow == MidiFlowIn)
         {
-            RETURN_IF_FAILED(NextDeviceSidePipe->AddConnectedPipe(transformPipe));
+            RETURN_IF_FAILED(RoutingGraph.Connect(NextDeviceSidePipe, transformPipe));
         }
         else
         {
-            RETURN_IF_FAILED(transformPipe->AddConnectedPipe(NextDeviceSidePipe));
+            RETURN_IF_FAILED(RoutingGraph.Connect(transformPipe, NextDeviceSidePipe));
         }
-
-        m_TransformPipes.emplace(DevicePipe->MidiDevice(), transform);
     }
 
     ClientConnectionPipe = transformPipe;
@@ -603,7 +687,7 @@ HRESULT
 CMidiClientManager::GetMidiJRTimestampHandler(
     handle_t BindingHandle,
     MidiFlow Flow,
-    wil::com_ptr_nothrow<CMidiPipe>& DevicePipe,
+    CMidiRoutingGraph& RoutingGraph,
     wil::com_ptr_nothrow<CMidiPipe>& NextDeviceSidePipe,
     wil::com_ptr_nothrow<CMidiPipe>& ClientConnectionPipe
 )
@@ -617,7 +701,7 @@ CMidiClientManager::GetMidiJRTimestampHandler(
 
     UNREFERENCED_PARAMETER(BindingHandle);
     UNREFERENCED_PARAMETER(Flow);
-    UNREFERENCED_PARAMETER(DevicePipe);
+    UNREFERENCED_PARAMETER(RoutingGraph);
     UNREFERENCED_PARAMETER(NextDeviceSidePipe);
     UNREFERENCED_PARAMETER(ClientConnectionPipe);
 
@@ -720,15 +804,17 @@ CMidiClientManager::CreateMidiClient(
 
     auto cleanupOnFailure = wil::scope_exit([&]()
     {
-        // If a new device has been created and added to m_DevicePipes,
+        // If a new device has been created and added to m_RoutingGraphs,
         // removing the client will also remove the unused device
         DestroyMidiClient(BindingHandle, Client->ClientHandle);
         Client->ClientHandle = NULL;
         Client->DataFormat = MidiDataFormat_Invalid;
     });
 
-    RETURN_IF_FAILED(GetMidiDevice(BindingHandle, midiDevice.c_str(), CreationParams, devicePipe));
-    devicePipe->AddClient((MidiClientHandle)clientPipe.get());
+    CMidiRoutingGraph* routingGraph{ nullptr };
+    RETURN_IF_FAILED(GetMidiDevice(BindingHandle, midiDevice.c_str(), CreationParams, &routingGraph));
+    RETURN_IF_FAILED(routingGraph->AddClient((MidiClientHandle)clientPipe.get(), clientPipe));
+    devicePipe = routingGraph->DevicePipe();
 
     // MidiFlowIn on the client flows data from the midi device to the client,
     // so we register the clientPipe to receive the callbacks from the clientConnectionPipe.
@@ -755,7 +841,7 @@ CMidiClientManager::CreateMidiClient(
                 MidiFlowIn, 
                 devicePipe->DataFormatIn(), 
                 clientPipe->DataFormatIn(), 
-                devicePipe, 
+                *routingGraph, 
                 clientConnectionPipe)); // clientConnectionPipe is the plugin
 
             clientConnectionPipe->AddClient((MidiClientHandle)clientPipe.get());
@@ -774,7 +860,7 @@ CMidiClientManager::CreateMidiClient(
             RETURN_IF_FAILED(GetMidiEndpointMetadataHandler(
                 BindingHandle,
                 MidiFlowIn,
-                devicePipe,
+                *routingGraph,
                 newClientConnectionPipe,
                 clientConnectionPipe)); // clientConnectionPipe is the plugin
 
@@ -791,7 +877,7 @@ CMidiClientManager::CreateMidiClient(
 
         RETURN_IF_FAILED(clientPipe->SetDataFormatIn(clientConnectionPipe->DataFormatIn()));
         Client->DataFormat = clientPipe->DataFormatIn();
-        RETURN_IF_FAILED(clientConnectionPipe->AddConnectedPipe(clientPipe));
+        RETURN_IF_FAILED(routingGraph->Connect(clientConnectionPipe, clientPipe));
         clientConnectionPipe.reset();
     }
 
@@ -867,7 +953,7 @@ CMidiClientManager::CreateMidiClient(
                 MidiFlowOut, 
                 clientPipe->DataFormatOut(), 
                 newClientConnectionPipe->DataFormatOut(), 
-                devicePipe, 
+                *routingGraph, 
                 clientConnectionPipe)); // clientConnectionPipe is the plugin
 
             clientConnectionPipe->AddClient((MidiClientHandle)clientPipe.get());
@@ -886,7 +972,7 @@ CMidiClientManager::CreateMidiClient(
             RETURN_IF_FAILED(GetMidiScheduler(
                 BindingHandle, 
                 MidiFlowOut, 
-                devicePipe, 
+                *routingGraph, 
                 newClientConnectionPipe, 
                 clientConnectionPipe)); // clientConnectionPipe is the plugin
 
@@ -902,7 +988,7 @@ CMidiClientManager::CreateMidiClient(
 
         RETURN_IF_FAILED(clientPipe->SetDataFormatOut(clientConnectionPipe->DataFormatOut()));
         Client->DataFormat = clientPipe->DataFormatOut();
-        RETURN_IF_FAILED(clientPipe->AddConnectedPipe(clientConnectionPipe));
+        RETURN_IF_FAILED(routingGraph->Connect(clientPipe, clientConnectionPipe));
 
         clientConnectionPipe.reset();
         newClientConnectionPipe.reset();
@@ -912,6 +998,14 @@ CMidiClientManager::CreateMidiClient(
 
     cleanupOnFailure.release();
 
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+        TraceLoggingPointer(this, "this"),
+        TraceLoggingWideString(routingGraph->Describe().c_str(), "routing graph")
+    );
+
     return S_OK;
 }
 
@@ -941,37 +1035,39 @@ CMidiClientManager::DestroyMidiClient(
     {
         wil::com_ptr_nothrow<CMidiClientPipe> midiClientPipe = (CMidiClientPipe*)(client->second.get());
 
+        m_PerformanceManager->LogClientPipeStatistics(client->second);
+
         midiClientPipe->Cleanup();
 
         m_SessionTracker->RemoveClientEndpointConnection(midiClientPipe->SessionId(), client->second->MidiDevice().c_str());
 
-        for (auto transform = m_TransformPipes.begin(); transform != m_TransformPipes.end();)
+        // disconnects the client, and cleans up any transforms only it was using
+        auto routingGraph = FindRoutingGraph(ClientHandle);
+        if (routingGraph)
         {
-            wil::com_ptr_nothrow<CMidiPipe> midiTransformPipe = transform->second.get();
-            midiTransformPipe->RemoveClient(ClientHandle);
-            if (!midiTransformPipe->InUse())
-            {
-                midiTransformPipe->Cleanup();
-                transform = m_TransformPipes.erase(transform);
-            }
-            else
-            {
-                transform++;
-            }
+            LOG_IF_FAILED(routingGraph->RemoveClient(ClientHandle));
+
+            TraceLoggingWrite(
+                MidiSrvTelemetryProvider::Provider(),
+                __FUNCTION__,
+                TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+                TraceLoggingPointer(this, "this"),
+                TraceLoggingWideString(routingGraph->Describe().c_str(), "routing graph")
+            );
         }
 
-        for (auto device = m_DevicePipes.begin(); device != m_DevicePipes.end();)
+        // and any device which no longer has clients, including one which was created for
+        // a client that then failed to connect
+        for (auto graph = m_RoutingGraphs.begin(); graph != m_RoutingGraphs.end();)
         {
-            wil::com_ptr_nothrow<CMidiPipe> midiDevicePipe = device->second.get();
-            midiDevicePipe->RemoveClient(ClientHandle);
-            if (!midiDevicePipe->InUse())
+            if (!graph->second->InUse())
             {
-                midiDevicePipe->Cleanup();
-                device = m_DevicePipes.erase(device);
+                LOG_IF_FAILED(graph->second->Cleanup());
+                graph = m_RoutingGraphs.erase(graph);
             }
             else
             {
-                device++;
+                graph++;
             }
         }
 
@@ -985,4 +1081,112 @@ CMidiClientManager::DestroyMidiClient(
     return S_OK;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidiClientManager::CancelScheduledMessages(
+    handle_t /* BindingHandle */,
+    MidiClientHandle ClientHandle,
+    PMIDI_SCHEDULED_MESSAGE_FILTER Filter,
+    UINT32* RemovedCount
+)
+{
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingPointer(this, "this")
+    );
+
+    RETURN_HR_IF_NULL(E_INVALIDARG, Filter);
+    RETURN_HR_IF_NULL(E_POINTER, RemovedCount);
+
+    *RemovedCount = 0;
+
+    auto lock = m_ClientManagerLock.lock();
+
+    auto client = m_ClientPipes.find(ClientHandle);
+    RETURN_HR_IF(E_INVALIDARG, client == m_ClientPipes.end());
+
+    // There's one scheduler per device, shared by all of its clients. It knows
+    // which client sent each message, so only this client's messages are cancelled.
+    auto routingGraph = FindRoutingGraph(ClientHandle);
+    if (routingGraph)
+    {
+        auto scheduler = routingGraph->Stage(MidiRouteStageRole_Scheduler);
+        if (scheduler)
+        {
+            RETURN_IF_FAILED(scheduler->CancelScheduledMessages(ClientHandle, Filter, RemovedCount));
+        }
+    }
+
+    // no scheduler for the device means nothing could have been scheduled
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiClientManager::SetSubscriptionFilter(
+    handle_t /* BindingHandle */,
+    MidiClientHandle ClientHandle,
+    PMIDI_SUBSCRIPTION_FILTER Filter
+)
+{
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingPointer(this, "this")
+    );
+
+    RETURN_HR_IF_NULL(E_INVALIDARG, Filter);
+
+    auto lock = m_ClientManagerLock.lock();
+
+    auto client = m_ClientPipes.find(ClientHandle);
+    RETURN_HR_IF(E_INVALIDARG, client == m_ClientPipes.end());
+
+    // The client pipe is the last stop before the client, so that's where messages
+    // are filtered. Other clients of the same device are unaffected.
+    RETURN_IF_FAILED(client->second->SetSubscriptionFilter(Filter));
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiClientManager::GetPipeStatistics(
+    handle_t /* BindingHandle */,
+    MidiClientHandle ClientHandle,
+    PMIDI_PIPE_STATISTICS ClientMidiIn,
+    PMIDI_PIPE_STATISTICS ClientMidiOut,
+    PMIDI_PIPE_STATISTICS DeviceMidiIn,
+    PMIDI_PIPE_STATISTICS DeviceMidiOut
+)
+{
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingPointer(this, "this")
+    );
+
+    auto lock = m_ClientManagerLock.lock();
+
+    auto client = m_ClientPipes.find(ClientHandle);
+    RETURN_HR_IF(E_INVALIDARG, client == m_ClientPipes.end());
+
+    wil::com_ptr_nothrow<CMidiPipe> devicePipe;
+
+    auto routingGraph = FindRoutingGraph(ClientHandle);
+    if (routingGraph)
+    {
+        devicePipe = routingGraph->DevicePipe();
+    }
+
+    RETURN_IF_FAILED(m_PerformanceManager->GetPipeStatistics(client->second, devicePipe, ClientMidiIn, ClientMidiOut, DeviceMidiIn, DeviceMidiOut));
+
+    return S_OK;
+}
+
 
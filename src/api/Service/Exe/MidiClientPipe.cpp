@@ -27,7 +27,9 @@ CMidiClientPipe::Initialize(
     PMIDISRV_CLIENTCREATION_PARAMS CreationParams,
     PMIDISRV_CLIENT Client,
     DWORD* MmcssTaskId,
-    BOOL OverwriteZeroTimestamps
+    BOOL OverwriteZeroTimestamps,
+    PTP_CALLBACK_ENVIRON DeliveryEnvironment,
+    UINT32 DeliveryQueueSize
 )
 {
     TraceLoggingWrite(
@@ -36,7 +38,9 @@ CMidiClientPipe::Initialize(
         TraceLoggingLevel(WINEVENT_LEVEL_INFO),
         TraceLoggingPointer(this, "this"),
         TraceLoggingWideString(Device),
-        TraceLoggingGuid(SessionId)
+        TraceLoggingGuid(SessionId),
+        TraceLoggingUInt32((UINT32)CreationParams->DeliveryOverflowPolicy, "Delivery overflow policy"),
+        TraceLoggingUInt32(DeliveryQueueSize, "Delivery queue size")
     );
 
     // for tracking the client connection
@@ -70,9 +74,11 @@ CMidiClientPipe::Initialize(
         SAFE_CLOSEHANDLE(Client->MidiInDataFileMapping);
         SAFE_CLOSEHANDLE(Client->MidiInRegisterFileMapping);
         SAFE_CLOSEHANDLE(Client->MidiInWriteEvent);
+        SAFE_CLOSEHANDLE(Client->MidiInSpaceAvailableEvent);
         SAFE_CLOSEHANDLE(Client->MidiOutDataFileMapping);
         SAFE_CLOSEHANDLE(Client->MidiOutRegisterFileMapping);
         SAFE_CLOSEHANDLE(Client->MidiOutWriteEvent);
+        SAFE_CLOSEHANDLE(Client->MidiOutSpaceAvailableEvent);
     });
 
     if (IsFlowSupported(MidiFlowIn))
@@ -88,12 +94,14 @@ CMidiClientPipe::Initialize(
 
         // Midi in controls, buffering, and eventing.
         RETURN_IF_FAILED(CreateMappedDataBuffer(CreationParams->BufferSize, midiInPipe->DataBuffer.get(), &midiInPipe->Data));
-        RETURN_IF_FAILED(CreateMappedRegisters(midiInPipe->RegistersBuffer.get(), &midiInPipe->Registers));
+        RETURN_IF_FAILED(CreateMappedRegisters(midiInPipe->RegistersBuffer.get(), midiInPipe->Data.BufferSize, &midiInPipe->Registers));
         midiInPipe->WriteEvent.create(wil::EventOptions::ManualReset);
+        midiInPipe->SpaceAvailableEvent.create(wil::EventOptions::ManualReset);
 
         RETURN_LAST_ERROR_IF(FALSE == DuplicateHandle(GetCurrentProcess(), midiInPipe->DataBuffer->FileMapping.get(), GetCurrentProcess(), &(Client->MidiInDataFileMapping), DUPLICATE_SAME_ACCESS, TRUE, 0));
         RETURN_LAST_ERROR_IF(FALSE == DuplicateHandle(GetCurrentProcess(), midiInPipe->RegistersBuffer->FileMapping.get(), GetCurrentProcess(), &(Client->MidiInRegisterFileMapping), DUPLICATE_SAME_ACCESS, TRUE, 0));
         RETURN_LAST_ERROR_IF(FALSE == DuplicateHandle(GetCurrentProcess(), midiInPipe->WriteEvent.get(), GetCurrentProcess(), &(Client->MidiInWriteEvent), EVENT_ALL_ACCESS, TRUE, 0));
+        RETURN_LAST_ERROR_IF(FALSE == DuplicateHandle(GetCurrentProcess(), midiInPipe->SpaceAvailableEvent.get(), GetCurrentProcess(), &(Client->MidiInSpaceAvailableEvent), EVENT_ALL_ACCESS, TRUE, 0));
         Client->MidiInBufferSize = midiInPipe->Data.BufferSize;
     }
 
@@ -110,15 +118,32 @@ CMidiClientPipe::Initialize(
 
         // Midi out controls, buffering, and eventing
         RETURN_IF_FAILED(CreateMappedDataBuffer(CreationParams->BufferSize, midiOutPipe->DataBuffer.get(), &midiOutPipe->Data));
-        RETURN_IF_FAILED(CreateMappedRegisters(midiOutPipe->RegistersBuffer.get(), &midiOutPipe->Registers));
+        RETURN_IF_FAILED(CreateMappedRegisters(midiOutPipe->RegistersBuffer.get(), midiOutPipe->Data.BufferSize, &midiOutPipe->Registers));
         midiOutPipe->WriteEvent.create(wil::EventOptions::ManualReset);
+        midiOutPipe->SpaceAvailableEvent.create(wil::EventOptions::ManualReset);
 
         RETURN_LAST_ERROR_IF(FALSE == DuplicateHandle(GetCurrentProcess(), midiOutPipe->DataBuffer->FileMapping.get(), GetCurrentProcess(), &(Client->MidiOutDataFileMapping), DUPLICATE_SAME_ACCESS, FALSE, 0));
         RETURN_LAST_ERROR_IF(FALSE == DuplicateHandle(GetCurrentProcess(), midiOutPipe->RegistersBuffer->FileMapping.get(), GetCurrentProcess(), &(Client->MidiOutRegisterFileMapping), DUPLICATE_SAME_ACCESS, FALSE, 0));
         RETURN_LAST_ERROR_IF(FALSE == DuplicateHandle(GetCurrentProcess(), midiOutPipe->WriteEvent.get(), GetCurrentProcess(), &(Client->MidiOutWriteEvent), EVENT_ALL_ACCESS, TRUE, 0));
+        RETURN_LAST_ERROR_IF(FALSE == DuplicateHandle(GetCurrentProcess(), midiOutPipe->SpaceAvailableEvent.get(), GetCurrentProcess(), &(Client->MidiOutSpaceAvailableEvent), EVENT_ALL_ACCESS, TRUE, 0));
         Client->MidiOutBufferSize = midiOutPipe->Data.BufferSize;
     }
 
+    if (IsFlowSupported(MidiFlowIn))
+    {
+        // for messages which arrive while the client is behind. The client manager has
+        // already swapped a default policy for the service's configured one.
+        RETURN_IF_FAILED(m_DeliveryQueue.Initialize(DeliveryQueueSize, CreationParams->DeliveryOverflowPolicy));
+
+        m_DeliveryWork.reset(CreateThreadpoolWork(DeliveryWorker, this, DeliveryEnvironment));
+        RETURN_LAST_ERROR_IF_NULL(m_DeliveryWork);
+
+        m_DeliveryWait.reset(CreateThreadpoolWait(DeliveryWaitCallback, this, DeliveryEnvironment));
+        RETURN_LAST_ERROR_IF_NULL(m_DeliveryWait);
+    }
+
+    m_OverwriteZeroTimestamps = OverwriteZeroTimestamps;
+
     m_MidiPump.reset(new (std::nothrow) CMidiXProc());
     RETURN_IF_NULL_ALLOC(m_MidiPump);
 
@@ -129,7 +154,9 @@ CMidiClientPipe::Initialize(
     // Thus, the pump is initialized with midiOutPipe for input and midiInPipe for output,
     // which appears backwards if you inspect the function prototype, but is correct for the connection
     // from the client to the server.
-    RETURN_IF_FAILED(m_MidiPump->Initialize(MmcssTaskId, midiOutPipe, midiInPipe, thisCallback.get(), 0, OverwriteZeroTimestamps));
+    // The callback context is our client handle, so the pipes we send to can tell which
+    // client each message came from.
+    RETURN_IF_FAILED(m_MidiPump->Initialize(MmcssTaskId, midiOutPipe, midiInPipe, thisCallback.get(), (LONGLONG)this, OverwriteZeroTimestamps));
 
     cleanupOnFailure.release();
 
@@ -146,6 +173,26 @@ CMidiClientPipe::Cleanup()
         TraceLoggingPointer(this, "this")
     );
 
+    // Stop the delivery work before the pump goes away. It doesn't take the client pipe
+    // lock, and never waits for the client to make room, so this is quick. Once
+    // m_DeliveryStopped is set, neither the work nor the wait is submitted again.
+    {
+        auto deliveryLock = m_DeliveryLock.lock();
+        m_DeliveryStopped = true;
+        m_DeliveryQueue.Clear();
+    }
+
+    if (m_DeliveryWait)
+    {
+        // a client which has gone away won't be making room
+        SetThreadpoolWait(m_DeliveryWait.get(), NULL, NULL);
+        WaitForThreadpoolWaitCallbacks(m_DeliveryWait.get(), TRUE);
+    }
+
+    if (m_DeliveryWork)
+    {
+        WaitForThreadpoolWorkCallbacks(m_DeliveryWork.get(), TRUE);
+    }
 
     auto lock = m_ClientPipeLock.lock();
     if (m_MidiPump)
@@ -170,11 +217,30 @@ CMidiClientPipe::SendMidiMessage(
     auto lock = m_ClientPipeLock.lock();
     if (m_MidiPump)
     {
-        return m_MidiPump->SendMidiMessage(Data, Length, Position);
+        if (DataFormatIn() == MidiDataFormat_UMP)
+        {
+            return DeliverUmpBatch(Data, Length, Position);
+        }
+
+        return DeliverMidiMessage(Data, Length, Position);
     }
     return E_ABORT;
 }
 
+// The stage upstream pipes deliver through. Only client pipes are ever given this.
+_Use_decl_annotations_
+HRESULT
+CMidiClientPipe::DeliverToClient(
+    CMidiPipe* Pipe,
+    PVOID Data,
+    UINT Length,
+    LONGLONG Position,
+    MidiClientHandle /* Source */
+)
+{
+    return static_cast<CMidiClientPipe*>(Pipe)->CMidiClientPipe::SendMidiMessage(Data, Length, Position);
+}
+
 _Use_decl_annotations_
 HRESULT
 CMidiClientPipe::SendMidiMessageNow(
@@ -187,8 +253,341 @@ CMidiClientPipe::SendMidiMessageNow(
     if (m_MidiPump)
     {
         // TODO: add a SendMidiMessageNow routine to the abstraction layers.
-        return m_MidiPump->SendMidiMessage(Data, Length, Position);
+        if (DataFormatIn() == MidiDataFormat_UMP)
+        {
+            return DeliverUmpBatch(Data, Length, Position);
+        }
+
+        return DeliverMidiMessage(Data, Length, Position);
     }
     return E_ABORT;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidiClientPipe::GetStatistics(
+    PMIDI_PIPE_STATISTICS MidiIn,
+    PMIDI_PIPE_STATISTICS MidiOut
+)
+{
+    RETURN_HR_IF_NULL(E_POINTER, MidiIn);
+    RETURN_HR_IF_NULL(E_POINTER, MidiOut);
+
+    auto lock = m_ClientPipeLock.lock();
+    if (m_MidiPump)
+    {
+        // the pump reads what the client sends, and writes what the client receives,
+        // so its directions are the other way around to the client's.
+        RETURN_IF_FAILED(m_MidiPump->GetStatistics(*MidiOut, *MidiIn));
+
+        // and anything which had to wait to be written is on its way to the client
+        auto deliveryLock = m_DeliveryLock.lock();
+
+        MidiIn->QueuedCount = m_DeliveryQueue.QueuedCount();
+        MidiIn->DroppedOldestCount = m_DeliveryQueue.DroppedOldestCount();
+        MidiIn->DroppedNewestCount = m_DeliveryQueue.DroppedNewestCount();
+        MidiIn->DeliveryStoppedCount = m_DeliveryQueue.DeliveryStoppedCount();
+
+        MidiIn->FilteredCount = m_FilteredCount;
+
+        return S_OK;
+    }
+    return E_ABORT;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiClientPipe::SetSubscriptionFilter(
+    PMIDI_SUBSCRIPTION_FILTER Filter
+)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, Filter);
+
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingPointer(this, "this"),
+        TraceLoggingHexUInt16(Filter->GroupMask, "Group mask"),
+        TraceLoggingHexUInt16(Filter->ChannelMask, "Channel mask"),
+        TraceLoggingHexUInt16(Filter->MessageTypeMask, "Message type mask"),
+        TraceLoggingBool(Filter->IncludeStreamMessages, "Include stream messages")
+    );
+
+    bool selectsAll = MidiSubscriptionFilterSelectsAll(*Filter);
+
+    // we only know where one message ends and the next begins for UMP
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_UNSUPPORTED_TYPE), !selectsAll && DataFormatIn() != MidiDataFormat_UMP);
+
+    auto lock = m_ClientPipeLock.lock();
+
+    m_SubscriptionFilter = *Filter;
+    m_SubscriptionFiltered = !selectsAll;
+
+    return S_OK;
+}
+
+// Sends on the UMPs in a UMP batch which the client's subscription filter selects, and
+// drops the rest before they get anywhere near the client. The client takes one UMP per
+// message, so the batch is split up here, and goes to the client's buffer in one write.
+// Called with m_ClientPipeLock held.
+_Use_decl_annotations_
+HRESULT
+CMidiClientPipe::DeliverUmpBatch(
+    PVOID Data,
+    UINT Length,
+    LONGLONG Position
+)
+{
+    MIDIMESSAGEBATCHENTRY messages[MIDI_UMP_BATCH_MAXIMUM_SIZE / sizeof(UINT32)];
+    UINT32 messageCount{ 0 };
+
+    auto walked = internal::ForEachUmpInBatch(Data, Length, [&](const uint8_t* message, uint32_t messageLength)
+        {
+            if (messageCount == _countof(messages))
+            {
+                return false;
+            }
+
+            UINT32 firstWord{ 0 };
+            CopyMemory(&firstWord, message, sizeof(firstWord));
+
+            if (m_SubscriptionFiltered && !MidiSubscriptionFilterMatches(m_SubscriptionFilter, firstWord))
+            {
+                m_FilteredCount++;
+                return true;
+            }
+
+            messages[messageCount].Position = Position;
+            messages[messageCount].Data = (PVOID)message;
+            messages[messageCount].ByteCount = messageLength;
+            messageCount++;
+
+            return true;
+        });
+
+    if (messageCount > 0)
+    {
+        RETURN_IF_FAILED(DeliverMidiMessages(messages, messageCount));
+    }
+
+    // not a whole UMP, or more than a batch holds. Let the client decide what to do with it
+    if (walked < Length)
+    {
+        return DeliverMidiMessage((BYTE*)Data + walked, Length - walked, Position);
+    }
+
+    return S_OK;
+}
+
+// Sends a message on to the client. Called with m_ClientPipeLock held, which keeps
+// the senders in order.
+//
+// This never waits for the client. A message goes straight into the client's buffer
+// if there's room and nothing is queued ahead of it. Otherwise it's queued, and the
+// delivery work sends it once the client makes room, so a client which isn't reading
+// doesn't hold up the device, or the device's other clients. If the queue fills up
+// too, the client's overflow policy decides what gives.
+_Use_decl_annotations_
+HRESULT
+CMidiClientPipe::DeliverMidiMessage(
+    PVOID Data,
+    UINT Length,
+    LONGLONG Position
+)
+{
+    MIDIMESSAGEBATCHENTRY message{ Position, Data, Length };
+
+    return DeliverMidiMessages(&message, 1);
+}
+
+// As DeliverMidiMessage, for messages which go to the client together. Whatever fits
+// in the client's buffer is written, and published, in one go. Whatever doesn't is
+// queued behind it.
+_Use_decl_annotations_
+HRESULT
+CMidiClientPipe::DeliverMidiMessages(
+    PMIDIMESSAGEBATCHENTRY Messages,
+    UINT32 MessageCount
+)
+{
+    auto deliveryLock = m_DeliveryLock.lock();
+
+    RETURN_HR_IF(E_ABORT, m_DeliveryStopped);
+
+    UINT32 sentCount{ 0 };
+
+    if (!m_Delivering)
+    {
+        HRESULT hr = m_MidiPump->SendMidiMessages(Messages, MessageCount, 0, sentCount);
+
+        if (hr != HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER) || !m_DeliveryWork)
+        {
+            return hr;
+        }
+    }
+
+    // The pump only fills in a zero timestamp when it writes the message, which could be
+    // a while yet, so do it now.
+    LONGLONG now{ 0 };
+
+    for (UINT32 i = sentCount; i < MessageCount; i++)
+    {
+        LONGLONG position = Messages[i].Position;
+
+        if (position == 0 && m_OverwriteZeroTimestamps)
+        {
+            if (now == 0)
+            {
+                now = (LONGLONG)shared::GetCurrentMidiTimestamp();
+            }
+
+            position = now;
+        }
+
+        MidiDeliveryQueueResult result{ MidiDeliveryQueueResult::Queued };
+        RETURN_IF_FAILED(m_DeliveryQueue.Push(Messages[i].Data, Messages[i].ByteCount, position, result));
+
+        if (result == MidiDeliveryQueueResult::Overflowed)
+        {
+            StopDelivery();
+            return E_ABORT;
+        }
+    }
+
+    if (!m_Delivering)
+    {
+        m_Delivering = true;
+        SubmitThreadpoolWork(m_DeliveryWork.get());
+    }
+
+    return S_OK;
+}
+
+// The client has fallen too far behind, and asked not to be sent a stream with gaps
+// in it. Stop sending it anything. The client finds out from DeliveryStoppedCount in
+// its statistics. Called with m_DeliveryLock held.
+void
+CMidiClientPipe::StopDelivery()
+{
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_WARNING),
+        TraceLoggingPointer(this, "this"),
+        TraceLoggingGuid(m_sessionId, "Session id"),
+        TraceLoggingWideString(MidiDevice().c_str(), "Device"),
+        TraceLoggingUInt32(m_DeliveryQueue.Capacity(), "Delivery queue size")
+    );
+
+    m_DeliveryStopped = true;
+    m_DeliveryQueue.Clear();
+}
+
+_Use_decl_annotations_
+void
+CALLBACK
+CMidiClientPipe::DeliveryWorker(
+    PTP_CALLBACK_INSTANCE,
+    PVOID Context,
+    PTP_WORK
+)
+{
+    ((CMidiClientPipe*)Context)->DeliverQueuedMessages();
+}
+
+_Use_decl_annotations_
+void
+CALLBACK
+CMidiClientPipe::DeliveryWaitCallback(
+    PTP_CALLBACK_INSTANCE,
+    PVOID Context,
+    PTP_WAIT,
+    TP_WAIT_RESULT
+)
+{
+    ((CMidiClientPipe*)Context)->DeliverQueuedMessages();
+}
+
+// Runs on the client manager's delivery threadpool, while m_Delivering is set. Sends
+// queued messages to the client in batches until the queue is empty. When the client's
+// buffer is full, this registers a threadpool wait on the client's space available
+// event and gives its thread back, carrying on when the event is set. No thread is
+// held while a client isn't reading, so a handful of threads can look after any
+// number of clients, stalled ones included.
+void
+CMidiClientPipe::DeliverQueuedMessages()
+{
+    MIDIMESSAGEBATCHENTRY messages[MIDI_XPROC_MAXIMUM_BATCH_MESSAGE_COUNT]{};
+
+    for (;;)
+    {
+        UINT32 messageCount{ 0 };
+
+        {
+            auto deliveryLock = m_DeliveryLock.lock();
+
+            if (m_DeliveryStopped)
+            {
+                m_DeliveryPendingCount = 0;
+                m_DeliveryPendingSent = 0;
+                m_Delivering = false;
+                return;
+            }
+
+            if (m_DeliveryPendingSent == m_DeliveryPendingCount)
+            {
+                m_DeliveryPendingCount = m_DeliveryQueue.PopFront(m_DeliveryPending, _countof(m_DeliveryPending));
+                m_DeliveryPendingSent = 0;
+
+                if (m_DeliveryPendingCount == 0)
+                {
+                    // all caught up. New messages can go straight to the client again
+                    m_Delivering = false;
+                    return;
+                }
+            }
+
+            for (UINT32 i = m_DeliveryPendingSent; i < m_DeliveryPendingCount; i++)
+            {
+                messages[messageCount].Position = m_DeliveryPending[i].Position;
+                messages[messageCount].Data = m_DeliveryPending[i].Data;
+                messages[messageCount].ByteCount = m_DeliveryPending[i].ByteCount;
+                messageCount++;
+            }
+        }
+
+        // m_DeliveryPending is only touched by this work item, so it's safe to send
+        // from without the lock, and senders can keep queueing while we wait.
+        UINT32 sentCount{ 0 };
+        HANDLE spaceAvailableEvent{ NULL };
+        HRESULT hr = m_MidiPump->SendMidiMessages(messages, messageCount, 0, sentCount);
+
+        if (hr == HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER))
+        {
+            // S_FALSE if the client made room in the meantime, and we go round again
+            hr = m_MidiPump->ArmMidiOutSpaceAvailable(messages[sentCount].ByteCount, spaceAvailableEvent);
+        }
+
+        auto deliveryLock = m_DeliveryLock.lock();
+
+        m_DeliveryPendingSent += sentCount;
+
+        if (spaceAvailableEvent != NULL)
+        {
+            if (!m_DeliveryStopped)
+            {
+                SetThreadpoolWait(m_DeliveryWait.get(), spaceAvailableEvent, NULL);
+                return;
+            }
+        }
+        else if (FAILED(hr))
+        {
+            // the client's end is unusable, so there's no point keeping anything for it
+            LOG_IF_FAILED(hr);
+            m_DeliveryQueue.Clear();
+            m_DeliveryPendingSent = m_DeliveryPendingCount;
+        }
+    }
+}
+
@@ -32,9 +32,10 @@ CMidiDevicePipe::Initialize(
     OutputDebugString(L"" __FUNCTION__ " Initialize.");
     OutputDebugString(Device);
 
-    ABSTRACTIONCREATIONPARAMS abstractionCreationParams;
+    ABSTRACTIONCREATIONPARAMS abstractionCreationParams{ };
 
     RETURN_IF_FAILED(CMidiPipe::Initialize(Device, CreationParams->Flow));
+    RETURN_IF_FAILED(InitializeSendingNoLock(CreationParams));
 
     abstractionCreationParams.DataFormat = CreationParams->DataFormat;
 
@@ -138,6 +139,52 @@ CMidiDevicePipe::Initialize(
     return S_OK;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidiDevicePipe::Initialize(
+    LPCWSTR Device,
+    PMIDISRV_DEVICECREATION_PARAMS CreationParams,
+    IMidiOut* MidiOutDevice
+)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, MidiOutDevice);
+    RETURN_HR_IF(E_INVALIDARG, MidiFlowOut != CreationParams->Flow);
+
+    auto deviceLock = m_DevicePipeLock.lock();
+
+    RETURN_IF_FAILED(CMidiPipe::Initialize(Device, CreationParams->Flow));
+    RETURN_IF_FAILED(InitializeSendingNoLock(CreationParams));
+
+    m_MidiOutDevice = MidiOutDevice;
+
+    RETURN_IF_FAILED(SetDataFormatOut(CreationParams->DataFormat));
+
+    return S_OK;
+}
+
+// What goes between the pipe and the device on the way out, whichever device that is.
+// Caller must hold m_DevicePipeLock
+_Use_decl_annotations_
+HRESULT
+CMidiDevicePipe::InitializeSendingNoLock(
+    PMIDISRV_DEVICECREATION_PARAMS CreationParams
+)
+{
+    m_PriorityLane.Initialize(CreationParams->PriorityMessageMask);
+
+    if (CreationParams->SysEx7TimeoutMs != 0)
+    {
+        RETURN_IF_FAILED(m_SysEx7Arbiter.Initialize(
+            MIDI_DEVICE_SYSEX7_PARKED_QUEUE_SIZE,
+            (ULONGLONG)CreationParams->SysEx7TimeoutMs * shared::GetMidiTimestampFrequency() / 1000));
+
+        m_SysEx7Timer.reset(CreateThreadpoolTimer(SysEx7TimeoutCallback, this, nullptr));
+        RETURN_LAST_ERROR_IF_NULL(m_SysEx7Timer);
+    }
+
+    return S_OK;
+}
+
 HRESULT
 CMidiDevicePipe::Cleanup()
 {
@@ -151,6 +198,13 @@ CMidiDevicePipe::Cleanup()
 
     OutputDebugString(L"" __FUNCTION__ " Cleanup started.");
 
+    // no more timeouts. This waits for one which is running, so do it before taking the lock
+    if (m_SysEx7Timer)
+    {
+        SetThreadpoolTimer(m_SysEx7Timer.get(), nullptr, 0, 0);
+        WaitForThreadpoolTimerCallbacks(m_SysEx7Timer.get(), TRUE);
+    }
+
     {
         auto lock = m_DevicePipeLock.lock();
 
@@ -187,13 +241,56 @@ CMidiDevicePipe::SendMidiMessage(
     LONGLONG Timestamp
 )
 {
+    // we don't know who sent this, so it's treated as one more client
+    return CMidiDevicePipe::SendMidiMessageFromSource(Data, Length, Timestamp, 0);
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiDevicePipe::SendMidiMessageFromSource(
+    PVOID Data,
+    UINT Length,
+    LONGLONG Timestamp,
+    MidiClientHandle Source
+)
+{
+    // Real-time messages skip ahead of anything another thread is sending to the device,
+    // including a SysEx transfer. They still go through the scheduler, so they can be
+    // scheduled, but one which is due, or not scheduled, comes straight here. One which
+    // arrives in a batch with other messages also goes ahead of the rest of its batch.
+    bool prioritySent{ false };
+
+    if (DataFormatOut() == MidiDataFormat_UMP && m_PriorityLane.Enabled())
+    {
+        HRESULT hr{ S_OK };
+
+        internal::ForEachUmpInBatch(Data, Length, [&](const uint8_t* message, uint32_t messageSize)
+            {
+                if (m_PriorityLane.IsPriorityMessage((PVOID)message, messageSize))
+                {
+                    hr = m_PriorityLane.Send(m_DevicePipeLock, (PVOID)message, messageSize, Timestamp, [&](PVOID priorityMessage, UINT priorityMessageSize, LONGLONG position)
+                        {
+                            return SendSingleMidiMessageNoLock(priorityMessage, priorityMessageSize, position);
+                        });
+
+                    prioritySent = true;
+                }
+
+                return SUCCEEDED(hr);
+            });
+
+        RETURN_IF_FAILED(hr);
+
+        if (prioritySent && Length == sizeof(UINT32))
+        {
+            // that was the whole batch
+            return S_OK;
+        }
+    }
+
     // TODO: 
-    // Figure out how to most efficiently handle real-time messages
-    // - Should we allow them to be scheduled?
-    // - Should they bypass plugins?
     // Run message through plugins
     // - The plugins may produce additional messages, or delete the message
-    // - If device is currently in the middle of SysEx7, we will want to park messages that aren't allowed to interrupt that
     // - After plugin processing, it goes to the scheduler
 
     // TODO: What happens with outgoing JR clock/timestamp messages? They can't take a different path
@@ -210,7 +307,22 @@ CMidiDevicePipe::SendMidiMessage(
     // for jitter calculation. The DevicePipe is the single connection to the device, so
     // we can ensure order there before it goes to the transport.
 
-    return SendMidiMessageNow(Data, Length, Timestamp);
+    return SendMidiMessageNowFromSource(Data, Length, Timestamp, Source, prioritySent);
+}
+
+// The stage upstream pipes deliver through. The source is the client which sent the
+// message, straight from the client pipe or passed along by the scheduler.
+_Use_decl_annotations_
+HRESULT
+CMidiDevicePipe::DeliverToDevice(
+    CMidiPipe* Pipe,
+    PVOID Data,
+    UINT Length,
+    LONGLONG Timestamp,
+    MidiClientHandle Source
+)
+{
+    return static_cast<CMidiDevicePipe*>(Pipe)->CMidiDevicePipe::SendMidiMessageFromSource(Data, Length, Timestamp, Source);
 }
 
 _Use_decl_annotations_
@@ -220,6 +332,21 @@ CMidiDevicePipe::SendMidiMessageNow(
     UINT Length,
     LONGLONG Timestamp
 )
+{
+    return SendMidiMessageNowFromSource(Data, Length, Timestamp, 0, false);
+}
+
+// SkipPriorityMessages is for a batch whose priority messages were already sent through
+// the priority lane.
+_Use_decl_annotations_
+HRESULT
+CMidiDevicePipe::SendMidiMessageNowFromSource(
+    PVOID Data,
+    UINT Length,
+    LONGLONG Timestamp,
+    MidiClientHandle Source,
+    bool SkipPriorityMessages
+)
 {
     // TODO: This function is where we'll check to see if we're in SysEx or not. If we are
     // then we need to add the message to the SysEx set-aside scheduler, or maybe just add
@@ -227,9 +354,240 @@ CMidiDevicePipe::SendMidiMessageNow(
 
 //    OutputDebugString(L"" __FUNCTION__);
 
-    // only one client may send a message to the device at a time
-    auto lock = m_DevicePipeLock.lock();
+    HRESULT hr{ S_OK };
+
+    {
+        // only one client may send a message to the device at a time
+        auto lock = m_DevicePipeLock.lock();
+
+        hr = SendMidiMessagesNoLock(Data, Length, Timestamp, Source, SkipPriorityMessages);
+    }
+
+    // priority messages which turned up after we last looked
+    m_PriorityLane.Flush(m_DevicePipeLock, [&](PVOID message, UINT messageSize, LONGLONG position)
+        {
+            return SendSingleMidiMessageNoLock(message, messageSize, position);
+        });
+
+    return hr;
+}
+
+// Caller must hold m_DevicePipeLock
+_Use_decl_annotations_
+HRESULT
+CMidiDevicePipe::SendMidiMessagesNoLock(
+    PVOID Data,
+    UINT Length,
+    LONGLONG Timestamp,
+    MidiClientHandle Source,
+    bool SkipPriorityMessages
+)
+{
+    auto sendToDevice = [&](PVOID message, UINT messageSize, LONGLONG position)
+        {
+            return SendSingleMidiMessageNoLock(message, messageSize, position);
+        };
+
+    // priority messages which were parked while someone else had the lock go first
+    m_PriorityLane.SendParked(sendToDevice);
+
+    // UMP arrives as a UMP batch, from the scheduler or a translator. The transports take
+    // a single UMP at a time, so split it up here, where we only need to take the lock
+    // once for all of them.
+    if (DataFormatOut() == MidiDataFormat_UMP)
+    {
+        HRESULT hr{ S_OK };
+
+        auto walked = internal::ForEachUmpInBatch(Data, Length, [&](const uint8_t* message, uint32_t messageSize)
+            {
+                if (SkipPriorityMessages && m_PriorityLane.IsPriorityMessage((PVOID)message, messageSize))
+                {
+                    // already went ahead
+                    return true;
+                }
+
+                hr = SendUmpNoLock((PVOID)message, messageSize, Timestamp, Source);
+
+                // so a priority message waits for one message at most, not the whole run
+                m_PriorityLane.SendParked(sendToDevice);
+
+                return SUCCEEDED(hr);
+            });
+
+        RETURN_IF_FAILED(hr);
+        RETURN_HR_IF(E_INVALIDARG, walked != Length);
+
+        return S_OK;
+    }
+
+    return SendSingleMidiMessageNoLock(Data, Length, Timestamp);
+}
+
+// One UMP, which waits here if another client is part way through a SysEx7 message on
+// its group. Caller must hold m_DevicePipeLock
+_Use_decl_annotations_
+HRESULT
+CMidiDevicePipe::SendUmpNoLock(
+    PVOID Data,
+    UINT Length,
+    LONGLONG Timestamp,
+    MidiClientHandle Source
+)
+{
+    if (!m_SysEx7Arbiter.Enabled())
+    {
+        return SendSingleMidiMessageNoLock(Data, Length, Timestamp);
+    }
+
+    MidiSysEx7ArbiterResult result{ MidiSysEx7ArbiterResult::Sent };
+
+    RETURN_IF_FAILED(m_SysEx7Arbiter.Send(Source, Data, Length, Timestamp, shared::GetCurrentMidiTimestamp(),
+        [&](PVOID message, UINT messageSize, LONGLONG position)
+        {
+            return SendSingleMidiMessageNoLock(message, messageSize, position);
+        },
+        result));
+
+    if (result == MidiSysEx7ArbiterResult::Parked)
+    {
+        ScheduleSysEx7TimeoutNoLock();
+    }
+    else if (result == MidiSysEx7ArbiterResult::Dropped)
+    {
+        TraceLoggingWrite(
+            MidiSrvTelemetryProvider::Provider(),
+            __FUNCTION__,
+            TraceLoggingLevel(WINEVENT_LEVEL_WARNING),
+            TraceLoggingPointer(this, "this"),
+            TraceLoggingWideString(L"No room to hold back a message during another client's SysEx7. Dropped", "message"),
+            TraceLoggingUInt64(Source, "Source"),
+            TraceLoggingUInt64(m_SysEx7Arbiter.DroppedCount(), "Dropped count")
+        );
+    }
+
+    return S_OK;
+}
+
+// Sets the timer for when the next waiting transfer could be abandoned, if it isn't
+// already set for then. Caller must hold m_DevicePipeLock
+void
+CMidiDevicePipe::ScheduleSysEx7TimeoutNoLock()
+{
+    ULONGLONG deadline{ 0 };
+
+    if (!m_SysEx7Arbiter.GetNextDeadline(deadline) || deadline == m_SysEx7TimerDeadline)
+    {
+        return;
+    }
+
+    m_SysEx7TimerDeadline = deadline;
+
+    ULONGLONG now = shared::GetCurrentMidiTimestamp();
+    ULONGLONG dueTicks = deadline > now ? deadline - now : 0;
+
+    // relative due time, in 100ns units
+    ULARGE_INTEGER dueTime{};
+    dueTime.QuadPart = (ULONGLONG)(-(LONGLONG)(std::max)(dueTicks * 10000000 / shared::GetMidiTimestampFrequency(), (ULONGLONG)1));
+
+    FILETIME dueFileTime{ dueTime.LowPart, dueTime.HighPart };
+
+    SetThreadpoolTimer(m_SysEx7Timer.get(), &dueFileTime, 0, 0);
+}
+
+_Use_decl_annotations_
+void
+CALLBACK
+CMidiDevicePipe::SysEx7TimeoutCallback(
+    PTP_CALLBACK_INSTANCE,
+    PVOID Context,
+    PTP_TIMER
+)
+{
+    ((CMidiDevicePipe*)Context)->ExpireSysEx7Transfers();
+}
+
+// Runs on the timer, in case nothing else is sent to the device to notice a transfer
+// has been abandoned.
+void
+CMidiDevicePipe::ExpireSysEx7Transfers()
+{
+    ULONGLONG abandonedBefore{ 0 };
+    ULONGLONG abandonedAfter{ 0 };
+
+    {
+        auto lock = m_DevicePipeLock.lock();
+
+        abandonedBefore = m_SysEx7Arbiter.AbandonedCount();
+
+        m_SysEx7TimerDeadline = 0;
+
+        m_SysEx7Arbiter.ExpireAbandoned(shared::GetCurrentMidiTimestamp(), [&](PVOID message, UINT messageSize, LONGLONG position)
+            {
+                return SendSingleMidiMessageNoLock(message, messageSize, position);
+            });
+
+        abandonedAfter = m_SysEx7Arbiter.AbandonedCount();
+
+        // the owner may have sent more since the timer was set, or someone new is waiting
+        ScheduleSysEx7TimeoutNoLock();
+    }
+
+    m_PriorityLane.Flush(m_DevicePipeLock, [&](PVOID message, UINT messageSize, LONGLONG position)
+        {
+            return SendSingleMidiMessageNoLock(message, messageSize, position);
+        });
+
+    if (abandonedAfter != abandonedBefore)
+    {
+        TraceLoggingWrite(
+            MidiSrvTelemetryProvider::Provider(),
+            __FUNCTION__,
+            TraceLoggingLevel(WINEVENT_LEVEL_WARNING),
+            TraceLoggingPointer(this, "this"),
+            TraceLoggingWideString(L"Abandoned a SysEx7 transfer which went quiet while other clients were waiting", "message"),
+            TraceLoggingUInt64(abandonedAfter - abandonedBefore, "Abandoned count")
+        );
+    }
+}
 
+// A client which goes mid SysEx7 would otherwise hold up everyone else until the timeout
+_Use_decl_annotations_
+void
+CMidiDevicePipe::RemoveClient(
+    MidiClientHandle Handle
+)
+{
+    CMidiPipe::RemoveClient(Handle);
+
+    if (!m_SysEx7Arbiter.Enabled())
+    {
+        return;
+    }
+
+    {
+        auto lock = m_DevicePipeLock.lock();
+
+        m_SysEx7Arbiter.RemoveSource(Handle, shared::GetCurrentMidiTimestamp(), [&](PVOID message, UINT messageSize, LONGLONG position)
+            {
+                return SendSingleMidiMessageNoLock(message, messageSize, position);
+            });
+    }
+
+    m_PriorityLane.Flush(m_DevicePipeLock, [&](PVOID message, UINT messageSize, LONGLONG position)
+        {
+            return SendSingleMidiMessageNoLock(message, messageSize, position);
+        });
+}
+
+// Caller must hold m_DevicePipeLock
+_Use_decl_annotations_
+HRESULT
+CMidiDevicePipe::SendSingleMidiMessageNoLock(
+    PVOID Data,
+    UINT Length,
+    LONGLONG Timestamp
+)
+{
     if (m_MidiBiDiDevice)
     {
         return m_MidiBiDiDevice->SendMidiMessage(Data, Length, Timestamp);
@@ -242,3 +600,52 @@ CMidiDevicePipe::SendMidiMessageNow(
     return E_ABORT;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidiDevicePipe::GetStatistics(
+    PMIDI_PIPE_STATISTICS MidiIn,
+    PMIDI_PIPE_STATISTICS MidiOut
+)
+{
+    RETURN_HR_IF_NULL(E_POINTER, MidiIn);
+    RETURN_HR_IF_NULL(E_POINTER, MidiOut);
+
+    *MidiIn = {};
+    *MidiOut = {};
+
+    wil::com_ptr_nothrow<IMidiPipeStatistics> statistics;
+
+    {
+        auto lock = m_DevicePipeLock.lock();
+
+        if (m_MidiBiDiDevice)
+        {
+            statistics = m_MidiBiDiDevice.try_query<IMidiPipeStatistics>();
+        }
+        else if (m_MidiInDevice)
+        {
+            statistics = m_MidiInDevice.try_query<IMidiPipeStatistics>();
+        }
+        else if (m_MidiOutDevice)
+        {
+            statistics = m_MidiOutDevice.try_query<IMidiPipeStatistics>();
+        }
+        else
+        {
+            return E_ABORT;
+        }
+    }
+
+    // in case a priority message was parked while we had the lock
+    m_PriorityLane.Flush(m_DevicePipeLock, [&](PVOID message, UINT messageSize, LONGLONG position)
+        {
+            return SendSingleMidiMessageNoLock(message, messageSize, position);
+        });
+
+    // Only abstractions which move messages through a cross process buffer have
+    // anything to report.
+    RETURN_HR_IF_NULL(E_NOTIMPL, statistics);
+
+    return statistics->GetPipeStatistics(MidiIn, MidiOut);
+}
+
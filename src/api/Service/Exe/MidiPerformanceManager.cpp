@@ -34,3 +34,81 @@ CMidiPerformanceManager::Cleanup()
     return S_OK;
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidiPerformanceManager::GetPipeStatistics(
+    wil::com_ptr_nothrow<CMidiPipe>& ClientPipe,
+    wil::com_ptr_nothrow<CMidiPipe>& DevicePipe,
+    PMIDI_PIPE_STATISTICS ClientMidiIn,
+    PMIDI_PIPE_STATISTICS ClientMidiOut,
+    PMIDI_PIPE_STATISTICS DeviceMidiIn,
+    PMIDI_PIPE_STATISTICS DeviceMidiOut
+)
+{
+    RETURN_HR_IF_NULL(E_POINTER, ClientMidiIn);
+    RETURN_HR_IF_NULL(E_POINTER, ClientMidiOut);
+    RETURN_HR_IF_NULL(E_POINTER, DeviceMidiIn);
+    RETURN_HR_IF_NULL(E_POINTER, DeviceMidiOut);
+
+    *ClientMidiIn = {};
+    *ClientMidiOut = {};
+    *DeviceMidiIn = {};
+    *DeviceMidiOut = {};
+
+    RETURN_HR_IF_NULL(E_INVALIDARG, ClientPipe);
+    RETURN_IF_FAILED(ClientPipe->GetStatistics(ClientMidiIn, ClientMidiOut));
+
+    // Not every transport goes through a cross process buffer, and a client may be
+    // connected to something other than a device, so there may be nothing more.
+    if (DevicePipe)
+    {
+        if (FAILED(DevicePipe->GetStatistics(DeviceMidiIn, DeviceMidiOut)))
+        {
+            *DeviceMidiIn = {};
+            *DeviceMidiOut = {};
+        }
+    }
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+void
+CMidiPerformanceManager::LogClientPipeStatistics(
+    wil::com_ptr_nothrow<CMidiPipe>& ClientPipe
+)
+{
+    MIDI_PIPE_STATISTICS midiIn{};
+    MIDI_PIPE_STATISTICS midiOut{};
+
+    if (!ClientPipe || FAILED(ClientPipe->GetStatistics(&midiIn, &midiOut)))
+    {
+        return;
+    }
+
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingPointer(this, "this"),
+        TraceLoggingWideString(ClientPipe->MidiDevice().c_str(), "Device"),
+        TraceLoggingUInt64(midiIn.ElapsedTicks, "Elapsed ticks"),
+        TraceLoggingUInt64(midiIn.MessageCount, "Midi in message count"),
+        TraceLoggingUInt64(midiIn.ByteCount, "Midi in byte count"),
+        TraceLoggingUInt32(midiIn.HighWaterMark, "Midi in high water mark"),
+        TraceLoggingUInt32(midiIn.BufferSize, "Midi in buffer size"),
+        TraceLoggingUInt64(midiIn.BufferFullCount, "Midi in buffer full count"),
+        TraceLoggingUInt64(midiIn.RetryCount, "Midi in retry count"),
+        TraceLoggingUInt64(midiIn.TimeoutCount, "Midi in timeout count"),
+        TraceLoggingUInt64(midiIn.QueuedCount, "Midi in queued count"),
+        TraceLoggingUInt64(midiIn.DroppedOldestCount, "Midi in dropped oldest count"),
+        TraceLoggingUInt64(midiIn.DroppedNewestCount, "Midi in dropped newest count"),
+        TraceLoggingUInt64(midiIn.DeliveryStoppedCount, "Midi in delivery stopped count"),
+        TraceLoggingUInt64(midiOut.MessageCount, "Midi out message count"),
+        TraceLoggingUInt64(midiOut.ByteCount, "Midi out byte count"),
+        TraceLoggingUInt32(midiOut.HighWaterMark, "Midi out high water mark"),
+        TraceLoggingUInt32(midiOut.BufferSize, "Midi out buffer size"),
+        TraceLoggingUInt64(midiOut.MaximumConsumerLag, "Midi out maximum consumer lag")
+    );
+}
+
@@ -0,0 +1,307 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#include "stdafx.h"
+
+static LPCWSTR RouteStageRoleName(_In_ UINT32 Role)
+{
+    switch (Role)
+    {
+    case MidiRouteStageRole_FormatIn: return L"FormatIn";
+    case MidiRouteStageRole_MetadataListener: return L"MetadataListener";
+    case MidiRouteStageRole_FormatOut: return L"FormatOut";
+    case MidiRouteStageRole_Scheduler: return L"Scheduler";
+    default: return L"Unknown";
+    }
+}
+
+static LPCWSTR DataFormatName(_In_ MidiDataFormat DataFormat)
+{
+    switch (DataFormat)
+    {
+    case MidiDataFormat_Any: return L"Any";
+    case MidiDataFormat_ByteStream: return L"ByteStream";
+    case MidiDataFormat_UMP: return L"UMP";
+    default: return L"Invalid";
+    }
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiRoutingGraph::Initialize(
+    wil::com_ptr_nothrow<CMidiPipe>& DevicePipe
+)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, DevicePipe);
+
+    m_DevicePipe = DevicePipe;
+
+    return S_OK;
+}
+
+void
+CMidiRoutingGraph::CleanupStages()
+{
+    for (auto& stage : m_Stages)
+    {
+        if (stage.Pipe)
+        {
+            Disconnect(stage.Pipe.get());
+            LOG_IF_FAILED(stage.Pipe->Cleanup());
+            stage.Pipe.reset();
+        }
+    }
+}
+
+HRESULT
+CMidiRoutingGraph::Cleanup()
+{
+    CleanupStages();
+
+    m_Connections.clear();
+    m_Clients.clear();
+
+    if (m_DevicePipe)
+    {
+        RETURN_IF_FAILED(m_DevicePipe->Cleanup());
+        m_DevicePipe.reset();
+    }
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+BOOL
+CMidiRoutingGraph::IsStageFormat(
+    MidiRouteStageRole Role,
+    MidiDataFormat DataFormatFrom,
+    MidiDataFormat DataFormatTo
+)
+{
+    return m_Stages[Role].DataFormatFrom == DataFormatFrom && m_Stages[Role].DataFormatTo == DataFormatTo;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiRoutingGraph::AddStage(
+    MidiRouteStageRole Role,
+    wil::com_ptr_nothrow<CMidiTransformPipe>& TransformPipe,
+    MidiDataFormat DataFormatFrom,
+    MidiDataFormat DataFormatTo
+)
+{
+    RETURN_HR_IF(E_INVALIDARG, Role >= MidiRouteStageRole_Count);
+    RETURN_HR_IF_NULL(E_INVALIDARG, TransformPipe);
+
+    // one of each per endpoint
+    RETURN_HR_IF(E_UNEXPECTED, m_Stages[Role].Pipe);
+
+    m_Stages[Role].Pipe = TransformPipe;
+    m_Stages[Role].DataFormatFrom = DataFormatFrom;
+    m_Stages[Role].DataFormatTo = DataFormatTo;
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiRoutingGraph::Connect(
+    wil::com_ptr_nothrow<CMidiPipe>& From,
+    wil::com_ptr_nothrow<CMidiPipe>& To
+)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, From);
+    RETURN_HR_IF_NULL(E_INVALIDARG, To);
+
+    for (auto const& connection : m_Connections)
+    {
+        if (connection.From == From && connection.To == To)
+        {
+            return S_OK;
+        }
+    }
+
+    RETURN_IF_FAILED(From->AddConnectedPipe(To));
+
+    m_Connections.push_back({ From, To });
+    m_Version++;
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiRoutingGraph::AddClient(
+    MidiClientHandle Client,
+    wil::com_ptr_nothrow<CMidiPipe>& ClientPipe
+)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, ClientPipe);
+    RETURN_HR_IF(E_UNEXPECTED, HasClient(Client));
+
+    m_DevicePipe->AddClient(Client);
+    m_Clients.push_back({ Client, ClientPipe });
+    m_Version++;
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiRoutingGraph::RemoveClient(
+    MidiClientHandle Client
+)
+{
+    auto client = std::find_if(m_Clients.begin(), m_Clients.end(), [&](MidiRouteClient const& item) { return item.Handle == Client; });
+    RETURN_HR_IF(E_INVALIDARG, client == m_Clients.end());
+
+    // stop sending to the client before anything else
+    Disconnect(client->Pipe.get());
+    m_Clients.erase(client);
+
+    // Unhook every stage which is no longer used before cleaning any of them up, so
+    // nothing is still sending to a stage by the time it goes.
+    std::vector<wil::com_ptr_nothrow<CMidiTransformPipe>> unused;
+
+    for (auto& stage : m_Stages)
+    {
+        if (stage.Pipe)
+        {
+            stage.Pipe->RemoveClient(Client);
+
+            if (!stage.Pipe->InUse())
+            {
+                Disconnect(stage.Pipe.get());
+                unused.push_back(std::move(stage.Pipe));
+                stage = MidiRouteStage{};
+            }
+        }
+    }
+
+    for (auto const& stage : unused)
+    {
+        LOG_IF_FAILED(stage->Cleanup());
+    }
+
+    m_DevicePipe->RemoveClient(Client);
+    m_Version++;
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+BOOL
+CMidiRoutingGraph::HasClient(
+    MidiClientHandle Client
+)
+{
+    return std::find_if(m_Clients.begin(), m_Clients.end(), [&](MidiRouteClient const& item) { return item.Handle == Client; }) != m_Clients.end();
+}
+
+_Use_decl_annotations_
+void
+CMidiRoutingGraph::Disconnect(
+    CMidiPipe* Pipe
+)
+{
+    for (auto connection = m_Connections.begin(); connection != m_Connections.end();)
+    {
+        if (connection->From.get() == Pipe || connection->To.get() == Pipe)
+        {
+            // a pipe which was cleaned up already doesn't have it
+            connection->From->RemoveConnectedPipe(connection->To);
+            connection = m_Connections.erase(connection);
+        }
+        else
+        {
+            connection++;
+        }
+    }
+}
+
+_Use_decl_annotations_
+std::wstring
+CMidiRoutingGraph::PipeName(
+    CMidiPipe* Pipe
+)
+{
+    if (Pipe == m_DevicePipe.get())
+    {
+        return L"Device";
+    }
+
+    for (UINT32 role = 0; role < MidiRouteStageRole_Count; role++)
+    {
+        if (Pipe == m_Stages[role].Pipe.get())
+        {
+            return RouteStageRoleName(role);
+        }
+    }
+
+    for (auto const& client : m_Clients)
+    {
+        if (Pipe == client.Pipe.get())
+        {
+            WCHAR name[32]{};
+            StringCchPrintfW(name, _countof(name), L"Client 0x%llx", (ULONGLONG)client.Handle);
+            return name;
+        }
+    }
+
+    return L"Unknown";
+}
+
+std::wstring
+CMidiRoutingGraph::Describe()
+{
+    std::wstring description;
+    WCHAR line[256]{};
+
+    if (!m_DevicePipe)
+    {
+        return L"(empty)";
+    }
+
+    StringCchPrintfW(line, _countof(line), L"%s version %u. Device in %s, out %s. ",
+        m_DevicePipe->MidiDevice().c_str(),
+        m_Version,
+        DataFormatName(m_DevicePipe->DataFormatIn()),
+        DataFormatName(m_DevicePipe->DataFormatOut()));
+    description += line;
+
+    for (UINT32 role = 0; role < MidiRouteStageRole_Count; role++)
+    {
+        if (m_Stages[role].Pipe)
+        {
+            StringCchPrintfW(line, _countof(line), L"%s %s to %s. ",
+                RouteStageRoleName(role),
+                DataFormatName(m_Stages[role].DataFormatFrom),
+                DataFormatName(m_Stages[role].DataFormatTo));
+            description += line;
+        }
+    }
+
+    for (auto const& client : m_Clients)
+    {
+        StringCchPrintfW(line, _countof(line), L"%s in %s, out %s. ",
+            PipeName(client.Pipe.get()).c_str(),
+            DataFormatName(client.Pipe->DataFormatIn()),
+            DataFormatName(client.Pipe->DataFormatOut()));
+        description += line;
+    }
+
+    for (auto const& connection : m_Connections)
+    {
+        description += PipeName(connection.From.get());
+        description += L" -> ";
+        description += PipeName(connection.To.get());
+        description += L". ";
+    }
+
+    return description;
+}
@@ -328,4 +328,165 @@ MidiSrvGetSessionList(
 
     return S_OK;
 
-}
\ No newline at end of file
+}
+
+HRESULT
+MidiSrvSetCalculatedOutputLatency(
+    /* [in] */ handle_t BindingHandle,
+    __RPC__in_string LPCWSTR EndpointDeviceInterfaceId,
+    __RPC__in ULONGLONG LatencyTicks
+)
+{
+    UNREFERENCED_PARAMETER(BindingHandle);
+
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingWideString(L"Enter"),
+        TraceLoggingWideString(EndpointDeviceInterfaceId, "Endpoint"),
+        TraceLoggingUInt64(LatencyTicks, "Latency ticks")
+    );
+
+    RETURN_HR_IF_NULL(E_INVALIDARG, EndpointDeviceInterfaceId);
+
+    // Every client of the endpoint gets its messages sent this much early, so a value no
+    // real device could have is refused rather than stored
+    RETURN_HR_IF(E_INVALIDARG, LatencyTicks > (ULONGLONG)MIDI_MAXIMUM_OUTPUT_LATENCY_MICROSECONDS * shared::GetMidiTimestampFrequency() / 1000000);
+
+    std::shared_ptr<CMidiDeviceManager> deviceManager;
+
+    auto coInit = wil::CoInitializeEx(COINIT_MULTITHREADED);
+
+    RETURN_IF_FAILED(g_MidiService->GetDeviceManager(deviceManager));
+
+    // The scheduler reads this when it is created for the endpoint, and pre-fetches
+    // outgoing messages by this amount unless the user has supplied an override.
+    DEVPROPERTY props[] =
+    {
+        {{ PKEY_MIDI_MidiOutCalculatedLatencyTicks, DEVPROP_STORE_SYSTEM, nullptr },
+            DEVPROP_TYPE_UINT64, static_cast<ULONG>(sizeof(LatencyTicks)), (PVOID)&LatencyTicks },
+    };
+
+    RETURN_IF_FAILED(deviceManager->UpdateEndpointProperties(EndpointDeviceInterfaceId, ARRAYSIZE(props), (PVOID)props));
+
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingWideString(L"Exit success")
+    );
+
+    return S_OK;
+}
+
+
+HRESULT
+MidiSrvCancelScheduledMessages(
+    /* [in] */ handle_t BindingHandle,
+    /* [in] */ __RPC__in MidiClientHandle ClientHandle,
+    /* [in] */ __RPC__in PMIDI_SCHEDULED_MESSAGE_FILTER Filter,
+    /* [out] */ __RPC__out UINT32* RemovedCount
+)
+{
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingWideString(L"Enter")
+    );
+
+    RETURN_HR_IF_NULL(E_INVALIDARG, Filter);
+    RETURN_HR_IF_NULL(E_POINTER, RemovedCount);
+
+    *RemovedCount = 0;
+
+    std::shared_ptr<CMidiClientManager> clientManager;
+
+    auto coInit = wil::CoInitializeEx(COINIT_MULTITHREADED);
+
+    RETURN_IF_FAILED(g_MidiService->GetClientManager(clientManager));
+    RETURN_IF_FAILED(clientManager->CancelScheduledMessages(BindingHandle, ClientHandle, Filter, RemovedCount));
+
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingWideString(L"Exit success"),
+        TraceLoggingUInt32(*RemovedCount, "Removed count")
+    );
+
+    return S_OK;
+}
+
+HRESULT
+MidiSrvSetSubscriptionFilter(
+    /* [in] */ handle_t BindingHandle,
+    /* [in] */ __RPC__in MidiClientHandle ClientHandle,
+    /* [in] */ __RPC__in PMIDI_SUBSCRIPTION_FILTER Filter
+)
+{
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingWideString(L"Enter")
+    );
+
+    RETURN_HR_IF_NULL(E_INVALIDARG, Filter);
+
+    std::shared_ptr<CMidiClientManager> clientManager;
+
+    auto coInit = wil::CoInitializeEx(COINIT_MULTITHREADED);
+
+    RETURN_IF_FAILED(g_MidiService->GetClientManager(clientManager));
+    RETURN_IF_FAILED(clientManager->SetSubscriptionFilter(BindingHandle, ClientHandle, Filter));
+
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingWideString(L"Exit success")
+    );
+
+    return S_OK;
+}
+
+HRESULT
+MidiSrvGetPipeStatistics(
+    /* [in] */ handle_t BindingHandle,
+    /* [in] */ __RPC__in MidiClientHandle ClientHandle,
+    /* [out] */ __RPC__out PMIDI_PIPE_STATISTICS ClientMidiIn,
+    /* [out] */ __RPC__out PMIDI_PIPE_STATISTICS ClientMidiOut,
+    /* [out] */ __RPC__out PMIDI_PIPE_STATISTICS DeviceMidiIn,
+    /* [out] */ __RPC__out PMIDI_PIPE_STATISTICS DeviceMidiOut
+)
+{
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingWideString(L"Enter")
+    );
+
+    RETURN_HR_IF_NULL(E_POINTER, ClientMidiIn);
+    RETURN_HR_IF_NULL(E_POINTER, ClientMidiOut);
+    RETURN_HR_IF_NULL(E_POINTER, DeviceMidiIn);
+    RETURN_HR_IF_NULL(E_POINTER, DeviceMidiOut);
+
+    std::shared_ptr<CMidiClientManager> clientManager;
+
+    auto coInit = wil::CoInitializeEx(COINIT_MULTITHREADED);
+
+    RETURN_IF_FAILED(g_MidiService->GetClientManager(clientManager));
+    RETURN_IF_FAILED(clientManager->GetPipeStatistics(BindingHandle, ClientHandle, ClientMidiIn, ClientMidiOut, DeviceMidiIn, DeviceMidiOut));
+
+    TraceLoggingWrite(
+        MidiSrvTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingWideString(L"Exit success")
+    );
+
+    return S_OK;
+}
@@ -28,6 +28,40 @@ CMidiTransformPipe::Initialize(
 
 
     wil::com_ptr_nothrow<IMidiTransform> midiTransform;
+
+    RETURN_IF_FAILED(CoCreateInstance(CreationParams->TransformGuid, nullptr, CLSCTX_ALL, IID_PPV_ARGS(&midiTransform)));
+    RETURN_IF_FAILED(midiTransform->Activate(__uuidof(IMidiDataTransform), (void**)&m_MidiDataTransform));
+
+    return InitializeTransform(Device, CreationParams, MmcssTaskId, MidiDeviceManager);
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiTransformPipe::Initialize(
+    LPCWSTR Device,
+    PMIDISRV_TRANSFORMCREATION_PARAMS CreationParams,
+    IMidiDataTransform* MidiDataTransform
+)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, MidiDataTransform);
+
+    DWORD mmcssTaskId{ 0 };
+
+    m_MidiDataTransform = MidiDataTransform;
+
+    return InitializeTransform(Device, CreationParams, &mmcssTaskId, nullptr);
+}
+
+// Everything after m_MidiDataTransform is set, whichever transform that is
+_Use_decl_annotations_
+HRESULT
+CMidiTransformPipe::InitializeTransform(
+    LPCWSTR Device,
+    PMIDISRV_TRANSFORMCREATION_PARAMS CreationParams,
+    DWORD* MmcssTaskId,
+    IUnknown* MidiDeviceManager
+)
+{
     TRANSFORMCREATIONPARAMS creationParams {};
 
     m_TransformGuid = CreationParams->TransformGuid;
@@ -37,8 +71,21 @@ CMidiTransformPipe::Initialize(
 
     RETURN_IF_FAILED(CMidiPipe::Initialize(Device, m_Flow));
 
-    RETURN_IF_FAILED(CoCreateInstance(m_TransformGuid, nullptr, CLSCTX_ALL, IID_PPV_ARGS(&midiTransform)));
-    RETURN_IF_FAILED(midiTransform->Activate(__uuidof(IMidiDataTransform), (void**)&m_MidiDataTransform));
+    // the scheduler wants to know which client each message came from. Other transforms don't care.
+    m_MidiDataTransform.try_query_to(&m_MidiSchedulerTransform);
+
+    if (m_Flow == MidiFlowOut &&
+        m_DataFormatIn == MidiDataFormat_UMP &&
+        m_DataFormatOut == MidiDataFormat_ByteStream &&
+        CreationParams->SysEx7TimeoutMs != 0)
+    {
+        RETURN_IF_FAILED(m_SysEx7Arbiter.Initialize(
+            MIDI_DEVICE_SYSEX7_PARKED_QUEUE_SIZE,
+            (ULONGLONG)CreationParams->SysEx7TimeoutMs * shared::GetMidiTimestampFrequency() / 1000));
+
+        m_SysEx7Timer.reset(CreateThreadpoolTimer(SysEx7TimeoutCallback, this, nullptr));
+        RETURN_LAST_ERROR_IF_NULL(m_SysEx7Timer);
+    }
 
     creationParams.DataFormatIn = m_DataFormatIn;
     creationParams.DataFormatOut = m_DataFormatOut;
@@ -62,6 +109,21 @@ CMidiTransformPipe::Cleanup()
         TraceLoggingPointer(this, "this")
     );
 
+    {
+        auto lock = m_TransformLock.lock_exclusive();
+        m_CleanedUp = true;
+    }
+
+    // Nothing can set the timer again now. This waits for a timeout which is running
+    if (m_SysEx7Timer)
+    {
+        SetThreadpoolTimer(m_SysEx7Timer.get(), nullptr, 0, 0);
+        WaitForThreadpoolTimerCallbacks(m_SysEx7Timer.get(), TRUE);
+    }
+
+    // Nothing is using the transform now, and nothing will start to. The references are
+    // kept until the pipe goes, since DeliveryStage reads m_MidiSchedulerTransform
+    // without the lock.
     if (m_MidiDataTransform)
     {
         RETURN_IF_FAILED(m_MidiDataTransform->Cleanup());
@@ -79,7 +141,10 @@ CMidiTransformPipe::SendMidiMessage(
     LONGLONG Timestamp
 )
 {
-    return m_MidiDataTransform->SendMidiMessage(Data, Length, Timestamp);
+    auto lock = m_TransformLock.lock_shared();
+    RETURN_HR_IF(E_ABORT, m_CleanedUp);
+
+    return SendToTransform(Data, Length, Timestamp, 0);
 }
 
 
@@ -91,6 +156,272 @@ CMidiTransformPipe::SendMidiMessageNow(
     LONGLONG Timestamp
 )
 {
-    return m_MidiDataTransform->SendMidiMessage(Data, Length, Timestamp);
+    auto lock = m_TransformLock.lock_shared();
+    RETURN_HR_IF(E_ABORT, m_CleanedUp);
+
+    return SendToTransform(Data, Length, Timestamp, 0);
 }
 
+_Use_decl_annotations_
+HRESULT
+CMidiTransformPipe::SendMidiMessageFromSource(
+    PVOID Data,
+    UINT Length,
+    LONGLONG Timestamp,
+    MidiClientHandle Source
+)
+{
+    auto lock = m_TransformLock.lock_shared();
+    RETURN_HR_IF(E_ABORT, m_CleanedUp);
+
+    if (m_MidiSchedulerTransform)
+    {
+        return m_MidiSchedulerTransform->SendMidiMessageFromSource(Data, Length, Timestamp, Source);
+    }
+
+    return SendToTransform(Data, Length, Timestamp, Source);
+}
+
+// Only the scheduler needs to know where each message came from, so everything else
+// skips straight to the transform. m_MidiSchedulerTransform is set in Initialize and
+// never reset, so this needs no lock.
+PFN_MIDI_PIPE_STAGE
+CMidiTransformPipe::DeliveryStage()
+{
+    if (m_MidiSchedulerTransform)
+    {
+        return &CMidiTransformPipe::DeliverToScheduler;
+    }
+
+    return &CMidiTransformPipe::DeliverToTransform;
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiTransformPipe::DeliverToTransform(
+    CMidiPipe* Pipe,
+    PVOID Data,
+    UINT Length,
+    LONGLONG Timestamp,
+    MidiClientHandle Source
+)
+{
+    auto transformPipe = static_cast<CMidiTransformPipe*>(Pipe);
+
+    auto lock = transformPipe->m_TransformLock.lock_shared();
+    RETURN_HR_IF(E_ABORT, transformPipe->m_CleanedUp);
+
+    return transformPipe->SendToTransform(Data, Length, Timestamp, Source);
+}
+
+// The source stops at the transform, since what a transform sends on isn't tied to any
+// one client. So for a translator to a byte stream device, this is where one client's
+// SysEx7 is kept from being broken up by another's, see CMidiSysEx7Arbiter. Caller must
+// hold m_TransformLock shared
+_Use_decl_annotations_
+HRESULT
+CMidiTransformPipe::SendToTransform(
+    PVOID Data,
+    UINT Length,
+    LONGLONG Timestamp,
+    MidiClientHandle Source
+)
+{
+    if (!m_SysEx7Arbiter.Enabled())
+    {
+        return m_MidiDataTransform->SendMidiMessage(Data, Length, Timestamp);
+    }
+
+    auto sendToTransform = [&](PVOID message, UINT messageSize, LONGLONG position)
+        {
+            return m_MidiDataTransform->SendMidiMessage(message, messageSize, position);
+        };
+
+    auto lock = m_SysEx7Lock.lock();
+
+    HRESULT hr{ S_OK };
+    bool parked{ false };
+    ULONGLONG droppedBefore = m_SysEx7Arbiter.DroppedCount();
+
+    // the arbiter decides one UMP at a time, so a batch is taken apart here
+    auto walked = internal::ForEachUmpInBatch(Data, Length, [&](const uint8_t* message, uint32_t messageSize)
+        {
+            MidiSysEx7ArbiterResult result{ MidiSysEx7ArbiterResult::Sent };
+
+            hr = m_SysEx7Arbiter.Send(Source, (PVOID)message, messageSize, Timestamp, shared::GetCurrentMidiTimestamp(), sendToTransform, result);
+
+            parked = parked || (result == MidiSysEx7ArbiterResult::Parked);
+
+            return SUCCEEDED(hr);
+        });
+
+    if (parked)
+    {
+        ScheduleSysEx7TimeoutNoLock();
+    }
+
+    if (m_SysEx7Arbiter.DroppedCount() != droppedBefore)
+    {
+        TraceLoggingWrite(
+            MidiSrvTelemetryProvider::Provider(),
+            __FUNCTION__,
+            TraceLoggingLevel(WINEVENT_LEVEL_WARNING),
+            TraceLoggingPointer(this, "this"),
+            TraceLoggingWideString(L"No room to hold back a message during another client's SysEx7. Dropped", "message"),
+            TraceLoggingUInt64(Source, "Source"),
+            TraceLoggingUInt64(m_SysEx7Arbiter.DroppedCount(), "Dropped count")
+        );
+    }
+
+    RETURN_IF_FAILED(hr);
+    RETURN_HR_IF(E_INVALIDARG, walked != Length);
+
+    return S_OK;
+}
+
+// Sets the timer for when the next waiting transfer could be abandoned, if it isn't
+// already set for then. Caller must hold m_SysEx7Lock
+void
+CMidiTransformPipe::ScheduleSysEx7TimeoutNoLock()
+{
+    ULONGLONG deadline{ 0 };
+
+    if (!m_SysEx7Arbiter.GetNextDeadline(deadline) || deadline == m_SysEx7TimerDeadline)
+    {
+        return;
+    }
+
+    m_SysEx7TimerDeadline = deadline;
+
+    ULONGLONG now = shared::GetCurrentMidiTimestamp();
+    ULONGLONG dueTicks = deadline > now ? deadline - now : 0;
+
+    // relative due time, in 100ns units
+    ULARGE_INTEGER dueTime{};
+    dueTime.QuadPart = (ULONGLONG)(-(LONGLONG)(std::max)(dueTicks * 10000000 / shared::GetMidiTimestampFrequency(), (ULONGLONG)1));
+
+    FILETIME dueFileTime{ dueTime.LowPart, dueTime.HighPart };
+
+    SetThreadpoolTimer(m_SysEx7Timer.get(), &dueFileTime, 0, 0);
+}
+
+_Use_decl_annotations_
+void
+CALLBACK
+CMidiTransformPipe::SysEx7TimeoutCallback(
+    PTP_CALLBACK_INSTANCE,
+    PVOID Context,
+    PTP_TIMER
+)
+{
+    ((CMidiTransformPipe*)Context)->ExpireSysEx7Transfers();
+}
+
+// Runs on the timer, in case no client sends anything else to notice a transfer has
+// been abandoned.
+void
+CMidiTransformPipe::ExpireSysEx7Transfers()
+{
+    auto transformLock = m_TransformLock.lock_shared();
+
+    if (m_CleanedUp)
+    {
+        return;
+    }
+
+    ULONGLONG abandoned{ 0 };
+
+    {
+        auto lock = m_SysEx7Lock.lock();
+
+        abandoned = m_SysEx7Arbiter.AbandonedCount();
+
+        m_SysEx7TimerDeadline = 0;
+
+        m_SysEx7Arbiter.ExpireAbandoned(shared::GetCurrentMidiTimestamp(), [&](PVOID message, UINT messageSize, LONGLONG position)
+            {
+                return m_MidiDataTransform->SendMidiMessage(message, messageSize, position);
+            });
+
+        abandoned = m_SysEx7Arbiter.AbandonedCount() - abandoned;
+
+        ScheduleSysEx7TimeoutNoLock();
+    }
+
+    if (abandoned != 0)
+    {
+        TraceLoggingWrite(
+            MidiSrvTelemetryProvider::Provider(),
+            __FUNCTION__,
+            TraceLoggingLevel(WINEVENT_LEVEL_WARNING),
+            TraceLoggingPointer(this, "this"),
+            TraceLoggingWideString(L"Abandoned a SysEx7 transfer which went quiet while other clients were waiting", "message"),
+            TraceLoggingUInt64(abandoned, "Abandoned count")
+        );
+    }
+}
+
+// A client which goes mid SysEx7 would otherwise hold up the others until the timeout
+_Use_decl_annotations_
+void
+CMidiTransformPipe::RemoveClient(
+    MidiClientHandle Handle
+)
+{
+    CMidiPipe::RemoveClient(Handle);
+
+    if (!m_SysEx7Arbiter.Enabled())
+    {
+        return;
+    }
+
+    auto transformLock = m_TransformLock.lock_shared();
+
+    if (m_CleanedUp)
+    {
+        return;
+    }
+
+    auto lock = m_SysEx7Lock.lock();
+
+    m_SysEx7Arbiter.RemoveSource(Handle, shared::GetCurrentMidiTimestamp(), [&](PVOID message, UINT messageSize, LONGLONG position)
+        {
+            return m_MidiDataTransform->SendMidiMessage(message, messageSize, position);
+        });
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiTransformPipe::DeliverToScheduler(
+    CMidiPipe* Pipe,
+    PVOID Data,
+    UINT Length,
+    LONGLONG Timestamp,
+    MidiClientHandle Source
+)
+{
+    auto transformPipe = static_cast<CMidiTransformPipe*>(Pipe);
+
+    auto lock = transformPipe->m_TransformLock.lock_shared();
+    RETURN_HR_IF(E_ABORT, transformPipe->m_CleanedUp);
+
+    return transformPipe->m_MidiSchedulerTransform->SendMidiMessageFromSource(Data, Length, Timestamp, Source);
+}
+
+_Use_decl_annotations_
+HRESULT
+CMidiTransformPipe::CancelScheduledMessages(
+    MidiClientHandle Source,
+    PMIDI_SCHEDULED_MESSAGE_FILTER Filter,
+    UINT32* RemovedCount
+)
+{
+    RETURN_HR_IF_NULL(E_POINTER, RemovedCount);
+    *RemovedCount = 0;
+
+    auto lock = m_TransformLock.lock_shared();
+    RETURN_HR_IF(E_ABORT, m_CleanedUp);
+    RETURN_HR_IF_NULL(E_NOTIMPL, m_MidiSchedulerTransform);
+
+    return m_MidiSchedulerTransform->CancelScheduledMessages(Source, Filter, RemovedCount);
+}
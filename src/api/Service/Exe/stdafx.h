@@ -45,6 +45,7 @@
 
 // Shared helpers
 #include "midi_ump.h"
+#include "ump_helpers.h"
 #include "midi_timestamp.h"
 #include "wstring_util.h"
 
@@ -103,6 +104,7 @@ namespace shared = ::Windows::Devices::Midi2::Internal::Shared;
 class CMidiEndpointProtocolManager;
 struct GUIDCompare;
 class CMidiSessionTracker;
+class CMidiPipe;
 
 #include "MidiTelemetry.h"
 #include "MidiPerformanceManager.h"
@@ -120,6 +122,7 @@ class CMidiDevicePipe;
 #include "MidiDevicePipe.h"
 #include "MidiClientPipe.h"
 #include "MidiTransformPipe.h"
+#include "MidiRoutingGraph.h"
 #include "MidiClientManager.h"
 
 #include "MidiEndpointProtocolManager.h"
@@ -0,0 +1,175 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#pragma once
+
+// Messages for one client which didn't fit in its midi in buffer, waiting to be
+// delivered once the client catches up. This is bounded, and the client's overflow
+// policy decides what happens when it fills up.
+//
+// Messages are copied in and copied out, so nothing here points into the buffers
+// of the pipe which sent them.
+//
+// This class is not thread safe. The owner is responsible for locking.
+
+typedef struct MIDI_QUEUED_MESSAGE
+{
+    LONGLONG Position;
+    UINT32 ByteCount;
+    BYTE Data[MAXIMUM_LOOPED_DATASIZE];
+} MIDI_QUEUED_MESSAGE, *PMIDI_QUEUED_MESSAGE;
+
+enum class MidiDeliveryQueueResult
+{
+    Queued,
+    QueuedDroppedOldest,    // queued, after dropping the oldest message to make room
+    DroppedNewest,          // full, so this message was dropped
+    Overflowed              // full, and the policy is to stop delivery. Nothing was queued
+};
+
+class CMidiClientDeliveryQueue
+{
+public:
+    CMidiClientDeliveryQueue() = default;
+
+    CMidiClientDeliveryQueue(CMidiClientDeliveryQueue const&) = delete;
+    CMidiClientDeliveryQueue& operator=(CMidiClientDeliveryQueue const&) = delete;
+
+    // The policy can't be MidiDeliveryOverflowPolicy_Default. The caller works out what
+    // the default is. Nothing is allocated until the first message is queued, since
+    // most clients keep up and never need this.
+    HRESULT Initialize(_In_ UINT32 Capacity, _In_ MidiDeliveryOverflowPolicy Policy)
+    {
+        RETURN_HR_IF(E_INVALIDARG, Capacity == 0);
+        RETURN_HR_IF(E_INVALIDARG, Policy != MidiDeliveryOverflowPolicy_DropOldest &&
+                                    Policy != MidiDeliveryOverflowPolicy_DropNewest &&
+                                    Policy != MidiDeliveryOverflowPolicy_StopDelivery);
+
+        m_Messages.reset();
+        m_Capacity = Capacity;
+        m_Policy = Policy;
+        m_Head = 0;
+        m_Count = 0;
+
+        return S_OK;
+    }
+
+    UINT32 Size() const noexcept { return m_Count; }
+    UINT32 Capacity() const noexcept { return m_Capacity; }
+    bool Empty() const noexcept { return m_Count == 0; }
+    MidiDeliveryOverflowPolicy Policy() const noexcept { return m_Policy; }
+
+    // Adds a copy of the message to the back of the queue, or applies the overflow policy
+    // if the queue is full. Fails if the message is too big or storage can't be allocated.
+    HRESULT Push(
+        _In_reads_bytes_(ByteCount) PVOID Data,
+        _In_ UINT32 ByteCount,
+        _In_ LONGLONG Position,
+        _Out_ MidiDeliveryQueueResult& Result
+    )
+    {
+        Result = MidiDeliveryQueueResult::DroppedNewest;
+
+        RETURN_HR_IF(E_INVALIDARG, nullptr == Data);
+        RETURN_HR_IF(E_INVALIDARG, ByteCount < MINIMUM_LOOPED_DATASIZE || ByteCount > MAXIMUM_LOOPED_DATASIZE);
+        RETURN_HR_IF(E_UNEXPECTED, m_Capacity == 0);
+
+        if (!m_Messages)
+        {
+            m_Messages.reset(new (std::nothrow) MIDI_QUEUED_MESSAGE[m_Capacity]);
+            RETURN_IF_NULL_ALLOC(m_Messages);
+        }
+
+        Result = MidiDeliveryQueueResult::Queued;
+
+        if (m_Count == m_Capacity)
+        {
+            switch (m_Policy)
+            {
+            case MidiDeliveryOverflowPolicy_DropOldest:
+                m_Head = (m_Head + 1) % m_Capacity;
+                m_Count--;
+                m_DroppedOldestCount++;
+                Result = MidiDeliveryQueueResult::QueuedDroppedOldest;
+                break;
+
+            case MidiDeliveryOverflowPolicy_DropNewest:
+                m_DroppedNewestCount++;
+                Result = MidiDeliveryQueueResult::DroppedNewest;
+                return S_OK;
+
+            default:
+                m_DeliveryStoppedCount++;
+                Result = MidiDeliveryQueueResult::Overflowed;
+                return S_OK;
+            }
+        }
+
+        auto& message = m_Messages[(m_Head + m_Count) % m_Capacity];
+
+        message.Position = Position;
+        message.ByteCount = ByteCount;
+        CopyMemory(message.Data, Data, ByteCount);
+
+        m_Count++;
+        m_QueuedCount++;
+
+        if (m_Count > m_HighWaterMark)
+        {
+            m_HighWaterMark = m_Count;
+        }
+
+        return S_OK;
+    }
+
+    // Moves up to MaximumCount messages from the front of the queue into Messages, oldest
+    // first. Returns the number moved.
+    UINT32 PopFront(
+        _Out_writes_to_(MaximumCount, return) PMIDI_QUEUED_MESSAGE Messages,
+        _In_ UINT32 MaximumCount
+    ) noexcept
+    {
+        UINT32 count = (std::min)(MaximumCount, m_Count);
+
+        for (UINT32 i = 0; i < count; i++)
+        {
+            Messages[i] = m_Messages[m_Head];
+            m_Head = (m_Head + 1) % m_Capacity;
+        }
+
+        m_Count -= count;
+
+        return count;
+    }
+
+    // drops everything waiting, without counting any of it as dropped by the policy
+    void Clear() noexcept
+    {
+        m_Head = 0;
+        m_Count = 0;
+    }
+
+    ULONGLONG QueuedCount() const noexcept { return m_QueuedCount; }
+    ULONGLONG DroppedOldestCount() const noexcept { return m_DroppedOldestCount; }
+    ULONGLONG DroppedNewestCount() const noexcept { return m_DroppedNewestCount; }
+    ULONGLONG DeliveryStoppedCount() const noexcept { return m_DeliveryStoppedCount; }
+    UINT32 HighWaterMark() const noexcept { return m_HighWaterMark; }
+
+private:
+    std::unique_ptr<MIDI_QUEUED_MESSAGE[]> m_Messages;
+    UINT32 m_Capacity{ 0 };
+    UINT32 m_Head{ 0 };
+    UINT32 m_Count{ 0 };
+    MidiDeliveryOverflowPolicy m_Policy{ MidiDeliveryOverflowPolicy_DropOldest };
+
+    ULONGLONG m_QueuedCount{ 0 };
+    ULONGLONG m_DroppedOldestCount{ 0 };
+    ULONGLONG m_DroppedNewestCount{ 0 };
+    ULONGLONG m_DeliveryStoppedCount{ 0 };
+    UINT32 m_HighWaterMark{ 0 };
+};
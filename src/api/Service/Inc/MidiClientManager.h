@@ -8,6 +8,8 @@
 
 #pragma once
 
+using unique_threadpool = wil::unique_any<PTP_POOL, decltype(&::CloseThreadpool), ::CloseThreadpool>;
+
 class CMidiClientManager
 {
 public:
@@ -29,6 +31,22 @@ public:
     HRESULT DestroyMidiClient(_In_ handle_t,
                                 _In_ MidiClientHandle);
 
+    HRESULT CancelScheduledMessages(_In_ handle_t,
+                                _In_ MidiClientHandle,
+                                _In_ PMIDI_SCHEDULED_MESSAGE_FILTER,
+                                _Out_ UINT32*);
+
+    HRESULT SetSubscriptionFilter(_In_ handle_t,
+                                _In_ MidiClientHandle,
+                                _In_ PMIDI_SUBSCRIPTION_FILTER);
+
+    HRESULT GetPipeStatistics(_In_ handle_t,
+                                _In_ MidiClientHandle,
+                                _Out_ PMIDI_PIPE_STATISTICS,
+                                _Out_ PMIDI_PIPE_STATISTICS,
+                                _Out_ PMIDI_PIPE_STATISTICS,
+                                _Out_ PMIDI_PIPE_STATISTICS);
+
     HRESULT Cleanup();
 
 private:
@@ -44,7 +62,9 @@ private:
     HRESULT GetMidiDevice(_In_ handle_t,
                                 _In_ LPCWSTR,
                                 _In_ PMIDISRV_CLIENTCREATION_PARAMS,
-                                _In_ wil::com_ptr_nothrow<CMidiPipe>&);
+                                _Out_ CMidiRoutingGraph**);
+
+    CMidiRoutingGraph* FindRoutingGraph(_In_ MidiClientHandle);
 
     // TODO: These should be made more generic and go by a configuration, rather than have
     // discrete methods for each type of transform. But right now, it's about making the
@@ -55,14 +75,14 @@ private:
                                 _In_ MidiFlow,
                                 _In_ MidiDataFormat,
                                 _In_ MidiDataFormat,
-                                _In_ wil::com_ptr_nothrow<CMidiPipe>&,
+                                _In_ CMidiRoutingGraph&,
                                 _In_ wil::com_ptr_nothrow<CMidiPipe>&);
 
     HRESULT
     CMidiClientManager::GetMidiScheduler(
                                 _In_ handle_t,
                                 _In_ MidiFlow,
-                                _In_ wil::com_ptr_nothrow<CMidiPipe>&,
+                                _In_ CMidiRoutingGraph&,
                                 _In_ wil::com_ptr_nothrow<CMidiPipe>&,
                                 _In_ wil::com_ptr_nothrow<CMidiPipe>&);
 
@@ -70,7 +90,7 @@ private:
     CMidiClientManager::GetMidiJRTimestampHandler(
                                 _In_ handle_t,
                                 _In_ MidiFlow,
-                                _In_ wil::com_ptr_nothrow<CMidiPipe>&,
+                                _In_ CMidiRoutingGraph&,
                                 _In_ wil::com_ptr_nothrow<CMidiPipe>&,
                                 _In_ wil::com_ptr_nothrow<CMidiPipe>&);
 
@@ -78,7 +98,7 @@ private:
     CMidiClientManager::GetMidiEndpointMetadataHandler(
                                 _In_ handle_t,
                                 _In_ MidiFlow,
-                                _In_ wil::com_ptr_nothrow<CMidiPipe>&,
+                                _In_ CMidiRoutingGraph&,
                                 _In_ wil::com_ptr_nothrow<CMidiPipe>&,
                                 _In_ wil::com_ptr_nothrow<CMidiPipe>&);
 
@@ -91,10 +111,25 @@ private:
     std::shared_ptr<CMidiSessionTracker> m_SessionTracker;
 
     std::map<MidiClientHandle, wil::com_ptr_nothrow<CMidiPipe>> m_ClientPipes;
-    std::map<std::wstring, wil::com_ptr_nothrow<CMidiPipe>> m_DevicePipes;
-    std::multimap<std::wstring, wil::com_ptr_nothrow<CMidiTransformPipe>> m_TransformPipes; // need this to be CMidiTransformPipe to make it reasonable to get properties
+
+    // One per endpoint with clients, keyed by device id. Each holds the endpoint's device
+    // pipe and transforms, and how they're connected to its clients.
+    std::map<std::wstring, std::unique_ptr<CMidiRoutingGraph>> m_RoutingGraphs;
 
     // mmcss task id that is shared among all midi clients
     DWORD m_MmcssTaskId {0};
+
+    // threads shared by all clients, for delivering messages to clients which have
+    // fallen behind, and the queue size and default policy each client gets
+    unique_threadpool m_DeliveryPool;
+    TP_CALLBACK_ENVIRON m_DeliveryEnvironment{};
+    UINT32 m_DeliveryQueueSize{ MIDI_CLIENT_DELIVERY_DEFAULT_QUEUE_SIZE };
+    MidiDeliveryOverflowPolicy m_DefaultDeliveryOverflowPolicy{ MIDI_CLIENT_DELIVERY_DEFAULT_OVERFLOW_POLICY };
+
+    // outgoing messages each device sends ahead of everything else
+    UINT32 m_DevicePriorityMessageMask{ MIDI_DEVICE_DEFAULT_PRIORITY_MESSAGE_MASK };
+
+    // how long a SysEx7 transfer can go quiet before other clients can have its group
+    UINT32 m_DeviceSysEx7TimeoutMs{ MIDI_DEVICE_DEFAULT_SYSEX7_TIMEOUT_MS };
 };
 
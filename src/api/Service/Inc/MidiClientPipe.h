@@ -9,6 +9,8 @@
 #pragma once
 
 #include "MidiPipe.h"
+#include "MidiClientDeliveryQueue.h"
+#include "MidiSubscriptionFilter.h"
 
 class CMidiClientPipe : public CMidiPipe
 {
@@ -20,12 +22,20 @@ public:
                             _In_ PMIDISRV_CLIENTCREATION_PARAMS,
                             _In_ PMIDISRV_CLIENT,
                             _In_ DWORD *,
-                            _In_ BOOL);
+                            _In_ BOOL,
+                            _In_opt_ PTP_CALLBACK_ENVIRON,
+                            _In_ UINT32);
     HRESULT Cleanup();
 
     HRESULT SendMidiMessage(_In_ PVOID, _In_ UINT, _In_ LONGLONG);
     HRESULT SendMidiMessageNow(_In_ PVOID, _In_ UINT, _In_ LONGLONG);
 
+    HRESULT GetStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS);
+
+    HRESULT SetSubscriptionFilter(_In_ PMIDI_SUBSCRIPTION_FILTER);
+
+    PFN_MIDI_PIPE_STAGE DeliveryStage() { return &CMidiClientPipe::DeliverToClient; }
+
     // client pipe must have the same format for both in and out, so
     // setting the format for one or the other sets for both.
     virtual HRESULT SetDataFormatIn(MidiDataFormat DataFormat)
@@ -54,9 +64,43 @@ public:
 private:
     HRESULT AdjustForBufferingRequirements(_In_ PMIDISRV_CLIENTCREATION_PARAMS CreationParams);
 
+    static HRESULT DeliverToClient(_In_ CMidiPipe*, _In_ PVOID, _In_ UINT, _In_ LONGLONG, _In_ MidiClientHandle);
+
+    HRESULT DeliverMidiMessage(_In_ PVOID, _In_ UINT, _In_ LONGLONG);
+    HRESULT DeliverMidiMessages(_In_reads_(MessageCount) PMIDIMESSAGEBATCHENTRY, _In_ UINT32 MessageCount);
+    HRESULT DeliverUmpBatch(_In_ PVOID, _In_ UINT, _In_ LONGLONG);
+    void StopDelivery();
+
+    static void CALLBACK DeliveryWorker(_Inout_ PTP_CALLBACK_INSTANCE, _Inout_opt_ PVOID, _Inout_ PTP_WORK);
+    static void CALLBACK DeliveryWaitCallback(_Inout_ PTP_CALLBACK_INSTANCE, _Inout_opt_ PVOID, _Inout_ PTP_WAIT, _In_ TP_WAIT_RESULT);
+    void DeliverQueuedMessages();
+
     wil::critical_section m_ClientPipeLock;
     MidiClientHandle m_ClientHandle{ 0 };
     std::unique_ptr<CMidiXProc> m_MidiPump;
+    BOOL m_OverwriteZeroTimestamps{ FALSE };
+
+    // which incoming messages the client wants, only checked when m_SubscriptionFiltered
+    // is set, and how many it didn't get because of it. Guarded by m_ClientPipeLock
+    MIDI_SUBSCRIPTION_FILTER m_SubscriptionFilter{};
+    bool m_SubscriptionFiltered{ false };
+    ULONGLONG m_FilteredCount{ 0 };
+
+    // Messages for the client which didn't fit in its midi in buffer, and the threadpool
+    // work which sends them on once there's room. While m_Delivering is set, the work
+    // item owns the pump's midi in side, and new messages queue up behind it so they
+    // stay in order. When the client's buffer is full, the work item hands over to
+    // m_DeliveryWait, which picks up where it left off once the client signals that it
+    // has made room. m_DeliveryPending holds the batch being sent, which carries over.
+    wil::critical_section m_DeliveryLock;
+    CMidiClientDeliveryQueue m_DeliveryQueue;
+    wil::unique_threadpool_work m_DeliveryWork;
+    wil::unique_threadpool_wait m_DeliveryWait;
+    bool m_Delivering{ false };
+    bool m_DeliveryStopped{ false };
+    MIDI_QUEUED_MESSAGE m_DeliveryPending[MIDI_XPROC_MAXIMUM_BATCH_MESSAGE_COUNT]{};
+    UINT32 m_DeliveryPendingCount{ 0 };
+    UINT32 m_DeliveryPendingSent{ 0 };
 
     GUID m_sessionId{};         // client session id for tracking
     //std::wstring m_device{};    // device id this connects to
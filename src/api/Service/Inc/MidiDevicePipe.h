@@ -9,12 +9,16 @@
 #pragma once
 
 #include "MidiPipe.h"
+#include "MidiDevicePriorityLane.h"
+#include "MidiSysEx7Arbiter.h"
 
 typedef struct MIDISRV_DEVICECREATION_PARAMS
 {
     MidiDataFormat DataFormat;
     MidiFlow Flow;
     ULONG BufferSize;
+    UINT32 PriorityMessageMask;
+    UINT32 SysEx7TimeoutMs;
 } MIDISRV_DEVICECREATION_PARAMS, *PMIDISRV_DEVICECREATION_PARAMS;
 
 class CMidiDevicePipe : public CMidiPipe
@@ -25,16 +29,53 @@ public:
                        _In_ LPCWSTR,
                        _In_ PMIDISRV_DEVICECREATION_PARAMS,
                        _In_ DWORD *);
+
+    // For running the pipe in-process against a device of the caller's own, instead of
+    // one from an abstraction. Only for MidiFlowOut.
+    HRESULT Initialize(_In_ LPCWSTR,
+                       _In_ PMIDISRV_DEVICECREATION_PARAMS,
+                       _In_ IMidiOut*);
+
     HRESULT Cleanup();
 
     // called by the client
     HRESULT SendMidiMessage(_In_ PVOID, _In_ UINT, _In_ LONGLONG);
+    HRESULT SendMidiMessageFromSource(_In_ PVOID, _In_ UINT, _In_ LONGLONG, _In_ MidiClientHandle);
 
     // called by the scheduler
     HRESULT SendMidiMessageNow(_In_ PVOID, _In_ UINT, _In_ LONGLONG);
 
+    HRESULT GetStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS);
+
+    PFN_MIDI_PIPE_STAGE DeliveryStage() { return &CMidiDevicePipe::DeliverToDevice; }
+
+    void RemoveClient(_In_ MidiClientHandle);
+
 private:
+    static HRESULT DeliverToDevice(_In_ CMidiPipe*, _In_ PVOID, _In_ UINT, _In_ LONGLONG, _In_ MidiClientHandle);
+    static void CALLBACK SysEx7TimeoutCallback(_Inout_ PTP_CALLBACK_INSTANCE, _Inout_opt_ PVOID, _Inout_ PTP_TIMER);
+
+    HRESULT InitializeSendingNoLock(_In_ PMIDISRV_DEVICECREATION_PARAMS);
+
+    HRESULT SendMidiMessageNowFromSource(_In_ PVOID, _In_ UINT, _In_ LONGLONG, _In_ MidiClientHandle, _In_ bool);
+    HRESULT SendMidiMessagesNoLock(_In_ PVOID, _In_ UINT, _In_ LONGLONG, _In_ MidiClientHandle, _In_ bool);
+    HRESULT SendUmpNoLock(_In_ PVOID, _In_ UINT, _In_ LONGLONG, _In_ MidiClientHandle);
+    HRESULT SendSingleMidiMessageNoLock(_In_ PVOID, _In_ UINT, _In_ LONGLONG);
+
+    void ExpireSysEx7Transfers();
+    void ScheduleSysEx7TimeoutNoLock();
+
+    // anything which takes m_DevicePipeLock has to flush this after, see CMidiDevicePriorityLane
     wil::critical_section m_DevicePipeLock;
+    CMidiDevicePriorityLane m_PriorityLane;
+
+    // Keeps clients' SysEx7 from being interleaved, for UMP devices. For a byte stream
+    // device, the translator's CMidiTransformPipe does this instead. Guarded by
+    // m_DevicePipeLock. The timer ends transfers which were abandoned part way through
+    // while nobody else is sending.
+    CMidiSysEx7Arbiter m_SysEx7Arbiter;
+    wil::unique_threadpool_timer m_SysEx7Timer;
+    ULONGLONG m_SysEx7TimerDeadline{ 0 };
     winrt::guid m_AbstractionGuid{};
     wil::com_ptr_nothrow<IMidiBiDi> m_MidiBiDiDevice;
     wil::com_ptr_nothrow<IMidiIn> m_MidiInDevice;
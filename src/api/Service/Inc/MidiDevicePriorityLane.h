@@ -0,0 +1,213 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#pragma once
+
+#include <atomic>
+
+// Real-time messages, like timing clock, which go out to a device ahead of whatever
+// else is being sent to it.
+//
+// Messages go to a device one at a time, under the device pipe's send lock. Without
+// this, a clock message which arrives while another thread is part way through a long
+// run of messages, like a SysEx transfer, waits for the whole run. Instead, when the
+// lock is taken, the message is parked here and the thread with the lock sends it
+// before its next message. So a priority message waits for at most one other message,
+// however much is queued ahead of it. UMP allows system messages between the packets
+// of a SysEx7 message, so this is fine mid transfer.
+//
+// Whoever holds the send lock has to call SendParked between messages, and Flush once
+// it has released the lock.
+
+typedef struct MIDI_PRIORITY_MESSAGE
+{
+    LONGLONG Position;
+    UINT32 Word;
+} MIDI_PRIORITY_MESSAGE, *PMIDI_PRIORITY_MESSAGE;
+
+class CMidiDevicePriorityLane
+{
+public:
+    CMidiDevicePriorityLane() = default;
+
+    CMidiDevicePriorityLane(CMidiDevicePriorityLane const&) = delete;
+    CMidiDevicePriorityLane& operator=(CMidiDevicePriorityLane const&) = delete;
+
+    // see MIDI_DEVICE_DEFAULT_PRIORITY_MESSAGE_MASK. 0 turns the lane off
+    void Initialize(_In_ UINT32 PriorityMessageMask) noexcept { m_PriorityMessageMask = PriorityMessageMask; }
+
+    bool Enabled() const noexcept { return m_PriorityMessageMask != 0; }
+
+    // Checks one UMP, so a batch has to be split up first. All of the utility and system
+    // messages are one word, and the status is in bits 20-23 of a utility message and
+    // bits 16-19 of a system one.
+    bool IsPriorityMessage(_In_reads_bytes_(Length) PVOID Data, _In_ UINT Length) const noexcept
+    {
+        if (Length != sizeof(UINT32) || m_PriorityMessageMask == 0)
+        {
+            return false;
+        }
+
+        UINT32 word{ 0 };
+        memcpy(&word, Data, sizeof(word));
+
+        UINT32 messageType = word >> 28;
+
+        if (messageType > 0x1)
+        {
+            return false;
+        }
+
+        UINT32 status = (word >> (20 - (messageType << 2))) & 0x0F;
+
+        return (m_PriorityMessageMask & (1u << ((messageType << 4) | status))) != 0;
+    }
+
+    // Sends a priority message now if nothing else is being sent, and otherwise parks it
+    // for the thread which is. SendToDevice(PVOID, UINT, LONGLONG) is only ever called
+    // with SendLock held. A parked message counts as sent.
+    template <typename TLock, typename TSend>
+    HRESULT Send(_In_ TLock& SendLock, _In_reads_bytes_(Length) PVOID Data, _In_ UINT Length, _In_ LONGLONG Position, _In_ TSend&& SendToDevice)
+    {
+        HRESULT hr{ S_OK };
+        bool sent{ false };
+
+        {
+            auto lock = SendLock.try_lock();
+
+            if (lock)
+            {
+                // anything parked before this goes first
+                SendParked(SendToDevice);
+
+                hr = SendToDevice(Data, Length, Position);
+                sent = true;
+            }
+        }
+
+        if (!sent)
+        {
+            UINT32 word{ 0 };
+            memcpy(&word, Data, sizeof(word));
+
+            if (Park(word, Position))
+            {
+                // the thread with the lock may have finished with it before it saw this
+                Flush(SendLock, SendToDevice);
+
+                return S_OK;
+            }
+
+            // full, so wait our turn like everything else
+            auto lock = SendLock.lock();
+
+            SendParked(SendToDevice);
+
+            hr = SendToDevice(Data, Length, Position);
+        }
+
+        Flush(SendLock, SendToDevice);
+
+        return hr;
+    }
+
+    // Sends the parked messages. Caller must hold the send lock
+    template <typename TSend>
+    void SendParked(_In_ TSend&& SendToDevice)
+    {
+        // this is called between every message sent to the device, so keep it cheap
+        if (m_ParkedCount.load() == 0)
+        {
+            return;
+        }
+
+        MIDI_PRIORITY_MESSAGE messages[MIDI_DEVICE_PRIORITY_LANE_SIZE];
+        UINT32 count{ 0 };
+
+        {
+            auto lock = m_LaneLock.lock();
+
+            for (; count < m_ParkedCount.load(); count++)
+            {
+                messages[count] = m_Parked[(m_ParkedHead + count) % MIDI_DEVICE_PRIORITY_LANE_SIZE];
+            }
+
+            m_ParkedHead = (m_ParkedHead + count) % MIDI_DEVICE_PRIORITY_LANE_SIZE;
+            m_ParkedCount -= count;
+        }
+
+        for (UINT32 i = 0; i < count; i++)
+        {
+            // nobody to tell if this fails, the sender was told it was sent
+            if (FAILED(SendToDevice(&messages[i].Word, (UINT)sizeof(messages[i].Word), messages[i].Position)))
+            {
+                m_FailedCount++;
+            }
+        }
+    }
+
+    // Call after releasing the send lock. A message parked after the last SendParked,
+    // while the lock was still held, would otherwise wait for the next send.
+    template <typename TLock, typename TSend>
+    void Flush(_In_ TLock& SendLock, _In_ TSend&& SendToDevice)
+    {
+        // pairs with the fence in Park
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        while (m_ParkedCount.load() != 0)
+        {
+            auto lock = SendLock.try_lock();
+
+            if (!lock)
+            {
+                // whoever has it now sends them, and flushes after
+                return;
+            }
+
+            SendParked(SendToDevice);
+        }
+    }
+
+    // how many messages had to wait for another thread, and how many of those then failed
+    ULONGLONG ParkedTotal() const noexcept { return m_ParkedTotal; }
+    ULONGLONG FailedCount() const noexcept { return m_FailedCount; }
+
+private:
+    bool Park(_In_ UINT32 Word, _In_ LONGLONG Position)
+    {
+        {
+            auto lock = m_LaneLock.lock();
+
+            if (m_ParkedCount.load() == MIDI_DEVICE_PRIORITY_LANE_SIZE)
+            {
+                return false;
+            }
+
+            m_Parked[(m_ParkedHead + m_ParkedCount.load()) % MIDI_DEVICE_PRIORITY_LANE_SIZE] = { Position, Word };
+            m_ParkedCount++;
+            m_ParkedTotal++;
+        }
+
+        // the count has to be visible before the caller looks at the send lock again
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        return true;
+    }
+
+    UINT32 m_PriorityMessageMask{ 0 };
+
+    // m_LaneLock guards the parked messages. m_ParkedCount is also read without it, to
+    // see if there's anything to do
+    wil::critical_section m_LaneLock;
+    MIDI_PRIORITY_MESSAGE m_Parked[MIDI_DEVICE_PRIORITY_LANE_SIZE]{};
+    UINT32 m_ParkedHead{ 0 };
+    std::atomic<UINT32> m_ParkedCount{ 0 };
+
+    ULONGLONG m_ParkedTotal{ 0 };
+    std::atomic<ULONGLONG> m_FailedCount{ 0 };
+};
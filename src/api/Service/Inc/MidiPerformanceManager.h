@@ -18,6 +18,18 @@ public:
     HRESULT Initialize();
     HRESULT Cleanup();
 
+    // Counts for a client's buffers and for its device's buffers. Any the pipes
+    // don't keep are left as zeros.
+    HRESULT GetPipeStatistics(_In_ wil::com_ptr_nothrow<CMidiPipe>&,
+                                _In_ wil::com_ptr_nothrow<CMidiPipe>&,
+                                _Out_ PMIDI_PIPE_STATISTICS,
+                                _Out_ PMIDI_PIPE_STATISTICS,
+                                _Out_ PMIDI_PIPE_STATISTICS,
+                                _Out_ PMIDI_PIPE_STATISTICS);
+
+    // Logs the final counts for a client's buffers, just before it goes away
+    void LogClientPipeStatistics(_In_ wil::com_ptr_nothrow<CMidiPipe>&);
+
 private:
 
 };
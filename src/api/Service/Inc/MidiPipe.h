@@ -10,10 +10,27 @@
 
 typedef ULONGLONG MidiPipeHandle;
 
+class CMidiPipe;
+
+// Delivers a message to one pipe. Which function that is gets worked out once, when the
+// pipe is connected, so each hop is a single call instead of a chain of virtual calls
+// through SendMidiMessageFromSource and SendMidiMessage.
+typedef HRESULT (*PFN_MIDI_PIPE_STAGE)(_In_ CMidiPipe*, _In_ PVOID, _In_ UINT, _In_ LONGLONG, _In_ MidiClientHandle);
+
+typedef struct MidiConnectedPipe
+{
+    wil::com_ptr_nothrow<CMidiPipe> Pipe;
+    PFN_MIDI_PIPE_STAGE Deliver;
+} MidiConnectedPipe;
+
+// The pipes a pipe sends to. Never changed once published, see m_ConnectedPipes
+typedef std::vector<MidiConnectedPipe> MidiConnectedPipeList;
+
 class CMidiPipe :
     public Microsoft::WRL::RuntimeClass<
         Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
-        IMidiCallback>
+        IMidiCallback,
+        IMidiBatchCallback>
 {
 public:
     virtual ~CMidiPipe()
@@ -43,7 +60,7 @@ public:
     virtual HRESULT Cleanup()
     {
         auto lock = m_Lock.lock();
-        m_ConnectedPipes.clear();
+        PublishConnectedPipes(nullptr);
         m_Clients.clear();
 
         return S_OK;
@@ -52,7 +69,18 @@ public:
     virtual HRESULT AddConnectedPipe(wil::com_ptr_nothrow<CMidiPipe>& ConnectedOutputPipe)
     {
         auto lock = m_Lock.lock();
-        m_ConnectedPipes[(MidiPipeHandle)ConnectedOutputPipe.get()] = ConnectedOutputPipe;
+
+        auto current = ConnectedPipes();
+
+        if (current && FindConnectedPipe(*current, ConnectedOutputPipe) != current->end())
+        {
+            return S_OK;
+        }
+
+        auto updated = current ? std::make_shared<MidiConnectedPipeList>(*current) : std::make_shared<MidiConnectedPipeList>();
+        updated->push_back({ ConnectedOutputPipe, ConnectedOutputPipe->DeliveryStage() });
+
+        PublishConnectedPipes(std::move(updated));
 
         return S_OK;
     }
@@ -61,12 +89,21 @@ public:
     {
         auto lock = m_Lock.lock();
 
-        auto item = m_ConnectedPipes.find((MidiPipeHandle)ConnectedOutputPipe.get());
+        auto current = ConnectedPipes();
 
-        if (item != m_ConnectedPipes.end())
+        if (current)
         {
-            m_ConnectedPipes.erase(item);
-            return S_OK;
+            auto item = FindConnectedPipe(*current, ConnectedOutputPipe);
+
+            if (item != current->end())
+            {
+                auto updated = std::make_shared<MidiConnectedPipeList>(*current);
+                updated->erase(updated->begin() + (item - current->begin()));
+
+                PublishConnectedPipes(std::move(updated));
+
+                return S_OK;
+            }
         }
 
         return E_INVALIDARG;
@@ -75,16 +112,57 @@ public:
     virtual HRESULT SendMidiMessage(_In_ PVOID, _In_ UINT, _In_ LONGLONG) { return E_NOTIMPL; }
     virtual HRESULT SendMidiMessageNow(_In_ PVOID, _In_ UINT, _In_ LONGLONG) { return E_NOTIMPL; }
 
-    STDMETHOD(Callback)(_In_ PVOID Data, _In_ UINT Length, _In_ LONGLONG Position, _In_ LONGLONG)
+    // Counts for the cross process buffers behind this pipe, for pipes which have them.
+    // MidiIn is the direction towards the client, as for IMidiPipeStatistics.
+    virtual HRESULT GetStatistics(_Out_ PMIDI_PIPE_STATISTICS, _Out_ PMIDI_PIPE_STATISTICS) { return E_NOTIMPL; }
+
+    // Which incoming messages the client wants. Only client pipes override this.
+    virtual HRESULT SetSubscriptionFilter(_In_ PMIDI_SUBSCRIPTION_FILTER) { return E_NOTIMPL; }
+
+    // How a pipe upstream of this one delivers to it. Asked for once, when this pipe is
+    // connected, and never per message. Pipes override this to hand out a function which
+    // calls straight into their own implementation.
+    virtual PFN_MIDI_PIPE_STAGE DeliveryStage() { return &CMidiPipe::DeliverToPipe; }
+
+    // Source is the client the message came from, when it is a client pipe calling
+    // back, and 0 otherwise. Only pipes which keep track of the sender override this.
+    virtual HRESULT SendMidiMessageFromSource(_In_ PVOID Data, _In_ UINT Length, _In_ LONGLONG Position, _In_ MidiClientHandle)
     {
-        // need to hold the client pipe lock to ensure that
-        // no clients are added or removed while performing the callback
-        // to the client.
-        auto lock = m_Lock.lock();
+        return SendMidiMessage(Data, Length, Position);
+    }
+
+    STDMETHOD(Callback)(_In_ PVOID Data, _In_ UINT Length, _In_ LONGLONG Position, _In_ LONGLONG Context)
+    {
+        // No lock here. The list we get can't change under us, and holds a reference
+        // to each pipe, so a pipe which is removed part way through is still safe to
+        // send to. It just fails the send if it has been cleaned up already.
+        auto connectedPipes = ConnectedPipes();
 
-        for (auto const& Client : m_ConnectedPipes)
+        if (connectedPipes)
         {
-            Client.second->SendMidiMessage(Data, Length, Position);
+            for (auto const& Client : *connectedPipes)
+            {
+                Client.Deliver(Client.Pipe.get(), Data, Length, Position, (MidiClientHandle)Context);
+            }
+        }
+
+        return S_OK;
+    }
+
+    // Same as Callback, for each message in turn, with the same list for all of them.
+    STDMETHOD(BatchCallback)(_In_ PMIDIMESSAGEBATCHENTRY Messages, _In_ UINT MessageCount, _In_ LONGLONG Context)
+    {
+        auto connectedPipes = ConnectedPipes();
+
+        if (connectedPipes)
+        {
+            for (UINT i = 0; i < MessageCount; i++)
+            {
+                for (auto const& Client : *connectedPipes)
+                {
+                    Client.Deliver(Client.Pipe.get(), Messages[i].Data, Messages[i].ByteCount, Messages[i].Position, (MidiClientHandle)Context);
+                }
+            }
         }
 
         return S_OK;
@@ -160,14 +238,42 @@ public:
         }
     }
 
+protected:
+    static HRESULT DeliverToPipe(_In_ CMidiPipe* Pipe, _In_ PVOID Data, _In_ UINT Length, _In_ LONGLONG Position, _In_ MidiClientHandle Source)
+    {
+        return Pipe->SendMidiMessageFromSource(Data, Length, Position, Source);
+    }
+
 private:
+    static MidiConnectedPipeList::const_iterator FindConnectedPipe(_In_ MidiConnectedPipeList const& List, _In_ wil::com_ptr_nothrow<CMidiPipe> const& Pipe)
+    {
+        return std::find_if(List.begin(), List.end(), [&](MidiConnectedPipe const& Connected) { return Connected.Pipe == Pipe; });
+    }
+
+    std::shared_ptr<const MidiConnectedPipeList> ConnectedPipes() const
+    {
+        return std::atomic_load_explicit(&m_ConnectedPipes, std::memory_order_acquire);
+    }
+
+    // Caller must hold m_Lock
+    void PublishConnectedPipes(std::shared_ptr<const MidiConnectedPipeList> ConnectedPipes)
+    {
+        std::atomic_store_explicit(&m_ConnectedPipes, std::move(ConnectedPipes), std::memory_order_release);
+    }
+
     std::wstring m_Device;
     MidiDataFormat m_DataFormatIn{ MidiDataFormat_Invalid };
     MidiDataFormat m_DataFormatOut{ MidiDataFormat_Invalid };
     MidiFlow m_Flow{ MidiFlowIn };
 
+    // m_Lock serializes changes to the connected pipes, and guards m_Clients.
     wil::critical_section m_Lock;
-    std::map<MidiPipeHandle, wil::com_ptr_nothrow<CMidiPipe>> m_ConnectedPipes;
+
+    // Copy on write. Adding or removing a pipe publishes a new list, and the callbacks
+    // deliver to whichever list was current when they started, without taking m_Lock.
+    // So a slow pipe doesn't hold up changes to the list, and changes to the list
+    // don't wait for messages already on their way.
+    std::shared_ptr<const MidiConnectedPipeList> m_ConnectedPipes;
     std::vector<MidiClientHandle> m_Clients;
 
 };
@@ -0,0 +1,113 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#pragma once
+
+// The transforms which can sit between an endpoint and its clients. There is at most
+// one of each per endpoint, shared by all of its clients.
+enum MidiRouteStageRole
+{
+    MidiRouteStageRole_FormatIn = 0,        // data format translation, device to client
+    MidiRouteStageRole_MetadataListener,    // endpoint metadata, device to client
+    MidiRouteStageRole_FormatOut,           // data format translation, client to device
+    MidiRouteStageRole_Scheduler,           // outgoing message scheduler, client to device
+    MidiRouteStageRole_Count
+};
+
+// Everything which carries messages between one endpoint and its clients: the device
+// pipe, the transforms, the client pipes, and how they're connected.
+//
+// This only changes when a client connects or disconnects. Each connection resolves
+// to a stage function in the sending pipe's connected list (see MidiConnectedPipe), so
+// messages go from pipe to pipe without coming back here, and without any lookups.
+// Stages are found by role, rather than by searching all of the service's transforms
+// for ones belonging to this device.
+//
+// That covers the hops into each pipe. What comes out of a transform, or of the
+// device, still comes back to its pipe through IMidiCallback::Callback, since that
+// is the interface transforms and abstractions are given, and goes on from there.
+//
+// Not thread safe. CMidiClientManager holds its lock while using this.
+class CMidiRoutingGraph
+{
+public:
+    CMidiRoutingGraph() = default;
+
+    CMidiRoutingGraph(CMidiRoutingGraph const&) = delete;
+    CMidiRoutingGraph& operator=(CMidiRoutingGraph const&) = delete;
+
+    HRESULT Initialize(_In_ wil::com_ptr_nothrow<CMidiPipe>&);
+
+    // Transforms go before the device, in case they're still sending to it
+    void CleanupStages();
+    HRESULT Cleanup();
+
+    wil::com_ptr_nothrow<CMidiPipe> DevicePipe() { return m_DevicePipe; }
+
+    // nullptr if there isn't one yet
+    wil::com_ptr_nothrow<CMidiTransformPipe> Stage(_In_ MidiRouteStageRole Role) { return m_Stages[Role].Pipe; }
+
+    // Only meaningful for the format translators. The other stages are UMP to UMP
+    BOOL IsStageFormat(_In_ MidiRouteStageRole, _In_ MidiDataFormat, _In_ MidiDataFormat);
+
+    HRESULT AddStage(_In_ MidiRouteStageRole,
+                        _In_ wil::com_ptr_nothrow<CMidiTransformPipe>&,
+                        _In_ MidiDataFormat,
+                        _In_ MidiDataFormat);
+
+    // Messages from the first pipe go to the second one from now on
+    HRESULT Connect(_In_ wil::com_ptr_nothrow<CMidiPipe>&,
+                        _In_ wil::com_ptr_nothrow<CMidiPipe>&);
+
+    HRESULT AddClient(_In_ MidiClientHandle, _In_ wil::com_ptr_nothrow<CMidiPipe>&);
+
+    // Disconnects the client, then removes it from every pipe here, cleaning up any
+    // stage which no longer has clients. The caller cleans up the client pipe.
+    HRESULT RemoveClient(_In_ MidiClientHandle);
+
+    BOOL HasClient(_In_ MidiClientHandle);
+    BOOL InUse() { return m_DevicePipe && m_DevicePipe->InUse(); }
+
+    // Goes up every time the graph changes
+    UINT32 Version() { return m_Version; }
+
+    // A readable dump of the stages, their formats and clients, and the connections
+    // between everything, for tracing.
+    std::wstring Describe();
+
+private:
+    typedef struct MidiRouteStage
+    {
+        wil::com_ptr_nothrow<CMidiTransformPipe> Pipe;
+        MidiDataFormat DataFormatFrom{ MidiDataFormat_Invalid };
+        MidiDataFormat DataFormatTo{ MidiDataFormat_Invalid };
+    } MidiRouteStage;
+
+    typedef struct MidiRouteConnection
+    {
+        wil::com_ptr_nothrow<CMidiPipe> From;
+        wil::com_ptr_nothrow<CMidiPipe> To;
+    } MidiRouteConnection;
+
+    typedef struct MidiRouteClient
+    {
+        MidiClientHandle Handle;
+        wil::com_ptr_nothrow<CMidiPipe> Pipe;
+    } MidiRouteClient;
+
+    // removes every connection to or from the pipe
+    void Disconnect(_In_ CMidiPipe*);
+
+    std::wstring PipeName(_In_ CMidiPipe*);
+
+    wil::com_ptr_nothrow<CMidiPipe> m_DevicePipe;
+    MidiRouteStage m_Stages[MidiRouteStageRole_Count];
+    std::vector<MidiRouteConnection> m_Connections;
+    std::vector<MidiRouteClient> m_Clients;
+    UINT32 m_Version{ 0 };
+};
@@ -0,0 +1,50 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#pragma once
+
+// true if the filter selects every message, in which case the client pipe doesn't
+// bother checking them
+inline bool MidiSubscriptionFilterSelectsAll(_In_ MIDI_SUBSCRIPTION_FILTER const& Filter) noexcept
+{
+    return Filter.GroupMask == MIDI_SUBSCRIPTION_FILTER_ALL &&
+        Filter.ChannelMask == MIDI_SUBSCRIPTION_FILTER_ALL &&
+        Filter.MessageTypeMask == MIDI_SUBSCRIPTION_FILTER_ALL &&
+        Filter.IncludeStreamMessages;
+}
+
+// true if the filter selects the UMP which starts with this word. See
+// MIDI_SUBSCRIPTION_FILTER for what each mask applies to.
+inline bool MidiSubscriptionFilterMatches(_In_ MIDI_SUBSCRIPTION_FILTER const& Filter, _In_ UINT32 FirstWord) noexcept
+{
+    UINT32 messageType = FirstWord >> 28;
+
+    if (messageType == 0xF)
+    {
+        return Filter.IncludeStreamMessages != FALSE;
+    }
+
+    if ((Filter.MessageTypeMask & (1u << messageType)) == 0)
+    {
+        return false;
+    }
+
+    // utility messages, like JR timestamps, are the only other ones without a group
+    if (messageType != 0x0 && (Filter.GroupMask & (1u << ((FirstWord >> 24) & 0x0F))) == 0)
+    {
+        return false;
+    }
+
+    // MIDI 1.0 and MIDI 2.0 channel voice messages
+    if ((messageType == 0x2 || messageType == 0x4) && (Filter.ChannelMask & (1u << ((FirstWord >> 16) & 0x0F))) == 0)
+    {
+        return false;
+    }
+
+    return true;
+}
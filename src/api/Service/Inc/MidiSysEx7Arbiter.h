@@ -0,0 +1,413 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+#pragma once
+
+#include "ump_helpers.h"
+
+// Keeps one client's SysEx7 from being broken up by other clients sending to the same
+// device.
+//
+// A client which sends a SysEx7 start packet owns that group until it sends the end
+// packet. Meanwhile, other clients' messages for the group are parked here, and sent
+// in the order they arrived once the group is free. Messages for other groups,
+// groupless messages and system real-time messages, which UMP allows between SysEx7
+// packets, aren't held up, so the device is kept busy the whole time. Anything else
+// the owner sends on the group ends its SysEx7, see IsMessageOkToSendDuringSysEx7.
+//
+// If the owner goes quiet for the timeout while others are waiting for the group, the
+// transfer is abandoned. The device is sent an empty end packet so it isn't left part
+// way through a message, and the group is released.
+//
+// Times are performance counter ticks. The caller says what time it is, so tests can
+// run this against a simulated clock.
+//
+// A device which takes UMP is arbitrated by its device pipe. A byte stream device is
+// sent its messages through a UMP to byte stream translator, which all of the device's
+// clients share, and which doesn't pass along who sent what. So for those, the
+// translator's transform pipe arbitrates instead, before the messages are translated.
+//
+// This class is not thread safe. The owner is responsible for locking.
+
+typedef struct MIDI_PARKED_UMP
+{
+    MidiClientHandle Source;
+    LONGLONG Position;
+    UINT32 ByteCount;
+    UINT32 Words[4];
+} MIDI_PARKED_UMP, *PMIDI_PARKED_UMP;
+
+enum class MidiSysEx7ArbiterResult
+{
+    Sent,
+    Parked,         // waiting for another client to finish its SysEx7
+    Dropped         // would have been parked, but there wasn't room
+};
+
+class CMidiSysEx7Arbiter
+{
+public:
+    CMidiSysEx7Arbiter() = default;
+
+    CMidiSysEx7Arbiter(CMidiSysEx7Arbiter const&) = delete;
+    CMidiSysEx7Arbiter& operator=(CMidiSysEx7Arbiter const&) = delete;
+
+    // Nothing is allocated until a message has to be parked, since most devices only
+    // ever have one client sending SysEx at a time.
+    HRESULT Initialize(_In_ UINT32 Capacity, _In_ ULONGLONG TimeoutTicks)
+    {
+        RETURN_HR_IF(E_INVALIDARG, Capacity == 0);
+        RETURN_HR_IF(E_INVALIDARG, TimeoutTicks == 0);
+
+        m_Parked.reset();
+        m_Capacity = Capacity;
+        m_TimeoutTicks = TimeoutTicks;
+        m_ParkedCount = 0;
+
+        for (auto& group : m_Groups)
+        {
+            group = {};
+        }
+
+        return S_OK;
+    }
+
+    bool Enabled() const noexcept { return m_Capacity != 0; }
+
+    // Sends the UMP now through SendToDevice(PVOID, UINT, LONGLONG), or parks it until
+    // its group is free. Either way, this may send parked messages which are now free
+    // to go, and end abandoned transfers.
+    template <typename TSend>
+    HRESULT Send(
+        _In_ MidiClientHandle Source,
+        _In_reads_bytes_(Length) PVOID Data,
+        _In_ UINT Length,
+        _In_ LONGLONG Position,
+        _In_ ULONGLONG Now,
+        _In_ TSend&& SendToDevice,
+        _Out_ MidiSysEx7ArbiterResult& Result
+    )
+    {
+        Result = MidiSysEx7ArbiterResult::Sent;
+
+        RETURN_HR_IF(E_INVALIDARG, nullptr == Data);
+        RETURN_HR_IF(E_INVALIDARG, Length < sizeof(UINT32) || Length > sizeof(MIDI_PARKED_UMP::Words));
+
+        ExpireAbandoned(Now, SendToDevice);
+
+        UINT32 word0{ 0 };
+        memcpy(&word0, Data, sizeof(word0));
+
+        if (IsBlocked(Source, word0))
+        {
+            RETURN_IF_FAILED(Park(Source, Data, Length, Position, word0, Result));
+
+            return S_OK;
+        }
+
+        RETURN_IF_FAILED(SendToDevice(Data, Length, Position));
+
+        if (Track(Source, word0, Now))
+        {
+            ReleaseParked(Now, SendToDevice);
+        }
+
+        return S_OK;
+    }
+
+    // Ends transfers which have gone quiet while someone is waiting for the group, and
+    // sends whatever was waiting on them.
+    template <typename TSend>
+    void ExpireAbandoned(_In_ ULONGLONG Now, _In_ TSend&& SendToDevice)
+    {
+        // nobody is waiting, so there's nothing to abandon
+        if (m_ParkedCount == 0)
+        {
+            return;
+        }
+
+        bool released{ false };
+
+        for (UINT32 groupIndex = 0; groupIndex < _countof(m_Groups); groupIndex++)
+        {
+            auto& group = m_Groups[groupIndex];
+
+            if (group.Owned && group.ParkedCount > 0 && Now >= group.LastActivity + m_TimeoutTicks)
+            {
+                EndTransfer(groupIndex, Now, SendToDevice);
+                released = true;
+            }
+        }
+
+        if (released)
+        {
+            ReleaseParked(Now, SendToDevice);
+        }
+    }
+
+    // A client has gone. Its parked messages are dropped, and any transfer it was part
+    // way through is ended, so the others can have the group.
+    template <typename TSend>
+    void RemoveSource(_In_ MidiClientHandle Source, _In_ ULONGLONG Now, _In_ TSend&& SendToDevice)
+    {
+        UINT32 kept{ 0 };
+
+        for (UINT32 i = 0; i < m_ParkedCount; i++)
+        {
+            if (m_Parked[i].Source == Source)
+            {
+                m_Groups[GroupIndex(m_Parked[i].Words[0])].ParkedCount--;
+                m_DroppedCount++;
+            }
+            else
+            {
+                m_Parked[kept++] = m_Parked[i];
+            }
+        }
+
+        m_ParkedCount = kept;
+
+        bool released{ false };
+
+        for (UINT32 groupIndex = 0; groupIndex < _countof(m_Groups); groupIndex++)
+        {
+            if (m_Groups[groupIndex].Owned && m_Groups[groupIndex].Owner == Source)
+            {
+                EndTransfer(groupIndex, Now, SendToDevice);
+                released = true;
+            }
+        }
+
+        if (released)
+        {
+            ReleaseParked(Now, SendToDevice);
+        }
+    }
+
+    // When ExpireAbandoned next has something to do, if anything is waiting
+    bool GetNextDeadline(_Out_ ULONGLONG& Deadline) const noexcept
+    {
+        bool waiting{ false };
+
+        Deadline = 0;
+
+        for (auto const& group : m_Groups)
+        {
+            if (group.Owned && group.ParkedCount > 0 && (!waiting || group.LastActivity + m_TimeoutTicks < Deadline))
+            {
+                Deadline = group.LastActivity + m_TimeoutTicks;
+                waiting = true;
+            }
+        }
+
+        return waiting;
+    }
+
+    UINT32 ParkedCount() const noexcept { return m_ParkedCount; }
+    bool IsGroupOwned(_In_ UINT8 Group) const noexcept { return m_Groups[Group & 0x0F].Owned; }
+
+    ULONGLONG ParkedTotal() const noexcept { return m_ParkedTotal; }
+    ULONGLONG DroppedCount() const noexcept { return m_DroppedCount; }
+    ULONGLONG AbandonedCount() const noexcept { return m_AbandonedCount; }
+    ULONGLONG FailedCount() const noexcept { return m_FailedCount; }
+    UINT32 HighWaterMark() const noexcept { return m_HighWaterMark; }
+
+private:
+    static UINT8 GroupIndex(_In_ UINT32 Word0) noexcept
+    {
+        return Windows::Devices::Midi2::Internal::GetGroupIndexFromFirstWord(Word0);
+    }
+
+    static bool HasGroup(_In_ UINT32 Word0) noexcept
+    {
+        return Windows::Devices::Midi2::Internal::MessageTypeHasGroupField(
+            Windows::Devices::Midi2::Internal::GetUmpMessageTypeFromFirstWord(Word0));
+    }
+
+    // whether a message has to wait for someone else's SysEx7 to finish
+    bool IsBlocked(_In_ MidiClientHandle Source, _In_ UINT32 Word0) const noexcept
+    {
+        if (!Enabled() || !HasGroup(Word0))
+        {
+            return false;
+        }
+
+        auto const& group = m_Groups[GroupIndex(Word0)];
+
+        if (!group.Owned || group.Owner == Source)
+        {
+            return false;
+        }
+
+        return !Windows::Devices::Midi2::Internal::IsSystemRealTimeMessage(Word0);
+    }
+
+    // Updates the group's state for a message which was just sent. Returns true if that
+    // freed up a group someone is waiting for.
+    bool Track(_In_ MidiClientHandle Source, _In_ UINT32 Word0, _In_ ULONGLONG Now) noexcept
+    {
+        if (!Enabled() || !HasGroup(Word0))
+        {
+            return false;
+        }
+
+        UINT8 groupIndex = GroupIndex(Word0);
+        auto& group = m_Groups[groupIndex];
+
+        if (Windows::Devices::Midi2::Internal::IsSysEx7StartMessage(Word0))
+        {
+            group.Owned = true;
+            group.Owner = Source;
+            group.LastActivity = Now;
+
+            return false;
+        }
+
+        if (!group.Owned || group.Owner != Source)
+        {
+            // real-time from someone else, which doesn't change anything
+            return false;
+        }
+
+        if (!Windows::Devices::Midi2::Internal::IsSysEx7CompleteMessage(Word0) &&
+            Windows::Devices::Midi2::Internal::IsMessageOkToSendDuringSysEx7(groupIndex, Word0))
+        {
+            group.LastActivity = Now;
+
+            return false;
+        }
+
+        // the end packet, or something else which ends the SysEx7
+        group.Owned = false;
+
+        return group.ParkedCount > 0;
+    }
+
+    HRESULT Park(
+        _In_ MidiClientHandle Source,
+        _In_reads_bytes_(Length) PVOID Data,
+        _In_ UINT Length,
+        _In_ LONGLONG Position,
+        _In_ UINT32 Word0,
+        _Out_ MidiSysEx7ArbiterResult& Result
+    )
+    {
+        Result = MidiSysEx7ArbiterResult::Dropped;
+
+        if (!m_Parked)
+        {
+            m_Parked.reset(new (std::nothrow) MIDI_PARKED_UMP[m_Capacity]);
+            RETURN_IF_NULL_ALLOC(m_Parked);
+        }
+
+        if (m_ParkedCount == m_Capacity)
+        {
+            m_DroppedCount++;
+
+            return S_OK;
+        }
+
+        auto& parked = m_Parked[m_ParkedCount++];
+
+        parked.Source = Source;
+        parked.Position = Position;
+        parked.ByteCount = Length;
+        CopyMemory(parked.Words, Data, Length);
+
+        m_Groups[GroupIndex(Word0)].ParkedCount++;
+        m_ParkedTotal++;
+
+        if (m_ParkedCount > m_HighWaterMark)
+        {
+            m_HighWaterMark = m_ParkedCount;
+        }
+
+        Result = MidiSysEx7ArbiterResult::Parked;
+
+        return S_OK;
+    }
+
+    // Sends parked messages which are free to go, oldest first. One of those may start a
+    // new transfer, which holds up the messages behind it, and end it again, which frees
+    // them, so go around until nothing changes.
+    template <typename TSend>
+    void ReleaseParked(_In_ ULONGLONG Now, _In_ TSend&& SendToDevice)
+    {
+        bool released{ true };
+
+        while (released && m_ParkedCount > 0)
+        {
+            released = false;
+
+            UINT32 kept{ 0 };
+
+            for (UINT32 i = 0; i < m_ParkedCount; i++)
+            {
+                auto parked = m_Parked[i];
+                UINT32 word0 = parked.Words[0];
+
+                if (IsBlocked(parked.Source, word0))
+                {
+                    m_Parked[kept++] = parked;
+                    continue;
+                }
+
+                m_Groups[GroupIndex(word0)].ParkedCount--;
+
+                // nobody to tell if this fails, the sender was told it was sent
+                if (FAILED(SendToDevice(parked.Words, parked.ByteCount, parked.Position)))
+                {
+                    m_FailedCount++;
+                }
+                else if (Track(parked.Source, word0, Now))
+                {
+                    released = true;
+                }
+            }
+
+            m_ParkedCount = kept;
+        }
+    }
+
+    // sends an empty end packet on the group, and releases it
+    template <typename TSend>
+    void EndTransfer(_In_ UINT32 Group, _In_ ULONGLONG Now, _In_ TSend&& SendToDevice)
+    {
+        UINT32 end[2]{ 0x30300000 | (Group << 24), 0 };
+
+        if (FAILED(SendToDevice(end, (UINT)sizeof(end), (LONGLONG)Now)))
+        {
+            m_FailedCount++;
+        }
+
+        m_Groups[Group].Owned = false;
+        m_AbandonedCount++;
+    }
+
+    struct GroupState
+    {
+        bool Owned{ false };
+        MidiClientHandle Owner{ 0 };        // 0 is a client we don't know, so Owned says if there is one
+        ULONGLONG LastActivity{ 0 };
+        UINT32 ParkedCount{ 0 };
+    };
+
+    GroupState m_Groups[16]{};
+
+    // parked messages in the order they arrived
+    std::unique_ptr<MIDI_PARKED_UMP[]> m_Parked;
+    UINT32 m_Capacity{ 0 };
+    UINT32 m_ParkedCount{ 0 };
+    ULONGLONG m_TimeoutTicks{ 0 };
+
+    ULONGLONG m_ParkedTotal{ 0 };
+    ULONGLONG m_DroppedCount{ 0 };
+    ULONGLONG m_AbandonedCount{ 0 };
+    ULONGLONG m_FailedCount{ 0 };
+    UINT32 m_HighWaterMark{ 0 };
+};
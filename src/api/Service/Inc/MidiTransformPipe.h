@@ -9,6 +9,7 @@
 #pragma once
 
 #include "MidiPipe.h"
+#include "MidiSysEx7Arbiter.h"
 
 typedef struct MIDISRV_TRANSFORMCREATION_PARAMS
 {
@@ -16,6 +17,7 @@ typedef struct MIDISRV_TRANSFORMCREATION_PARAMS
     MidiDataFormat DataFormatIn;
     MidiDataFormat DataFormatOut;
     MidiFlow Flow;
+    UINT32 SysEx7TimeoutMs;     // only used by a UMP to byte stream translator. 0 for no arbitration
 } MIDISRV_TRANSFORMCREATION_PARAMS, *PMIDISRV_TRANSFORMCREATION_PARAMS;
 
 class CMidiTransformPipe : public CMidiPipe
@@ -28,18 +30,66 @@ public:
                             _In_ DWORD *, // mmcss
                             _In_ IUnknown* // MidiDeviceManager to provide to transforms that need to update device properties
     ); 
+
+    // For running the pipe in-process with a transform of the caller's own, instead of
+    // creating the one TransformGuid names.
+    HRESULT Initialize(_In_ LPCWSTR,
+                            _In_ PMIDISRV_TRANSFORMCREATION_PARAMS,
+                            _In_ IMidiDataTransform*
+    );
+
     HRESULT Cleanup();
 
     HRESULT SendMidiMessage(_In_ PVOID, _In_ UINT, _In_ LONGLONG);
     HRESULT SendMidiMessageNow(_In_ PVOID, _In_ UINT, _In_ LONGLONG);
+    HRESULT SendMidiMessageFromSource(_In_ PVOID, _In_ UINT, _In_ LONGLONG, _In_ MidiClientHandle);
+
+    PFN_MIDI_PIPE_STAGE DeliveryStage();
+
+    HRESULT CancelScheduledMessages(_In_ MidiClientHandle, _In_ PMIDI_SCHEDULED_MESSAGE_FILTER, _Out_ UINT32*);
 
     GUID TransformGuid();
 
+    void RemoveClient(_In_ MidiClientHandle);
+
 private:
+    static HRESULT DeliverToTransform(_In_ CMidiPipe*, _In_ PVOID, _In_ UINT, _In_ LONGLONG, _In_ MidiClientHandle);
+    static HRESULT DeliverToScheduler(_In_ CMidiPipe*, _In_ PVOID, _In_ UINT, _In_ LONGLONG, _In_ MidiClientHandle);
+    static void CALLBACK SysEx7TimeoutCallback(_Inout_ PTP_CALLBACK_INSTANCE, _Inout_opt_ PVOID, _Inout_ PTP_TIMER);
+
+    HRESULT InitializeTransform(_In_ LPCWSTR, _In_ PMIDISRV_TRANSFORMCREATION_PARAMS, _In_ DWORD*, _In_opt_ IUnknown*);
+
+    HRESULT SendToTransform(_In_ PVOID, _In_ UINT, _In_ LONGLONG, _In_ MidiClientHandle);
+
+    void ExpireSysEx7Transfers();
+    void ScheduleSysEx7TimeoutNoLock();
+
+    // Upstream pipes deliver from a snapshot of their connections, without a lock, so a
+    // delivery can still be on its way in after we've been disconnected. Everything
+    // which uses the transform holds this shared while it does. Cleanup takes it
+    // exclusive, which waits for deliveries already in here, and sets m_CleanedUp so
+    // those which come later go no further. The transform members are only released
+    // after that.
+    wil::srwlock m_TransformLock;
+    bool m_CleanedUp{ false };
+
     wil::com_ptr_nothrow<IMidiDataTransform> m_MidiDataTransform;
+
+    // only set if the transform is the scheduler
+    wil::com_ptr_nothrow<IMidiSchedulerTransform> m_MidiSchedulerTransform;
     winrt::guid m_TransformGuid{};
     MidiDataFormat m_DataFormatIn{};
     MidiDataFormat m_DataFormatOut{};
     MidiFlow m_Flow{};
+
+    // A UMP to byte stream translator is shared by all of the device's clients, and what
+    // it sends the device isn't tied to any one of them, so the device pipe can't keep
+    // their SysEx7 apart. This does it instead, before the messages reach the translator.
+    // Guarded by m_SysEx7Lock, which is held while sending to the translator so a
+    // released message can't overtake one which is being translated.
+    wil::critical_section m_SysEx7Lock;
+    CMidiSysEx7Arbiter m_SysEx7Arbiter;
+    wil::unique_threadpool_timer m_SysEx7Timer;
+    ULONGLONG m_SysEx7TimerDeadline{ 0 };
 };
 
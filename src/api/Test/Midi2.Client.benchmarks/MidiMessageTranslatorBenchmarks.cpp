@@ -0,0 +1,67 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+
+
+#include "stdafx.h"
+
+#include <chrono>
+#include <vector>
+
+
+// Type 2 to type 4, one message per call the way an app does it today, and then a
+// whole buffer at a time.
+void MidiMessageTranslatorBenchmarks::BenchmarkUpscaleMidi1ChannelVoiceMessages()
+{
+    LOG_OUTPUT(L"MIDI 1.0 to MIDI 2.0 translation benchmark **********************************************************************");
+
+    const uint32_t messageCount = 1000000;
+
+    // a mix of notes, controllers and pitch bend on all groups and channels
+    std::vector<uint32_t> midi1Words(messageCount);
+
+    for (uint32_t i = 0; i < messageCount; i++)
+    {
+        uint32_t status = 0x8 + (i % 7);
+        midi1Words[i] = 0x20000000 | ((i % 16) << 24) | (status << 20) | (((i / 16) % 16) << 16) | ((i % 128) << 8) | ((i * 7) % 128);
+    }
+
+    std::vector<uint32_t> midi2Words(messageCount * 2);
+
+    // per message
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < messageCount; i++)
+    {
+        auto translated = MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2(MidiMessage32(0, midi1Words[i]));
+
+        midi2Words[i * 2] = translated.Word0();
+        midi2Words[i * 2 + 1] = translated.Word1();
+    }
+
+    double perMessageSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<uint32_t> perMessageWords = midi2Words;
+
+    // whole buffer
+    uint32_t midi2WordCount{ 0 };
+
+    start = std::chrono::steady_clock::now();
+
+    auto translatedCount = MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessagesToMidi2(midi1Words, 0, midi2Words, midi2WordCount);
+
+    double bufferSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    VERIFY_ARE_EQUAL(translatedCount, messageCount);
+    VERIFY_ARE_EQUAL(midi2WordCount, messageCount * 2);
+    VERIFY_IS_TRUE(perMessageWords == midi2Words);
+
+    LOG_OUTPUT(L"%u messages", messageCount);
+    LOG_OUTPUT(L"Per message: %.3f seconds, %.0f messages per second", perMessageSeconds, messageCount / perMessageSeconds);
+    LOG_OUTPUT(L"Whole buffer: %.3f seconds, %.0f messages per second", bufferSeconds, messageCount / bufferSeconds);
+}
@@ -0,0 +1,28 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+
+#pragma once
+
+
+class MidiMessageTranslatorBenchmarks
+    : public WEX::TestClass<MidiMessageTranslatorBenchmarks>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiMessageTranslatorBenchmarks)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Benchmark")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"Windows.Devices.Midi2.dll")
+    END_TEST_CLASS()
+
+    TEST_METHOD(BenchmarkUpscaleMidi1ChannelVoiceMessages);
+
+private:
+
+
+};
@@ -30,6 +30,7 @@ using namespace winrt::Windows::Devices::Midi2;
 
 #include "MidiBenchmarks.h"
 #include "MidiSchedulerBenchmarks.h"
+#include "MidiMessageTranslatorBenchmarks.h"
 
 #ifndef LOG_OUTPUT
 #define LOG_OUTPUT(fmt, ...)  WEX::Logging::Log::Comment(WEX::Common::String().Format(fmt, __VA_ARGS__))
@@ -597,3 +597,139 @@ void MidiEndpointConnectionTests::TestSendAndReceiveWordArray()
 }
 
 
+void MidiEndpointConnectionTests::TestSendAndReceiveMultipleMessagesWordArray()
+{
+    LOG_OUTPUT(L"TestSendAndReceiveMultipleMessagesWordArray **********************************************************************");
+
+    wil::unique_event_nothrow allMessagesReceived;
+    allMessagesReceived.create();
+
+    auto session = MidiSession::CreateSession(L"Test Session Name");
+
+    VERIFY_IS_TRUE(session.IsOpen());
+    VERIFY_ARE_EQUAL(session.Connections().Size(), (uint32_t)0);
+
+    auto connSend = session.CreateEndpointConnection(MidiEndpointDeviceInformation::DiagnosticsLoopbackAEndpointId());
+    auto connReceive = session.CreateEndpointConnection(MidiEndpointDeviceInformation::DiagnosticsLoopbackBEndpointId());
+
+    VERIFY_IS_NOT_NULL(connSend);
+    VERIFY_IS_NOT_NULL(connReceive);
+
+    // a 32 bit, a 64 bit, a 128 bit and another 32 bit message, back to back
+    uint32_t sendBuffer[]
+    {
+        0x21234567,
+        0x41234567, 0xDEADBEEF,
+        0x51234567, 0x01020304, 0x05060708, 0x090A0B0C,
+        0x21345678
+    };
+
+    uint32_t expectedWordCounts[]{ 1, 2, 4, 1 };
+
+    uint32_t receivedMessageCount{ 0 };
+    uint32_t receivedWordIndex{ 0 };
+    bool messagesMatch{ true };
+
+    auto MessageReceivedHandler = [&](IMidiMessageReceivedEventSource const& sender, MidiMessageReceivedEventArgs const& args)
+        {
+            VERIFY_IS_NOT_NULL(sender);
+            VERIFY_IS_NOT_NULL(args);
+
+            uint32_t receiveBuffer[4]{};
+            auto wordCount = args.FillWordArray(receiveBuffer, 0);
+
+            // messages must arrive separately, and in the order they were sent
+            if (receivedMessageCount >= ARRAYSIZE(expectedWordCounts) || wordCount != expectedWordCounts[receivedMessageCount])
+            {
+                messagesMatch = false;
+            }
+            else
+            {
+                for (uint32_t i = 0; i < wordCount; i++)
+                {
+                    if (receiveBuffer[i] != sendBuffer[receivedWordIndex + i])
+                    {
+                        messagesMatch = false;
+                    }
+                }
+
+                receivedWordIndex += wordCount;
+            }
+
+            if (++receivedMessageCount == ARRAYSIZE(expectedWordCounts))
+            {
+                allMessagesReceived.SetEvent();
+            }
+        };
+
+    auto eventRevokeToken = connReceive.MessageReceived(MessageReceivedHandler);
+
+    VERIFY_IS_TRUE(connSend.Open());
+    VERIFY_IS_TRUE(connReceive.Open());
+
+    uint32_t sentMessageCount{ 0 };
+
+    auto result = connSend.SendMessagesWordArray(0, sendBuffer, sentMessageCount);
+
+    VERIFY_IS_TRUE(MidiEndpointConnection::SendMessageSucceeded(result));
+    VERIFY_ARE_EQUAL(sentMessageCount, (uint32_t)ARRAYSIZE(expectedWordCounts));
+
+    // Wait for incoming messages
+    if (!allMessagesReceived.wait(3000))
+    {
+        std::cout << "Failure waiting for messages, timed out." << std::endl;
+    }
+
+    VERIFY_ARE_EQUAL(receivedMessageCount, (uint32_t)ARRAYSIZE(expectedWordCounts));
+    VERIFY_IS_TRUE(messagesMatch);
+
+    // unwire event
+    connReceive.MessageReceived(eventRevokeToken);
+
+    // cleanup endpoint. Technically not required as session will do it
+    session.DisconnectEndpointConnection(connSend.ConnectionId());
+    session.DisconnectEndpointConnection(connReceive.ConnectionId());
+
+    session.Close();
+}
+
+
+void MidiEndpointConnectionTests::TestSendMultipleMessagesIncompleteMessageError()
+{
+    LOG_OUTPUT(L"TestSendMultipleMessagesIncompleteMessageError **********************************************************************");
+
+    auto session = MidiSession::CreateSession(L"Test Session Name");
+
+    VERIFY_IS_TRUE(session.IsOpen());
+    VERIFY_ARE_EQUAL(session.Connections().Size(), (uint32_t)0);
+
+    auto connSend = session.CreateEndpointConnection(MidiEndpointDeviceInformation::DiagnosticsLoopbackAEndpointId());
+
+    VERIFY_IS_NOT_NULL(connSend);
+
+    // the 64 bit message at the end is missing its second word
+    uint32_t sendBuffer[]
+    {
+        0x21234567,
+        0x41234567, 0xDEADBEEF,
+        0x41234567
+    };
+
+    VERIFY_IS_TRUE(connSend.Open());
+
+    auto result = connSend.SendMessagesWordArray(0, sendBuffer);
+    VERIFY_IS_TRUE(MidiEndpointConnection::SendMessageFailed(result));
+    VERIFY_IS_TRUE((result & MidiSendMessageResult::InvalidMessageTypeForWordCount) == MidiSendMessageResult::InvalidMessageTypeForWordCount);
+
+    // none of it goes out, not even the complete messages at the start
+    uint32_t sentMessageCount{ 99 };
+
+    result = connSend.SendMessagesWordArray(0, sendBuffer, sentMessageCount);
+    VERIFY_IS_TRUE(MidiEndpointConnection::SendMessageFailed(result));
+    VERIFY_ARE_EQUAL(sentMessageCount, (uint32_t)0);
+
+    session.DisconnectEndpointConnection(connSend.ConnectionId());
+
+    session.Close();
+}
+
@@ -44,8 +44,10 @@ public:
     TEST_METHOD(TestSendAndReceiveUmp32);
     TEST_METHOD(TestSendAndReceiveWords);
     TEST_METHOD(TestSendAndReceiveWordArray);
+    TEST_METHOD(TestSendAndReceiveMultipleMessagesWordArray);
 
     TEST_METHOD(TestSendWordArrayBoundsError);
+    TEST_METHOD(TestSendMultipleMessagesIncompleteMessageError);
 
 
     //TEST_METHOD(TestSendMessageSuccessImmediateReturnCode);
@@ -0,0 +1,212 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+
+#include "stdafx.h"
+
+#include <vector>
+
+#include "midi_message_translation.h"
+
+#include "MidiMessageTranslatorTests.h"
+
+
+using namespace winrt::Windows::Devices::Midi2;
+
+namespace internal = ::Windows::Devices::Midi2::Internal;
+
+
+void MidiMessageTranslatorTests::TestScalingTables()
+{
+    // the tables have to give exactly what the min-center-max algorithm does, for every value
+    for (uint32_t i = 0; i < 128; i++)
+    {
+        VERIFY_ARE_EQUAL((uint32_t)internal::ScaleMidi7BitValueTo16Bit((uint8_t)i), internal::ScaleUpMidiValue(i, 7, 16));
+        VERIFY_ARE_EQUAL(internal::ScaleMidi7BitValueTo32Bit((uint8_t)i), internal::ScaleUpMidiValue(i, 7, 32));
+    }
+
+    uint32_t mismatchCount{ 0 };
+
+    for (uint32_t i = 0; i < 16384; i++)
+    {
+        if (internal::ScaleMidi14BitValueTo32Bit((uint16_t)i) != internal::ScaleUpMidiValue(i, 14, 32))
+        {
+            mismatchCount++;
+        }
+    }
+
+    VERIFY_ARE_EQUAL(mismatchCount, (uint32_t)0);
+
+    // and scaling back down gives the original value
+    for (uint32_t i = 0; i < 128; i++)
+    {
+        VERIFY_ARE_EQUAL(internal::ScaleDownMidiValue(internal::ScaleMidi7BitValueTo32Bit((uint8_t)i), 32, 7), i);
+    }
+}
+
+void MidiMessageTranslatorTests::TestUpscaleMidi1ChannelVoiceMessage()
+{
+    // Note On, group 3 channel 5
+    auto noteOn = MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2(MidiMessage32(1234, 0x23953C40));
+
+    VERIFY_IS_NOT_NULL(noteOn);
+    VERIFY_ARE_EQUAL(noteOn.Timestamp(), (uint64_t)1234);
+    VERIFY_ARE_EQUAL(noteOn.Word0(), (uint32_t)0x43953C00);
+    VERIFY_ARE_EQUAL(noteOn.Word1(), (uint32_t)0x80000000);
+
+    // Note On with a velocity of 0 is a Note Off
+    auto noteOff = MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2(0, 0, 0x90, 0x3C, 0x00);
+
+    VERIFY_IS_NOT_NULL(noteOff);
+    VERIFY_ARE_EQUAL(noteOff.Word0(), (uint32_t)0x40803C00);
+    VERIFY_ARE_EQUAL(noteOff.Word1(), (uint32_t)0x80000000);
+
+    // Pitch Bend maximum
+    auto pitchBend = MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2(0, 1, 0xE2, 0x7F, 0x7F);
+
+    VERIFY_IS_NOT_NULL(pitchBend);
+    VERIFY_ARE_EQUAL(pitchBend.Word0(), (uint32_t)0x41E20000);
+    VERIFY_ARE_EQUAL(pitchBend.Word1(), (uint32_t)0xFFFFFFFF);
+
+    // Program Change
+    auto programChange = MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2(0, 0, 0xC1, 0x05);
+
+    VERIFY_IS_NOT_NULL(programChange);
+    VERIFY_ARE_EQUAL(programChange.Word0(), (uint32_t)0x40C10000);
+    VERIFY_ARE_EQUAL(programChange.Word1(), (uint32_t)0x05000000);
+
+    // not channel voice
+    VERIFY_IS_NULL(MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2(MidiMessage32(0, 0x10F80000)));
+    VERIFY_IS_NULL(MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2(0, 0, 0xF8));
+}
+
+void MidiMessageTranslatorTests::TestDownscaleMidi2ChannelVoiceMessage()
+{
+    // Control Change, group 2 channel 1
+    auto controlChange = MidiMessageTranslator::DownscaleMidi2ChannelVoiceMessageToMidi1(MidiMessage64(99, 0x42B10700, 0xFFFFFFFF));
+
+    VERIFY_IS_NOT_NULL(controlChange);
+    VERIFY_ARE_EQUAL(controlChange.Timestamp(), (uint64_t)99);
+    VERIFY_ARE_EQUAL(controlChange.Word0(), (uint32_t)0x22B1077F);
+
+    // Note On with a velocity which scales to 0 stays a Note On
+    auto noteOn = MidiMessageTranslator::DownscaleMidi2ChannelVoiceMessageToMidi1(MidiMessage64(0, 0x40903C00, 0x00010000));
+
+    VERIFY_IS_NOT_NULL(noteOn);
+    VERIFY_ARE_EQUAL(noteOn.Word0(), (uint32_t)0x20903C01);
+
+    // Pitch Bend center
+    auto pitchBend = MidiMessageTranslator::DownscaleMidi2ChannelVoiceMessageToMidi1(MidiMessage64(0, 0x40E00000, 0x80000000));
+
+    VERIFY_IS_NOT_NULL(pitchBend);
+    VERIFY_ARE_EQUAL(pitchBend.Word0(), (uint32_t)0x20E00040);
+
+    // RPN and per-note messages have no single MIDI 1.0 message
+    VERIFY_IS_NULL(MidiMessageTranslator::DownscaleMidi2ChannelVoiceMessageToMidi1(MidiMessage64(0, 0x40200000, 0x80000000)));
+    VERIFY_IS_NULL(MidiMessageTranslator::DownscaleMidi2ChannelVoiceMessageToMidi1(MidiMessage64(0, 0x40603C00, 0x80000000)));
+
+    // every MIDI 1.0 message survives a round trip
+    for (uint32_t status = 0x8; status <= 0xE; status++)
+    {
+        for (uint32_t value = 0; value < 128; value++)
+        {
+            uint32_t dataByte2 = (status == 0xC || status == 0xD) ? 0 : value;
+
+            // a Note On with a velocity of 0 comes back as a Note Off
+            if (status == 0x9 && value == 0) continue;
+
+            uint32_t word = 0x20000000 | (status << 20) | (value << 8) | dataByte2;
+
+            auto upscaled = MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessageToMidi2(MidiMessage32(0, word));
+            VERIFY_IS_NOT_NULL(upscaled);
+
+            auto downscaled = MidiMessageTranslator::DownscaleMidi2ChannelVoiceMessageToMidi1(upscaled);
+            VERIFY_IS_NOT_NULL(downscaled);
+
+            VERIFY_ARE_EQUAL(downscaled.Word0(), word);
+        }
+    }
+}
+
+void MidiMessageTranslatorTests::TestUpscaleMidi1ChannelVoiceMessages()
+{
+    std::vector<uint32_t> source
+    {
+        0x20903C40,                 // Note On
+        0x10F80000,                 // Timing Clock, copied across
+        0x40B00700, 0x12345678,     // already MIDI 2.0, copied across
+        0x21D37F00,                 // Channel Pressure
+    };
+
+    std::vector<uint32_t> destination(source.size() * 2);
+    uint32_t destinationWordCount{ 0 };
+
+    auto translatedCount = MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessagesToMidi2(source, 0, destination, destinationWordCount);
+
+    VERIFY_ARE_EQUAL(translatedCount, (uint32_t)source.size());
+    VERIFY_ARE_EQUAL(destinationWordCount, (uint32_t)7);
+
+    std::vector<uint32_t> expected{ 0x40903C00, 0x80000000, 0x10F80000, 0x40B00700, 0x12345678, 0x41D30000, 0xFFFFFFFF };
+
+    for (uint32_t i = 0; i < destinationWordCount; i++)
+    {
+        VERIFY_ARE_EQUAL(destination[i], expected[i]);
+    }
+
+    // only whole messages are written, and translation picks up where it left off
+    std::vector<uint32_t> smallDestination(3);
+
+    translatedCount = MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessagesToMidi2(source, 0, smallDestination, destinationWordCount);
+
+    VERIFY_ARE_EQUAL(translatedCount, (uint32_t)2);
+    VERIFY_ARE_EQUAL(destinationWordCount, (uint32_t)3);
+
+    translatedCount = MidiMessageTranslator::UpscaleMidi1ChannelVoiceMessagesToMidi2(source, 2, smallDestination, destinationWordCount);
+
+    VERIFY_ARE_EQUAL(translatedCount, (uint32_t)2);
+    VERIFY_ARE_EQUAL(destinationWordCount, (uint32_t)2);
+    VERIFY_ARE_EQUAL(smallDestination[0], (uint32_t)0x40B00700);
+}
+
+void MidiMessageTranslatorTests::TestDownscaleMidi2ChannelVoiceMessages()
+{
+    std::vector<uint32_t> source
+    {
+        0x40C30001, 0x05000102,     // Program Change with bank
+        0x40200000, 0x18800000,     // RPN 0/0 (pitch bend sensitivity)
+        0x40603C00, 0x80000000,     // per-note Pitch Bend, dropped
+        0x10F80000,                 // Timing Clock, copied across
+    };
+
+    std::vector<uint32_t> destination(source.size() * 2);
+    uint32_t destinationWordCount{ 0 };
+
+    auto translatedCount = MidiMessageTranslator::DownscaleMidi2ChannelVoiceMessagesToMidi1(source, 0, destination, destinationWordCount);
+
+    VERIFY_ARE_EQUAL(translatedCount, (uint32_t)source.size());
+    VERIFY_ARE_EQUAL(destinationWordCount, (uint32_t)8);
+
+    std::vector<uint32_t> expected
+    {
+        0x20B30001, 0x20B32002, 0x20C30500,
+        0x20B06500, 0x20B06400, 0x20B0060C, 0x20B02620,
+        0x10F80000
+    };
+
+    for (uint32_t i = 0; i < destinationWordCount; i++)
+    {
+        VERIFY_ARE_EQUAL(destination[i], expected[i]);
+    }
+
+    // a message cut off at the end isn't translated
+    translatedCount = MidiMessageTranslator::DownscaleMidi2ChannelVoiceMessagesToMidi1(
+        winrt::array_view<uint32_t const>(source.data(), 3), 0, destination, destinationWordCount);
+
+    VERIFY_ARE_EQUAL(translatedCount, (uint32_t)2);
+    VERIFY_ARE_EQUAL(destinationWordCount, (uint32_t)3);
+}
@@ -0,0 +1,32 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+
+#pragma once
+
+using namespace winrt::Windows::Devices::Midi2;
+
+class MidiMessageTranslatorTests
+    : public WEX::TestClass<MidiMessageTranslatorTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiMessageTranslatorTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"Windows.Devices.Midi2.dll")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestScalingTables);
+    TEST_METHOD(TestUpscaleMidi1ChannelVoiceMessage);
+    TEST_METHOD(TestDownscaleMidi2ChannelVoiceMessage);
+    TEST_METHOD(TestUpscaleMidi1ChannelVoiceMessages);
+    TEST_METHOD(TestDownscaleMidi2ChannelVoiceMessages);
+
+private:
+
+};
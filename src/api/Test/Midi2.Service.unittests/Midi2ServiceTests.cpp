@@ -151,9 +151,11 @@ void Midi2ServiceTests::TestMidiServiceClientRPC()
             SAFE_CLOSEHANDLE(client->MidiInDataFileMapping);
             SAFE_CLOSEHANDLE(client->MidiInRegisterFileMapping);
             SAFE_CLOSEHANDLE(client->MidiInWriteEvent);
+            SAFE_CLOSEHANDLE(client->MidiInSpaceAvailableEvent);
             SAFE_CLOSEHANDLE(client->MidiOutDataFileMapping);
             SAFE_CLOSEHANDLE(client->MidiOutRegisterFileMapping);
             SAFE_CLOSEHANDLE(client->MidiOutWriteEvent);
+            SAFE_CLOSEHANDLE(client->MidiOutSpaceAvailableEvent);
 
             MIDL_user_free(client);
             client = nullptr;
@@ -223,6 +225,8 @@ void Midi2ServiceTests::TestMidiServiceClientRPC()
     client->MidiInRegisterFileMapping = NULL;
     midiInPipe->WriteEvent.reset(client->MidiInWriteEvent);
     client->MidiInWriteEvent = NULL;
+    midiInPipe->SpaceAvailableEvent.reset(client->MidiInSpaceAvailableEvent);
+    client->MidiInSpaceAvailableEvent = NULL;
     midiInPipe->Data.BufferSize = client->MidiInBufferSize;
     midiOutPipe->DataBuffer->FileMapping.reset(client->MidiOutDataFileMapping);
     client->MidiOutDataFileMapping = NULL;
@@ -230,6 +234,8 @@ void Midi2ServiceTests::TestMidiServiceClientRPC()
     client->MidiOutRegisterFileMapping = NULL;
     midiOutPipe->WriteEvent.reset(client->MidiOutWriteEvent);
     client->MidiOutWriteEvent = NULL;
+    midiOutPipe->SpaceAvailableEvent.reset(client->MidiOutSpaceAvailableEvent);
+    client->MidiOutSpaceAvailableEvent = NULL;
     midiOutPipe->Data.BufferSize = client->MidiOutBufferSize;
 
     MIDL_user_free(client);
@@ -237,11 +243,11 @@ void Midi2ServiceTests::TestMidiServiceClientRPC()
 
     // Midi in controls, buffering, and eventing.
     VERIFY_SUCCEEDED(CreateMappedDataBuffer(0, midiInPipe->DataBuffer.get(), &midiInPipe->Data));
-    VERIFY_SUCCEEDED(CreateMappedRegisters(midiInPipe->RegistersBuffer.get(), &midiInPipe->Registers));
+    VERIFY_SUCCEEDED(CreateMappedRegisters(midiInPipe->RegistersBuffer.get(), midiInPipe->Data.BufferSize, &midiInPipe->Registers));
 
     // Midi out controls, buffering, and eventing
     VERIFY_SUCCEEDED(CreateMappedDataBuffer(0, midiOutPipe->DataBuffer.get(), &midiOutPipe->Data));
-    VERIFY_SUCCEEDED(CreateMappedRegisters(midiOutPipe->RegistersBuffer.get(), &midiOutPipe->Registers));
+    VERIFY_SUCCEEDED(CreateMappedRegisters(midiOutPipe->RegistersBuffer.get(), midiOutPipe->Data.BufferSize, &midiOutPipe->Registers));
 
     UINT midiMessagesReceived = 0;
     UINT messagesExpected{ 0 };
@@ -276,6 +282,239 @@ void Midi2ServiceTests::TestMidiServiceClientRPC()
 
 }
 
+void Midi2ServiceTests::TestMidiServiceClientRPCBursts()
+{
+    TestMidiServiceClientBursts(0);
+}
+
+void Midi2ServiceTests::TestMidiServiceClientRPCPolling()
+{
+    TestMidiServiceClientBursts(MIDI_XPROC_MAXIMUM_POLLING_WINDOW_MICROSECONDS);
+}
+
+_Use_decl_annotations_
+void Midi2ServiceTests::TestMidiServiceClientBursts(DWORD PollingWindowMicroseconds)
+{
+    WEX::TestExecution::SetVerifyOutput verifySettings(WEX::TestExecution::VerifyOutputSettings::LogOnlyFailures);
+
+    MIDISRV_CLIENTCREATION_PARAMS creationParams {0};
+    PMIDISRV_CLIENT client {nullptr};
+    wil::unique_rpc_binding bindingHandle;
+    MidiClientHandle clientHandle{ 0 };
+    std::unique_ptr<CMidiXProc> midiPump;
+    DWORD MmCssTaskId{ 0 };
+
+    std::vector<std::unique_ptr<MIDIU_DEVICE>> testDevices;
+    VERIFY_SUCCEEDED(MidiSWDeviceEnum::EnumerateDevices(testDevices, [&](PMIDIU_DEVICE device)
+    {
+        if (device->Flow == MidiFlowBidirectional &&
+            (std::wstring::npos != device->ParentDeviceInstanceId.find(L"MinMidi") ||
+            std::wstring::npos != device->ParentDeviceInstanceId.find(L"VID_CAFE&PID_4001&MI_02")) &&
+            !device->MidiOne)
+        {
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+    }));
+
+    if (testDevices.size() == 0)
+    {
+        WEX::Logging::Log::Result(WEX::Logging::TestResults::Skipped, L"Test requires at least 1 MinMidi bidi endpoint.");
+        return;
+    }
+
+    VERIFY_IS_TRUE(testDevices.size() > 0);
+
+    std::wstring midiDevice = testDevices[0]->DeviceId;
+    
+    auto cleanupOnExit = wil::scope_exit([&]() {
+
+        if (midiPump)
+        {
+            midiPump->Cleanup();
+        }
+
+        if (client)
+        {
+            SAFE_CLOSEHANDLE(client->MidiInDataFileMapping);
+            SAFE_CLOSEHANDLE(client->MidiInRegisterFileMapping);
+            SAFE_CLOSEHANDLE(client->MidiInWriteEvent);
+            SAFE_CLOSEHANDLE(client->MidiInSpaceAvailableEvent);
+            SAFE_CLOSEHANDLE(client->MidiOutDataFileMapping);
+            SAFE_CLOSEHANDLE(client->MidiOutRegisterFileMapping);
+            SAFE_CLOSEHANDLE(client->MidiOutWriteEvent);
+            SAFE_CLOSEHANDLE(client->MidiOutSpaceAvailableEvent);
+
+            MIDL_user_free(client);
+            client = nullptr;
+        }
+
+        if (0 != clientHandle)
+        {
+            HRESULT hr = ([&]()
+            {
+                // RPC calls are placed in a lambda to work around compiler error C2712, limiting use of try/except blocks
+                // with structured exception handling.
+                RpcTryExcept RETURN_IF_FAILED(MidiSrvDestroyClient(bindingHandle.get(), clientHandle));
+                RpcExcept(I_RpcExceptionFilter(RpcExceptionCode())) RETURN_IF_FAILED(HRESULT_FROM_WIN32(RpcExceptionCode()));
+                RpcEndExcept
+                    return S_OK;
+            }());
+
+            if (FAILED(hr))
+            {
+                LOG_OUTPUT(L"MidiSrvDestroyClient failed 0x%08x", hr);
+            }
+        }
+    });
+
+    creationParams.DataFormat = MidiDataFormat_UMP;
+    creationParams.Flow = MidiFlowBidirectional;
+    creationParams.BufferSize = PAGE_SIZE;
+
+    LOG_OUTPUT(L"Retrieving binding handle");
+    VERIFY_SUCCEEDED(GetMidiSrvBindingHandle(&bindingHandle));
+
+    GUID DummySessionId{};
+
+    VERIFY_SUCCEEDED([&]() {
+        // RPC calls are placed in a lambda to work around compiler error C2712, limiting use of try/except blocks
+        // with structured exception handling.
+        RpcTryExcept RETURN_IF_FAILED(MidiSrvCreateClient(bindingHandle.get(), midiDevice.c_str(), &creationParams, DummySessionId, &client));
+        RpcExcept(I_RpcExceptionFilter(RpcExceptionCode())) RETURN_IF_FAILED(HRESULT_FROM_WIN32(RpcExceptionCode()));
+        RpcEndExcept
+        return S_OK;
+    }());
+
+    clientHandle = client->ClientHandle;
+
+    std::unique_ptr<MEMORY_MAPPED_PIPE> midiInPipe = std::unique_ptr<MEMORY_MAPPED_PIPE>(new (std::nothrow) MEMORY_MAPPED_PIPE);
+    VERIFY_IS_TRUE(nullptr != midiInPipe);
+
+    std::unique_ptr <MEMORY_MAPPED_PIPE> midiOutPipe = std::unique_ptr<MEMORY_MAPPED_PIPE>(new (std::nothrow) MEMORY_MAPPED_PIPE);
+    VERIFY_IS_TRUE(nullptr != midiOutPipe);
+
+    midiInPipe->DataBuffer.reset(new (std::nothrow) MEMORY_MAPPED_BUFFER);
+    VERIFY_IS_TRUE(nullptr != midiInPipe->DataBuffer);
+
+    midiInPipe->RegistersBuffer.reset(new (std::nothrow) MEMORY_MAPPED_BUFFER);
+    VERIFY_IS_TRUE(nullptr != midiInPipe->RegistersBuffer);
+
+    midiOutPipe->DataBuffer.reset(new (std::nothrow) MEMORY_MAPPED_BUFFER);
+    VERIFY_IS_TRUE(nullptr != midiOutPipe->DataBuffer);
+
+    midiOutPipe->RegistersBuffer.reset(new (std::nothrow) MEMORY_MAPPED_BUFFER);
+    VERIFY_IS_TRUE(nullptr != midiOutPipe->RegistersBuffer);
+
+    // Transfer the handles to local storage
+    midiInPipe->DataBuffer->FileMapping.reset(client->MidiInDataFileMapping);
+    client->MidiInDataFileMapping = NULL;
+    midiInPipe->RegistersBuffer->FileMapping.reset(client->MidiInRegisterFileMapping);
+    client->MidiInRegisterFileMapping = NULL;
+    midiInPipe->WriteEvent.reset(client->MidiInWriteEvent);
+    client->MidiInWriteEvent = NULL;
+    midiInPipe->SpaceAvailableEvent.reset(client->MidiInSpaceAvailableEvent);
+    client->MidiInSpaceAvailableEvent = NULL;
+    midiInPipe->Data.BufferSize = client->MidiInBufferSize;
+    midiOutPipe->DataBuffer->FileMapping.reset(client->MidiOutDataFileMapping);
+    client->MidiOutDataFileMapping = NULL;
+    midiOutPipe->RegistersBuffer->FileMapping.reset(client->MidiOutRegisterFileMapping);
+    client->MidiOutRegisterFileMapping = NULL;
+    midiOutPipe->WriteEvent.reset(client->MidiOutWriteEvent);
+    client->MidiOutWriteEvent = NULL;
+    midiOutPipe->SpaceAvailableEvent.reset(client->MidiOutSpaceAvailableEvent);
+    client->MidiOutSpaceAvailableEvent = NULL;
+    midiOutPipe->Data.BufferSize = client->MidiOutBufferSize;
+
+    MIDL_user_free(client);
+    client = nullptr;
+
+    // Midi in controls, buffering, and eventing.
+    VERIFY_SUCCEEDED(CreateMappedDataBuffer(0, midiInPipe->DataBuffer.get(), &midiInPipe->Data));
+    VERIFY_SUCCEEDED(CreateMappedRegisters(midiInPipe->RegistersBuffer.get(), midiInPipe->Data.BufferSize, &midiInPipe->Registers));
+
+    // Midi out controls, buffering, and eventing
+    VERIFY_SUCCEEDED(CreateMappedDataBuffer(0, midiOutPipe->DataBuffer.get(), &midiOutPipe->Data));
+    VERIFY_SUCCEEDED(CreateMappedRegisters(midiOutPipe->RegistersBuffer.get(), midiOutPipe->Data.BufferSize, &midiOutPipe->Registers));
+
+    UINT midiMessagesReceived = 0;
+    UINT messagesExpected{ 0 };
+    wil::unique_event_nothrow allMessagesReceived;
+
+    VERIFY_SUCCEEDED(allMessagesReceived.create());
+
+    m_MidiInCallback = [&](PVOID payload, UINT32 payloadSize, LONGLONG payloadPosition, LONGLONG)
+    {
+        PrintMidiMessage(payload, payloadSize, sizeof(UMP32), payloadPosition);
+
+        midiMessagesReceived++;
+        if (midiMessagesReceived == messagesExpected)
+        {
+            allMessagesReceived.SetEvent();
+        }
+    };
+
+    midiPump.reset(new (std::nothrow) CMidiXProc());
+    VERIFY_IS_TRUE(nullptr != midiPump);
+
+    VERIFY_SUCCEEDED(midiPump->Initialize(&MmCssTaskId, midiInPipe, midiOutPipe, this, 0, true));
+    VERIFY_SUCCEEDED(midiPump->SetMidiInPollingWindow(PollingWindowMicroseconds));
+
+    // bursts of messages, with a gap between them short enough for polling to catch
+    const UINT burstCount = 100;
+
+    LOG_OUTPUT(L"Writing midi data");
+    messagesExpected = 4 * burstCount;
+
+    for (UINT i = 0; i < burstCount; i++)
+    {
+        VERIFY_SUCCEEDED(midiPump->SendMidiMessage((void*)&g_MidiTestData_32, sizeof(UMP32), 0));
+        VERIFY_SUCCEEDED(midiPump->SendMidiMessage((void*)&g_MidiTestData_64, sizeof(UMP64), 0));
+        VERIFY_SUCCEEDED(midiPump->SendMidiMessage((void*)&g_MidiTestData_96, sizeof(UMP96), 0));
+        VERIFY_SUCCEEDED(midiPump->SendMidiMessage((void*)&g_MidiTestData_128, sizeof(UMP128), 0));
+
+        YieldProcessor();
+    }
+
+    VERIFY_IS_TRUE(allMessagesReceived.wait(5000));
+
+    MIDI_PIPE_STATISTICS statistics;
+    MIDI_PIPE_STATISTICS midiOutStatistics;
+    VERIFY_SUCCEEDED(midiPump->GetStatistics(statistics, midiOutStatistics));
+
+    LOG_OUTPUT(L"%llu messages in %llu batches, %llu wake ups, %llu of %llu polls found messages",
+        statistics.MessageCount, statistics.BatchCount, statistics.WakeupCount, statistics.PollHitCount, statistics.PollCount);
+    LOG_OUTPUT(L"midi in high water mark %u of %u bytes, longest wait %llu ticks",
+        statistics.HighWaterMark, statistics.BufferSize, statistics.MaximumConsumerLag);
+    LOG_OUTPUT(L"midi out high water mark %u of %u bytes, %llu sends found the buffer full, %llu retries",
+        midiOutStatistics.HighWaterMark, midiOutStatistics.BufferSize, midiOutStatistics.BufferFullCount, midiOutStatistics.RetryCount);
+
+    VERIFY_ARE_EQUAL(statistics.MessageCount, (ULONGLONG)messagesExpected);
+    VERIFY_ARE_EQUAL(midiOutStatistics.MessageCount, (ULONGLONG)messagesExpected);
+    VERIFY_ARE_EQUAL(midiOutStatistics.ByteCount, statistics.ByteCount);
+    VERIFY_IS_LESS_THAN(statistics.HighWaterMark, statistics.BufferSize);
+    VERIFY_IS_LESS_THAN(midiOutStatistics.HighWaterMark, midiOutStatistics.BufferSize);
+    VERIFY_ARE_EQUAL(midiOutStatistics.TimeoutCount, (ULONGLONG)0);
+    VERIFY_IS_LESS_THAN_OR_EQUAL(statistics.BatchCount, statistics.MessageCount);
+    VERIFY_IS_LESS_THAN_OR_EQUAL(statistics.PollHitCount, statistics.PollCount);
+
+    if (0 == PollingWindowMicroseconds)
+    {
+        VERIFY_ARE_EQUAL(statistics.PollCount, (ULONGLONG)0);
+    }
+    else
+    {
+        // the first burst always needs a wake up, after that polling gets a chance
+        VERIFY_IS_GREATER_THAN(statistics.PollCount, (ULONGLONG)0);
+    }
+
+    // out of range
+    VERIFY_FAILED(midiPump->SetMidiInPollingWindow(MIDI_XPROC_MAXIMUM_POLLING_WINDOW_MICROSECONDS + 1));
+}
+
 bool Midi2ServiceTests::TestSetup()
 {
     m_MidiInCallback = nullptr;
@@ -35,6 +35,8 @@ public:
     TEST_METHOD(TestMidiServiceRPC);
 
     TEST_METHOD(TestMidiServiceClientRPC);
+    TEST_METHOD(TestMidiServiceClientRPCBursts);
+    TEST_METHOD(TestMidiServiceClientRPCPolling);
 
     Midi2ServiceTests()
     {}
@@ -54,6 +56,10 @@ public:
     STDMETHODIMP_(ULONG) Release() { return 1; }
 
 private:
+    // bursts of messages over the client pipes, checking the pipe statistics after.
+    // The midi in worker polls for up to PollingWindowMicroseconds between bursts
+    void TestMidiServiceClientBursts(_In_ DWORD PollingWindowMicroseconds);
+
     std::function<void(PVOID, UINT32, LONGLONG, LONGLONG)> m_MidiInCallback;
 };
 
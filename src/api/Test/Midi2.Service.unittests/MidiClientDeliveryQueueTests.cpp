@@ -0,0 +1,181 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include "MidiDefs.h"
+#include "MidiClientDeliveryQueue.h"
+#include "MidiClientDeliveryQueueTests.h"
+
+// Each test message is one word, holding its sequence number.
+static MidiDeliveryQueueResult PushTestMessage(_In_ CMidiClientDeliveryQueue& queue, _In_ UINT32 sequence)
+{
+    MidiDeliveryQueueResult result{ MidiDeliveryQueueResult::Queued };
+
+    VERIFY_SUCCEEDED(queue.Push(&sequence, sizeof(sequence), sequence, result));
+
+    return result;
+}
+
+// Pops everything left in the queue, and checks it's the messages from first on, in order.
+static void VerifyQueuedMessages(_In_ CMidiClientDeliveryQueue& queue, _In_ UINT32 first, _In_ UINT32 count)
+{
+    MIDI_QUEUED_MESSAGE messages[3]{};
+    UINT32 expected = first;
+    UINT32 popped{ 0 };
+
+    while ((popped = queue.PopFront(messages, _countof(messages))) > 0)
+    {
+        for (UINT32 i = 0; i < popped; i++)
+        {
+            UINT32 word{ 0 };
+            memcpy(&word, messages[i].Data, sizeof(word));
+
+            VERIFY_ARE_EQUAL(messages[i].ByteCount, (UINT32)sizeof(UINT32));
+            VERIFY_ARE_EQUAL(messages[i].Position, (LONGLONG)expected);
+            VERIFY_ARE_EQUAL(word, expected);
+
+            expected++;
+        }
+    }
+
+    VERIFY_ARE_EQUAL(expected, first + count);
+    VERIFY_IS_TRUE(queue.Empty());
+}
+
+void MidiClientDeliveryQueueTests::TestDeliveryQueueInitialize()
+{
+    CMidiClientDeliveryQueue queue;
+
+    // the caller has to resolve the default policy, and the queue needs some room
+    VERIFY_FAILED(queue.Initialize(8, MidiDeliveryOverflowPolicy_Default));
+    VERIFY_FAILED(queue.Initialize(8, (MidiDeliveryOverflowPolicy)(MidiDeliveryOverflowPolicy_StopDelivery + 1)));
+    VERIFY_FAILED(queue.Initialize(0, MidiDeliveryOverflowPolicy_DropOldest));
+
+    VERIFY_SUCCEEDED(queue.Initialize(8, MidiDeliveryOverflowPolicy_DropOldest));
+    VERIFY_ARE_EQUAL(queue.Capacity(), (UINT32)8);
+    VERIFY_IS_TRUE(queue.Empty());
+
+    // too small and too big
+    MidiDeliveryQueueResult result{ MidiDeliveryQueueResult::Queued };
+    BYTE data[MAXIMUM_LOOPED_DATASIZE + 1]{};
+
+    VERIFY_FAILED(queue.Push(data, 0, 0, result));
+    VERIFY_FAILED(queue.Push(data, sizeof(data), 0, result));
+    VERIFY_IS_TRUE(queue.Empty());
+    VERIFY_ARE_EQUAL(queue.QueuedCount(), (ULONGLONG)0);
+}
+
+void MidiClientDeliveryQueueTests::TestDeliveryQueueOrder()
+{
+    CMidiClientDeliveryQueue queue;
+
+    VERIFY_SUCCEEDED(queue.Initialize(5, MidiDeliveryOverflowPolicy_DropNewest));
+
+    UINT32 sequence{ 0 };
+    UINT32 expected{ 0 };
+
+    // keep the queue partly full, so the front and back go round and round it
+    for (UINT32 pass = 0; pass < 100; pass++)
+    {
+        while (queue.Size() < queue.Capacity())
+        {
+            VERIFY_ARE_EQUAL(PushTestMessage(queue, sequence++), MidiDeliveryQueueResult::Queued);
+        }
+
+        MIDI_QUEUED_MESSAGE messages[3]{};
+        UINT32 popped = queue.PopFront(messages, (pass % 3) + 1);
+
+        VERIFY_ARE_EQUAL(popped, (pass % 3) + 1);
+
+        for (UINT32 i = 0; i < popped; i++)
+        {
+            VERIFY_ARE_EQUAL(messages[i].Position, (LONGLONG)expected);
+            expected++;
+        }
+    }
+
+    VerifyQueuedMessages(queue, expected, sequence - expected);
+
+    VERIFY_ARE_EQUAL(queue.QueuedCount(), (ULONGLONG)sequence);
+    VERIFY_ARE_EQUAL(queue.HighWaterMark(), (UINT32)5);
+    VERIFY_ARE_EQUAL(queue.DroppedOldestCount() + queue.DroppedNewestCount() + queue.DeliveryStoppedCount(), (ULONGLONG)0);
+}
+
+void MidiClientDeliveryQueueTests::TestDeliveryQueueDropOldest()
+{
+    CMidiClientDeliveryQueue queue;
+
+    VERIFY_SUCCEEDED(queue.Initialize(4, MidiDeliveryOverflowPolicy_DropOldest));
+
+    for (UINT32 i = 0; i < 4; i++)
+    {
+        VERIFY_ARE_EQUAL(PushTestMessage(queue, i), MidiDeliveryQueueResult::Queued);
+    }
+
+    // each new message pushes the oldest one out
+    for (UINT32 i = 4; i < 10; i++)
+    {
+        VERIFY_ARE_EQUAL(PushTestMessage(queue, i), MidiDeliveryQueueResult::QueuedDroppedOldest);
+    }
+
+    VERIFY_ARE_EQUAL(queue.Size(), (UINT32)4);
+    VERIFY_ARE_EQUAL(queue.DroppedOldestCount(), (ULONGLONG)6);
+    VERIFY_ARE_EQUAL(queue.DroppedNewestCount(), (ULONGLONG)0);
+    VERIFY_ARE_EQUAL(queue.DeliveryStoppedCount(), (ULONGLONG)0);
+    VERIFY_ARE_EQUAL(queue.QueuedCount(), (ULONGLONG)10);
+
+    // so the newest ones are left
+    VerifyQueuedMessages(queue, 6, 4);
+}
+
+void MidiClientDeliveryQueueTests::TestDeliveryQueueDropNewest()
+{
+    CMidiClientDeliveryQueue queue;
+
+    VERIFY_SUCCEEDED(queue.Initialize(4, MidiDeliveryOverflowPolicy_DropNewest));
+
+    for (UINT32 i = 0; i < 4; i++)
+    {
+        VERIFY_ARE_EQUAL(PushTestMessage(queue, i), MidiDeliveryQueueResult::Queued);
+    }
+
+    for (UINT32 i = 4; i < 10; i++)
+    {
+        VERIFY_ARE_EQUAL(PushTestMessage(queue, i), MidiDeliveryQueueResult::DroppedNewest);
+    }
+
+    VERIFY_ARE_EQUAL(queue.Size(), (UINT32)4);
+    VERIFY_ARE_EQUAL(queue.DroppedOldestCount(), (ULONGLONG)0);
+    VERIFY_ARE_EQUAL(queue.DroppedNewestCount(), (ULONGLONG)6);
+    VERIFY_ARE_EQUAL(queue.DeliveryStoppedCount(), (ULONGLONG)0);
+    VERIFY_ARE_EQUAL(queue.QueuedCount(), (ULONGLONG)4);
+
+    // the oldest ones are still there, and there's room again once they've gone
+    VerifyQueuedMessages(queue, 0, 4);
+    VERIFY_ARE_EQUAL(PushTestMessage(queue, 10), MidiDeliveryQueueResult::Queued);
+}
+
+void MidiClientDeliveryQueueTests::TestDeliveryQueueStopDelivery()
+{
+    CMidiClientDeliveryQueue queue;
+
+    VERIFY_SUCCEEDED(queue.Initialize(4, MidiDeliveryOverflowPolicy_StopDelivery));
+
+    for (UINT32 i = 0; i < 4; i++)
+    {
+        VERIFY_ARE_EQUAL(PushTestMessage(queue, i), MidiDeliveryQueueResult::Queued);
+    }
+
+    // the queue leaves it to the owner to stop delivery, and doesn't change anything itself
+    VERIFY_ARE_EQUAL(PushTestMessage(queue, 4), MidiDeliveryQueueResult::Overflowed);
+
+    VERIFY_ARE_EQUAL(queue.Size(), (UINT32)4);
+    VERIFY_ARE_EQUAL(queue.DeliveryStoppedCount(), (ULONGLONG)1);
+    VERIFY_ARE_EQUAL(queue.DroppedOldestCount() + queue.DroppedNewestCount(), (ULONGLONG)0);
+
+    // clearing it isn't counted as dropping anything
+    queue.Clear();
+
+    VERIFY_IS_TRUE(queue.Empty());
+    VERIFY_ARE_EQUAL(queue.DroppedOldestCount() + queue.DroppedNewestCount(), (ULONGLONG)0);
+    VERIFY_ARE_EQUAL(queue.QueuedCount(), (ULONGLONG)4);
+}
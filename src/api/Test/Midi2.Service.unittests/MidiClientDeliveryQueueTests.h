@@ -0,0 +1,24 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiClientDeliveryQueueTests
+    : public WEX::TestClass<MidiClientDeliveryQueueTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiClientDeliveryQueueTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"MidiSrv.exe")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestDeliveryQueueInitialize);
+    TEST_METHOD(TestDeliveryQueueOrder);
+    TEST_METHOD(TestDeliveryQueueDropOldest);
+    TEST_METHOD(TestDeliveryQueueDropNewest);
+    TEST_METHOD(TestDeliveryQueueStopDelivery);
+
+private:
+
+};
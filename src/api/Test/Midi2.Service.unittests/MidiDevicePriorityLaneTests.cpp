@@ -0,0 +1,289 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <thread>
+#include <vector>
+#include <wrl\implements.h>
+#include <wil\tracelogging.h>
+
+#include "MidiDefs.h"
+#include "MidiAbstraction.h"
+#include "ump_helpers.h"
+#include "midi_timestamp.h"
+#include "wstring_util.h"
+
+namespace internal = ::Windows::Devices::Midi2::Internal;
+namespace shared = ::Windows::Devices::Midi2::Internal::Shared;
+
+#include "MidiTelemetry.h"
+#include "MidiDevicePipe.h"
+#include "MidiDevicePriorityLaneTests.h"
+
+#define TEST_CLOCK_WORD 0x10F80000
+#define TEST_NOTE_ON_WORD 0x20904060
+#define TEST_NOTE_OFF_WORD 0x20804060
+
+#define TEST_DEVICE_WAIT_MS 10000
+
+static bool IsPriority(_In_ CMidiDevicePriorityLane& lane, _In_ UINT32 word)
+{
+    return lane.IsPriorityMessage(&word, sizeof(word));
+}
+
+void MidiDevicePriorityLaneTests::TestPriorityMessageClassification()
+{
+    CMidiDevicePriorityLane lane;
+
+    // off until it's given a mask
+    VERIFY_IS_FALSE(IsPriority(lane, TEST_CLOCK_WORD));
+
+    lane.Initialize(MIDI_DEVICE_DEFAULT_PRIORITY_MESSAGE_MASK);
+
+    // system real-time, on any group
+    VERIFY_IS_TRUE(IsPriority(lane, 0x10F80000));
+    VERIFY_IS_TRUE(IsPriority(lane, 0x1BFA0000));
+    VERIFY_IS_TRUE(IsPriority(lane, 0x10FB0000));
+    VERIFY_IS_TRUE(IsPriority(lane, 0x10FC0000));
+    VERIFY_IS_TRUE(IsPriority(lane, 0x10FE0000));
+    VERIFY_IS_TRUE(IsPriority(lane, 0x10FF0000));
+
+    // JR clock, but not JR timestamps, which belong with the next message
+    VERIFY_IS_TRUE(IsPriority(lane, 0x00101234));
+    VERIFY_IS_FALSE(IsPriority(lane, 0x00201234));
+
+    // system common, channel voice, and anything which isn't a single word
+    VERIFY_IS_FALSE(IsPriority(lane, 0x10F21234));
+    VERIFY_IS_FALSE(IsPriority(lane, 0x10F10000));
+    VERIFY_IS_FALSE(IsPriority(lane, 0x20904060));
+    VERIFY_IS_FALSE(IsPriority(lane, 0x40904060));
+
+    UINT32 sysex[2]{ 0x30160000, 0 };
+    VERIFY_IS_FALSE(lane.IsPriorityMessage(sysex, sizeof(sysex)));
+
+    // a mask of our own, with song position
+    lane.Initialize(MIDI_PRIORITY_MESSAGE_SYSTEM(0xF2));
+    VERIFY_IS_TRUE(IsPriority(lane, 0x10F21234));
+    VERIFY_IS_FALSE(IsPriority(lane, TEST_CLOCK_WORD));
+}
+
+void MidiDevicePriorityLaneTests::TestPriorityMessageParking()
+{
+    CMidiDevicePriorityLane lane;
+    wil::critical_section sendLock;
+    std::vector<UINT32> sent;
+
+    lane.Initialize(MIDI_DEVICE_DEFAULT_PRIORITY_MESSAGE_MASK);
+
+    auto sendToDevice = [&](PVOID data, UINT length, LONGLONG)
+        {
+            UINT32 word{ 0 };
+            memcpy(&word, data, sizeof(word));
+            VERIFY_ARE_EQUAL(length, (UINT)sizeof(word));
+
+            sent.push_back(word);
+            return S_OK;
+        };
+
+    UINT32 clock = TEST_CLOCK_WORD;
+
+    // nothing else sending, so it goes straight out
+    VERIFY_SUCCEEDED(lane.Send(sendLock, &clock, sizeof(clock), 0, sendToDevice));
+    VERIFY_ARE_EQUAL(sent.size(), (size_t)1);
+    VERIFY_ARE_EQUAL(lane.ParkedTotal(), (ULONGLONG)0);
+
+    {
+        // someone else is sending, so the message waits for them
+        auto lock = sendLock.lock();
+
+        std::thread sender([&]()
+            {
+                VERIFY_SUCCEEDED(lane.Send(sendLock, &clock, sizeof(clock), 1, sendToDevice));
+            });
+
+        sender.join();
+
+        VERIFY_ARE_EQUAL(sent.size(), (size_t)1);
+        VERIFY_ARE_EQUAL(lane.ParkedTotal(), (ULONGLONG)1);
+
+        // and they send it between two of their messages
+        lane.SendParked(sendToDevice);
+        VERIFY_ARE_EQUAL(sent.size(), (size_t)2);
+    }
+
+    VERIFY_ARE_EQUAL(sent[1], (UINT32)TEST_CLOCK_WORD);
+    VERIFY_ARE_EQUAL(lane.FailedCount(), (ULONGLONG)0);
+}
+
+// A device which keeps the first word of each message it is sent, and can be made to
+// stop part way through, holding the device pipe's send lock, until it is let go.
+class CMidiTestOutDevice :
+    public Microsoft::WRL::RuntimeClass<
+        Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+        IMidiOut>
+{
+public:
+    STDMETHOD(Initialize)(_In_ LPCWSTR, _In_ PABSTRACTIONCREATIONPARAMS, _In_ DWORD*, _In_ GUID) { return S_OK; }
+    STDMETHOD(Cleanup)() { return S_OK; }
+
+    STDMETHOD(SendMidiMessage)(_In_ PVOID Data, _In_ UINT Length, _In_ LONGLONG)
+    {
+        RETURN_HR_IF(E_INVALIDARG, Length < sizeof(UINT32));
+
+        UINT32 word{ 0 };
+        memcpy(&word, Data, sizeof(word));
+
+        size_t index{ 0 };
+
+        {
+            auto lock = m_SentLock.lock();
+
+            index = m_Sent.size();
+            m_Sent.push_back(word);
+        }
+
+        if (index == m_StopAt)
+        {
+            m_Stopped.SetEvent();
+            m_Resume.wait(TEST_DEVICE_WAIT_MS);
+        }
+
+        return S_OK;
+    }
+
+    // the message to stop at, counting from 0
+    void StopAt(_In_ size_t Index) { m_StopAt = Index; }
+    bool WaitUntilStopped() { return m_Stopped.wait(TEST_DEVICE_WAIT_MS); }
+    void Resume() { m_Resume.SetEvent(); }
+
+    std::vector<UINT32> Sent()
+    {
+        auto lock = m_SentLock.lock();
+        return m_Sent;
+    }
+
+private:
+    wil::critical_section m_SentLock;
+    std::vector<UINT32> m_Sent;
+
+    size_t m_StopAt{ SIZE_MAX };
+    wil::unique_event m_Stopped{ wil::EventOptions::ManualReset };
+    wil::unique_event m_Resume{ wil::EventOptions::ManualReset };
+};
+
+static wil::com_ptr_nothrow<CMidiDevicePipe> CreateTestDevicePipe(
+    _In_ CMidiTestOutDevice* Device,
+    _In_ UINT32 PriorityMessageMask
+)
+{
+    MIDISRV_DEVICECREATION_PARAMS creationParams{};
+    creationParams.DataFormat = MidiDataFormat_UMP;
+    creationParams.Flow = MidiFlowOut;
+    creationParams.PriorityMessageMask = PriorityMessageMask;
+
+    wil::com_ptr_nothrow<CMidiDevicePipe> pipe;
+
+    VERIFY_SUCCEEDED(Microsoft::WRL::MakeAndInitialize<CMidiDevicePipe>(&pipe));
+    VERIFY_SUCCEEDED(pipe->Initialize(L"TestDevice", &creationParams, Device));
+
+    return pipe;
+}
+
+void MidiDevicePriorityLaneTests::TestClockSkipsAheadOfSysEx()
+{
+    const UINT32 packetCount = 64;
+    const size_t stopAt = 8;
+
+    auto device = Microsoft::WRL::Make<CMidiTestOutDevice>();
+    VERIFY_IS_NOT_NULL(device.Get());
+
+    auto pipe = CreateTestDevicePipe(device.Get(), MIDI_DEVICE_DEFAULT_PRIORITY_MESSAGE_MASK);
+
+    // one long SysEx7 message, in a single batch, as the scheduler hands it over
+    std::vector<UINT32> sysEx(packetCount * 2);
+    for (UINT32 i = 0; i < packetCount; i++)
+    {
+        sysEx[i * 2] = (i == 0) ? 0x30160000 : (i == packetCount - 1) ? 0x30360000 : 0x30260000;
+        sysEx[i * 2 + 1] = i;
+    }
+
+    device->StopAt(stopAt);
+
+    HRESULT sysExResult{ E_FAIL };
+
+    std::thread sender([&]()
+        {
+            sysExResult = pipe->SendMidiMessageFromSource(sysEx.data(), (UINT)(sysEx.size() * sizeof(UINT32)), 0, 1);
+        });
+
+    // the SysEx has the device, part way through
+    VERIFY_IS_TRUE(device->WaitUntilStopped());
+
+    // so the clock doesn't wait for it, or go out yet. It's parked
+    UINT32 clock = TEST_CLOCK_WORD;
+    VERIFY_SUCCEEDED(pipe->SendMidiMessageFromSource(&clock, sizeof(clock), 0, 2));
+    VERIFY_ARE_EQUAL(device->Sent().size(), stopAt + 1);
+
+    device->Resume();
+    sender.join();
+
+    VERIFY_SUCCEEDED(sysExResult);
+
+    // and it went out right after the packet the device was busy with, ahead of the rest
+    auto sent = device->Sent();
+
+    VERIFY_ARE_EQUAL(sent.size(), (size_t)packetCount + 1);
+    VERIFY_ARE_EQUAL(sent[stopAt + 1], (UINT32)TEST_CLOCK_WORD);
+
+    for (size_t i = 0; i < sent.size(); i++)
+    {
+        if (i != stopAt + 1)
+        {
+            VERIFY_ARE_EQUAL(sent[i], sysEx[(i < stopAt + 1 ? i : i - 1) * 2]);
+        }
+    }
+
+    VERIFY_SUCCEEDED(pipe->Cleanup());
+}
+
+void MidiDevicePriorityLaneTests::TestPriorityMessageSplitFromBatch()
+{
+    UINT32 batch[]{ TEST_NOTE_ON_WORD, TEST_CLOCK_WORD, TEST_NOTE_OFF_WORD };
+
+    {
+        auto device = Microsoft::WRL::Make<CMidiTestOutDevice>();
+        VERIFY_IS_NOT_NULL(device.Get());
+
+        auto pipe = CreateTestDevicePipe(device.Get(), MIDI_DEVICE_DEFAULT_PRIORITY_MESSAGE_MASK);
+
+        VERIFY_SUCCEEDED(pipe->SendMidiMessage(batch, sizeof(batch), 0));
+
+        // the clock goes ahead of the rest of its batch, which stays in order
+        auto sent = device->Sent();
+
+        VERIFY_ARE_EQUAL(sent.size(), (size_t)3);
+        VERIFY_ARE_EQUAL(sent[0], (UINT32)TEST_CLOCK_WORD);
+        VERIFY_ARE_EQUAL(sent[1], (UINT32)TEST_NOTE_ON_WORD);
+        VERIFY_ARE_EQUAL(sent[2], (UINT32)TEST_NOTE_OFF_WORD);
+
+        VERIFY_SUCCEEDED(pipe->Cleanup());
+    }
+
+    {
+        // without the lane, the batch goes out as it came
+        auto device = Microsoft::WRL::Make<CMidiTestOutDevice>();
+        VERIFY_IS_NOT_NULL(device.Get());
+
+        auto pipe = CreateTestDevicePipe(device.Get(), 0);
+
+        VERIFY_SUCCEEDED(pipe->SendMidiMessage(batch, sizeof(batch), 0));
+
+        auto sent = device->Sent();
+
+        VERIFY_ARE_EQUAL(sent.size(), (size_t)3);
+        VERIFY_ARE_EQUAL(sent[0], (UINT32)TEST_NOTE_ON_WORD);
+        VERIFY_ARE_EQUAL(sent[1], (UINT32)TEST_CLOCK_WORD);
+        VERIFY_ARE_EQUAL(sent[2], (UINT32)TEST_NOTE_OFF_WORD);
+
+        VERIFY_SUCCEEDED(pipe->Cleanup());
+    }
+}
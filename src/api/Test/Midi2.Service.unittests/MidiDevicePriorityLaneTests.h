@@ -0,0 +1,23 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiDevicePriorityLaneTests
+    : public WEX::TestClass<MidiDevicePriorityLaneTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiDevicePriorityLaneTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"MidiSrv.exe")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestPriorityMessageClassification);
+    TEST_METHOD(TestPriorityMessageParking);
+    TEST_METHOD(TestClockSkipsAheadOfSysEx);
+    TEST_METHOD(TestPriorityMessageSplitFromBatch);
+
+private:
+
+};
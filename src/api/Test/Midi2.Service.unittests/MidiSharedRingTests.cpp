@@ -0,0 +1,292 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "midi_shared_ring.h"
+#include "MidiSharedRingTests.h"
+
+using namespace Windows::Devices::Midi2::Internal;
+
+struct TestRingMessage
+{
+    int64_t Position{ 0 };
+    void const* Data{ nullptr };
+    uint32_t ByteCount{ 0 };
+};
+
+// The message with this sequence number is 4, 8, 12 or 16 bytes long, and each word
+// holds the sequence number, so the reader can check it got the right bytes.
+static uint32_t FillTestMessage(_In_ uint32_t sequence, _Out_writes_(4) uint32_t* words)
+{
+    uint32_t wordCount = (sequence % 4) + 1;
+
+    for (uint32_t i = 0; i < wordCount; i++)
+    {
+        words[i] = sequence + i;
+    }
+
+    return wordCount * sizeof(uint32_t);
+}
+
+static bool CheckTestMessage(_In_ uint32_t sequence, _In_ int64_t position, _In_ uint8_t const* data, _In_ uint32_t byteCount)
+{
+    uint32_t expected[4]{};
+    uint32_t expectedByteCount = FillTestMessage(sequence, expected);
+
+    return position == (int64_t)sequence &&
+        byteCount == expectedByteCount &&
+        memcmp(data, expected, byteCount) == 0;
+}
+
+// Sends messageCount test messages from one thread to another through a ring of the
+// given size, and checks every one arrives in order with the right contents.
+static void RunSharedRingTransfer(
+    _In_ uint32_t capacity,
+    _In_ uint32_t messageCount,
+    _In_ uint32_t writeBatchSize,
+    _In_ uint32_t readBatchSize,
+    _Out_ double& elapsedSeconds,
+    _Out_ uint64_t& writerPeerReadCount,
+    _Out_ uint64_t& readerPeerReadCount
+)
+{
+    MidiSharedRingRegisters registers;
+    std::vector<uint8_t> buffer(capacity);
+
+    InitializeMidiSharedRingRegisters(registers, capacity);
+
+    MidiSharedRingWriter writer(registers, buffer.data(), capacity);
+    MidiSharedRingReader reader(registers, buffer.data(), capacity);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread producer([&]()
+        {
+            std::vector<uint32_t> words(writeBatchSize * 4);
+            std::vector<TestRingMessage> messages(writeBatchSize);
+
+            uint32_t sequence{ 0 };
+
+            while (sequence < messageCount)
+            {
+                uint32_t batchCount = (std::min)(writeBatchSize, messageCount - sequence);
+
+                for (uint32_t i = 0; i < batchCount; i++)
+                {
+                    messages[i].Position = sequence + i;
+                    messages[i].Data = &words[i * 4];
+                    messages[i].ByteCount = FillTestMessage(sequence + i, &words[i * 4]);
+                }
+
+                uint32_t writtenCount = writer.TryWriteMany(messages.data(), batchCount);
+
+                if (writtenCount == 0)
+                {
+                    // the reader will catch up
+                    std::this_thread::yield();
+                }
+
+                // anything which didn't fit is filled in again next time around
+                sequence += writtenCount;
+            }
+        });
+
+    uint32_t readSequence{ 0 };
+    bool contentMatches{ true };
+
+    while (readSequence < messageCount)
+    {
+        uint32_t readCount = reader.Read(readBatchSize, [&](int64_t position, uint8_t const* data, uint32_t byteCount)
+            {
+                contentMatches = contentMatches && CheckTestMessage(readSequence, position, data, byteCount);
+                readSequence++;
+            });
+
+        if (readCount == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+
+    elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    writerPeerReadCount = writer.PeerReadCount();
+    readerPeerReadCount = reader.PeerReadCount();
+
+    VERIFY_IS_TRUE(contentMatches);
+    VERIFY_ARE_EQUAL(readSequence, messageCount);
+
+    // nothing left over
+    VERIFY_ARE_EQUAL(reader.Read(1, [](int64_t, uint8_t const*, uint32_t) {}), (uint32_t)0);
+    VERIFY_ARE_EQUAL(writer.GetBytesAvailable(), capacity - 1);
+}
+
+void MidiSharedRingTests::TestSharedRingLayout()
+{
+    MidiSharedRingRegisters registers;
+
+    // each register is on its own cache line
+    VERIFY_ARE_EQUAL(sizeof(MidiSharedRingRegisters), (size_t)(4 * MIDI_SHARED_RING_CACHE_LINE_SIZE));
+    VERIFY_ARE_EQUAL((size_t)((uint8_t*)&registers.ReadPosition - (uint8_t*)&registers), (size_t)(1 * MIDI_SHARED_RING_CACHE_LINE_SIZE));
+    VERIFY_ARE_EQUAL((size_t)((uint8_t*)&registers.WritePosition - (uint8_t*)&registers), (size_t)(2 * MIDI_SHARED_RING_CACHE_LINE_SIZE));
+    VERIFY_ARE_EQUAL((size_t)((uint8_t*)&registers.WriterWaiting - (uint8_t*)&registers), (size_t)(3 * MIDI_SHARED_RING_CACHE_LINE_SIZE));
+
+    InitializeMidiSharedRingRegisters(registers, 4096);
+
+    VERIFY_IS_TRUE(IsMidiSharedRingRegistersCompatible(registers, 4096));
+
+    // the other side has to agree on the size of the buffer
+    VERIFY_IS_FALSE(IsMidiSharedRingRegistersCompatible(registers, 8192));
+
+    // and on the layout
+    registers.Header.LayoutVersion = MIDI_SHARED_RING_LAYOUT_VERSION - 1;
+    VERIFY_IS_FALSE(IsMidiSharedRingRegistersCompatible(registers, 4096));
+}
+
+void MidiSharedRingTests::TestSharedRingWrapAround()
+{
+    // an odd size, so messages and headers get split at every possible point
+    const uint32_t capacity = 101;
+
+    MidiSharedRingRegisters registers;
+    std::vector<uint8_t> buffer(capacity);
+
+    InitializeMidiSharedRingRegisters(registers, capacity);
+
+    MidiSharedRingWriter writer(registers, buffer.data(), capacity);
+    MidiSharedRingReader reader(registers, buffer.data(), capacity);
+
+    // one byte is always left empty
+    VERIFY_ARE_EQUAL(writer.GetBytesAvailable(), capacity - 1);
+
+    // too small and too big
+    uint32_t words[5]{};
+    VERIFY_IS_FALSE(writer.TryWrite(0, words, 0));
+    VERIFY_IS_FALSE(writer.TryWrite(0, words, sizeof(words)));
+
+    uint32_t writeSequence{ 0 };
+    uint32_t readSequence{ 0 };
+    bool contentMatches{ true };
+
+    auto check = [&](int64_t position, uint8_t const* data, uint32_t byteCount)
+        {
+            contentMatches = contentMatches && CheckTestMessage(readSequence, position, data, byteCount);
+            readSequence++;
+        };
+
+    for (uint32_t pass = 0; pass < 1000; pass++)
+    {
+        // fill it up
+        for (;;)
+        {
+            uint32_t byteCount = FillTestMessage(writeSequence, words);
+
+            if (!writer.TryWrite(writeSequence, words, byteCount))
+            {
+                break;
+            }
+
+            writeSequence++;
+        }
+
+        VERIFY_IS_GREATER_THAN(writeSequence, readSequence);
+
+        // read back a varying number, so the start position moves around the ring
+        reader.Read((pass % 3) + 1, check);
+    }
+
+    // drain it
+    while (reader.Read(8, check) > 0)
+    {
+    }
+
+    VERIFY_IS_TRUE(contentMatches);
+    VERIFY_ARE_EQUAL(readSequence, writeSequence);
+    VERIFY_ARE_EQUAL(writer.GetBytesAvailable(), capacity - 1);
+}
+
+void MidiSharedRingTests::TestSharedRingWriteMany()
+{
+    const uint32_t capacity = 256;
+
+    MidiSharedRingRegisters registers;
+    std::vector<uint8_t> buffer(capacity);
+
+    InitializeMidiSharedRingRegisters(registers, capacity);
+
+    MidiSharedRingWriter writer(registers, buffer.data(), capacity);
+    MidiSharedRingReader reader(registers, buffer.data(), capacity);
+
+    // 20 bytes each with the header, so 12 of them fit
+    uint32_t words[32]{};
+    TestRingMessage messages[32];
+
+    for (uint32_t i = 0; i < _countof(messages); i++)
+    {
+        words[i] = i;
+        messages[i].Position = i;
+        messages[i].Data = &words[i];
+        messages[i].ByteCount = sizeof(uint32_t);
+    }
+
+    VERIFY_ARE_EQUAL(writer.TryWriteMany(messages, _countof(messages)), (uint32_t)12);
+
+    // all of them were published together
+    VERIFY_ARE_EQUAL(registers.WritePosition.load(), (uint32_t)(12 * (sizeof(MidiSharedRingEntryHeader) + sizeof(uint32_t))));
+
+    uint32_t readCount{ 0 };
+    bool contentMatches{ true };
+
+    VERIFY_ARE_EQUAL(reader.Read(_countof(messages), [&](int64_t position, uint8_t const* data, uint32_t byteCount)
+        {
+            uint32_t word{ 0 };
+            memcpy(&word, data, sizeof(word));
+
+            contentMatches = contentMatches && position == readCount && byteCount == sizeof(uint32_t) && word == readCount;
+            readCount++;
+        }), (uint32_t)12);
+
+    VERIFY_IS_TRUE(contentMatches);
+
+    // and released together
+    VERIFY_ARE_EQUAL(registers.ReadPosition.load(), registers.WritePosition.load());
+
+    // the reader only had to look at the write position once
+    VERIFY_ARE_EQUAL(reader.PeerReadCount(), (uint64_t)1);
+}
+
+void MidiSharedRingTests::TestSharedRingStress()
+{
+    double elapsedSeconds{ 0 };
+    uint64_t writerPeerReadCount{ 0 };
+    uint64_t readerPeerReadCount{ 0 };
+
+    // A small odd sized ring, so the two threads are always running into each other and
+    // wrapping at a different place every time around.
+    RunSharedRingTransfer(509, 2000000, 1, 1, elapsedSeconds, writerPeerReadCount, readerPeerReadCount);
+    RunSharedRingTransfer(509, 2000000, 7, 5, elapsedSeconds, writerPeerReadCount, readerPeerReadCount);
+}
+
+void MidiSharedRingTests::TestSharedRingThroughput()
+{
+    const uint32_t messageCount = 10000000;
+
+    double elapsedSeconds{ 0 };
+    uint64_t writerPeerReadCount{ 0 };
+    uint64_t readerPeerReadCount{ 0 };
+
+    // the size of the ring the service uses, read and written in batches like MidiXProc does
+    RunSharedRingTransfer(0x10000, messageCount, 16, 64, elapsedSeconds, writerPeerReadCount, readerPeerReadCount);
+
+    LOG_OUTPUT(L"%u messages in %.3f seconds, %.0f messages per second", messageCount, elapsedSeconds, messageCount / elapsedSeconds);
+    LOG_OUTPUT(L"Writer read the read position %llu times, reader read the write position %llu times", writerPeerReadCount, readerPeerReadCount);
+
+    // the cached positions mean neither side goes to the other's cache line for every message
+    VERIFY_IS_LESS_THAN(writerPeerReadCount, (uint64_t)messageCount);
+    VERIFY_IS_LESS_THAN(readerPeerReadCount, (uint64_t)messageCount);
+}
@@ -0,0 +1,24 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiSharedRingTests
+    : public WEX::TestClass<MidiSharedRingTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiSharedRingTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"MidiXProc.lib")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestSharedRingLayout);
+    TEST_METHOD(TestSharedRingWrapAround);
+    TEST_METHOD(TestSharedRingWriteMany);
+    TEST_METHOD(TestSharedRingStress);
+    TEST_METHOD(TestSharedRingThroughput);
+
+private:
+
+};
@@ -0,0 +1,97 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include "MidiSubscriptionFilter.h"
+#include "MidiSubscriptionFilterTests.h"
+
+static MIDI_SUBSCRIPTION_FILTER AllMessages()
+{
+    return MIDI_SUBSCRIPTION_FILTER{ MIDI_SUBSCRIPTION_FILTER_ALL, MIDI_SUBSCRIPTION_FILTER_ALL, MIDI_SUBSCRIPTION_FILTER_ALL, TRUE };
+}
+
+void MidiSubscriptionFilterTests::TestSubscriptionFilterSelectsAll()
+{
+    auto filter = AllMessages();
+
+    VERIFY_IS_TRUE(MidiSubscriptionFilterSelectsAll(filter));
+
+    // every message type, on every group and channel
+    for (UINT32 messageType = 0; messageType <= 0xF; messageType++)
+    {
+        for (UINT32 groupAndChannel = 0; groupAndChannel <= 0xF; groupAndChannel++)
+        {
+            UINT32 word = (messageType << 28) | (groupAndChannel << 24) | (groupAndChannel << 16);
+
+            VERIFY_IS_TRUE(MidiSubscriptionFilterMatches(filter, word));
+        }
+    }
+
+    filter.IncludeStreamMessages = FALSE;
+    VERIFY_IS_FALSE(MidiSubscriptionFilterSelectsAll(filter));
+
+    filter = AllMessages();
+    filter.ChannelMask = 0x0001;
+    VERIFY_IS_FALSE(MidiSubscriptionFilterSelectsAll(filter));
+}
+
+void MidiSubscriptionFilterTests::TestSubscriptionFilterGroups()
+{
+    auto filter = AllMessages();
+
+    // groups 2 and 10
+    filter.GroupMask = (1 << 2) | (1 << 10);
+
+    VERIFY_IS_TRUE(MidiSubscriptionFilterMatches(filter, 0x22904060));
+    VERIFY_IS_TRUE(MidiSubscriptionFilterMatches(filter, 0x4A904060));
+    VERIFY_IS_FALSE(MidiSubscriptionFilterMatches(filter, 0x20904060));
+    VERIFY_IS_FALSE(MidiSubscriptionFilterMatches(filter, 0x43904060));
+
+    // system and sysex messages have a group too
+    VERIFY_IS_TRUE(MidiSubscriptionFilterMatches(filter, 0x12F80000));
+    VERIFY_IS_FALSE(MidiSubscriptionFilterMatches(filter, 0x11F80000));
+    VERIFY_IS_TRUE(MidiSubscriptionFilterMatches(filter, 0x3A160000));
+    VERIFY_IS_FALSE(MidiSubscriptionFilterMatches(filter, 0x3B160000));
+
+    // utility messages and stream messages don't
+    VERIFY_IS_TRUE(MidiSubscriptionFilterMatches(filter, 0x00201234));
+    VERIFY_IS_TRUE(MidiSubscriptionFilterMatches(filter, 0xF0010101));
+}
+
+void MidiSubscriptionFilterTests::TestSubscriptionFilterChannels()
+{
+    auto filter = AllMessages();
+
+    // channel 9 only
+    filter.ChannelMask = (1 << 9);
+
+    VERIFY_IS_TRUE(MidiSubscriptionFilterMatches(filter, 0x20994060));
+    VERIFY_IS_FALSE(MidiSubscriptionFilterMatches(filter, 0x20904060));
+    VERIFY_IS_TRUE(MidiSubscriptionFilterMatches(filter, 0x40B90000));
+    VERIFY_IS_FALSE(MidiSubscriptionFilterMatches(filter, 0x40B00000));
+
+    // the third byte of a system message isn't a channel
+    VERIFY_IS_TRUE(MidiSubscriptionFilterMatches(filter, 0x10F80000));
+}
+
+void MidiSubscriptionFilterTests::TestSubscriptionFilterMessageTypes()
+{
+    auto filter = AllMessages();
+
+    // MIDI 2.0 channel voice only, no stream messages
+    filter.MessageTypeMask = (1 << 0x4);
+    filter.IncludeStreamMessages = FALSE;
+
+    VERIFY_IS_TRUE(MidiSubscriptionFilterMatches(filter, 0x40904060));
+    VERIFY_IS_FALSE(MidiSubscriptionFilterMatches(filter, 0x20904060));
+    VERIFY_IS_FALSE(MidiSubscriptionFilterMatches(filter, 0x10F80000));
+    VERIFY_IS_FALSE(MidiSubscriptionFilterMatches(filter, 0x00201234));
+    VERIFY_IS_FALSE(MidiSubscriptionFilterMatches(filter, 0xF0010101));
+
+    // stream messages only follow IncludeStreamMessages, not the type mask
+    filter.IncludeStreamMessages = TRUE;
+    VERIFY_IS_TRUE(MidiSubscriptionFilterMatches(filter, 0xF0010101));
+
+    filter.MessageTypeMask = MIDI_SUBSCRIPTION_FILTER_ALL;
+    filter.IncludeStreamMessages = FALSE;
+    VERIFY_IS_FALSE(MidiSubscriptionFilterMatches(filter, 0xF0010101));
+}
@@ -0,0 +1,23 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiSubscriptionFilterTests
+    : public WEX::TestClass<MidiSubscriptionFilterTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiSubscriptionFilterTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"MidiSrv.exe")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestSubscriptionFilterSelectsAll);
+    TEST_METHOD(TestSubscriptionFilterGroups);
+    TEST_METHOD(TestSubscriptionFilterChannels);
+    TEST_METHOD(TestSubscriptionFilterMessageTypes);
+
+private:
+
+};
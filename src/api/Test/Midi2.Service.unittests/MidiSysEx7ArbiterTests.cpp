@@ -0,0 +1,393 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <vector>
+#include <wrl\implements.h>
+#include <wil\tracelogging.h>
+
+#include "MidiDefs.h"
+#include "MidiAbstraction.h"
+#include "ump_helpers.h"
+#include "midi_timestamp.h"
+#include "wstring_util.h"
+
+namespace internal = ::Windows::Devices::Midi2::Internal;
+namespace shared = ::Windows::Devices::Midi2::Internal::Shared;
+
+#include "MidiTelemetry.h"
+#include "MidiSysEx7Arbiter.h"
+#include "MidiDevicePipe.h"
+#include "MidiTransformPipe.h"
+#include "MidiSysEx7ArbiterTests.h"
+
+#define TEST_CLIENT_A ((MidiClientHandle)0x1000)
+#define TEST_CLIENT_B ((MidiClientHandle)0x2000)
+#define TEST_CLIENT_C ((MidiClientHandle)0x3000)
+
+// a second, in ticks
+#define TEST_TIMEOUT_TICKS 10000000
+
+// SysEx7 packets on a group. The second word holds a tag, so we can tell them apart
+#define SYSEX7_START(group) (0x30160000 | ((group) << 24))
+#define SYSEX7_CONTINUE(group) (0x30260000 | ((group) << 24))
+#define SYSEX7_END(group) (0x30360000 | ((group) << 24))
+#define SYSEX7_EMPTY_END(group) (0x30300000 | ((group) << 24))
+
+// 32 bit messages. The low byte is the tag
+#define NOTE_ON(group) (0x20904000 | ((group) << 24))
+#define TIMING_CLOCK(group) (0x10F80000 | ((group) << 24))
+#define NOOP 0x00000000
+
+struct TestSentMessage
+{
+    UINT32 Word0;
+    UINT32 Tag;
+};
+
+class TestDevice
+{
+public:
+    TestDevice(_In_ UINT32 capacity = 64)
+    {
+        VERIFY_SUCCEEDED(Arbiter.Initialize(capacity, TEST_TIMEOUT_TICKS));
+    }
+
+    auto SendToDevice()
+    {
+        return [&](PVOID data, UINT length, LONGLONG)
+            {
+                UINT32 words[4]{};
+                memcpy(words, data, length);
+
+                Sent.push_back(TestSentMessage{ words[0], length == sizeof(UINT32) ? (words[0] & 0xFF) : words[1] });
+
+                return S_OK;
+            };
+    }
+
+    MidiSysEx7ArbiterResult Send(_In_ MidiClientHandle source, _In_ UINT32 word0, _In_ UINT32 tag, _In_ ULONGLONG now = 0)
+    {
+        UINT32 words[2]{ word0, tag };
+        UINT length = (word0 >> 28) == 0x3 ? sizeof(words) : sizeof(UINT32);
+
+        if (length == sizeof(UINT32))
+        {
+            words[0] = (word0 & 0xFFFFFF00) | (tag & 0xFF);
+        }
+
+        MidiSysEx7ArbiterResult result{ MidiSysEx7ArbiterResult::Dropped };
+
+        VERIFY_SUCCEEDED(Arbiter.Send(source, words, length, (LONGLONG)tag, now, SendToDevice(), result));
+
+        return result;
+    }
+
+    // the tags of everything sent so far, in order
+    std::vector<UINT32> SentTags() const
+    {
+        std::vector<UINT32> tags;
+
+        for (auto const& message : Sent)
+        {
+            tags.push_back(message.Tag);
+        }
+
+        return tags;
+    }
+
+    CMidiSysEx7Arbiter Arbiter;
+    std::vector<TestSentMessage> Sent;
+};
+
+void MidiSysEx7ArbiterTests::TestSysEx7ParksOtherClients()
+{
+    TestDevice device;
+
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_A, SYSEX7_START(0), 1) == MidiSysEx7ArbiterResult::Sent);
+    VERIFY_IS_TRUE(device.Arbiter.IsGroupOwned(0));
+
+    // B has to wait for A, except for timing, and stream messages which have no group
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, NOTE_ON(0), 2) == MidiSysEx7ArbiterResult::Parked);
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, SYSEX7_START(0), 3) == MidiSysEx7ArbiterResult::Parked);
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, TIMING_CLOCK(0), 4) == MidiSysEx7ArbiterResult::Sent);
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, NOOP, 5) == MidiSysEx7ArbiterResult::Sent);
+
+    // A carries on, including with timing of its own
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_A, SYSEX7_CONTINUE(0), 6) == MidiSysEx7ArbiterResult::Sent);
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_A, TIMING_CLOCK(0), 7) == MidiSysEx7ArbiterResult::Sent);
+    VERIFY_IS_TRUE(device.Arbiter.IsGroupOwned(0));
+    VERIFY_ARE_EQUAL(device.Arbiter.ParkedCount(), (UINT32)2);
+
+    // and when it's done, B's messages follow, and B now owns the group
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_A, SYSEX7_END(0), 8) == MidiSysEx7ArbiterResult::Sent);
+
+    std::vector<UINT32> expected{ 1, 4, 5, 6, 7, 8, 2, 3 };
+    VERIFY_IS_TRUE(device.SentTags() == expected);
+
+    VERIFY_ARE_EQUAL(device.Arbiter.ParkedCount(), (UINT32)0);
+    VERIFY_IS_TRUE(device.Arbiter.IsGroupOwned(0));
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_A, NOTE_ON(0), 9) == MidiSysEx7ArbiterResult::Parked);
+
+    VERIFY_ARE_EQUAL(device.Arbiter.ParkedTotal(), (ULONGLONG)3);
+    VERIFY_ARE_EQUAL(device.Arbiter.DroppedCount(), (ULONGLONG)0);
+}
+
+void MidiSysEx7ArbiterTests::TestSysEx7ReleasesInOrder()
+{
+    TestDevice device;
+
+    device.Send(TEST_CLIENT_A, SYSEX7_START(0), 1);
+
+    // B's whole message, and C's note in the middle of it
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, SYSEX7_START(0), 2) == MidiSysEx7ArbiterResult::Parked);
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_C, NOTE_ON(0), 3) == MidiSysEx7ArbiterResult::Parked);
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, SYSEX7_CONTINUE(0), 4) == MidiSysEx7ArbiterResult::Parked);
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, SYSEX7_END(0), 5) == MidiSysEx7ArbiterResult::Parked);
+
+    device.Send(TEST_CLIENT_A, SYSEX7_END(0), 6);
+
+    // C's note waits for B to finish, even though it was parked before the rest of B's message
+    std::vector<UINT32> expected{ 1, 6, 2, 4, 5, 3 };
+    VERIFY_IS_TRUE(device.SentTags() == expected);
+
+    VERIFY_IS_FALSE(device.Arbiter.IsGroupOwned(0));
+    VERIFY_ARE_EQUAL(device.Arbiter.ParkedCount(), (UINT32)0);
+
+    // anything else from the owner ends its SysEx7 too
+    device.Send(TEST_CLIENT_A, SYSEX7_START(0), 7);
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, NOTE_ON(0), 8) == MidiSysEx7ArbiterResult::Parked);
+    device.Send(TEST_CLIENT_A, NOTE_ON(0), 9);
+
+    expected.insert(expected.end(), { 7, 9, 8 });
+    VERIFY_IS_TRUE(device.SentTags() == expected);
+    VERIFY_IS_FALSE(device.Arbiter.IsGroupOwned(0));
+}
+
+void MidiSysEx7ArbiterTests::TestSysEx7GroupsAreIndependent()
+{
+    TestDevice device;
+
+    // two patch dumps at once, on different groups, never wait for each other
+    for (UINT32 i = 0; i < 100; i++)
+    {
+        UINT32 statusA = i == 0 ? SYSEX7_START(0) : (i == 99 ? SYSEX7_END(0) : SYSEX7_CONTINUE(0));
+        UINT32 statusB = i == 0 ? SYSEX7_START(1) : (i == 99 ? SYSEX7_END(1) : SYSEX7_CONTINUE(1));
+
+        VERIFY_IS_TRUE(device.Send(TEST_CLIENT_A, statusA, i * 2) == MidiSysEx7ArbiterResult::Sent);
+        VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, statusB, i * 2 + 1) == MidiSysEx7ArbiterResult::Sent);
+
+        // and a third client playing notes on another group
+        VERIFY_IS_TRUE(device.Send(TEST_CLIENT_C, NOTE_ON(2), 0) == MidiSysEx7ArbiterResult::Sent);
+    }
+
+    VERIFY_ARE_EQUAL(device.Sent.size(), (size_t)300);
+    VERIFY_ARE_EQUAL(device.Arbiter.ParkedTotal(), (ULONGLONG)0);
+    VERIFY_IS_FALSE(device.Arbiter.IsGroupOwned(0));
+    VERIFY_IS_FALSE(device.Arbiter.IsGroupOwned(1));
+}
+
+void MidiSysEx7ArbiterTests::TestSysEx7AbandonedTransfer()
+{
+    TestDevice device;
+    ULONGLONG deadline{ 0 };
+
+    device.Send(TEST_CLIENT_A, SYSEX7_START(3), 1, 100);
+
+    // nobody is waiting, so there's no deadline, however long A takes
+    VERIFY_IS_FALSE(device.Arbiter.GetNextDeadline(deadline));
+    device.Send(TEST_CLIENT_A, SYSEX7_CONTINUE(3), 2, 100 + TEST_TIMEOUT_TICKS * 2);
+
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, NOTE_ON(3), 3, 100 + TEST_TIMEOUT_TICKS * 2) == MidiSysEx7ArbiterResult::Parked);
+
+    // the clock starts from A's last packet
+    VERIFY_IS_TRUE(device.Arbiter.GetNextDeadline(deadline));
+    VERIFY_ARE_EQUAL(deadline, (ULONGLONG)(100 + TEST_TIMEOUT_TICKS * 3));
+
+    device.Arbiter.ExpireAbandoned(deadline - 1, device.SendToDevice());
+    VERIFY_ARE_EQUAL(device.Sent.size(), (size_t)2);
+
+    device.Arbiter.ExpireAbandoned(deadline, device.SendToDevice());
+
+    // A's message is closed off for the device, then B goes
+    VERIFY_ARE_EQUAL(device.Sent.size(), (size_t)4);
+    VERIFY_ARE_EQUAL(device.Sent[2].Word0, (UINT32)SYSEX7_EMPTY_END(3));
+    VERIFY_ARE_EQUAL(device.Sent[3].Tag, (UINT32)3);
+
+    VERIFY_IS_FALSE(device.Arbiter.IsGroupOwned(3));
+    VERIFY_IS_FALSE(device.Arbiter.GetNextDeadline(deadline));
+    VERIFY_ARE_EQUAL(device.Arbiter.AbandonedCount(), (ULONGLONG)1);
+}
+
+void MidiSysEx7ArbiterTests::TestSysEx7RemoveClient()
+{
+    TestDevice device;
+
+    device.Send(TEST_CLIENT_A, SYSEX7_START(0), 1);
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, NOTE_ON(0), 2) == MidiSysEx7ArbiterResult::Parked);
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_C, NOTE_ON(0), 3) == MidiSysEx7ArbiterResult::Parked);
+
+    // B goes away, and its note with it
+    device.Arbiter.RemoveSource(TEST_CLIENT_B, 0, device.SendToDevice());
+    VERIFY_ARE_EQUAL(device.Arbiter.ParkedCount(), (UINT32)1);
+    VERIFY_ARE_EQUAL(device.Sent.size(), (size_t)1);
+
+    // then A goes part way through its message
+    device.Arbiter.RemoveSource(TEST_CLIENT_A, 0, device.SendToDevice());
+
+    VERIFY_ARE_EQUAL(device.Sent.size(), (size_t)3);
+    VERIFY_ARE_EQUAL(device.Sent[1].Word0, (UINT32)SYSEX7_EMPTY_END(0));
+    VERIFY_ARE_EQUAL(device.Sent[2].Tag, (UINT32)3);
+
+    VERIFY_IS_FALSE(device.Arbiter.IsGroupOwned(0));
+    VERIFY_ARE_EQUAL(device.Arbiter.DroppedCount(), (ULONGLONG)1);
+}
+
+void MidiSysEx7ArbiterTests::TestSysEx7ParkedQueueFull()
+{
+    TestDevice device(2);
+
+    device.Send(TEST_CLIENT_A, SYSEX7_START(0), 1);
+
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, NOTE_ON(0), 2) == MidiSysEx7ArbiterResult::Parked);
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, NOTE_ON(0), 3) == MidiSysEx7ArbiterResult::Parked);
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, NOTE_ON(0), 4) == MidiSysEx7ArbiterResult::Dropped);
+
+    // other groups don't need the room
+    VERIFY_IS_TRUE(device.Send(TEST_CLIENT_B, NOTE_ON(1), 5) == MidiSysEx7ArbiterResult::Sent);
+
+    device.Send(TEST_CLIENT_A, SYSEX7_END(0), 6);
+
+    std::vector<UINT32> expected{ 1, 5, 6, 2, 3 };
+    VERIFY_IS_TRUE(device.SentTags() == expected);
+
+    VERIFY_ARE_EQUAL(device.Arbiter.DroppedCount(), (ULONGLONG)1);
+    VERIFY_ARE_EQUAL(device.Arbiter.HighWaterMark(), (UINT32)2);
+}
+
+// Stands in for the UMP to byte stream translator. It passes on each buffer it is
+// given as it is, so the device sees exactly what the translator was asked to translate.
+class CMidiTestTranslator :
+    public Microsoft::WRL::RuntimeClass<
+        Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+        IMidiDataTransform>
+{
+public:
+    STDMETHOD(Initialize)(_In_ LPCWSTR, _In_ PTRANSFORMCREATIONPARAMS, _In_ DWORD*, _In_opt_ IMidiCallback* Callback, _In_ LONGLONG Context, _In_opt_ IUnknown*)
+    {
+        m_Callback = Callback;
+        m_Context = Context;
+
+        return S_OK;
+    }
+
+    STDMETHOD(Cleanup)() { return S_OK; }
+
+    STDMETHOD(SendMidiMessage)(_In_ PVOID Data, _In_ UINT Length, _In_ LONGLONG Position)
+    {
+        return m_Callback->Callback(Data, Length, Position, m_Context);
+    }
+
+private:
+    // the pipe, which owns us
+    IMidiCallback* m_Callback{ nullptr };
+    LONGLONG m_Context{ 0 };
+};
+
+// A byte stream device which keeps the tag of each message it is sent
+class CMidiTestByteStreamDevice :
+    public Microsoft::WRL::RuntimeClass<
+        Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+        IMidiOut>
+{
+public:
+    STDMETHOD(Initialize)(_In_ LPCWSTR, _In_ PABSTRACTIONCREATIONPARAMS, _In_ DWORD*, _In_ GUID) { return S_OK; }
+    STDMETHOD(Cleanup)() { return S_OK; }
+
+    STDMETHOD(SendMidiMessage)(_In_ PVOID Data, _In_ UINT Length, _In_ LONGLONG)
+    {
+        RETURN_HR_IF(E_INVALIDARG, Length < sizeof(UINT32) || Length > sizeof(UINT32) * 4);
+
+        UINT32 words[4]{};
+        memcpy(words, Data, Length);
+
+        SentTags.push_back(Length == sizeof(UINT32) ? (words[0] & 0xFF) : words[1]);
+
+        return S_OK;
+    }
+
+    std::vector<UINT32> SentTags;
+};
+
+void MidiSysEx7ArbiterTests::TestSysEx7ByteStreamDeviceTwoClients()
+{
+    auto device = Microsoft::WRL::Make<CMidiTestByteStreamDevice>();
+    VERIFY_IS_NOT_NULL(device.Get());
+
+    MIDISRV_DEVICECREATION_PARAMS deviceParams{};
+    deviceParams.DataFormat = MidiDataFormat_ByteStream;
+    deviceParams.Flow = MidiFlowOut;
+
+    wil::com_ptr_nothrow<CMidiDevicePipe> devicePipe;
+    VERIFY_SUCCEEDED(Microsoft::WRL::MakeAndInitialize<CMidiDevicePipe>(&devicePipe));
+    VERIFY_SUCCEEDED(devicePipe->Initialize(L"TestDevice", &deviceParams, device.Get()));
+
+    auto translator = Microsoft::WRL::Make<CMidiTestTranslator>();
+    VERIFY_IS_NOT_NULL(translator.Get());
+
+    MIDISRV_TRANSFORMCREATION_PARAMS transformParams{};
+    transformParams.DataFormatIn = MidiDataFormat_UMP;
+    transformParams.DataFormatOut = MidiDataFormat_ByteStream;
+    transformParams.Flow = MidiFlowOut;
+    transformParams.SysEx7TimeoutMs = MIDI_DEVICE_DEFAULT_SYSEX7_TIMEOUT_MS;
+
+    wil::com_ptr_nothrow<CMidiTransformPipe> translatorPipe;
+    VERIFY_SUCCEEDED(Microsoft::WRL::MakeAndInitialize<CMidiTransformPipe>(&translatorPipe));
+    VERIFY_SUCCEEDED(translatorPipe->Initialize(L"TestDevice", &transformParams, translator.Get()));
+
+    wil::com_ptr_nothrow<CMidiPipe> nextPipe = devicePipe.get();
+    VERIFY_SUCCEEDED(translatorPipe->AddConnectedPipe(nextPipe));
+
+    translatorPipe->AddClient(TEST_CLIENT_A);
+    translatorPipe->AddClient(TEST_CLIENT_B);
+
+    // both clients send SysEx7 on group 0. B's arrives as one batch, as the scheduler
+    // sends messages which share a timestamp
+    UINT32 startA[]{ SYSEX7_START(0), 1 };
+    UINT32 continueA[]{ SYSEX7_CONTINUE(0), 2 };
+    UINT32 endA[]{ SYSEX7_END(0), 3 };
+    UINT32 messageB[]{ SYSEX7_START(0), 10, SYSEX7_CONTINUE(0), 11, SYSEX7_END(0), 12 };
+    UINT32 noteB{ NOTE_ON(1) | 13 };
+
+    VERIFY_SUCCEEDED(translatorPipe->SendMidiMessageFromSource(startA, sizeof(startA), 0, TEST_CLIENT_A));
+    VERIFY_SUCCEEDED(translatorPipe->SendMidiMessageFromSource(messageB, sizeof(messageB), 0, TEST_CLIENT_B));
+
+    // another group isn't held up
+    VERIFY_SUCCEEDED(translatorPipe->SendMidiMessageFromSource(&noteB, sizeof(noteB), 0, TEST_CLIENT_B));
+
+    VERIFY_SUCCEEDED(translatorPipe->SendMidiMessageFromSource(continueA, sizeof(continueA), 0, TEST_CLIENT_A));
+
+    std::vector<UINT32> expectedBeforeEnd{ 1, 13, 2 };
+    VERIFY_IS_TRUE(device->SentTags == expectedBeforeEnd);
+
+    // A's end lets B's message through, whole
+    VERIFY_SUCCEEDED(translatorPipe->SendMidiMessageFromSource(endA, sizeof(endA), 0, TEST_CLIENT_A));
+
+    std::vector<UINT32> expected{ 1, 13, 2, 3, 10, 11, 12 };
+    VERIFY_IS_TRUE(device->SentTags == expected);
+
+    // a client which goes part way through doesn't hold up the other
+    device->SentTags.clear();
+
+    VERIFY_SUCCEEDED(translatorPipe->SendMidiMessageFromSource(startA, sizeof(startA), 0, TEST_CLIENT_A));
+    VERIFY_SUCCEEDED(translatorPipe->SendMidiMessageFromSource(messageB, sizeof(messageB), 0, TEST_CLIENT_B));
+
+    translatorPipe->RemoveClient(TEST_CLIENT_A);
+
+    VERIFY_ARE_EQUAL(device->SentTags.size(), (size_t)5);
+    VERIFY_ARE_EQUAL(device->SentTags[0], (UINT32)1);
+    VERIFY_ARE_EQUAL(device->SentTags[2], (UINT32)10);
+    VERIFY_ARE_EQUAL(device->SentTags[4], (UINT32)12);
+
+    VERIFY_SUCCEEDED(translatorPipe->Cleanup());
+    VERIFY_SUCCEEDED(devicePipe->Cleanup());
+}
@@ -0,0 +1,26 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiSysEx7ArbiterTests
+    : public WEX::TestClass<MidiSysEx7ArbiterTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiSysEx7ArbiterTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"MidiSrv.exe")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestSysEx7ParksOtherClients);
+    TEST_METHOD(TestSysEx7ReleasesInOrder);
+    TEST_METHOD(TestSysEx7GroupsAreIndependent);
+    TEST_METHOD(TestSysEx7AbandonedTransfer);
+    TEST_METHOD(TestSysEx7RemoveClient);
+    TEST_METHOD(TestSysEx7ParkedQueueFull);
+    TEST_METHOD(TestSysEx7ByteStreamDeviceTwoClients);
+
+private:
+
+};
@@ -0,0 +1,193 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <random>
+#include <chrono>
+#include <vector>
+
+#include "MidiDefs.h"
+#include "ump_helpers.h"
+#include "bytestreamToUMP.h"
+#include "umpToBytestream.h"
+#include "MidiByteStreamConversionBenchmarks.h"
+
+namespace internal = ::Windows::Devices::Midi2::Internal;
+
+// Runs a dense MIDI 1.0 capture through the AM_MIDI2 byte stream to UMP parser and
+// back again, the same way the BS2UMP and UMP2BS transforms do, and reports MB/s of
+// byte stream in each direction. Nothing here depends on the service, so the numbers
+// are just the parsers.
+
+// Channel voice, system common, real time and SysEx, all with explicit status bytes,
+// so converting to UMP and back gives exactly the same bytes.
+static std::vector<uint8_t> BuildDenseCapture(_In_ size_t minimumByteCount)
+{
+    std::mt19937 random(0x4D494449);
+    std::vector<uint8_t> capture;
+    capture.reserve(minimumByteCount + 128);
+
+    while (capture.size() < minimumByteCount)
+    {
+        uint8_t channel = (uint8_t)(random() % 16);
+        uint8_t data1 = (uint8_t)(random() % 128);
+        uint8_t data2 = (uint8_t)(random() % 128);
+
+        switch (random() % 10)
+        {
+        case 0:
+        case 1:
+            capture.insert(capture.end(), { (uint8_t)(0x90 | channel), data1, data2 });
+            break;
+        case 2:
+        case 3:
+            capture.insert(capture.end(), { (uint8_t)(0x80 | channel), data1, data2 });
+            break;
+        case 4:
+            capture.insert(capture.end(), { (uint8_t)(0xB0 | channel), data1, data2 });
+            break;
+        case 5:
+            capture.insert(capture.end(), { (uint8_t)(0xE0 | channel), data1, data2 });
+            break;
+        case 6:
+            capture.insert(capture.end(), { (uint8_t)(0xC0 | channel), data1 });
+            break;
+        case 7:
+            capture.insert(capture.end(), { (uint8_t)(0xD0 | channel), data1 });
+            break;
+        case 8:
+            capture.push_back(0xF8);
+            break;
+        default:
+        {
+            // dumps are mostly short, with the odd long one
+            size_t length = (random() % 8 == 0) ? 200 + (random() % 300) : 1 + (random() % 24);
+
+            capture.push_back(0xF0);
+            for (size_t i = 0; i < length; i++)
+            {
+                capture.push_back((uint8_t)(random() % 128));
+            }
+            capture.push_back(0xF7);
+            break;
+        }
+        }
+    }
+
+    return capture;
+}
+
+_Use_decl_annotations_
+void MidiByteStreamConversionBenchmarks::BenchmarkThroughput(size_t outputBufferSize)
+{
+    const uint32_t passCount = 10;
+
+    std::vector<uint8_t> capture = BuildDenseCapture(1024 * 1024);
+
+    // UMP is never more than 4 bytes for every byte of MIDI 1.0
+    std::vector<uint32_t> umps(capture.size());
+    std::vector<uint8_t> roundTrip(capture.size() + outputBufferSize);
+
+    std::vector<uint32_t> umpBuffer(outputBufferSize / sizeof(uint32_t));
+    std::vector<uint8_t> byteBuffer(outputBufferSize);
+
+    size_t umpCount{ 0 };
+    size_t roundTripCount{ 0 };
+
+    double toUmpSeconds{ 0 };
+    double toByteStreamSeconds{ 0 };
+
+    for (uint32_t pass = 0; pass < passCount; pass++)
+    {
+        bytestreamToUMP bs2ump;
+        umpToBytestream ump2bs;
+
+        // byte stream to UMP, a buffer at a time like the BS2UMP transform
+        auto start = std::chrono::steady_clock::now();
+
+        umpCount = 0;
+        size_t consumed{ 0 };
+
+        while (consumed < capture.size())
+        {
+            size_t written{ 0 };
+            consumed += bs2ump.bytestreamParse(capture.data() + consumed, capture.size() - consumed, umpBuffer.data(), umpBuffer.size(), written);
+
+            memcpy(umps.data() + umpCount, umpBuffer.data(), written * sizeof(uint32_t));
+            umpCount += written;
+        }
+
+        auto converted = std::chrono::steady_clock::now();
+
+        // and back again, like the UMP2BS transform
+        roundTripCount = 0;
+        consumed = 0;
+
+        while (consumed < umpCount)
+        {
+            size_t written{ 0 };
+            consumed += ump2bs.UMPStreamParse(umps.data() + consumed, umpCount - consumed, byteBuffer.data(), byteBuffer.size(), written);
+
+            if (roundTripCount + written > roundTrip.size()) break;
+
+            memcpy(roundTrip.data() + roundTripCount, byteBuffer.data(), written);
+            roundTripCount += written;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        toUmpSeconds += std::chrono::duration<double>(converted - start).count();
+        toByteStreamSeconds += std::chrono::duration<double>(end - converted).count();
+    }
+
+    VERIFY_ARE_EQUAL(roundTripCount, capture.size());
+    VERIFY_IS_TRUE(memcmp(roundTrip.data(), capture.data(), capture.size()) == 0);
+
+    // the batch calls give the same UMPs as feeding the parser a byte at a time
+    bytestreamToUMP singleByte;
+    std::vector<uint32_t> singleByteUmps;
+    singleByteUmps.reserve(umpCount);
+
+    for (auto b : capture)
+    {
+        singleByte.bytestreamParse(b);
+
+        while (singleByte.availableUMP())
+        {
+            singleByteUmps.push_back(singleByte.readUMP());
+        }
+    }
+
+    VERIFY_ARE_EQUAL(singleByteUmps.size(), umpCount);
+    VERIFY_IS_TRUE(memcmp(singleByteUmps.data(), umps.data(), umpCount * sizeof(uint32_t)) == 0);
+
+    // and every buffer the batch call writes is a UMP batch, which the stages downstream
+    // can walk without finding part of a message
+    bytestreamToUMP batchCheck;
+    size_t checked{ 0 };
+    bool wholeUmps{ true };
+
+    while (checked < capture.size())
+    {
+        size_t written{ 0 };
+        checked += batchCheck.bytestreamParse(capture.data() + checked, capture.size() - checked, umpBuffer.data(), umpBuffer.size(), written);
+
+        uint32_t byteCount = (uint32_t)(written * sizeof(uint32_t));
+        wholeUmps = wholeUmps && internal::ForEachUmpInBatch(umpBuffer.data(), byteCount, [](const uint8_t*, uint32_t) { return true; }) == byteCount;
+    }
+
+    VERIFY_IS_TRUE(wholeUmps);
+
+    double megabytes = (double)capture.size() * passCount / (1024 * 1024);
+
+    LOG_OUTPUT(L"%zu byte output buffer, %zu bytes of MIDI 1.0, %zu UMP words", outputBufferSize, capture.size(), umpCount);
+    LOG_OUTPUT(L"  Byte stream to UMP: %.1f MB/s", megabytes / toUmpSeconds);
+    LOG_OUTPUT(L"  UMP to byte stream: %.1f MB/s", megabytes / toByteStreamSeconds);
+}
+
+void MidiByteStreamConversionBenchmarks::BenchmarkByteStreamConversionThroughput()
+{
+    // the sizes UMP2BS and BS2UMP write into, and a large buffer to show the cost per call
+    BenchmarkThroughput(MAXIMUM_LOOPED_DATASIZE);
+    BenchmarkThroughput(MIDI_UMP_BATCH_MAXIMUM_SIZE);
+    BenchmarkThroughput(4096);
+}
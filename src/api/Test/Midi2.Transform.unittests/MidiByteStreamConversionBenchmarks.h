@@ -0,0 +1,22 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiByteStreamConversionBenchmarks
+    : public WEX::TestClass<MidiByteStreamConversionBenchmarks>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiByteStreamConversionBenchmarks)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Benchmark")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"Midi2.BS2UMPTransform.dll")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"Midi2.UMP2BSTransform.dll")
+    END_TEST_CLASS()
+
+    TEST_METHOD(BenchmarkByteStreamConversionThroughput);
+
+private:
+    void BenchmarkThroughput(_In_ size_t outputBufferSize);
+
+};
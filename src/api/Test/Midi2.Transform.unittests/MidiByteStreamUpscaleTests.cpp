@@ -0,0 +1,219 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <vector>
+#include <wrl\implements.h>
+#include <wil\registry.h>
+
+#include "Midi2BS2UMPTransform.h"
+#include "MidiDefs.h"
+
+#include "bytestreamToUMP.h"
+#include "MidiByteStreamUpscaleTests.h"
+
+// an endpoint which doesn't exist. The transform only uses the id to look up its setting
+#define TEST_UPSCALE_ENDPOINT_ID L"\\\\?\\swd#midisrv#midiu_bs2ump_upscale_test"
+
+// MIDI 1.0 byte streams and the UMP the BS2UMP transform is expected to produce for them
+// when upscaling is turned on for the endpoint. Each entry runs through a
+// parser of its own, so state like bank select and RPN doesn't carry between entries.
+struct UpscaleConformanceCase
+{
+    LPCWSTR Description;
+    std::vector<uint8_t> Input;
+    std::vector<uint32_t> Expected;
+};
+
+static const UpscaleConformanceCase g_UpscaleConformanceCorpus[] =
+{
+    { L"Note On",
+        { 0x90, 0x3C, 0x64 },
+        { 0x40903C00, 0xC9240000 } },
+    { L"Note On with velocity 0 is a Note Off with velocity 0x8000",
+        { 0x91, 0x3C, 0x00 },
+        { 0x40813C00, 0x80000000 } },
+    { L"Note Off",
+        { 0x80, 0x3C, 0x7F },
+        { 0x40803C00, 0xFFFF0000 } },
+    { L"Running status",
+        { 0x90, 0x3C, 0x64, 0x3E, 0x00 },
+        { 0x40903C00, 0xC9240000, 0x40803E00, 0x80000000 } },
+    { L"Real time in the middle of a message",
+        { 0x90, 0x3C, 0xF8, 0x64 },
+        { 0x10F80000, 0x40903C00, 0xC9240000 } },
+    { L"Poly Pressure",
+        { 0xA2, 0x40, 0x20 },
+        { 0x40A24000, 0x40000000 } },
+    { L"Channel Pressure",
+        { 0xD3, 0x7F },
+        { 0x40D30000, 0xFFFFFFFF } },
+    { L"Pitch Bend center",
+        { 0xE0, 0x00, 0x40 },
+        { 0x40E00000, 0x80000000 } },
+    { L"Pitch Bend maximum",
+        { 0xE0, 0x7F, 0x7F },
+        { 0x40E00000, 0xFFFFFFFF } },
+    { L"Pitch Bend LSB comes first",
+        { 0xE0, 0x01, 0x00 },
+        { 0x40E00000, 0x00040000 } },
+    { L"Program Change without Bank Select",
+        { 0xC5, 0x0A },
+        { 0x40C50000, 0x0A000000 } },
+    { L"Program Change with Bank Select",
+        { 0xB0, 0x00, 0x01, 0xB0, 0x20, 0x02, 0xC0, 0x05 },
+        { 0x40C00001, 0x05000102 } },
+    { L"Program Change with only the Bank Select MSB",
+        { 0xB1, 0x00, 0x03, 0xC1, 0x07 },
+        { 0x40C10001, 0x07000300 } },
+    { L"Bank Select is per channel",
+        { 0xB0, 0x00, 0x01, 0xC1, 0x05 },
+        { 0x40C10000, 0x05000000 } },
+    { L"14 bit Controller MSB then LSB",
+        { 0xB0, 0x07, 0x64, 0xB0, 0x27, 0x10 },
+        { 0x40B00700, 0xC9249249, 0x40B00700, 0xC8424212 } },
+    { L"Controller LSB without an MSB is a 7 bit Controller",
+        { 0xB2, 0x28, 0x05 },
+        { 0x40B22800, 0x0A000000 } },
+    { L"7 bit Controller",
+        { 0xB0, 0x40, 0x7F },
+        { 0x40B04000, 0xFFFFFFFF } },
+    { L"RPN with Data Entry MSB then LSB",
+        { 0xB0, 0x65, 0x00, 0xB0, 0x64, 0x00, 0xB0, 0x06, 0x0C, 0xB0, 0x26, 0x20 },
+        { 0x40200000, 0x18000000, 0x40200000, 0x18800000 } },
+    { L"RPN bank and index",
+        { 0xB4, 0x65, 0x01, 0xB4, 0x64, 0x02, 0xB4, 0x06, 0x10 },
+        { 0x40240102, 0x20000000 } },
+    { L"NRPN with Data Entry MSB only",
+        { 0xB0, 0x63, 0x05, 0xB0, 0x62, 0x0A, 0xB0, 0x06, 0x40 },
+        { 0x4030050A, 0x80000000 } },
+    { L"Data Entry after RPN Null is dropped",
+        { 0xB0, 0x65, 0x00, 0xB0, 0x64, 0x00, 0xB0, 0x65, 0x7F, 0xB0, 0x64, 0x7F, 0xB0, 0x06, 0x10 },
+        { } },
+    { L"Data Entry LSB without an MSB is dropped",
+        { 0xB0, 0x65, 0x00, 0xB0, 0x64, 0x01, 0xB0, 0x26, 0x10 },
+        { } },
+    { L"Switching from RPN to NRPN needs both halves of the NRPN",
+        { 0xB0, 0x65, 0x00, 0xB0, 0x64, 0x00, 0xB0, 0x63, 0x01, 0xB0, 0x06, 0x10 },
+        { } },
+    { L"SysEx is unchanged",
+        { 0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7 },
+        { 0x30047E7F, 0x06010000 } },
+};
+
+// Runs the input through the same batch call the transform uses
+static std::vector<uint32_t> UpscaleByteStream(_In_ std::vector<uint8_t> const& input, _In_ bool outputMidi2)
+{
+    bytestreamToUMP parser;
+    parser.outputMIDI2 = outputMidi2;
+
+    std::vector<uint32_t> output;
+    uint32_t words[16];
+    size_t consumed{ 0 };
+
+    do
+    {
+        size_t written{ 0 };
+        consumed += parser.bytestreamParse(input.data() + consumed, input.size() - consumed, words, _countof(words), written);
+        output.insert(output.end(), words, words + written);
+    } while (consumed < input.size());
+
+    return output;
+}
+
+void MidiByteStreamUpscaleTests::TestByteStreamUpscaleConformance()
+{
+    for (auto const& testCase : g_UpscaleConformanceCorpus)
+    {
+        LOG_OUTPUT(L"%s", testCase.Description);
+
+        auto output = UpscaleByteStream(testCase.Input, true);
+
+        VERIFY_ARE_EQUAL(output.size(), testCase.Expected.size());
+
+        for (size_t i = 0; i < output.size(); i++)
+        {
+            VERIFY_ARE_EQUAL(output[i], testCase.Expected[i]);
+        }
+    }
+}
+
+void MidiByteStreamUpscaleTests::TestByteStreamWithoutUpscale()
+{
+    // With the endpoint left at MIDI 1.0, channel voice messages stay as MIDI 1.0 UMP and
+    // nothing is held back for bank select or RPN
+    auto output = UpscaleByteStream({ 0xB0, 0x00, 0x01, 0xC0, 0x05, 0xB0, 0x65, 0x00, 0x90, 0x3C, 0x00 }, false);
+
+    std::vector<uint32_t> expected{ 0x20B00001, 0x20C00500, 0x20B06500, 0x20903C00 };
+
+    VERIFY_ARE_EQUAL(output.size(), expected.size());
+
+    for (size_t i = 0; i < output.size(); i++)
+    {
+        VERIFY_ARE_EQUAL(output[i], expected[i]);
+    }
+}
+
+// Keeps the UMP the transform sends on
+class CMidiTestUmpCallback :
+    public Microsoft::WRL::RuntimeClass<
+        Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+        IMidiCallback>
+{
+public:
+    STDMETHOD(Callback)(_In_ PVOID Data, _In_ UINT Size, _In_ LONGLONG, _In_ LONGLONG)
+    {
+        auto words = (uint32_t*)Data;
+        Received.insert(Received.end(), words, words + Size / sizeof(uint32_t));
+
+        return S_OK;
+    }
+
+    std::vector<uint32_t> Received;
+};
+
+// Creates the transform for the test endpoint the way the service does, and sends it the input
+static std::vector<uint32_t> SendThroughTransform(_In_ std::vector<uint8_t> const& input)
+{
+    wil::com_ptr_nothrow<IMidiTransform> midiTransform;
+    wil::com_ptr_nothrow<IMidiDataTransform> dataTransform;
+
+    VERIFY_SUCCEEDED(CoCreateInstance(__uuidof(Midi2BS2UMPTransform), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&midiTransform)));
+    VERIFY_SUCCEEDED(midiTransform->Activate(__uuidof(IMidiDataTransform), (void**)&dataTransform));
+
+    auto callback = Microsoft::WRL::Make<CMidiTestUmpCallback>();
+
+    TRANSFORMCREATIONPARAMS creationParams{};
+    creationParams.DataFormatIn = MidiDataFormat_ByteStream;
+    creationParams.DataFormatOut = MidiDataFormat_UMP;
+
+    DWORD mmcssTaskId{ 0 };
+
+    VERIFY_SUCCEEDED(dataTransform->Initialize(TEST_UPSCALE_ENDPOINT_ID, &creationParams, &mmcssTaskId, callback.Get(), 0, nullptr));
+    VERIFY_SUCCEEDED(dataTransform->SendMidiMessage((PVOID)input.data(), (UINT)input.size(), 0));
+    VERIFY_SUCCEEDED(dataTransform->Cleanup());
+
+    return callback->Received;
+}
+
+void MidiByteStreamUpscaleTests::TestUpscaleSettingAppliedAtInitialize()
+{
+    // writes to HKLM, so this needs to run elevated
+    std::vector<uint8_t> noteOn{ 0x90, 0x3C, 0x64 };
+    std::vector<uint32_t> midi1{ 0x20903C64 };
+    std::vector<uint32_t> midi2{ 0x40903C00, 0xC9240000 };
+
+    auto removeSetting = wil::scope_exit([&]()
+        {
+            RegDeleteKeyValueW(HKEY_LOCAL_MACHINE, MIDI_BYTESTREAM_UPSCALE_REG_KEY, TEST_UPSCALE_ENDPOINT_ID);
+        });
+
+    // no setting is MIDI 1.0
+    RegDeleteKeyValueW(HKEY_LOCAL_MACHINE, MIDI_BYTESTREAM_UPSCALE_REG_KEY, TEST_UPSCALE_ENDPOINT_ID);
+    VERIFY_IS_TRUE(SendThroughTransform(noteOn) == midi1);
+
+    VERIFY_NO_THROW(wil::reg::set_value_dword(HKEY_LOCAL_MACHINE, MIDI_BYTESTREAM_UPSCALE_REG_KEY, TEST_UPSCALE_ENDPOINT_ID, 1));
+    VERIFY_IS_TRUE(SendThroughTransform(noteOn) == midi2);
+
+    VERIFY_NO_THROW(wil::reg::set_value_dword(HKEY_LOCAL_MACHINE, MIDI_BYTESTREAM_UPSCALE_REG_KEY, TEST_UPSCALE_ENDPOINT_ID, 0));
+    VERIFY_IS_TRUE(SendThroughTransform(noteOn) == midi1);
+}
@@ -0,0 +1,19 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiByteStreamUpscaleTests
+    : public WEX::TestClass<MidiByteStreamUpscaleTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiByteStreamUpscaleTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"Midi2.BS2UMPTransform.dll")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestByteStreamUpscaleConformance);
+    TEST_METHOD(TestByteStreamWithoutUpscale);
+    TEST_METHOD(TestUpscaleSettingAppliedAtInitialize);
+};
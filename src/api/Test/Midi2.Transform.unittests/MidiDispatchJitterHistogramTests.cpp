@@ -0,0 +1,69 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include "MidiDispatchJitterHistogram.h"
+#include "MidiDispatchJitterHistogramTests.h"
+
+void MidiDispatchJitterHistogramTests::TestJitterHistogramBuckets()
+{
+    // 10MHz, so 10 ticks per microsecond
+    const uint64_t frequency = 10000000;
+
+    VERIFY_ARE_EQUAL(MidiDispatchJitterHistogram::BucketIndex(-1, frequency), (uint32_t)0);
+    VERIFY_ARE_EQUAL(MidiDispatchJitterHistogram::BucketIndex(0, frequency), (uint32_t)1);
+    VERIFY_ARE_EQUAL(MidiDispatchJitterHistogram::BucketIndex(9, frequency), (uint32_t)1);
+
+    // 1us
+    VERIFY_ARE_EQUAL(MidiDispatchJitterHistogram::BucketIndex(10, frequency), (uint32_t)2);
+    VERIFY_ARE_EQUAL(MidiDispatchJitterHistogram::BucketIndex(19, frequency), (uint32_t)2);
+
+    // 2us and 3us
+    VERIFY_ARE_EQUAL(MidiDispatchJitterHistogram::BucketIndex(20, frequency), (uint32_t)3);
+    VERIFY_ARE_EQUAL(MidiDispatchJitterHistogram::BucketIndex(39, frequency), (uint32_t)3);
+
+    // 1ms is between 512us and 1024us
+    VERIFY_ARE_EQUAL(MidiDispatchJitterHistogram::BucketIndex(10000, frequency), (uint32_t)11);
+    VERIFY_ARE_EQUAL(MidiDispatchJitterHistogram::BucketUpperBoundMicroseconds(11), (uint64_t)1024);
+
+    // a minute late ends up in the last bucket
+    VERIFY_ARE_EQUAL(MidiDispatchJitterHistogram::BucketIndex(60 * (int64_t)frequency, frequency), MidiDispatchJitterHistogram::BucketCount - 1);
+    VERIFY_ARE_EQUAL(MidiDispatchJitterHistogram::BucketUpperBoundMicroseconds(MidiDispatchJitterHistogram::BucketCount - 1), UINT64_MAX);
+}
+
+void MidiDispatchJitterHistogramTests::TestJitterHistogramTotals()
+{
+    const uint64_t frequency = 10000000;
+
+    MidiDispatchJitterHistogram histogram;
+
+    VERIFY_ARE_EQUAL(histogram.Count(), (uint64_t)0);
+
+    histogram.Record(5, frequency);
+    histogram.Record(-3, frequency);
+    histogram.Record(25, frequency);
+    histogram.Record(25, frequency);
+
+    VERIFY_ARE_EQUAL(histogram.Count(), (uint64_t)4);
+    VERIFY_ARE_EQUAL(histogram.MinimumTicks(), (int64_t)-3);
+    VERIFY_ARE_EQUAL(histogram.MaximumTicks(), (int64_t)25);
+
+    // early dispatches don't count towards the late total
+    VERIFY_ARE_EQUAL(histogram.TotalLateTicks(), (uint64_t)55);
+
+    VERIFY_ARE_EQUAL(histogram.BucketValue(0), (uint64_t)1);
+    VERIFY_ARE_EQUAL(histogram.BucketValue(1), (uint64_t)1);
+    VERIFY_ARE_EQUAL(histogram.BucketValue(3), (uint64_t)2);
+
+    uint64_t bucketTotal{ 0 };
+    for (uint32_t i = 0; i < MidiDispatchJitterHistogram::BucketCount; i++)
+    {
+        bucketTotal += histogram.BucketValue(i);
+    }
+
+    VERIFY_ARE_EQUAL(bucketTotal, histogram.Count());
+
+    histogram.Reset();
+
+    VERIFY_ARE_EQUAL(histogram.Count(), (uint64_t)0);
+    VERIFY_ARE_EQUAL(histogram.BucketValue(3), (uint64_t)0);
+}
@@ -0,0 +1,21 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiDispatchJitterHistogramTests
+    : public WEX::TestClass<MidiDispatchJitterHistogramTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiDispatchJitterHistogramTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"Midi2.SchedulerTransform.dll")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestJitterHistogramBuckets);
+    TEST_METHOD(TestJitterHistogramTotals);
+
+private:
+
+};
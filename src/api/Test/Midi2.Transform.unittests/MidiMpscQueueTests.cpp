@@ -0,0 +1,153 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <thread>
+
+#include "MidiMpscQueue.h"
+#include "MidiMpscQueueTests.h"
+
+struct TestStagedEntry
+{
+    uint32_t ProducerId{ 0 };
+    uint32_t Sequence{ 0 };
+
+    TestStagedEntry() = default;
+
+    TestStagedEntry(_In_ uint32_t producerId, _In_ uint32_t sequence)
+    {
+        ProducerId = producerId;
+        Sequence = sequence;
+    }
+};
+
+void MidiMpscQueueTests::TestMpscQueueSingleProducerOrderAndCapacity()
+{
+    MidiMpscQueue<TestStagedEntry, 8> queue;
+    TestStagedEntry entry;
+
+    VERIFY_IS_TRUE(queue.Empty());
+    VERIFY_IS_FALSE(queue.TryPop(entry));
+
+    // go around the ring a few times to make sure the sequence numbers wrap correctly
+    for (uint32_t lap = 0; lap < 4; lap++)
+    {
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            VERIFY_IS_TRUE(queue.TryPush(lap, i));
+        }
+
+        // full
+        VERIFY_IS_FALSE(queue.TryPush(lap, (uint32_t)8));
+        VERIFY_IS_FALSE(queue.Empty());
+
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            VERIFY_IS_TRUE(queue.TryPop(entry));
+            VERIFY_ARE_EQUAL(entry.ProducerId, lap);
+            VERIFY_ARE_EQUAL(entry.Sequence, i);
+        }
+
+        VERIFY_IS_TRUE(queue.Empty());
+        VERIFY_IS_FALSE(queue.TryPop(entry));
+    }
+}
+
+void MidiMpscQueueTests::TestMpscQueueMultipleProducers()
+{
+    const uint32_t producerCount = 4;
+    const uint32_t entriesPerProducer = 100000;
+
+    MidiMpscQueue<TestStagedEntry, 1024> queue;
+
+    std::vector<std::thread> producers;
+
+    for (uint32_t producerId = 0; producerId < producerCount; producerId++)
+    {
+        producers.emplace_back([&queue, producerId, entriesPerProducer]()
+            {
+                for (uint32_t i = 0; i < entriesPerProducer; i++)
+                {
+                    // the consumer will catch up
+                    while (!queue.TryPush(producerId, i))
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+    }
+
+    std::vector<uint32_t> nextExpectedSequence(producerCount, 0);
+    uint32_t receivedCount{ 0 };
+    TestStagedEntry entry;
+
+    while (receivedCount < producerCount * entriesPerProducer)
+    {
+        if (queue.TryPop(entry))
+        {
+            // each producer's entries must come out in the order it pushed them
+            VERIFY_IS_LESS_THAN(entry.ProducerId, producerCount);
+            VERIFY_ARE_EQUAL(entry.Sequence, nextExpectedSequence[entry.ProducerId]);
+
+            nextExpectedSequence[entry.ProducerId]++;
+            receivedCount++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+
+    VERIFY_IS_TRUE(queue.Empty());
+
+    for (uint32_t producerId = 0; producerId < producerCount; producerId++)
+    {
+        VERIFY_ARE_EQUAL(nextExpectedSequence[producerId], entriesPerProducer);
+    }
+}
+
+void MidiMpscQueueTests::TestMpscQueuePushManyAllOrNothing()
+{
+    MidiMpscQueue<TestStagedEntry, 8> queue;
+    TestStagedEntry entry;
+
+    auto makeEntry = [](uint32_t i) { return TestStagedEntry(1, i); };
+
+    VERIFY_IS_TRUE(queue.TryPushMany(0, makeEntry));
+    VERIFY_IS_TRUE(queue.Empty());
+
+    VERIFY_IS_TRUE(queue.TryPush((uint32_t)0, (uint32_t)0));
+    VERIFY_IS_TRUE(queue.TryPushMany(5, makeEntry));
+
+    // two cells left, so none of these go in
+    VERIFY_IS_FALSE(queue.TryPushMany(3, makeEntry));
+    VERIFY_IS_FALSE(queue.TryPushMany(9, makeEntry));
+
+    VERIFY_IS_TRUE(queue.TryPop(entry));
+    VERIFY_ARE_EQUAL(entry.ProducerId, (uint32_t)0);
+
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        VERIFY_IS_TRUE(queue.TryPop(entry));
+        VERIFY_ARE_EQUAL(entry.ProducerId, (uint32_t)1);
+        VERIFY_ARE_EQUAL(entry.Sequence, i);
+    }
+
+    VERIFY_IS_FALSE(queue.TryPop(entry));
+
+    // wraps around the end of the ring
+    VERIFY_IS_TRUE(queue.TryPushMany(8, makeEntry));
+    VERIFY_IS_FALSE(queue.TryPush((uint32_t)0, (uint32_t)0));
+
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        VERIFY_IS_TRUE(queue.TryPop(entry));
+        VERIFY_ARE_EQUAL(entry.Sequence, i);
+    }
+
+    VERIFY_IS_TRUE(queue.Empty());
+}
@@ -0,0 +1,22 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiMpscQueueTests
+    : public WEX::TestClass<MidiMpscQueueTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiMpscQueueTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"Midi2.SchedulerTransform.dll")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestMpscQueueSingleProducerOrderAndCapacity);
+    TEST_METHOD(TestMpscQueueMultipleProducers);
+    TEST_METHOD(TestMpscQueuePushManyAllOrNothing);
+
+private:
+
+};
@@ -0,0 +1,222 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "MidiScheduledMessageIndex.h"
+#include "MidiScheduledMessageIndexTests.h"
+
+// same shape as MIDI_SCHEDULED_MESSAGE_FILTER
+struct TestScheduledMessageFilter
+{
+    uint16_t GroupMask{ 0xFFFF };
+    uint16_t ChannelMask{ 0xFFFF };
+    uint16_t MessageTypeMask{ 0xFFFF };
+    uint64_t EarliestTimestamp{ 0 };
+    uint64_t LatestTimestamp{ UINT64_MAX };
+};
+
+void MidiScheduledMessageIndexTests::TestScheduledMessageIndexCancelsOnlyMatchingMessages()
+{
+    MidiScheduledMessageIndex<64> index;
+
+    const uint64_t firstSource = 0x1000;
+    const uint64_t secondSource = 0x2000;
+
+    // MIDI 2.0 note on, group 3, channel 5
+    const uint32_t noteOnGroup3Channel5 = 0x43950000;
+    // MIDI 1.0 note on, group 3, channel 6
+    const uint32_t noteOnGroup3Channel6 = 0x23963C7F;
+    // MIDI 2.0 note on, group 4, channel 5
+    const uint32_t noteOnGroup4Channel5 = 0x44950000;
+    // endpoint discovery stream message. No group or channel
+    const uint32_t streamMessage = 0xF0000101;
+
+    std::vector<uint32_t> handles{};
+
+    handles.push_back(index.Add(firstSource, noteOnGroup3Channel5, 100, 0));
+    handles.push_back(index.Add(firstSource, noteOnGroup3Channel6, 100, 1));
+    handles.push_back(index.Add(firstSource, noteOnGroup4Channel5, 100, 2));
+    handles.push_back(index.Add(firstSource, streamMessage, 100, 3));
+    handles.push_back(index.Add(secondSource, noteOnGroup3Channel5, 100, 4));
+
+    VERIFY_ARE_EQUAL(index.Size(), (uint32_t)5);
+
+    std::vector<uint32_t> removed{};
+    auto collect = [&](uint32_t value) { removed.push_back(value); };
+
+    // group 3 only. The stream message has no group, so stays
+    TestScheduledMessageFilter groupFilter{};
+    groupFilter.GroupMask = 1 << 3;
+
+    VERIFY_ARE_EQUAL(index.RemoveMatching(firstSource, groupFilter, collect), (uint32_t)2);
+    std::sort(removed.begin(), removed.end());
+    VERIFY_IS_TRUE(removed == std::vector<uint32_t>({ 0, 1 }));
+
+    // nothing left from the first source in group 3, and the second source is untouched
+    removed.clear();
+    VERIFY_ARE_EQUAL(index.RemoveMatching(firstSource, groupFilter, collect), (uint32_t)0);
+    VERIFY_ARE_EQUAL(index.Size(), (uint32_t)3);
+
+    // a source which has never added anything
+    VERIFY_ARE_EQUAL(index.RemoveMatching(0x3000, TestScheduledMessageFilter{}, collect), (uint32_t)0);
+
+    // MIDI 2.0 channel voice, channel 5, any group
+    TestScheduledMessageFilter channelFilter{};
+    channelFilter.ChannelMask = 1 << 5;
+    channelFilter.MessageTypeMask = 1 << 0x4;
+
+    VERIFY_ARE_EQUAL(index.RemoveMatching(firstSource, channelFilter, collect), (uint32_t)1);
+    VERIFY_IS_TRUE(removed == std::vector<uint32_t>({ 2 }));
+
+    // everything
+    removed.clear();
+    VERIFY_ARE_EQUAL(index.RemoveMatching(firstSource, TestScheduledMessageFilter{}, collect), (uint32_t)1);
+    VERIFY_IS_TRUE(removed == std::vector<uint32_t>({ 3 }));
+
+    // the second source's message is removed the way the scheduler does it after sending
+    index.Remove(handles[4]);
+    VERIFY_ARE_EQUAL(index.Size(), (uint32_t)0);
+
+    removed.clear();
+    VERIFY_ARE_EQUAL(index.RemoveMatching(secondSource, TestScheduledMessageFilter{}, collect), (uint32_t)0);
+}
+
+void MidiScheduledMessageIndexTests::TestScheduledMessageIndexCancelsTimestampRange()
+{
+    MidiScheduledMessageIndex<64> index;
+
+    const uint64_t source = 0x1000;
+    const uint32_t noteOn = 0x40900000;
+
+    // mostly in order, with a few out of order, like a sequencer which sends a late
+    // correction now and then
+    std::vector<uint64_t> timestamps{};
+
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        uint64_t timestamp = (i % 100 == 99) ? (uint64_t)(i - 50) * 10 : (uint64_t)i * 10;
+
+        timestamps.push_back(timestamp);
+        index.Add(source, noteOn, timestamp, i);
+    }
+
+    std::vector<uint32_t> removed{};
+    auto collect = [&](uint32_t value) { removed.push_back(value); };
+
+    // everything from 5000 on
+    TestScheduledMessageFilter laterFilter{};
+    laterFilter.EarliestTimestamp = 5000;
+
+    uint32_t expectedCount = (uint32_t)std::count_if(timestamps.begin(), timestamps.end(), [](uint64_t t) { return t >= 5000; });
+
+    VERIFY_ARE_EQUAL(index.RemoveMatching(source, laterFilter, collect), expectedCount);
+
+    for (auto value : removed)
+    {
+        VERIFY_IS_TRUE(timestamps[value] >= 5000);
+    }
+
+    // a range closed at both ends
+    removed.clear();
+
+    TestScheduledMessageFilter rangeFilter{};
+    rangeFilter.EarliestTimestamp = 1000;
+    rangeFilter.LatestTimestamp = 1990;
+
+    expectedCount = (uint32_t)std::count_if(timestamps.begin(), timestamps.end(), [](uint64_t t) { return t >= 1000 && t <= 1990; });
+
+    VERIFY_ARE_EQUAL(index.RemoveMatching(source, rangeFilter, collect), expectedCount);
+
+    for (auto value : removed)
+    {
+        VERIFY_IS_TRUE(timestamps[value] >= 1000 && timestamps[value] <= 1990);
+    }
+
+    // everything up to 500
+    removed.clear();
+
+    TestScheduledMessageFilter earlierFilter{};
+    earlierFilter.LatestTimestamp = 500;
+
+    expectedCount = (uint32_t)std::count_if(timestamps.begin(), timestamps.end(), [](uint64_t t) { return t <= 500; });
+
+    VERIFY_ARE_EQUAL(index.RemoveMatching(source, earlierFilter, collect), expectedCount);
+
+    // what's left is 510 to 990 and 2000 to 4990
+    expectedCount = (uint32_t)std::count_if(timestamps.begin(), timestamps.end(),
+        [](uint64_t t) { return (t > 500 && t < 1000) || (t > 1990 && t < 5000); });
+
+    VERIFY_ARE_EQUAL(index.Size(), expectedCount);
+
+    removed.clear();
+    VERIFY_ARE_EQUAL(index.RemoveMatching(source, TestScheduledMessageFilter{}, collect), expectedCount);
+    VERIFY_ARE_EQUAL(index.Size(), (uint32_t)0);
+}
+
+void MidiScheduledMessageIndexTests::TestScheduledMessageIndexReleasesSourcesWhenEmpty()
+{
+    MidiScheduledMessageIndex<64> index;
+
+    // a few message types per source, so each one uses more than one bucket
+    const uint32_t firstWords[]{ 0x40900000, 0x20913C7F, 0x43950000, 0xF0000101 };
+
+    std::vector<uint32_t> removed{};
+    auto collect = [&](uint32_t value) { removed.push_back(value); };
+
+    uint32_t bucketCapacity{ 0 };
+
+    // clients coming and going, each sending a handful of messages. Half of them have
+    // their messages sent, and the other half cancel them
+    for (uint64_t source = 1; source <= 10000; source++)
+    {
+        std::vector<uint32_t> handles{};
+
+        for (uint32_t i = 0; i < _countof(firstWords); i++)
+        {
+            handles.push_back(index.Add(source, firstWords[i], source * 10 + i, i));
+        }
+
+        VERIFY_ARE_EQUAL(index.SourceCount(), (uint32_t)1);
+
+        if (source % 2 == 0)
+        {
+            for (auto handle : handles)
+            {
+                index.Remove(handle);
+            }
+        }
+        else
+        {
+            removed.clear();
+            VERIFY_ARE_EQUAL(index.RemoveMatching(source, TestScheduledMessageFilter{}, collect), (uint32_t)_countof(firstWords));
+        }
+
+        VERIFY_ARE_EQUAL(index.SourceCount(), (uint32_t)0);
+        VERIFY_ARE_EQUAL(index.Size(), (uint32_t)0);
+
+        if (source == 1)
+        {
+            bucketCapacity = index.BucketCapacity();
+        }
+        else
+        {
+            // buckets from the sources which have gone are reused
+            VERIFY_ARE_EQUAL(index.BucketCapacity(), bucketCapacity);
+        }
+    }
+
+    // a partial cancel keeps the source, and what's left still cancels
+    index.Add(1, firstWords[0], 100, 0);
+    index.Add(1, firstWords[2], 100, 1);
+
+    TestScheduledMessageFilter groupFilter{};
+    groupFilter.GroupMask = 1 << 3;
+
+    VERIFY_ARE_EQUAL(index.RemoveMatching(1, groupFilter, collect), (uint32_t)1);
+    VERIFY_ARE_EQUAL(index.SourceCount(), (uint32_t)1);
+
+    VERIFY_ARE_EQUAL(index.RemoveMatching(1, TestScheduledMessageFilter{}, collect), (uint32_t)1);
+    VERIFY_ARE_EQUAL(index.SourceCount(), (uint32_t)0);
+}
@@ -0,0 +1,22 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiScheduledMessageIndexTests
+    : public WEX::TestClass<MidiScheduledMessageIndexTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiScheduledMessageIndexTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"Midi2.SchedulerTransform.dll")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestScheduledMessageIndexCancelsOnlyMatchingMessages);
+    TEST_METHOD(TestScheduledMessageIndexCancelsTimestampRange);
+    TEST_METHOD(TestScheduledMessageIndexReleasesSourcesWhenEmpty);
+
+private:
+
+};
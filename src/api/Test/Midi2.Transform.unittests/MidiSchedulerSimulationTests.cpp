@@ -0,0 +1,336 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+#include <wrl\implements.h>
+#include <wil\registry.h>
+
+#include "midi_ump.h"
+#include "midi_timestamp.h"
+
+namespace internal = ::Windows::Devices::Midi2::Internal;
+namespace shared = ::Windows::Devices::Midi2::Internal::Shared;
+
+#include "MidiDefs.h"
+#include "plugin_defs.h"
+#include "ScheduledUmpMessage.h"
+#include "MidiTimingWheel.h"
+#include "MidiSlabPool.h"
+#include "MidiScheduledMessageIndex.h"
+#include "MidiScheduledMessageQueue.h"
+#include "MidiMpscQueue.h"
+#include "MidiDispatchJitterHistogram.h"
+#include "Midi2SchedulerTransform.h"
+#include "Midi2.SchedulerMidiTransform.h"
+#include "MidiSchedulerSimulationTests.h"
+
+// Runs the scheduler transform, worker thread and all, against a simulated clock. The test
+// moves the clock to the next send time, then waits for the worker to send what's due
+// before moving it on again, so every dispatch happens at a known time.
+
+// 10MHz, the usual performance counter frequency
+const uint64_t SimulatedFrequency = 10000000;
+
+// everything comes from the one sequencer
+const uint64_t SimulatedSourceId = 1;
+
+// with no device latency, the worker sends this far ahead of the timestamp
+const uint64_t SimulatedLatencyTicks = MIDI_SCHEDULER_LOCK_AND_SEND_FUNCTION_LATENCY_TICKS;
+
+// how long to wait for the worker before failing the test. Wall clock, not simulated
+const ULONGLONG WorkerTimeoutMilliseconds = 10000;
+
+struct SimulatedDispatch
+{
+    uint64_t Timestamp{ 0 };
+    uint64_t DispatchTimestamp{ 0 };
+    uint32_t Sequence{ 0 };
+};
+
+// Keeps everything the scheduler sends, along with the simulated time it was sent at
+class CMidiSimulationCallback :
+    public Microsoft::WRL::RuntimeClass<
+        Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+        IMidiCallback>
+{
+public:
+    CMidiSimulationCallback(_In_ shared::MidiClockSource& clock) : m_clock(clock)
+    {
+    }
+
+    STDMETHOD(Callback)(_In_ PVOID Data, _In_ UINT Size, _In_ LONGLONG Timestamp, _In_ LONGLONG Context)
+    {
+        // the scheduler passes the source along as the context
+        if (Context != (LONGLONG)SimulatedSourceId || Size % 8 != 0)
+        {
+            MalformedCount++;
+        }
+
+        auto now = m_clock.GetCurrentTimestamp();
+        uint32_t messageCount = Size / 8;
+
+        for (uint32_t i = 0; i < messageCount; i++)
+        {
+            uint32_t words[2]{};
+            memcpy(words, (BYTE*)Data + i * sizeof(words), sizeof(words));
+
+            Dispatched.push_back(SimulatedDispatch{ (uint64_t)Timestamp, now, words[1] });
+        }
+
+        SendCount++;
+        ReceivedCount.fetch_add(messageCount, std::memory_order_release);
+
+        return S_OK;
+    }
+
+    // only read these once the worker has stopped
+    std::vector<SimulatedDispatch> Dispatched;
+    uint32_t SendCount{ 0 };
+    uint32_t MalformedCount{ 0 };
+
+    std::atomic<uint64_t> ReceivedCount{ 0 };
+
+private:
+    shared::MidiClockSource& m_clock;
+};
+
+// Waits for the worker to have sent count messages
+static bool WaitForReceivedCount(_In_ CMidiSimulationCallback* callback, _In_ uint64_t count)
+{
+    auto start = GetTickCount64();
+
+    while (callback->ReceivedCount.load(std::memory_order_acquire) < count)
+    {
+        if (GetTickCount64() - start > WorkerTimeoutMilliseconds)
+        {
+            return false;
+        }
+
+        std::this_thread::yield();
+    }
+
+    return true;
+}
+
+// A sequencer playing 16 channels of sixteenth notes at 120bpm, with a little random
+// timing on each note so some share timestamps and some don't. It schedules a couple
+// of seconds ahead, like a real one would. Returns everything the scheduler sent, in order.
+std::vector<SimulatedDispatch> RunSimulatedSequence(
+    _In_ uint64_t durationSeconds,
+    _In_ bool coalesce,
+    _Out_ uint32_t& sendCount)
+{
+    sendCount = 0;
+
+    // the transform reads this at Initialize. Put back whatever was there before
+    auto previousCoalesce = wil::reg::try_get_value_dword(HKEY_LOCAL_MACHINE, MIDI_ROOT_REG_KEY, MIDI_SCHEDULER_COALESCE_REG_VALUE);
+
+    auto restoreCoalesce = wil::scope_exit([&]()
+        {
+            if (previousCoalesce.has_value())
+            {
+                wil::reg::set_value_dword_nothrow(HKEY_LOCAL_MACHINE, MIDI_ROOT_REG_KEY, MIDI_SCHEDULER_COALESCE_REG_VALUE, previousCoalesce.value());
+            }
+            else
+            {
+                RegDeleteKeyValueW(HKEY_LOCAL_MACHINE, MIDI_ROOT_REG_KEY, MIDI_SCHEDULER_COALESCE_REG_VALUE);
+            }
+        });
+
+    VERIFY_NO_THROW(wil::reg::set_value_dword(HKEY_LOCAL_MACHINE, MIDI_ROOT_REG_KEY, MIDI_SCHEDULER_COALESCE_REG_VALUE, coalesce ? 1 : 0));
+
+    shared::MidiSimulatedClockSource clock(SimulatedFrequency, 0x0000001000000000);
+
+    auto callback = Microsoft::WRL::Make<CMidiSimulationCallback>(clock);
+    auto scheduler = Microsoft::WRL::Make<CMidi2SchedulerMidiTransform>();
+
+    scheduler->SetClockSource(&clock);
+
+    TRANSFORMCREATIONPARAMS creationParams{};
+    creationParams.DataFormatIn = MidiDataFormat_UMP;
+    creationParams.DataFormatOut = MidiDataFormat_UMP;
+
+    DWORD mmcssTaskId{ 0 };
+
+    // no device, so no device latency
+    VERIFY_SUCCEEDED(scheduler->Initialize(nullptr, &creationParams, &mmcssTaskId, callback.Get(), 0, nullptr));
+
+    auto cleanup = wil::scope_exit([&]()
+        {
+            scheduler->Cleanup();
+        });
+
+    std::mt19937_64 random(42);
+
+    // timestamps of everything scheduled but not yet due, earliest first
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> pending;
+    uint64_t dueCount{ 0 };
+
+    const uint64_t stepTicks = SimulatedFrequency / 8;
+    const uint64_t lookAheadTicks = 2 * SimulatedFrequency;
+    const uint64_t startTimestamp = clock.GetCurrentTimestamp() + SimulatedFrequency;
+    const uint64_t endTimestamp = startTimestamp + durationSeconds * SimulatedFrequency;
+
+    uint64_t nextStepTimestamp = startTimestamp;
+    uint32_t sequence{ 0 };
+
+    while (nextStepTimestamp < endTimestamp || !pending.empty())
+    {
+        // schedule the next steps once they come inside the look-ahead window
+        while (nextStepTimestamp < endTimestamp && nextStepTimestamp <= clock.GetCurrentTimestamp() + lookAheadTicks)
+        {
+            for (uint32_t channel = 0; channel < 16; channel++)
+            {
+                // MIDI 2.0 note on, with the sequence number where the velocity goes
+                uint32_t words[2]{ 0x40900000 | (channel << 16) | 0x3C00, ++sequence };
+
+                // most notes are right on the step, the rest are up to 1ms off
+                uint64_t offset = random() % 4 == 0 ? random() % (SimulatedFrequency / 1000) : 0;
+
+                VERIFY_ARE_EQUAL(scheduler->SendMidiMessageFromSource(words, (UINT)sizeof(words), (LONGLONG)(nextStepTimestamp + offset), SimulatedSourceId),
+                    HR_S_MIDI_SENDMSG_SCHEDULED);
+
+                pending.push(nextStepTimestamp + offset);
+            }
+
+            nextStepTimestamp += stepTicks;
+        }
+
+        // move on to when the next message is due, or until the sequencer has more to add
+        uint64_t wakeup = nextStepTimestamp < endTimestamp ? nextStepTimestamp - lookAheadTicks : UINT64_MAX;
+
+        if (!pending.empty())
+        {
+            wakeup = (std::min)(wakeup, pending.top() - SimulatedLatencyTicks);
+        }
+
+        clock.SetCurrentTimestamp(wakeup);
+
+        while (!pending.empty() && pending.top() <= clock.GetCurrentTimestamp() + SimulatedLatencyTicks)
+        {
+            pending.pop();
+            dueCount++;
+        }
+
+        // the clock doesn't move again until the worker has sent everything due
+        if (!WaitForReceivedCount(callback.Get(), dueCount))
+        {
+            VERIFY_FAIL(L"Scheduler did not send due messages");
+            break;
+        }
+    }
+
+    // stop the worker before we read what it sent
+    cleanup.reset();
+
+    VERIFY_ARE_EQUAL(callback->MalformedCount, (uint32_t)0);
+    VERIFY_ARE_EQUAL(callback->ReceivedCount.load(), dueCount);
+
+    sendCount = callback->SendCount;
+
+    return callback->Dispatched;
+}
+
+void MidiSchedulerSimulationTests::TestSimulatedHourDispatchesInOrder()
+{
+    // writes to HKLM, so this needs to run elevated
+    uint32_t sendCount{ 0 };
+
+    auto dispatched = RunSimulatedSequence(3600, false, sendCount);
+
+    // 16 channels, 8 steps a second, for an hour
+    VERIFY_ARE_EQUAL(dispatched.size(), (size_t)(16 * 8 * 3600));
+    VERIFY_ARE_EQUAL(sendCount, (uint32_t)dispatched.size());
+
+    for (size_t i = 0; i < dispatched.size(); i++)
+    {
+        // sent exactly the latency ahead of its timestamp, to the tick
+        VERIFY_ARE_EQUAL(dispatched[i].DispatchTimestamp + SimulatedLatencyTicks, dispatched[i].Timestamp);
+
+        if (i > 0)
+        {
+            // in timestamp order, and in the order they were added for equal timestamps
+            VERIFY_IS_LESS_THAN_OR_EQUAL(dispatched[i - 1].Timestamp, dispatched[i].Timestamp);
+
+            if (dispatched[i - 1].Timestamp == dispatched[i].Timestamp)
+            {
+                VERIFY_IS_LESS_THAN(dispatched[i - 1].Sequence, dispatched[i].Sequence);
+            }
+        }
+    }
+
+    // the clock only moves when we move it, so a second run is exactly the same
+    uint32_t secondSendCount{ 0 };
+
+    auto secondRun = RunSimulatedSequence(3600, false, secondSendCount);
+
+    VERIFY_ARE_EQUAL(secondRun.size(), dispatched.size());
+
+    for (size_t i = 0; i < dispatched.size(); i++)
+    {
+        VERIFY_ARE_EQUAL(secondRun[i].Timestamp, dispatched[i].Timestamp);
+        VERIFY_ARE_EQUAL(secondRun[i].DispatchTimestamp, dispatched[i].DispatchTimestamp);
+        VERIFY_ARE_EQUAL(secondRun[i].Sequence, dispatched[i].Sequence);
+    }
+}
+
+void MidiSchedulerSimulationTests::TestSimulatedChordsAreCoalesced()
+{
+    // writes to HKLM, so this needs to run elevated
+    uint32_t separateSendCount{ 0 };
+    uint32_t coalescedSendCount{ 0 };
+
+    auto separate = RunSimulatedSequence(60, false, separateSendCount);
+    auto coalesced = RunSimulatedSequence(60, true, coalescedSendCount);
+
+    // same messages in the same order, in fewer sends
+    VERIFY_ARE_EQUAL(coalesced.size(), separate.size());
+
+    uint32_t distinctTimestamps{ 0 };
+
+    for (size_t i = 0; i < separate.size(); i++)
+    {
+        VERIFY_ARE_EQUAL(coalesced[i].Timestamp, separate[i].Timestamp);
+        VERIFY_ARE_EQUAL(coalesced[i].Sequence, separate[i].Sequence);
+
+        if (i == 0 || separate[i].Timestamp != separate[i - 1].Timestamp)
+        {
+            distinctTimestamps++;
+        }
+    }
+
+    VERIFY_ARE_EQUAL(separateSendCount, (uint32_t)separate.size());
+    VERIFY_ARE_EQUAL(coalescedSendCount, distinctTimestamps);
+    VERIFY_IS_LESS_THAN(coalescedSendCount, separateSendCount);
+}
+
+void MidiSchedulerSimulationTests::TestMidiTimestampFollowsClockSource()
+{
+    shared::MidiSimulatedClockSource clock(SimulatedFrequency, 1234);
+
+    shared::SetMidiClockSource(&clock);
+
+    auto restoreClock = wil::scope_exit([&]()
+        {
+            shared::SetMidiClockSource(nullptr);
+        });
+
+    VERIFY_ARE_EQUAL(shared::GetCurrentMidiTimestamp(), (uint64_t)1234);
+    VERIFY_ARE_EQUAL(shared::GetMidiTimestampFrequency(), SimulatedFrequency);
+
+    clock.Advance(100);
+
+    VERIFY_ARE_EQUAL(shared::GetCurrentMidiTimestamp(), (uint64_t)1334);
+
+    // and back to the performance counter
+    restoreClock.reset();
+
+    VERIFY_ARE_EQUAL(&shared::GetMidiClockSource(), (shared::MidiClockSource*)&shared::MidiSystemClockSource::Instance());
+    VERIFY_ARE_EQUAL(shared::GetMidiTimestampFrequency(), shared::QueryMidiPerformanceFrequency());
+}
@@ -0,0 +1,22 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiSchedulerSimulationTests
+    : public WEX::TestClass<MidiSchedulerSimulationTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiSchedulerSimulationTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"Midi2.SchedulerTransform.dll")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestSimulatedHourDispatchesInOrder);
+    TEST_METHOD(TestSimulatedChordsAreCoalesced);
+    TEST_METHOD(TestMidiTimestampFollowsClockSource);
+
+private:
+
+};
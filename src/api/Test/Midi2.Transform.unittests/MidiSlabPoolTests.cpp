@@ -0,0 +1,94 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <vector>
+
+#include "MidiSlabPool.h"
+#include "MidiSlabPoolTests.h"
+
+struct TestPooledPayload
+{
+    uint32_t Value{ 0 };
+
+    TestPooledPayload() = default;
+
+    TestPooledPayload(_In_ uint32_t value)
+    {
+        Value = value;
+    }
+};
+
+void MidiSlabPoolTests::TestSlabPoolAllocateAndFree()
+{
+    MidiSlabPool<TestPooledPayload, 4> pool;
+
+    VERIFY_ARE_EQUAL(pool.Capacity(), (uint32_t)0);
+    VERIFY_ARE_EQUAL(pool.Size(), (uint32_t)0);
+
+    // spans more than one chunk
+    std::vector<uint32_t> slots{};
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        slots.push_back(pool.Allocate(i));
+    }
+
+    VERIFY_ARE_EQUAL(pool.Size(), (uint32_t)10);
+    VERIFY_ARE_EQUAL(pool.Capacity(), (uint32_t)12);
+
+    // entries in earlier chunks don't move when a chunk is added
+    TestPooledPayload* first = &pool.Get(slots[0]);
+
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        VERIFY_ARE_EQUAL(pool.Get(slots[i]).Value, i);
+    }
+
+    pool.Free(slots[3]);
+    VERIFY_ARE_EQUAL(pool.Size(), (uint32_t)9);
+
+    // most recently freed is reused first
+    uint32_t reused = pool.Allocate((uint32_t)100);
+    VERIFY_ARE_EQUAL(reused, slots[3]);
+    VERIFY_ARE_EQUAL(pool.Get(reused).Value, (uint32_t)100);
+
+    VERIFY_ARE_EQUAL(first, &pool.Get(slots[0]));
+    VERIFY_ARE_EQUAL(pool.Get(slots[0]).Value, (uint32_t)0);
+
+    pool.Clear();
+
+    VERIFY_ARE_EQUAL(pool.Capacity(), (uint32_t)0);
+    VERIFY_ARE_EQUAL(pool.Size(), (uint32_t)0);
+}
+
+void MidiSlabPoolTests::TestSlabPoolNoGrowthAfterWarmUp()
+{
+    MidiSlabPool<TestPooledPayload, 64> pool;
+
+    pool.Reserve(1000);
+
+    uint32_t capacity = pool.Capacity();
+    VERIFY_IS_TRUE(capacity >= 1000);
+
+    // churn well past the reserved count, never holding more than it at once
+    std::vector<uint32_t> slots{};
+    slots.reserve(1000);
+
+    for (uint32_t round = 0; round < 50; round++)
+    {
+        for (uint32_t i = 0; i < 1000; i++)
+        {
+            slots.push_back(pool.Allocate(round * 1000 + i));
+        }
+
+        for (uint32_t i = 0; i < 1000; i++)
+        {
+            VERIFY_ARE_EQUAL(pool.Get(slots[i]).Value, round * 1000 + i);
+            pool.Free(slots[i]);
+        }
+
+        slots.clear();
+    }
+
+    VERIFY_ARE_EQUAL(pool.Capacity(), capacity);
+    VERIFY_ARE_EQUAL(pool.Size(), (uint32_t)0);
+}
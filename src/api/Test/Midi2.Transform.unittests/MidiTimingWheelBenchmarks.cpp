@@ -0,0 +1,112 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <random>
+#include <chrono>
+#include <queue>
+
+#include "MidiTimingWheel.h"
+#include "MidiTimingWheelTests.h"
+#include "MidiTimingWheelBenchmarks.h"
+
+// Compares per-message enqueue and dequeue cost of the scheduler's timing wheel
+// against the std::priority_queue it replaced, at increasing queue depths. The
+// timing wheel numbers should stay roughly flat across all depths.
+
+_Use_decl_annotations_
+void MidiTimingWheelBenchmarks::BenchmarkQueueDepth(uint32_t messageCount)
+{
+    std::mt19937_64 random(messageCount);
+
+    // one second of 10MHz ticks, starting at a realistic QPC value
+    const uint64_t baseTimestamp = 0x000000E8D4A51000;
+    const uint64_t timestampSpread = 10000000;
+
+    std::vector<uint64_t> timestamps;
+    timestamps.reserve(messageCount);
+
+    for (uint32_t i = 0; i < messageCount; i++)
+    {
+        timestamps.push_back(baseTimestamp + (random() % timestampSpread));
+    }
+
+    // timing wheel
+
+    MidiTimingWheel<TestScheduledEntry> wheel;
+    wheel.Reserve(messageCount);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < messageCount; i++)
+    {
+        wheel.Emplace(timestamps[i], (uint64_t)i);
+    }
+
+    auto enqueued = std::chrono::steady_clock::now();
+
+    uint32_t dequeuedCount{ 0 };
+    uint64_t lastTimestamp{ 0 };
+
+    while (auto entry = wheel.PeekDue(baseTimestamp + timestampSpread))
+    {
+        if (entry->Timestamp < lastTimestamp) break;
+        lastTimestamp = entry->Timestamp;
+
+        wheel.Pop();
+        dequeuedCount++;
+    }
+
+    auto dequeued = std::chrono::steady_clock::now();
+
+    VERIFY_ARE_EQUAL(dequeuedCount, messageCount);
+
+    double wheelEnqueueNs = std::chrono::duration<double, std::nano>(enqueued - start).count() / messageCount;
+    double wheelDequeueNs = std::chrono::duration<double, std::nano>(dequeued - enqueued).count() / messageCount;
+
+    // previous implementation, for comparison
+
+    auto compare = [](TestScheduledEntry const& left, TestScheduledEntry const& right)
+        {
+            if (left.Timestamp == right.Timestamp)
+            {
+                return left.ReceivedIndex > right.ReceivedIndex;
+            }
+            else
+            {
+                return left.Timestamp > right.Timestamp;
+            }
+        };
+
+    std::priority_queue<TestScheduledEntry, std::deque<TestScheduledEntry>, decltype(compare)> priorityQueue(compare);
+
+    start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < messageCount; i++)
+    {
+        priorityQueue.emplace(timestamps[i], (uint64_t)i);
+    }
+
+    enqueued = std::chrono::steady_clock::now();
+
+    while (!priorityQueue.empty())
+    {
+        priorityQueue.pop();
+    }
+
+    dequeued = std::chrono::steady_clock::now();
+
+    double heapEnqueueNs = std::chrono::duration<double, std::nano>(enqueued - start).count() / messageCount;
+    double heapDequeueNs = std::chrono::duration<double, std::nano>(dequeued - enqueued).count() / messageCount;
+
+    LOG_OUTPUT(L"%u queued messages", messageCount);
+    LOG_OUTPUT(L"  Timing wheel:   enqueue %.1f ns/msg, dequeue %.1f ns/msg", wheelEnqueueNs, wheelDequeueNs);
+    LOG_OUTPUT(L"  Priority queue: enqueue %.1f ns/msg, dequeue %.1f ns/msg", heapEnqueueNs, heapDequeueNs);
+}
+
+void MidiTimingWheelBenchmarks::BenchmarkTimingWheelQueueDepth()
+{
+    for (uint32_t messageCount = 10; messageCount <= 1000000; messageCount *= 10)
+    {
+        BenchmarkQueueDepth(messageCount);
+    }
+}
@@ -0,0 +1,21 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiTimingWheelBenchmarks
+    : public WEX::TestClass<MidiTimingWheelBenchmarks>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiTimingWheelBenchmarks)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Benchmark")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"Midi2.SchedulerTransform.dll")
+    END_TEST_CLASS()
+
+    TEST_METHOD(BenchmarkTimingWheelQueueDepth);
+
+private:
+    void BenchmarkQueueDepth(_In_ uint32_t messageCount);
+
+};
@@ -0,0 +1,310 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <random>
+#include <algorithm>
+
+#include "MidiTimingWheel.h"
+#include "MidiTimingWheelTests.h"
+
+void MidiTimingWheelTests::TestTimingWheelOrdersByTimestamp()
+{
+    MidiTimingWheel<TestScheduledEntry> wheel;
+    std::vector<TestScheduledEntry> expected;
+
+    std::mt19937_64 random(42);
+
+    // spread the timestamps over roughly 10 seconds of 10MHz ticks, so entries
+    // start out on several different levels of the wheel
+    const uint64_t baseTimestamp = 0x0000001234500000;
+
+    for (uint64_t i = 1; i <= 10000; i++)
+    {
+        uint64_t timestamp = baseTimestamp + (random() % 100000000);
+
+        wheel.Emplace(timestamp, i);
+        expected.emplace_back(timestamp, i);
+    }
+
+    std::stable_sort(expected.begin(), expected.end(),
+        [](TestScheduledEntry const& left, TestScheduledEntry const& right) { return left.Timestamp < right.Timestamp; });
+
+    VERIFY_ARE_EQUAL(wheel.Size(), expected.size());
+
+    for (auto const& expectedEntry : expected)
+    {
+        auto entry = wheel.PeekDue(UINT64_MAX);
+
+        VERIFY_IS_NOT_NULL(entry);
+        VERIFY_ARE_EQUAL(entry->Timestamp, expectedEntry.Timestamp);
+        VERIFY_ARE_EQUAL(entry->ReceivedIndex, expectedEntry.ReceivedIndex);
+
+        wheel.Pop();
+    }
+
+    VERIFY_IS_TRUE(wheel.Empty());
+    VERIFY_IS_NULL(wheel.PeekDue(UINT64_MAX));
+}
+
+void MidiTimingWheelTests::TestTimingWheelPreservesReceivedOrderForDuplicateTimestamps()
+{
+    MidiTimingWheel<TestScheduledEntry> wheel;
+
+    // two timestamps in different upper-level slots, added interleaved, with a
+    // partial drain in between so some entries are added after the wheel has moved
+    const uint64_t firstTimestamp = 0x0000000100000000;
+    const uint64_t secondTimestamp = 0x0000000100FF0000;
+
+    uint64_t receivedIndex = 0;
+
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        wheel.Emplace(secondTimestamp, ++receivedIndex);
+        wheel.Emplace(firstTimestamp, ++receivedIndex);
+    }
+
+    uint64_t lastReceivedIndex = 0;
+
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        auto entry = wheel.PeekDue(firstTimestamp);
+
+        VERIFY_IS_NOT_NULL(entry);
+        VERIFY_ARE_EQUAL(entry->Timestamp, firstTimestamp);
+        VERIFY_IS_GREATER_THAN(entry->ReceivedIndex, lastReceivedIndex);
+
+        lastReceivedIndex = entry->ReceivedIndex;
+        wheel.Pop();
+    }
+
+    VERIFY_IS_NULL(wheel.PeekDue(firstTimestamp));
+
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        wheel.Emplace(secondTimestamp, ++receivedIndex);
+    }
+
+    lastReceivedIndex = 0;
+
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        auto entry = wheel.PeekDue(secondTimestamp);
+
+        VERIFY_IS_NOT_NULL(entry);
+        VERIFY_ARE_EQUAL(entry->Timestamp, secondTimestamp);
+        VERIFY_IS_GREATER_THAN(entry->ReceivedIndex, lastReceivedIndex);
+
+        lastReceivedIndex = entry->ReceivedIndex;
+        wheel.Pop();
+    }
+
+    VERIFY_IS_TRUE(wheel.Empty());
+}
+
+void MidiTimingWheelTests::TestTimingWheelOnlyReturnsDueEntries()
+{
+    MidiTimingWheel<TestScheduledEntry> wheel;
+
+    const uint64_t timestamp = 0x0000000012345678;
+
+    wheel.Emplace(timestamp, (uint64_t)1);
+
+    uint64_t nextTimestamp{ 0 };
+
+    // the next timestamp is a lower bound until the entry reaches the bottom level
+    VERIFY_IS_TRUE(wheel.GetNextTimestamp(nextTimestamp));
+    VERIFY_IS_LESS_THAN_OR_EQUAL(nextTimestamp, timestamp);
+
+    VERIFY_IS_NULL(wheel.PeekDue(timestamp - 1));
+    VERIFY_ARE_EQUAL(wheel.Size(), (size_t)1);
+
+    // after advancing as far as we're allowed, the next timestamp is exact
+    VERIFY_IS_TRUE(wheel.GetNextTimestamp(nextTimestamp));
+    VERIFY_ARE_EQUAL(nextTimestamp, timestamp);
+
+    auto entry = wheel.PeekDue(timestamp);
+    VERIFY_IS_NOT_NULL(entry);
+    VERIFY_ARE_EQUAL(entry->Timestamp, timestamp);
+
+    wheel.Pop();
+
+    VERIFY_IS_TRUE(wheel.Empty());
+    VERIFY_IS_FALSE(wheel.GetNextTimestamp(nextTimestamp));
+}
+
+void MidiTimingWheelTests::TestTimingWheelReturnsOverdueEntriesFirst()
+{
+    MidiTimingWheel<TestScheduledEntry> wheel;
+
+    const uint64_t futureTimestamp = 0x0000000200000000;
+    const uint64_t wheelTimestamp = 0x0000000100000000;
+
+    wheel.Emplace(wheelTimestamp, (uint64_t)1);
+    wheel.Emplace(futureTimestamp, (uint64_t)2);
+
+    // moves the wheel's current time forward to wheelTimestamp
+    auto entry = wheel.PeekDue(wheelTimestamp);
+    VERIFY_IS_NOT_NULL(entry);
+    VERIFY_ARE_EQUAL(entry->ReceivedIndex, (uint64_t)1);
+    wheel.Pop();
+
+    // this is now behind the wheel, so it's already due
+    wheel.Emplace(wheelTimestamp - 100, (uint64_t)3);
+
+    entry = wheel.PeekDue(wheelTimestamp);
+    VERIFY_IS_NOT_NULL(entry);
+    VERIFY_ARE_EQUAL(entry->ReceivedIndex, (uint64_t)3);
+    wheel.Pop();
+
+    VERIFY_IS_NULL(wheel.PeekDue(wheelTimestamp));
+
+    entry = wheel.PeekDue(futureTimestamp);
+    VERIFY_IS_NOT_NULL(entry);
+    VERIFY_ARE_EQUAL(entry->ReceivedIndex, (uint64_t)2);
+    wheel.Pop();
+
+    VERIFY_IS_TRUE(wheel.Empty());
+}
+
+void MidiTimingWheelTests::TestTimingWheelRemovesByHandle()
+{
+    MidiTimingWheel<TestScheduledEntry> wheel;
+    std::vector<TestScheduledEntry> expected;
+    std::vector<std::pair<uint32_t, TestScheduledEntry>> added;
+
+    std::mt19937_64 random(7);
+
+    const uint64_t baseTimestamp = 0x0000001234500000;
+    uint64_t receivedIndex = 0;
+
+    for (uint32_t i = 0; i < 5000; i++)
+    {
+        uint64_t timestamp = baseTimestamp + (random() % 100000000);
+        receivedIndex++;
+
+        added.emplace_back(wheel.Emplace(timestamp, receivedIndex), TestScheduledEntry(timestamp, receivedIndex));
+    }
+
+    // move the wheel part of the way through, so some entries have been cascaded
+    // and the ones added next are overdue
+    const uint64_t dueTimestamp = baseTimestamp + 50000000;
+    std::vector<uint64_t> drained;
+
+    while (auto entry = wheel.PeekDue(dueTimestamp))
+    {
+        drained.push_back(entry->ReceivedIndex);
+        wheel.Pop();
+    }
+
+    added.erase(std::remove_if(added.begin(), added.end(),
+        [&](auto const& item) { return std::find(drained.begin(), drained.end(), item.second.ReceivedIndex) != drained.end(); }),
+        added.end());
+
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        uint64_t timestamp = baseTimestamp + (random() % 1000);
+        receivedIndex++;
+
+        added.emplace_back(wheel.Emplace(timestamp, receivedIndex), TestScheduledEntry(timestamp, receivedIndex));
+    }
+
+    // remove every third entry, wherever it is
+    for (size_t i = 0; i < added.size(); i++)
+    {
+        if (i % 3 == 0)
+        {
+            VERIFY_ARE_EQUAL(wheel.Get(added[i].first).ReceivedIndex, added[i].second.ReceivedIndex);
+
+            wheel.Remove(added[i].first);
+        }
+        else
+        {
+            expected.push_back(added[i].second);
+        }
+    }
+
+    VERIFY_ARE_EQUAL(wheel.Size(), expected.size());
+
+    // the overdue entries come first, in the order they were added
+    std::stable_sort(expected.begin(), expected.end(),
+        [&](TestScheduledEntry const& left, TestScheduledEntry const& right)
+        {
+            bool leftOverdue = left.Timestamp < dueTimestamp;
+            bool rightOverdue = right.Timestamp < dueTimestamp;
+
+            if (leftOverdue != rightOverdue) return leftOverdue;
+            if (leftOverdue) return false;
+
+            return left.Timestamp < right.Timestamp;
+        });
+
+    for (auto const& expectedEntry : expected)
+    {
+        auto entry = wheel.PeekDue(UINT64_MAX);
+
+        VERIFY_IS_NOT_NULL(entry);
+        VERIFY_ARE_EQUAL(entry->ReceivedIndex, expectedEntry.ReceivedIndex);
+
+        wheel.Pop();
+    }
+
+    VERIFY_IS_TRUE(wheel.Empty());
+}
+
+void MidiTimingWheelTests::TestTimingWheelVisitsSameTimestampRun()
+{
+    MidiTimingWheel<TestScheduledEntry> wheel;
+
+    const uint64_t chordTimestamp = 0x0000000012345678;
+
+    // a chord, something later, and then more of the chord
+    wheel.Emplace(chordTimestamp, (uint64_t)1);
+    wheel.Emplace(chordTimestamp, (uint64_t)2);
+    wheel.Emplace(chordTimestamp + 1, (uint64_t)3);
+    wheel.Emplace(chordTimestamp, (uint64_t)4);
+
+    VERIFY_IS_NOT_NULL(wheel.PeekDue(chordTimestamp + 1));
+
+    std::vector<uint64_t> visited;
+
+    // stops when the visitor does
+    uint32_t count = wheel.VisitDueRun([&](TestScheduledEntry const& entry)
+    {
+        visited.push_back(entry.ReceivedIndex);
+        return visited.size() < 2;
+    });
+
+    VERIFY_ARE_EQUAL(count, (uint32_t)1);
+    VERIFY_ARE_EQUAL(visited.size(), (size_t)2);
+
+    visited.clear();
+
+    // and otherwise at the end of the timestamp. Nothing is removed
+    count = wheel.VisitDueRun([&](TestScheduledEntry const& entry)
+    {
+        visited.push_back(entry.ReceivedIndex);
+        return true;
+    });
+
+    VERIFY_ARE_EQUAL(count, (uint32_t)3);
+    VERIFY_ARE_EQUAL(visited.size(), (size_t)3);
+    VERIFY_ARE_EQUAL(visited[0], (uint64_t)1);
+    VERIFY_ARE_EQUAL(visited[1], (uint64_t)2);
+    VERIFY_ARE_EQUAL(visited[2], (uint64_t)4);
+    VERIFY_ARE_EQUAL(wheel.Size(), (size_t)4);
+
+    // popping that many takes exactly the run
+    for (uint32_t i = 0; i < count; i++)
+    {
+        auto entry = wheel.PeekDue(chordTimestamp);
+        VERIFY_IS_NOT_NULL(entry);
+        VERIFY_ARE_EQUAL(entry->ReceivedIndex, visited[i]);
+        wheel.Pop();
+    }
+
+    VERIFY_IS_NULL(wheel.PeekDue(chordTimestamp));
+
+    auto entry = wheel.PeekDue(chordTimestamp + 1);
+    VERIFY_IS_NOT_NULL(entry);
+    VERIFY_ARE_EQUAL(entry->ReceivedIndex, (uint64_t)3);
+}
@@ -0,0 +1,38 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+// minimal queue entry. The scheduler uses ScheduledUmpMessage
+struct TestScheduledEntry
+{
+    uint64_t Timestamp{ 0 };
+    uint64_t ReceivedIndex{ 0 };
+
+    TestScheduledEntry(_In_ uint64_t timestamp, _In_ uint64_t receivedIndex)
+    {
+        Timestamp = timestamp;
+        ReceivedIndex = receivedIndex;
+    }
+};
+
+class MidiTimingWheelTests
+    : public WEX::TestClass<MidiTimingWheelTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiTimingWheelTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+        TEST_CLASS_PROPERTY(L"BinaryUnderTest", L"Midi2.SchedulerTransform.dll")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestTimingWheelOrdersByTimestamp);
+    TEST_METHOD(TestTimingWheelPreservesReceivedOrderForDuplicateTimestamps);
+    TEST_METHOD(TestTimingWheelOnlyReturnsDueEntries);
+    TEST_METHOD(TestTimingWheelReturnsOverdueEntriesFirst);
+    TEST_METHOD(TestTimingWheelRemovesByHandle);
+    TEST_METHOD(TestTimingWheelVisitsSameTimestampRun);
+
+private:
+
+};
@@ -0,0 +1,144 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <random>
+#include <chrono>
+#include <vector>
+
+#include "ump_stream_scanner.h"
+#include "MidiUmpStreamScannerBenchmarks.h"
+
+namespace internal = ::Windows::Devices::Midi2::Internal;
+
+// Compares finding the message boundaries in a buffer of UMP words with the stream
+// scanner against walking it a message at a time with the switch the length helpers
+// used before, for streams with different amounts of single word messages.
+
+// previous implementation of GetUmpLengthInMidiWordsFromMessageType, for comparison
+static uint8_t SwitchUmpLengthInMidiWords(_In_ uint8_t const messageType) noexcept
+{
+    switch (messageType & 0x0F)
+    {
+    case 0x0:
+    case 0x1:
+    case 0x2:
+    case 0x6:
+    case 0x7:
+        return 1;
+
+    case 0x3:
+    case 0x4:
+    case 0x8:
+    case 0x9:
+    case 0xA:
+        return 2;
+
+    case 0xB:
+    case 0xC:
+        return 3;
+
+    case 0x5:
+    case 0xD:
+    case 0xE:
+    case 0xF:
+        return 4;
+
+    default:
+        return 0;
+    };
+}
+
+_Use_decl_annotations_
+void MidiUmpStreamScannerBenchmarks::BenchmarkThroughput(uint32_t singleWordPercent)
+{
+    const uint32_t messageCount = 1000000;
+    const uint32_t passCount = 20;
+
+    std::mt19937 random(singleWordPercent);
+    std::vector<uint32_t> words{};
+
+    // MIDI 1.0 channel voice for the single word messages, and a mix of MIDI 2.0
+    // channel voice, SysEx and stream messages for the rest
+    for (uint32_t i = 0; i < messageCount; i++)
+    {
+        if (random() % 100 < singleWordPercent)
+        {
+            words.push_back(0x20903C7F);
+        }
+        else
+        {
+            switch (random() % 3)
+            {
+            case 0:
+                words.insert(words.end(), { 0x40903C00, 0xFFFF0000 });
+                break;
+            case 1:
+                words.insert(words.end(), { 0x30160001, 0x02030405 });
+                break;
+            default:
+                words.insert(words.end(), { 0xF0010000, 0x00000000, 0x00000000, 0x00000000 });
+                break;
+            }
+        }
+    }
+
+    uint32_t wordCount = (uint32_t)words.size();
+    std::vector<uint32_t> switchBoundaries(wordCount);
+    std::vector<uint32_t> scannerBoundaries(wordCount);
+    uint32_t switchMessageCount{ 0 };
+    uint32_t scannerMessageCount{ 0 };
+
+    // per-message switch
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t pass = 0; pass < passCount; pass++)
+    {
+        switchMessageCount = 0;
+
+        for (uint32_t i = 0; i < wordCount; )
+        {
+            uint8_t messageWordCount = SwitchUmpLengthInMidiWords((uint8_t)(words[i] >> 28));
+
+            if (i + messageWordCount > wordCount)
+            {
+                break;
+            }
+
+            switchBoundaries[switchMessageCount++] = i;
+            i += messageWordCount;
+        }
+    }
+
+    auto switchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // stream scanner
+
+    start = std::chrono::steady_clock::now();
+
+    for (uint32_t pass = 0; pass < passCount; pass++)
+    {
+        uint32_t scannedWordCount{ 0 };
+        scannerMessageCount = internal::FindUmpBoundaries(words.data(), wordCount, scannerBoundaries.data(), wordCount, scannedWordCount);
+    }
+
+    auto scannerSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    VERIFY_ARE_EQUAL(switchMessageCount, messageCount);
+    VERIFY_ARE_EQUAL(scannerMessageCount, messageCount);
+    VERIFY_IS_TRUE(memcmp(switchBoundaries.data(), scannerBoundaries.data(), messageCount * sizeof(uint32_t)) == 0);
+
+    double totalMessages = (double)messageCount * passCount;
+
+    LOG_OUTPUT(L"%u messages, %u%% single word, %u words", messageCount, singleWordPercent, wordCount);
+    LOG_OUTPUT(L"  Per-message switch: %.2f ns/msg", switchSeconds * 1e9 / totalMessages);
+    LOG_OUTPUT(L"  Stream scanner:     %.2f ns/msg", scannerSeconds * 1e9 / totalMessages);
+}
+
+void MidiUmpStreamScannerBenchmarks::BenchmarkUmpStreamScannerThroughput()
+{
+    BenchmarkThroughput(100);
+    BenchmarkThroughput(90);
+    BenchmarkThroughput(50);
+    BenchmarkThroughput(0);
+}
@@ -0,0 +1,20 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiUmpStreamScannerBenchmarks
+    : public WEX::TestClass<MidiUmpStreamScannerBenchmarks>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiUmpStreamScannerBenchmarks)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Benchmark")
+    END_TEST_CLASS()
+
+    TEST_METHOD(BenchmarkUmpStreamScannerThroughput);
+
+private:
+    void BenchmarkThroughput(_In_ uint32_t singleWordPercent);
+
+};
@@ -0,0 +1,217 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include "stdafx.h"
+
+#include <random>
+#include <vector>
+
+#include "ump_helpers.h"
+#include "ump_stream_scanner.h"
+#include "MidiUmpStreamScannerTests.h"
+
+namespace internal = ::Windows::Devices::Midi2::Internal;
+
+// Message types by size, from the UMP specification, so the expected boundaries don't
+// come from the table under test
+static const uint8_t c_TestUmp32Types[]{ 0x0, 0x1, 0x2, 0x6, 0x7 };
+static const uint8_t c_TestUmp64Types[]{ 0x3, 0x4, 0x8, 0x9, 0xA };
+static const uint8_t c_TestUmp96Types[]{ 0xB, 0xC };
+static const uint8_t c_TestUmp128Types[]{ 0x5, 0xD, 0xE, 0xF };
+
+// Random messages of every type, with random data words. Every word after the first
+// also gets a random top nibble, so data words look like any message type. The index
+// of the first word of each message goes in boundaries.
+static std::vector<uint32_t> BuildTestUmpStream(
+    _In_ uint32_t messageCount,
+    _In_ uint32_t seed,
+    _Out_ std::vector<uint32_t>& boundaries)
+{
+    std::mt19937 random(seed);
+    std::vector<uint32_t> words{};
+
+    boundaries.clear();
+
+    for (uint32_t i = 0; i < messageCount; i++)
+    {
+        uint8_t messageType{ 0 };
+        uint32_t wordCount{ 0 };
+
+        switch (random() % 4)
+        {
+        case 0:
+            messageType = c_TestUmp32Types[random() % _countof(c_TestUmp32Types)];
+            wordCount = 1;
+            break;
+        case 1:
+            messageType = c_TestUmp64Types[random() % _countof(c_TestUmp64Types)];
+            wordCount = 2;
+            break;
+        case 2:
+            messageType = c_TestUmp96Types[random() % _countof(c_TestUmp96Types)];
+            wordCount = 3;
+            break;
+        default:
+            messageType = c_TestUmp128Types[random() % _countof(c_TestUmp128Types)];
+            wordCount = 4;
+            break;
+        }
+
+        boundaries.push_back((uint32_t)words.size());
+        words.push_back(((uint32_t)messageType << 28) | (random() & 0x0FFFFFFF));
+
+        for (uint32_t w = 1; w < wordCount; w++)
+        {
+            words.push_back((uint32_t)random());
+        }
+    }
+
+    return words;
+}
+
+void MidiUmpStreamScannerTests::TestUmpStreamScannerBoundaries()
+{
+    std::vector<uint32_t> expectedBoundaries{};
+    auto words = BuildTestUmpStream(10000, 1, expectedBoundaries);
+
+    std::vector<uint32_t> boundaries(words.size());
+    uint32_t scannedWordCount{ 0 };
+
+    uint32_t messageCount = internal::FindUmpBoundaries(words.data(), (uint32_t)words.size(), boundaries.data(), (uint32_t)boundaries.size(), scannedWordCount);
+
+    VERIFY_ARE_EQUAL(messageCount, (uint32_t)expectedBoundaries.size());
+    VERIFY_ARE_EQUAL(scannedWordCount, (uint32_t)words.size());
+    VERIFY_IS_TRUE(memcmp(boundaries.data(), expectedBoundaries.data(), messageCount * sizeof(uint32_t)) == 0);
+
+    VERIFY_ARE_EQUAL(internal::GetWholeUmpWordCount(words.data(), (uint32_t)words.size()), (uint32_t)words.size());
+
+    // every starting point, so the four word checks start at every alignment
+    for (uint32_t start = 1; start < 8; start++)
+    {
+        messageCount = internal::FindUmpBoundaries(words.data() + expectedBoundaries[start], (uint32_t)words.size() - expectedBoundaries[start], boundaries.data(), (uint32_t)boundaries.size(), scannedWordCount);
+
+        VERIFY_ARE_EQUAL(messageCount, (uint32_t)expectedBoundaries.size() - start);
+
+        bool matches{ true };
+
+        for (uint32_t i = 0; i < messageCount; i++)
+        {
+            matches = matches && boundaries[i] + expectedBoundaries[start] == expectedBoundaries[start + i];
+        }
+
+        VERIFY_IS_TRUE(matches);
+    }
+
+    // nothing to scan
+    VERIFY_ARE_EQUAL(internal::FindUmpBoundaries(words.data(), 0, boundaries.data(), (uint32_t)boundaries.size(), scannedWordCount), (uint32_t)0);
+    VERIFY_ARE_EQUAL(scannedWordCount, (uint32_t)0);
+}
+
+void MidiUmpStreamScannerTests::TestUmpStreamScannerIncompleteMessage()
+{
+    // three UMP32s, a UMP64, then a UMP128 missing its last word
+    uint32_t words[]{ 0x20903C7F, 0x10F80000, 0x20803C00, 0x40903C00, 0xFFFF0000, 0xF0010000, 0x00000000, 0x00000000 };
+    uint32_t boundaries[_countof(words)]{};
+    uint32_t scannedWordCount{ 0 };
+
+    uint32_t messageCount = internal::FindUmpBoundaries(words, _countof(words), boundaries, _countof(boundaries), scannedWordCount);
+
+    VERIFY_ARE_EQUAL(messageCount, (uint32_t)4);
+    VERIFY_ARE_EQUAL(scannedWordCount, (uint32_t)5);
+    VERIFY_ARE_EQUAL(boundaries[3], (uint32_t)3);
+
+    VERIFY_ARE_EQUAL(internal::GetWholeUmpWordCount(words, _countof(words)), (uint32_t)5);
+
+    // a lone word of a UMP64
+    VERIFY_ARE_EQUAL(internal::GetWholeUmpWordCount(&words[3], 1), (uint32_t)0);
+}
+
+void MidiUmpStreamScannerTests::TestUmpStreamScannerMaximumBoundaryCount()
+{
+    std::vector<uint32_t> expectedBoundaries{};
+    auto words = BuildTestUmpStream(1000, 2, expectedBoundaries);
+
+    // walk it a few messages at a time, the way ForEachUmpInBatch does
+    uint32_t boundaries[5]{};
+    uint32_t offset{ 0 };
+    uint32_t found{ 0 };
+    bool matches{ true };
+
+    while (offset < words.size())
+    {
+        uint32_t scannedWordCount{ 0 };
+        uint32_t messageCount = internal::FindUmpBoundaries(words.data() + offset, (uint32_t)words.size() - offset, boundaries, _countof(boundaries), scannedWordCount);
+
+        VERIFY_IS_GREATER_THAN(messageCount, (uint32_t)0);
+        VERIFY_IS_LESS_THAN_OR_EQUAL(messageCount, (uint32_t)_countof(boundaries));
+
+        for (uint32_t i = 0; i < messageCount; i++)
+        {
+            matches = matches && offset + boundaries[i] == expectedBoundaries[found + i];
+        }
+
+        found += messageCount;
+        offset += scannedWordCount;
+    }
+
+    VERIFY_IS_TRUE(matches);
+    VERIFY_ARE_EQUAL(found, (uint32_t)expectedBoundaries.size());
+}
+
+void MidiUmpStreamScannerTests::TestUmpStreamScannerMessageTypeCheck()
+{
+    uint32_t words[]{ 0x20903C7F, 0x10F80000, 0x20803C00, 0x40903C00, 0x7FFF0000, 0x20803C00 };
+
+    VERIFY_IS_TRUE(internal::UmpWordsMayContainMessageType(words, _countof(words), 0x2));
+    VERIFY_IS_TRUE(internal::UmpWordsMayContainMessageType(words, _countof(words), 0x4));
+    VERIFY_IS_FALSE(internal::UmpWordsMayContainMessageType(words, _countof(words), 0xF));
+
+    // in the words after the first four, which aren't checked four at a time
+    VERIFY_IS_TRUE(internal::UmpWordsMayContainMessageType(words, _countof(words), 0x7));
+
+    words[5] = 0xF0010000;
+    VERIFY_IS_TRUE(internal::UmpWordsMayContainMessageType(words, _countof(words), 0xF));
+    VERIFY_IS_FALSE(internal::UmpWordsMayContainMessageType(words, 5, 0xF));
+    VERIFY_IS_FALSE(internal::UmpWordsMayContainMessageType(words, 0, 0x2));
+}
+
+void MidiUmpStreamScannerTests::TestForEachUmpInBatch()
+{
+    // more messages than ForEachUmpInBatch scans at a time
+    std::vector<uint32_t> expectedBoundaries{};
+    auto words = BuildTestUmpStream(500, 3, expectedBoundaries);
+
+    uint32_t byteCount = (uint32_t)(words.size() * sizeof(uint32_t));
+    uint32_t messageIndex{ 0 };
+    bool matches{ true };
+
+    auto walked = internal::ForEachUmpInBatch(words.data(), byteCount, [&](const uint8_t* message, uint32_t messageSize)
+        {
+            uint32_t expectedEnd = (messageIndex + 1 < expectedBoundaries.size()) ? expectedBoundaries[messageIndex + 1] : (uint32_t)words.size();
+
+            matches = matches &&
+                message == (const uint8_t*)(words.data() + expectedBoundaries[messageIndex]) &&
+                messageSize == (expectedEnd - expectedBoundaries[messageIndex]) * sizeof(uint32_t);
+
+            messageIndex++;
+
+            return true;
+        });
+
+    VERIFY_IS_TRUE(matches);
+    VERIFY_ARE_EQUAL(walked, byteCount);
+    VERIFY_ARE_EQUAL(messageIndex, (uint32_t)expectedBoundaries.size());
+
+    // stopping early gives the offset of the message which stopped it
+    messageIndex = 0;
+
+    walked = internal::ForEachUmpInBatch(words.data(), byteCount, [&](const uint8_t*, uint32_t)
+        {
+            return ++messageIndex < 300;
+        });
+
+    VERIFY_ARE_EQUAL(walked, (uint32_t)(expectedBoundaries[299] * sizeof(uint32_t)));
+
+    // a buffer which isn't a whole number of UMPs is walked up to the partial message
+    walked = internal::ForEachUmpInBatch(words.data(), (uint32_t)(expectedBoundaries[10] * sizeof(uint32_t)) + 3, [](const uint8_t*, uint32_t) { return true; });
+
+    VERIFY_ARE_EQUAL(walked, (uint32_t)(expectedBoundaries[10] * sizeof(uint32_t)));
+}
@@ -0,0 +1,23 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#pragma once
+
+#include <WexTestClass.h>
+
+class MidiUmpStreamScannerTests
+    : public WEX::TestClass<MidiUmpStreamScannerTests>
+{
+public:
+
+    BEGIN_TEST_CLASS(MidiUmpStreamScannerTests)
+        TEST_CLASS_PROPERTY(L"TestClassification", L"Unit")
+    END_TEST_CLASS()
+
+    TEST_METHOD(TestUmpStreamScannerBoundaries);
+    TEST_METHOD(TestUmpStreamScannerIncompleteMessage);
+    TEST_METHOD(TestUmpStreamScannerMaximumBoundaryCount);
+    TEST_METHOD(TestUmpStreamScannerMessageTypeCheck);
+    TEST_METHOD(TestForEachUmpInBatch);
+
+private:
+
+};
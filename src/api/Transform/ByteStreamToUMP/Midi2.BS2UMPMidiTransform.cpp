@@ -32,6 +32,32 @@ CMidi2BS2UMPMidiTransform::Initialize(
     m_BS2UMP.outputMIDI2 = false;
     m_BS2UMP.defaultGroup = 0;
 
+    // A byte stream device only speaks MIDI 1.0, and has no protocol negotiation to say
+    // otherwise, so whether its channel voice messages are upscaled to MIDI 2.0 here, once,
+    // instead of in every client, is a setting for the endpoint. This is read when the
+    // transform is created, so a change applies the next time the endpoint is opened. A
+    // missing value means MIDI 1.0.
+    if (Device != nullptr)
+    {
+        try
+        {
+            m_BS2UMP.outputMIDI2 = wil::reg::get_value<DWORD>(HKEY_LOCAL_MACHINE, MIDI_BYTESTREAM_UPSCALE_REG_KEY, Device) != 0;
+        }
+        catch (...)
+        {
+            // value is not present in the registry, so keep MIDI 1.0
+            m_BS2UMP.outputMIDI2 = false;
+        }
+    }
+
+    TraceLoggingWrite(
+        MidiBS2UMPTransformTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingPointer(this, "this"),
+        TraceLoggingBool(m_BS2UMP.outputMIDI2, "Upscaling to MIDI 2.0")
+    );
+
     return S_OK;
 }
 
@@ -58,30 +84,28 @@ CMidi2BS2UMPMidiTransform::SendMidiMessage(
 {
     OutputDebugString(L"" __FUNCTION__);
 
-    // Send the bytestream byte(s) to the parser
+    // Send the bytestream to the parser a buffer at a time. The parser only
+    // writes whole UMPs, and stops when the next one might not fit, so each
+    // callback is a UMP batch. A running status burst read from the device
+    // in one go goes downstream in one call.
     BYTE *data = (BYTE *)Data;
-    for (UINT i = 0; i < Length; i++)
-    {
-        m_BS2UMP.bytestreamParse(data[i]);
-    }
+    size_t consumed{ 0 };
 
-    // retrieve teh UMP(s) from the parser
-    // and sent it on
-    while (m_BS2UMP.availableUMP())
+    auto lock = m_SendLock.lock();
+
+    do
     {
-        uint32_t umpMessage[MAXIMUM_LOOPED_DATASIZE / 4];
-        UINT umpCount;
-        for(umpCount = 0; umpCount < _countof(umpMessage) && m_BS2UMP.availableUMP(); umpCount++)
-        {
-            umpMessage[umpCount] = m_BS2UMP.readUMP();
-        }
+        uint32_t umpMessage[MIDI_UMP_BATCH_MAXIMUM_SIZE / sizeof(uint32_t)];
+        size_t umpCount{ 0 };
+
+        consumed += m_BS2UMP.bytestreamParse(data + consumed, Length - consumed, umpMessage, _countof(umpMessage), umpCount);
 
         if (umpCount > 0)
         {
             // there are 4 bytes per each 32 bit UMP returned by the parser.
-            RETURN_IF_FAILED(m_Callback->Callback(&(umpMessage[0]), umpCount * 4, Position, m_Context));
+            RETURN_IF_FAILED(m_Callback->Callback(&(umpMessage[0]), (UINT)(umpCount * 4), Position, m_Context));
         }
-    }
+    } while (consumed < Length);
 
     return S_OK;
 }
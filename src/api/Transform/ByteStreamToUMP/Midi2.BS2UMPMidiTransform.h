@@ -19,6 +19,11 @@ private:
     std::wstring m_Device;
     wil::com_ptr_nothrow<IMidiCallback> m_Callback;
     LONGLONG m_Context;
+
+    // Going to the device, the service shares one of these between all of the
+    // endpoint's byte stream clients, which can send at the same time. The parser keeps
+    // state from one call to the next, so sends are serialized.
+    wil::critical_section m_SendLock;
     bytestreamToUMP m_BS2UMP;
 };
 
@@ -18,6 +18,7 @@
 #include <wil\com.h>
 #include <wil\resource.h>
 #include <wil\result_macros.h>
+#include <wil\registry.h>
 #include <wil\tracelogging.h>
 #include <ppltasks.h>
 
@@ -147,11 +147,27 @@ CMidi2EndpointMetadataListenerMidiTransform::SendMidiMessage(
         m_callback->Callback(data, size, timestamp, m_context);
     }
 
-    if (data != nullptr && size == UMP128_BYTE_COUNT)
+    // Most batches have no stream messages at all, and if no word has type F in its top
+    // nibble, there's nothing to walk
+    if (!internal::UmpWordsMayContainMessageType((const uint32_t*)data, size / sizeof(uint32_t), 0xF))
     {
+        return S_OK;
+    }
+
+    // This may be a UMP batch, so look at each UMP in it. Anything which isn't a UMP128
+    // can't be a stream message, and falls out quickly
+    HRESULT hr = S_OK;
+
+    internal::ForEachUmpInBatch(data, size, [&](const uint8_t* message, uint32_t messageSize)
+    {
+        if (messageSize != UMP128_BYTE_COUNT)
+        {
+            return true;
+        }
+
         internal::PackedUmp128 ump;
 
-        if (internal::FillPackedUmp128FromBytePointer((byte*)data, (uint8_t)size, ump))
+        if (internal::FillPackedUmp128FromBytePointer((byte*)message, (uint8_t)messageSize, ump))
         {
             // if type F, process it.
 
@@ -167,19 +183,18 @@ CMidi2EndpointMetadataListenerMidiTransform::SendMidiMessage(
             {
                 // not a stream message. Ignore and move on
             }
+
+            return true;
         }
         else
         {
             // couldn't fill the UMP. Shouldn't happen since we pre-validate
-            return E_FAIL;
+            hr = E_FAIL;
+            return false;
         }
-    }
-    else
-    {
-        // Either null (hopefully not) or not a UMP128 so can't be a stream message. Fall out quickly
-    }
+    });
 
-    return S_OK;
+    return hr;
 }
 
 
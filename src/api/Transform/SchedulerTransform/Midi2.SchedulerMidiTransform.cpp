@@ -12,9 +12,13 @@
 
 
 
-#define MIDI_SCHEDULER_MINIMUM_EVENT_SLEEP_TIME_MS 2000
 #define MIDI_OUTBOUND_EMPTY_QUEUE_SLEEP_DURATION_MS 60000
 
+// timestamp minus ticks, stopping at 0 rather than wrapping around to the far future
+inline uint64_t SubtractTicksSaturated(_In_ uint64_t timestamp, _In_ uint64_t ticks)
+{
+    return timestamp > ticks ? timestamp - ticks : 0;
+}
 
 
 
@@ -29,7 +33,6 @@ CMidi2SchedulerMidiTransform::Initialize(
     IUnknown* /*MidiDeviceManager*/
 )
 {
-    UNREFERENCED_PARAMETER(deviceId);
     UNREFERENCED_PARAMETER(creationParams);
     UNREFERENCED_PARAMETER(mmcssTaskId);
     
@@ -48,10 +51,123 @@ CMidi2SchedulerMidiTransform::Initialize(
 
     m_context = context;
 
-    // need to make sure this is created before starting up the worker thread
- //   m_messageProcessorWakeup.create(wil::EventOptions::ManualReset);
+    m_timestampFrequency = m_clock->GetTimestampFrequency();
+    m_lastStatisticsTimestamp = m_clock->GetCurrentTimestamp();
+
+    // The worker works out how far ahead to send from the device latency when it starts,
+    // so this needs to be read first. A missing or unreadable property just means we
+    // don't send anything early.
+    if (deviceId != nullptr)
+    {
+        try
+        {
+            auto additionalProperties = winrt::single_threaded_vector<winrt::hstring>();
+            additionalProperties.Append(winrt::to_hstring(STRING_PKEY_MIDI_MidiOutCalculatedLatencyTicks));
+            additionalProperties.Append(winrt::to_hstring(STRING_PKEY_MIDI_MidiOutUserSuppliedLatencyTicks));
+            additionalProperties.Append(winrt::to_hstring(STRING_PKEY_MIDI_MidiOutLatencyTicksUserOverride));
+
+            auto deviceInfo = winrt::Windows::Devices::Enumeration::DeviceInformation::CreateFromIdAsync(
+                deviceId,
+                additionalProperties,
+                winrt::Windows::Devices::Enumeration::DeviceInformationKind::DeviceInterface).get();
+
+            auto properties = deviceInfo.Properties();
+
+            bool useUserSuppliedLatency{ false };
+
+            if (properties.HasKey(winrt::to_hstring(STRING_PKEY_MIDI_MidiOutLatencyTicksUserOverride)))
+            {
+                auto overrideProperty = properties.Lookup(winrt::to_hstring(STRING_PKEY_MIDI_MidiOutLatencyTicksUserOverride));
+
+                if (overrideProperty != nullptr)
+                {
+                    useUserSuppliedLatency = winrt::unbox_value<bool>(overrideProperty);
+                }
+            }
+
+            auto latencyKey = useUserSuppliedLatency ?
+                winrt::to_hstring(STRING_PKEY_MIDI_MidiOutUserSuppliedLatencyTicks) :
+                winrt::to_hstring(STRING_PKEY_MIDI_MidiOutCalculatedLatencyTicks);
+
+            if (properties.HasKey(latencyKey))
+            {
+                auto latencyProperty = properties.Lookup(latencyKey);
+
+                if (latencyProperty != nullptr)
+                {
+                    m_deviceLatencyTicks = winrt::unbox_value<uint64_t>(latencyProperty);
+                }
+            }
+
+            // the service refuses to store more than this, but the property store can be
+            // written by other means
+            uint64_t maximumLatencyTicks = (uint64_t)MIDI_MAXIMUM_OUTPUT_LATENCY_MICROSECONDS * m_timestampFrequency / 1000000;
+
+            if (m_deviceLatencyTicks > maximumLatencyTicks)
+            {
+                OutputDebugString(L"" __FUNCTION__ " Device latency is out of range. Clamping to the maximum.");
+
+                m_deviceLatencyTicks = maximumLatencyTicks;
+            }
+
+            OutputDebugString((std::wstring(L"" __FUNCTION__ " Device latency ticks: ") + std::to_wstring(m_deviceLatencyTicks)).c_str());
+        }
+        catch (...)
+        {
+            OutputDebugString(L"" __FUNCTION__ " Unable to read device latency properties. Using 0.");
+
+            m_deviceLatencyTicks = 0;
+        }
+    }
+
+    // warm up the queue storage so the worker doesn't need to allocate for typical queue sizes
+    try
+    {
+        m_messageQueue.Reserve(MIDI_SCHEDULER_INITIAL_RESERVED_MESSAGE_COUNT);
+    }
+    CATCH_RETURN();
+
+    // need to make sure these are created before starting up the worker thread
+    RETURN_IF_FAILED(m_messageProcessorWakeup.create(wil::EventOptions::ManualReset));
+
+    // high resolution timers are Windows 10 1803 and later. If we can't get one, a regular
+    // waitable timer still works, but wakes up late by as much as a full timer tick
+    m_wakeupTimer.reset(CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS));
+
+    if (!m_wakeupTimer)
+    {
+        OutputDebugString(L"" __FUNCTION__ " High resolution timer unavailable. Falling back to standard waitable timer.");
+
+        m_wakeupTimer.reset(CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS));
+    }
+
+    RETURN_LAST_ERROR_IF(!m_wakeupTimer);
 
-    // create the queue worker thread
+    DWORD spinWindowMicroseconds{ MIDI_SCHEDULER_DEFAULT_SPIN_WINDOW_MICROSECONDS };
+
+    try
+    {
+        spinWindowMicroseconds = wil::reg::get_value<DWORD>(HKEY_LOCAL_MACHINE, MIDI_ROOT_REG_KEY, MIDI_SCHEDULER_SPIN_WINDOW_REG_VALUE);
+    }
+    catch (...)
+    {
+        // value is not present in the registry, so keep the default
+    }
+
+    spinWindowMicroseconds = (std::min)(spinWindowMicroseconds, (DWORD)MIDI_SCHEDULER_MAXIMUM_SPIN_WINDOW_MICROSECONDS);
+    m_spinWindowTicks = ((uint64_t)spinWindowMicroseconds * m_timestampFrequency) / 1000000;
+
+    try
+    {
+        m_messageQueue.SetCoalesceSameTimestamp(wil::reg::get_value<DWORD>(HKEY_LOCAL_MACHINE, MIDI_ROOT_REG_KEY, MIDI_SCHEDULER_COALESCE_REG_VALUE) != 0);
+    }
+    catch (...)
+    {
+        // value is not present in the registry, so keep the default
+    }
+
+    // create the queue worker thread. It uses the queues, the timer and the callback, so
+    // it is joined in Cleanup rather than detached
     std::thread workerThread(
         &CMidi2SchedulerMidiTransform::QueueWorker,
         this);
@@ -61,13 +177,34 @@ CMidi2SchedulerMidiTransform::Initialize(
 
     m_queueWorkerThread = std::move(workerThread);
 
-    // start up the worker thread
-    m_queueWorkerThread.detach();
-
 
     return S_OK;
 }
 
+CMidi2SchedulerMidiTransform::~CMidi2SchedulerMidiTransform()
+{
+    // in case Cleanup wasn't called. The worker can't outlive what it uses
+    StopQueueWorker();
+}
+
+// Tells the worker to quit, and waits for it to. Nothing the worker uses may be released
+// before this returns.
+void CMidi2SchedulerMidiTransform::StopQueueWorker()
+{
+    m_continueProcessing = false;
+
+    // in case it is in a wait
+    if (m_messageProcessorWakeup)
+    {
+        m_messageProcessorWakeup.SetEvent();
+    }
+
+    if (m_queueWorkerThread.joinable())
+    {
+        m_queueWorkerThread.join();
+    }
+}
+
 HRESULT
 CMidi2SchedulerMidiTransform::Cleanup()
 {
@@ -81,55 +218,13 @@ CMidi2SchedulerMidiTransform::Cleanup()
     try
     {
         OutputDebugString(L"" __FUNCTION__ " Scheduler shut down time");
-        OutputDebugString((std::wstring(L"" __FUNCTION__ " Abandoned queue size is: ") + std::to_wstring(m_messageQueue.size())).c_str());
-
-
-        // tell the thread to quit. Call SetEvent in case it is in a wait
-        m_continueProcessing = false;
-
-        // give the thread a change to terminate
-        m_messageProcessorWakeup.SetEvent();
-        Sleep(0);
-
-        //// clear the queue
-        //bool locked = false;
-        //while (!locked)
-        //{
-        //    // clear the queue
-        //    if (m_queueLock.try_lock())
-        //    {
-        //        while (m_messageQueue.size() > 0)
-        //        {
-        //            m_messageQueue.pop();
-        //        }
+        OutputDebugString((std::wstring(L"" __FUNCTION__ " Abandoned queue size is: ") + std::to_wstring(m_scheduledMessageCount)).c_str());
 
-        //        locked = true;
-        //    }
+        // the worker has to be gone before the pipe releases us, or it could wake up and
+        // use the queues, the timer or the callback after they're freed
+        StopQueueWorker();
 
-        //    Sleep(0);
-        //}
-
-
-        // join the worker thread and wait for it to end
-        if (m_queueWorkerThread.joinable())
-            m_queueWorkerThread.join();
-
-        // don't let the component shut down until we're sure everything is wrapped up.
-        // this has a bit of a smell to it, but was having problems with the queue
-        // getting torn down before the worker thread was done
-
-        //locked = false;
-
-        //while (!locked)
-        //{
-        //    // clear the queue
-        //    if (m_queueLock.try_lock())
-        //    {
-        //        locked = true;
-        //    }
-
-        //    Sleep(0);
-        //}
+        LogDispatchStatistics();
 
         return S_OK;
     }
@@ -142,21 +237,25 @@ CMidi2SchedulerMidiTransform::Cleanup()
     }
 }
 
-// This is called for messages coming out of the scheduler queue (via
-// the overload), or when the scheduler is bypassed due to a timestamp
-// of 0 or a timestamp within the "now" send window
+// This is called for messages coming out of the scheduler queue, or when
+// the scheduler is bypassed due to a timestamp of 0 or a timestamp within
+// the "now" send window
 _Use_decl_annotations_
 HRESULT
 CMidi2SchedulerMidiTransform::SendMidiMessageNow(
     PVOID data,
     UINT size,
-    LONGLONG timestamp)
+    LONGLONG timestamp,
+    ULONGLONG sourceId)
 {
     try
     {
         if (m_callback != nullptr)
         {
-            m_callback->Callback(data, size, timestamp, m_context);
+            // The service reads the callback context as the client the message came
+            // from, which the device needs to keep one client's SysEx from breaking
+            // into another's. So pass that along when we know it.
+            m_callback->Callback(data, size, timestamp, sourceId != 0 ? (LONGLONG)sourceId : m_context);
             return S_OK;
         }
         else
@@ -176,32 +275,26 @@ CMidi2SchedulerMidiTransform::SendMidiMessageNow(
 }
 
 
-// This is called for messages coming out of the scheduler queue
+
 _Use_decl_annotations_
-HRESULT 
-CMidi2SchedulerMidiTransform::SendMidiMessageNow(
-    ScheduledUmpMessage const message)
+HRESULT
+CMidi2SchedulerMidiTransform::SendMidiMessage(
+    PVOID data,
+    UINT size,
+    LONGLONG timestamp)
 {
-//    OutputDebugString((std::wstring(L"" __FUNCTION__ " Sending queued message. Queue size is: ") + std::to_wstring(m_messageQueue.size())).c_str());
-
-    if (!m_continueProcessing) return S_OK;
-
-    return SendMidiMessageNow(
-        (PVOID)(message.Data), 
-        message.ByteCount, 
-        (LONGLONG)(message.Timestamp));
-
+    // sender isn't known, so these can only be cancelled along with everything else
+    // from source 0
+    return SendMidiMessageFromSource(data, size, timestamp, 0);
 }
 
-
-
-
 _Use_decl_annotations_
 HRESULT
-CMidi2SchedulerMidiTransform::SendMidiMessage(
+CMidi2SchedulerMidiTransform::SendMidiMessageFromSource(
     PVOID data,
     UINT size,
-    LONGLONG timestamp)
+    LONGLONG timestamp,
+    ULONGLONG sourceId)
 {
 
     if (!m_continueProcessing) return S_OK;
@@ -212,7 +305,7 @@ CMidi2SchedulerMidiTransform::SendMidiMessage(
         if (timestamp == 0)
         {
             // bypass scheduling logic completely
-            auto hr = SendMidiMessageNow(data, size, timestamp);
+            auto hr = SendMidiMessageNow(data, size, timestamp, sourceId);
 
             if (SUCCEEDED(hr))
             {
@@ -223,10 +316,10 @@ CMidi2SchedulerMidiTransform::SendMidiMessage(
                 return hr;
             }
         }
-        else if (shared::GetCurrentMidiTimestamp() >= timestamp - m_tickWindow - m_deviceLatencyTicks)
+        else if (m_clock->GetCurrentTimestamp() >= SubtractTicksSaturated((uint64_t)timestamp, m_tickWindow + m_deviceLatencyTicks))
         {
             // timestamp is in the past or within our tick window: so send now
-            auto hr = SendMidiMessageNow(data, size, timestamp);
+            auto hr = SendMidiMessageNow(data, size, timestamp, sourceId);
 
             if (SUCCEEDED(hr))
             {
@@ -239,49 +332,67 @@ CMidi2SchedulerMidiTransform::SendMidiMessage(
         }
         else
         {
-            // bypass scheduling for a stable release
-            auto hr = SendMidiMessageNow(data, size, timestamp);
-            return hr;
+            // otherwise, we schedule the message. This may be a UMP batch from a
+            // translator, so each UMP in it is queued on its own, with the shared
+            // timestamp. A batch is queued whole or not at all, so a caller which gets a
+            // failure back knows none of it was sent, and can retry without duplicates.
 
-#if false
-            // otherwise, we schedule the message
-
-            if (size >= MINIMUM_UMP_DATASIZE && size <= MAXIMUM_UMP_DATASIZE)
+            if (size < MINIMUM_UMP_DATASIZE || size > MIDI_UMP_BATCH_MAXIMUM_SIZE || size % sizeof(uint32_t) != 0)
             {
-                std::lock_guard<std::mutex> lock{ m_queueMutex };
+                // invalid data size
+                return HR_E_MIDI_SENDMSG_INVALID_MESSAGE;
+            }
 
-                // recycle the current received index whenever the queue is empty. Prevents long-term wrapping
-                if (m_messageQueue.size() == 0)
-                {
-                    m_currentReceivedIndex = 0;
-                }
+            auto words = (const uint32_t*)data;
+            uint32_t wordCount = size / sizeof(uint32_t);
 
-                // schedule the message for sending in the future
+            uint32_t boundaries[MIDI_UMP_BATCH_MAXIMUM_SIZE / sizeof(uint32_t)];
+            uint32_t scannedWordCount{ 0 };
 
-                if (m_messageQueue.size() < MIDI_OUTGOING_MESSAGE_QUEUE_MAX_MESSAGE_COUNT)
-                {
-                    m_messageQueue.emplace(timestamp, ++m_currentReceivedIndex, size, (byte*)data);
+            uint32_t messageCount = internal::FindUmpBoundaries(words, wordCount, boundaries, _countof(boundaries), scannedWordCount);
 
-                    // notify the worker thread
-                    if (m_continueProcessing) m_messageProcessorWakeup.SetEvent();
-                       
-                    // break out of the loop and return
-                    return HR_S_MIDI_SENDMSG_SCHEDULED;
-                }
-                else
-                {
-                    // priority queue doesn't give us any way to pop from the back
-                    // so we just have to fail. 
+            if (scannedWordCount != wordCount)
+            {
+                // not a whole number of UMPs
+                return HR_E_MIDI_SENDMSG_INVALID_MESSAGE;
+            }
 
-                    return HR_E_MIDI_SENDMSG_SCHEDULER_QUEUE_FULL;
-                }
+            // reserve room for the whole batch against the overall limit. This counts
+            // messages still in the staging queue as well as those the worker has
+            // already merged
+            if (m_scheduledMessageCount.fetch_add(messageCount) + messageCount > MIDI_OUTGOING_MESSAGE_QUEUE_MAX_MESSAGE_COUNT)
+            {
+                m_scheduledMessageCount -= messageCount;
+
+                return HR_E_MIDI_SENDMSG_SCHEDULER_QUEUE_FULL;
             }
-            else
+
+            // schedule the messages for sending in the future. The worker assigns the
+            // received index when it merges, and the staging queue preserves order
+            bool staged = m_stagingQueue.TryPushMany(messageCount, [&](uint32_t i)
             {
-                // invalid data size
-                return HR_E_MIDI_SENDMSG_INVALID_MESSAGE;
+                uint32_t messageEnd = (i + 1 < messageCount) ? boundaries[i + 1] : scannedWordCount;
+
+                return ScheduledUmpMessage(
+                    (internal::MidiTimestamp)timestamp,
+                    (uint64_t)0,
+                    (uint64_t)sourceId,
+                    (UINT)((messageEnd - boundaries[i]) * sizeof(uint32_t)),
+                    (BYTE*)(words + boundaries[i]));
+            });
+
+            if (!staged)
+            {
+                // the worker has fallen behind merging staged messages
+                m_scheduledMessageCount -= messageCount;
+
+                return HR_E_MIDI_SENDMSG_SCHEDULER_QUEUE_FULL;
             }
-#endif
+
+            // notify the worker thread
+            if (m_continueProcessing) m_messageProcessorWakeup.SetEvent();
+
+            return HR_S_MIDI_SENDMSG_SCHEDULED;
 
         }
 
@@ -311,9 +422,10 @@ CMidi2SchedulerMidiTransform::GetTopMessageTimestamp(internal::MidiTimestamp &ti
 
         std::lock_guard<std::mutex> lock{ m_queueMutex };
 
-        if (m_continueProcessing && !m_messageQueue.empty())
+        // this is the earliest time the top message could be due. It's exact once
+        // the message has cascaded down to the lowest level of the timing wheel
+        if (m_continueProcessing && m_messageQueue.GetNextTimestamp(timestamp))
         {
-            timestamp = m_messageQueue.top().Timestamp;
             ret = S_OK;
 
         //    OutputDebugString(L"\n--Retrieved current timestamp\n");
@@ -332,42 +444,213 @@ CMidi2SchedulerMidiTransform::GetTopMessageTimestamp(internal::MidiTimestamp &ti
 }
 
 
-_Use_decl_annotations_
+// Moves everything senders have staged so far into the timing wheel.
 HRESULT
-CMidi2SchedulerMidiTransform::CalculateSafeSleepTime(internal::MidiTimestamp nextWakeupWindowTimestamp, uint32_t & sleepMS)
+CMidi2SchedulerMidiTransform::MergeStagedMessages()
 {
-    if (!m_continueProcessing) return E_FAIL;
+    try
+    {
+        std::lock_guard<std::mutex> lock{ m_queueMutex };
 
-    HRESULT ret = E_FAIL;
-    sleepMS = 0;
+        return MergeStagedMessagesNoLock();
+    }
+    catch (...)
+    {
+        return E_FAIL;
+    }
+}
 
+// Caller must hold m_queueMutex
+HRESULT
+CMidi2SchedulerMidiTransform::MergeStagedMessagesNoLock()
+{
     try
     {
-        auto now = internal::Shared::GetCurrentMidiTimestamp();
+        ScheduledUmpMessage message;
+        uint32_t mergedMessages = 0;
 
-        if (nextWakeupWindowTimestamp > now)
+        // limit this to one lap of the staging queue so busy senders can't keep us here
+        while (mergedMessages < m_stagingQueue.MaxSize() && m_stagingQueue.TryPop(message))
         {
-            auto diff = (nextWakeupWindowTimestamp - now) / m_timestampFrequency;
+            // the queue only throws if it had to grow and couldn't. The message is dropped
+            auto countOnFailure = wil::scope_exit([&]()
+            {
+                m_scheduledMessageCount--;
+            });
 
-            sleepMS = (uint32_t)(diff * 1000);
+            m_messageQueue.Add(message);
 
-            // if the sleep time is under the limit, we don't sleep at all because the timing is not that accurate
-            if (sleepMS < MIDI_SCHEDULER_MINIMUM_EVENT_SLEEP_TIME_MS)
-            {
-                sleepMS = 0;
-            }
+            countOnFailure.release();
+
+            mergedMessages++;
         }
 
         return S_OK;
     }
     catch (...)
     {
-        ret = E_FAIL;
+        return E_FAIL;
     }
+}
 
-    return ret;
+// Called only from the worker thread. Returns when it's time to send a message timestamped
+// wakeupTimestamp, or earlier if a new message has been staged (it may need to go out first)
+// or we're shutting down. Anything further out than the spin window is a sleep on the high
+// resolution timer, which returns with us inside the spin window, and the rest is a spin.
+_Use_decl_annotations_
+HRESULT
+CMidi2SchedulerMidiTransform::WaitUntil(internal::MidiTimestamp wakeupTimestamp)
+{
+    if (!m_continueProcessing) return S_OK;
+
+    auto now = m_clock->GetCurrentTimestamp();
+
+    if (wakeupTimestamp <= now)
+    {
+        return S_OK;
+    }
+
+    uint64_t remainingTicks = wakeupTimestamp - now;
+
+    // a simulated clock can jump forward at any time, so we only sleep on the real one
+    if (remainingTicks > m_spinWindowTicks && m_clock == &shared::MidiSystemClockSource::Instance())
+    {
+        // don't sleep for more than the empty-queue duration in one go. We'll just come
+        // back around. This also keeps the conversion below from overflowing.
+        uint64_t sleepTicks = (std::min)(remainingTicks - m_spinWindowTicks,
+            (uint64_t)MIDI_OUTBOUND_EMPTY_QUEUE_SLEEP_DURATION_MS * m_timestampFrequency / 1000);
+
+        // negative due time is relative, in 100ns units
+        LARGE_INTEGER dueTime{};
+        dueTime.QuadPart = -(LONGLONG)((sleepTicks * 10000000) / m_timestampFrequency);
+
+        if (dueTime.QuadPart < 0 && SetWaitableTimerEx(m_wakeupTimer.get(), &dueTime, 0, nullptr, nullptr, nullptr, 0))
+        {
+            HANDLE handles[] = { m_messageProcessorWakeup.get(), m_wakeupTimer.get() };
+
+            m_timerWaitCount.fetch_add(1, std::memory_order_relaxed);
+
+            // waiting will get interrupted if a new message comes in. We want that.
+            if (WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1)
+            {
+                CancelWaitableTimer(m_wakeupTimer.get());
+            }
+
+            return S_OK;
+        }
+    }
+
+    // within the spin window. New messages are checked for, in case one of them is due
+    // sooner than the one we're waiting on
+    m_spinWaitCount.fetch_add(1, std::memory_order_relaxed);
+
+    auto spinStart = now;
+
+    while (m_continueProcessing && now < wakeupTimestamp && m_stagingQueue.Empty())
+    {
+        YieldProcessor();
+
+        now = m_clock->GetCurrentTimestamp();
+    }
+
+    m_spinTicks.fetch_add(now - spinStart, std::memory_order_relaxed);
+
+    return S_OK;
 }
 
+// Removes messages from sourceId which haven't been sent yet. Messages the worker is
+// sending right now either go out before we get the lock, or are cancelled.
+_Use_decl_annotations_
+HRESULT
+CMidi2SchedulerMidiTransform::CancelScheduledMessages(
+    ULONGLONG sourceId,
+    PMIDI_SCHEDULED_MESSAGE_FILTER filter,
+    UINT32* removedCount)
+{
+    TraceLoggingWrite(
+        MidiSchedulerTransformTelemetryProvider::Provider(),
+        __FUNCTION__,
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingPointer(this, "this"),
+        TraceLoggingUInt64(sourceId, "Source")
+        );
+
+    RETURN_HR_IF_NULL(E_INVALIDARG, filter);
+    RETURN_HR_IF_NULL(E_POINTER, removedCount);
+
+    *removedCount = 0;
+
+    try
+    {
+        std::lock_guard<std::mutex> lock{ m_queueMutex };
+
+        // messages the client sent before cancelling may still be staged
+        RETURN_IF_FAILED(MergeStagedMessagesNoLock());
+
+        *removedCount = m_messageQueue.RemoveMatching(sourceId, *filter);
+
+        m_scheduledMessageCount -= *removedCount;
+    }
+    CATCH_RETURN();
+
+    // the worker may be waiting for a message which is no longer there
+    if (*removedCount > 0 && m_continueProcessing)
+    {
+        m_messageProcessorWakeup.SetEvent();
+    }
+
+    OutputDebugString((std::wstring(L"" __FUNCTION__ " Cancelled messages: ") + std::to_wstring(*removedCount)).c_str());
+
+    return S_OK;
+}
+
+void CMidi2SchedulerMidiTransform::LogDispatchStatistics()
+{
+    uint64_t buckets[MidiDispatchJitterHistogram::BucketCount]{};
+
+    for (uint32_t i = 0; i < MidiDispatchJitterHistogram::BucketCount; i++)
+    {
+        buckets[i] = m_dispatchJitter.BucketValue(i);
+    }
+
+    TraceLoggingWrite(
+        MidiSchedulerTransformTelemetryProvider::Provider(),
+        "SchedulerDispatchStatistics",
+        TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingPointer(this, "this"),
+        TraceLoggingUInt64(m_dispatchJitter.Count(), "Dispatched message count"),
+        TraceLoggingInt64(m_dispatchJitter.MinimumTicks(), "Minimum dispatch delta ticks"),
+        TraceLoggingInt64(m_dispatchJitter.MaximumTicks(), "Maximum dispatch delta ticks"),
+        TraceLoggingUInt64(m_dispatchJitter.TotalLateTicks(), "Total late ticks"),
+        TraceLoggingUInt64FixedArray(buckets, MidiDispatchJitterHistogram::BucketCount, "Dispatch delta histogram"),
+        TraceLoggingUInt64(m_timerWaitCount.load(), "Timer wait count"),
+        TraceLoggingUInt64(m_spinWaitCount.load(), "Spin wait count"),
+        TraceLoggingUInt64(m_spinTicks.load(), "Spin ticks"),
+        TraceLoggingUInt64(m_coalescedSendCount.load(), "Coalesced send count"),
+        TraceLoggingUInt64(m_coalescedMessageCount.load(), "Coalesced message count"),
+        TraceLoggingUInt64(m_spinWindowTicks, "Spin window ticks"),
+        TraceLoggingUInt64(m_timestampFrequency, "Timestamp frequency")
+    );
+}
+
+// Called by the worker each time around its loop. Traces the statistics once the
+// interval has passed, but only if something was dispatched since the last trace, so an
+// idle endpoint doesn't keep writing the same numbers
+void CMidi2SchedulerMidiTransform::LogDispatchStatisticsIfDue()
+{
+    auto now = m_clock->GetCurrentTimestamp();
+
+    if (now - m_lastStatisticsTimestamp < m_timestampFrequency * MIDI_SCHEDULER_STATISTICS_TRACE_INTERVAL_SECONDS) return;
+
+    auto dispatchCount = m_dispatchJitter.Count();
+
+    if (dispatchCount == m_lastStatisticsDispatchCount) return;
+
+    LogDispatchStatistics();
+
+    m_lastStatisticsTimestamp = now;
+    m_lastStatisticsDispatchCount = dispatchCount;
+}
 
 
 void CMidi2SchedulerMidiTransform::QueueWorker()
@@ -380,9 +663,19 @@ void CMidi2SchedulerMidiTransform::QueueWorker()
 
         while (m_continueProcessing)
         {
+            // pick up anything senders have added since last time around
+            LOG_IF_FAILED(MergeStagedMessages());
+
+            // a cancel can empty the queue from another thread, so check under the lock
+            bool queueEmpty{ true };
+            {
+                std::lock_guard<std::mutex> lock{ m_queueMutex };
+                queueEmpty = m_messageQueue.Empty();
+            }
+
             // check to see if the queue is empty, and if so, go to sleep until we're signaled
             // to wake up due to a new message arriving or due to shut down.
-            if (m_continueProcessing && m_messageQueue.empty())
+            if (m_continueProcessing && queueEmpty)
             {
                 OutputDebugString(L"" __FUNCTION__ " queue is empty. About to sleep");
 
@@ -392,7 +685,7 @@ void CMidi2SchedulerMidiTransform::QueueWorker()
                 if (triggered) OutputDebugString(L"" __FUNCTION__ " Wake up from sleep");
 
             }
-            else if (m_continueProcessing && !m_messageQueue.empty())
+            else if (m_continueProcessing && !queueEmpty)
             {
                 internal::MidiTimestamp topTimestamp = 0;
 
@@ -400,57 +693,68 @@ void CMidi2SchedulerMidiTransform::QueueWorker()
                 // each time in case messages were added since last loop iteration
                 if (SUCCEEDED(GetTopMessageTimestamp(topTimestamp)))
                 {
-                    uint64_t nextMessageSendTime = topTimestamp - totalExpectedLatency;
+                    uint64_t nextMessageSendTime = SubtractTicksSaturated(topTimestamp, totalExpectedLatency);
 
                     // check to see if it's time to send the message. If not, we'll just
                     // wrap back around
-                    if (shared::GetCurrentMidiTimestamp() >= nextMessageSendTime)
+                    auto now = m_clock->GetCurrentTimestamp();
+
+                    if (now >= nextMessageSendTime)
                     {
                         std::lock_guard<std::mutex> lock{ m_queueMutex };
 
-                        // we have the queue locked, so send ALL messages that have the *same* timestamp
+                        // we have the queue locked, so send ALL messages that are due now,
                         // but we need to limit the number to send at once here, so we do.
+                        uint32_t sentMessages{ 0 };
 
-                        uint32_t processedMessages = 0;
+                        bool sendFailed = !m_messageQueue.SendDueMessages(
+                            now + totalExpectedLatency,
+                            MIDI_SCHEDULER_MAX_MESSAGES_TO_PROCESS_AT_ONCE,
+                            [&](BYTE const* data, UINT byteCount, uint64_t timestamp, uint32_t messageCount, uint64_t sourceId)
+                            {
+                                auto dispatchTimestamp = m_clock->GetCurrentTimestamp();
 
-                        while (!m_messageQueue.empty() && 
-                            processedMessages < MIDI_SCHEDULER_MAX_MESSAGES_TO_PROCESS_AT_ONCE &&
-                            m_messageQueue.top().Timestamp <= topTimestamp)
-                        {
-                            // send the message
-                            auto hr = SendMidiMessageNow(m_messageQueue.top());
+                                auto hr = m_continueProcessing ? SendMidiMessageNow((PVOID)data, byteCount, (LONGLONG)timestamp, sourceId) : S_OK;
 
-                            if (SUCCEEDED(hr))
-                            {
-                                // pop the top item off the queue
-                                m_messageQueue.pop();
-                            }
-                            else
-                            {
-                                LOG_IF_FAILED(hr);
+                                if (FAILED(hr))
+                                {
+                                    // We'll catch these messages the next time around.
+                                    LOG_IF_FAILED(hr);
+                                    OutputDebugString(L"" __FUNCTION__ " Failed to send MIDI message");
+
+                                    return false;
+                                }
+
+                                for (uint32_t i = 0; i < messageCount; i++)
+                                {
+                                    m_dispatchJitter.Record(
+                                        (int64_t)dispatchTimestamp - (int64_t)SubtractTicksSaturated(timestamp, totalExpectedLatency),
+                                        m_timestampFrequency);
+                                }
+
+                                if (messageCount > 1)
+                                {
+                                    // a chord or a burst of controllers went downstream as one buffer
+                                    m_coalescedSendCount.fetch_add(1, std::memory_order_relaxed);
+                                    m_coalescedMessageCount.fetch_add(messageCount, std::memory_order_relaxed);
+                                }
+
+                                return true;
+                            },
+                            sentMessages);
 
-                                // we failed to send for some reason, so break out of the loop. We'll catch 
-                                // these messages the next time around.
-                                OutputDebugString(L"" __FUNCTION__ " Failed to send MIDI message");
-                                break;
-                            }
+                        m_scheduledMessageCount -= sentMessages;
 
-                            processedMessages++;
+                        if (sendFailed)
+                        {
+                            // give whatever is holding things up a chance to clear before we retry
+                            Sleep(0);
                         }
                     }
                     else
                     {
-                        // not yet time to send the top message, so we'll sleep
-                        uint32_t sleepTime{ 0 };
-
-                        if (m_continueProcessing && SUCCEEDED(CalculateSafeSleepTime(nextMessageSendTime, sleepTime)))
-                        {
-                            if (sleepTime > 0)
-                            {
-                                // waiting will get interrupted if a new message comes in. We want that.
-                                m_messageProcessorWakeup.wait(sleepTime);
-                            }
-                        }
+                        // not yet time to send the top message, so sleep and then spin until it is
+                        LOG_IF_FAILED(WaitUntil(nextMessageSendTime));
                     }
                 }
                 else
@@ -463,14 +767,15 @@ void CMidi2SchedulerMidiTransform::QueueWorker()
 
             if (m_continueProcessing)
             {
-                // we're looping, not sleeping now, so we need to reset this to make sure we don't miss new messages
+                LogDispatchStatisticsIfDue();
+
+                // we're looping, not sleeping now, so we need to reset this to make sure we don't miss new messages.
+                // This happens before we merge staged messages at the top of the loop, so anything
+                // staged after the reset is either merged or sets the event again.
                 if (m_messageProcessorWakeup.is_signaled())
                 {
                     m_messageProcessorWakeup.ResetEvent();
                 }
-
-                // return the rest of the time slice so we're not in a tight loop
-                Sleep(0);
             }
 
         } // main loop
@@ -482,7 +787,7 @@ void CMidi2SchedulerMidiTransform::QueueWorker()
     }
 
     
-    OutputDebugString((std::wstring(L"" __FUNCTION__ " Exit. Abandoned queue size is: ") + std::to_wstring(m_messageQueue.size())).c_str());
+    OutputDebugString((std::wstring(L"" __FUNCTION__ " Exit. Abandoned queue size is: ") + std::to_wstring(m_messageQueue.Size())).c_str());
 
 }
 
@@ -11,84 +11,117 @@
 class CMidi2SchedulerMidiTransform :
     public Microsoft::WRL::RuntimeClass<
         Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
-        IMidiDataTransform>
+        IMidiDataTransform,
+        IMidiSchedulerTransform>
 {
 public:
+    ~CMidi2SchedulerMidiTransform();
 
     STDMETHOD(Initialize(_In_ LPCWSTR, _In_ PTRANSFORMCREATIONPARAMS, _In_ DWORD *, _In_opt_ IMidiCallback *, _In_ LONGLONG, _In_ IUnknown*));
     STDMETHOD(SendMidiMessage(_In_ PVOID message, _In_ UINT size, _In_ LONGLONG));
     STDMETHOD(Cleanup)();
 
+    // IMidiSchedulerTransform
+    STDMETHOD(SendMidiMessageFromSource(_In_ PVOID message, _In_ UINT size, _In_ LONGLONG, _In_ ULONGLONG sourceId));
+    STDMETHOD(CancelScheduledMessages(_In_ ULONGLONG sourceId, _In_ PMIDI_SCHEDULED_MESSAGE_FILTER filter, _Out_ UINT32* removedCount));
+
+    // For running the scheduler in-process against a simulated clock. Call before
+    // Initialize. With any clock other than the system clock, the worker polls the clock
+    // instead of sleeping on its timer, so moving the clock on releases it right away.
+    void SetClockSource(_In_ shared::MidiClockSource* clock) { m_clock = clock; }
+
 private:
 
     HRESULT GetTopMessageTimestamp(_Out_ internal::MidiTimestamp& timestamp);
 
-    HRESULT CalculateSafeSleepTime(_In_ internal::MidiTimestamp nextWakeupWindowTimestamp, _Out_ uint32_t& sleepMS);
+    HRESULT MergeStagedMessages();
+    HRESULT MergeStagedMessagesNoLock();
+
+    HRESULT WaitUntil(_In_ internal::MidiTimestamp wakeupTimestamp);
+
+    void LogDispatchStatistics();
+    void LogDispatchStatisticsIfDue();
 
 
     HRESULT SendMidiMessageNow(
         _In_ PVOID Data,
         _In_ UINT Size,
-        _In_ LONGLONG Timestamp);
+        _In_ LONGLONG Timestamp,
+        _In_ ULONGLONG SourceId);
 
-    HRESULT SendMidiMessageNow(
-        _In_ ScheduledUmpMessage const message);
-
-    // priority queue with comparison set up to compare the timestamps and to preserve order.
-    // We want the smallest timestamp as front/top of the queue. In the case of duplicate timestamps
-    // we want to preserve the order the messages were sent.
-
-    // NOTE: As expected, this works for small-ish numbers of queued messages. But when you start 
-    // getting up into the thousands, the delay becomes larger. Example: just over 1ms for 10,000 
-    // messages. Not really any other std:: options here, at least for the data structure we need. 
-    // It's already using a heap / tree underneath, which is efficient for finding messages.
-    // 
-    // Consider a separate thread for writing to the queue to make that return quickly.
-
-    std::priority_queue<ScheduledUmpMessage, std::deque<ScheduledUmpMessage>, auto(*)(ScheduledUmpMessage&, ScheduledUmpMessage&)->bool>
-        m_messageQueue{ [](_In_ ScheduledUmpMessage& left, _In_ ScheduledUmpMessage& right) ->
-            bool
-            {
-                if (left.Timestamp == right.Timestamp)
-                {
-                    // preserve receive order for messages with the same timestamp
-                    return left.ReceivedIndex > right.ReceivedIndex;
-                }
-                else
-                {
-                    return left.Timestamp > right.Timestamp;
-                }
-            } };
+
+    // messages waiting for their send time. See MidiScheduledMessageQueue
+    MidiScheduledMessageQueue m_messageQueue;
+
+    // SendMidiMessage pushes into this without taking any lock, so senders never wait
+    // while the worker is dispatching. The worker, or a cancel, pops from it under
+    // m_queueMutex, merging the messages into m_messageQueue.
+    MidiMpscQueue<ScheduledUmpMessage, MIDI_SCHEDULER_STAGING_QUEUE_SIZE> m_stagingQueue;
+
+    // messages which are either staged or in m_messageQueue. This is what we check
+    // against MIDI_OUTGOING_MESSAGE_QUEUE_MAX_MESSAGE_COUNT
+    std::atomic<uint32_t> m_scheduledMessageCount{ 0 };
 
     // this is the minimum amount of ticks into the future to send immediately vs scheduling
     // it is essentially our resolution, and will need to be set based on calculating
     // the actual wake-up frequency
     uint64_t m_tickWindow{ MIDI_SCHEDULER_LOCK_AND_SEND_FUNCTION_LATENCY_TICKS + MIDI_SCHEDULER_ENQUEUE_OVERHEAD_LATENCY_TICKS };
 
-    // TODO: we may allow device latency to be set for the device as a property value with key
-    // PKEY_MIDI_MidiOutLatencyTicks. We'd then pre-fetch from the queue by this amount.
+    // Read from the endpoint at Initialize. This is PKEY_MIDI_MidiOutCalculatedLatencyTicks, set
+    // by calibrating the endpoint, unless PKEY_MIDI_MidiOutLatencyTicksUserOverride is set, in
+    // which case it's PKEY_MIDI_MidiOutUserSuppliedLatencyTicks. We pre-fetch from the queue by this amount.
     uint64_t m_deviceLatencyTicks{ 0 };
 
     void QueueWorker();
+    void StopQueueWorker();
     
     IMidiCallback* m_callback{ nullptr };
     LONGLONG m_context{ 0 };
 
     //wil::critical_section m_queueLock;
 
+    // held while using m_messageQueue. Senders do not take it.
     std::mutex m_queueMutex;
 
-    uint64_t m_currentReceivedIndex{ 0 };     // need to use the queueLock before writing to this
-
     //bool m_continueProcessing{ true };
     std::atomic<bool> m_continueProcessing{ true };
 
     std::thread m_queueWorkerThread;
 
-    //wil::unique_event_nothrow m_messageProcessorWakeup;
-    wil::slim_event_manual_reset m_messageProcessorWakeup;
+    // manual reset. This is a real event rather than a slim event so the worker can wait on
+    // it together with m_wakeupTimer
+    wil::unique_event_nothrow m_messageProcessorWakeup;
+
+    // high resolution waitable timer the worker sleeps on until it is within
+    // m_spinWindowTicks of the next send time
+    wil::unique_handle m_wakeupTimer;
+
+    // how close to the send time we stop sleeping and spin instead. Timer wakeups are only
+    // accurate to somewhere around half a millisecond, so this is what gets us the rest
+    uint64_t m_spinWindowTicks{ 0 };
+
+    // actual dispatch time minus target send time for every message sent from the queue
+    MidiDispatchJitterHistogram m_dispatchJitter;
+
+    // what the waiting costs us, for comparing against m_dispatchJitter
+    std::atomic<uint64_t> m_timerWaitCount{ 0 };
+    std::atomic<uint64_t> m_spinWaitCount{ 0 };
+    std::atomic<uint64_t> m_spinTicks{ 0 };
+
+    // callbacks which carried more than one message, and the messages they carried
+    std::atomic<uint64_t> m_coalescedSendCount{ 0 };
+    std::atomic<uint64_t> m_coalescedMessageCount{ 0 };
+
+    // when the worker last traced the statistics, and how many messages had been
+    // dispatched then. Only the worker uses these
+    uint64_t m_lastStatisticsTimestamp{ 0 };
+    uint64_t m_lastStatisticsDispatchCount{ 0 };
+
+    // everything the scheduler decides is based on this clock. It's the module's clock
+    // source (see shared::SetMidiClockSource) unless SetClockSource was called before Initialize
+    shared::MidiClockSource* m_clock{ &shared::GetMidiClockSource() };
 
-    uint64_t m_timestampFrequency = internal::Shared::GetMidiTimestampFrequency();
+    uint64_t m_timestampFrequency{ 0 };
 };
 
 
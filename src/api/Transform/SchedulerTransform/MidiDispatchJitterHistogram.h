@@ -0,0 +1,114 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Histogram of how far from its target time the scheduler actually dispatched each
+// message. The difference is recorded in ticks of the MIDI timestamp clock and
+// bucketed in microseconds:
+//
+//   bucket 0       dispatched early
+//   bucket 1       0 to under 1us late
+//   bucket n       2^(n-2) to under 2^(n-1) us late
+//   last bucket    everything later than that, including anything that came out of
+//                  the queue after a long delay
+//
+// Only the scheduler worker records, but the counters are atomics so anyone can read
+// them (relaxed, so a reader may see a count and the totals from slightly different
+// moments). Recording is a handful of instructions and doesn't allocate, so this is
+// always on.
+
+class MidiDispatchJitterHistogram
+{
+public:
+    static constexpr uint32_t BucketCount{ 24 };
+
+    MidiDispatchJitterHistogram() = default;
+
+    MidiDispatchJitterHistogram(MidiDispatchJitterHistogram const&) = delete;
+    MidiDispatchJitterHistogram& operator=(MidiDispatchJitterHistogram const&) = delete;
+
+    void Record(_In_ int64_t deltaTicks, _In_ uint64_t timestampFrequency) noexcept
+    {
+        m_buckets[BucketIndex(deltaTicks, timestampFrequency)].fetch_add(1, std::memory_order_relaxed);
+
+        m_count.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t lateTicks = deltaTicks > 0 ? (uint64_t)deltaTicks : 0;
+        m_totalLateTicks.fetch_add(lateTicks, std::memory_order_relaxed);
+
+        if (m_count.load(std::memory_order_relaxed) == 1 || deltaTicks < m_minimumTicks.load(std::memory_order_relaxed))
+        {
+            m_minimumTicks.store(deltaTicks, std::memory_order_relaxed);
+        }
+
+        if (m_count.load(std::memory_order_relaxed) == 1 || deltaTicks > m_maximumTicks.load(std::memory_order_relaxed))
+        {
+            m_maximumTicks.store(deltaTicks, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t Count() const noexcept { return m_count.load(std::memory_order_relaxed); }
+    uint64_t BucketValue(_In_ uint32_t bucket) const noexcept { return bucket < BucketCount ? m_buckets[bucket].load(std::memory_order_relaxed) : 0; }
+    uint64_t TotalLateTicks() const noexcept { return m_totalLateTicks.load(std::memory_order_relaxed); }
+    int64_t MinimumTicks() const noexcept { return m_minimumTicks.load(std::memory_order_relaxed); }
+    int64_t MaximumTicks() const noexcept { return m_maximumTicks.load(std::memory_order_relaxed); }
+
+    // exclusive upper bound of the bucket, in microseconds. 0 for the early bucket
+    // and UINT64_MAX for the last one.
+    static constexpr uint64_t BucketUpperBoundMicroseconds(_In_ uint32_t bucket) noexcept
+    {
+        return bucket == 0 ? 0 : (bucket + 1 >= BucketCount ? UINT64_MAX : (uint64_t)1 << (bucket - 1));
+    }
+
+    static uint32_t BucketIndex(_In_ int64_t deltaTicks, _In_ uint64_t timestampFrequency) noexcept
+    {
+        if (deltaTicks < 0)
+        {
+            return 0;
+        }
+
+        uint64_t microseconds = timestampFrequency > 0 ?
+            (uint64_t)deltaTicks / timestampFrequency * 1000000 + ((uint64_t)deltaTicks % timestampFrequency) * 1000000 / timestampFrequency :
+            0;
+
+        uint32_t bucket = 1;
+
+        while (bucket + 1 < BucketCount && microseconds >= BucketUpperBoundMicroseconds(bucket))
+        {
+            bucket++;
+        }
+
+        return bucket;
+    }
+
+    void Reset() noexcept
+    {
+        for (auto& bucket : m_buckets)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+
+        m_count.store(0, std::memory_order_relaxed);
+        m_totalLateTicks.store(0, std::memory_order_relaxed);
+        m_minimumTicks.store(0, std::memory_order_relaxed);
+        m_maximumTicks.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> m_buckets[BucketCount]{};
+
+    std::atomic<uint64_t> m_count{ 0 };
+    std::atomic<uint64_t> m_totalLateTicks{ 0 };
+    std::atomic<int64_t> m_minimumTicks{ 0 };
+    std::atomic<int64_t> m_maximumTicks{ 0 };
+};
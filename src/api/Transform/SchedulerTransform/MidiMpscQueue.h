@@ -0,0 +1,198 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free multi-producer, single-consumer ring.
+//
+// This is the staging area between the threads calling SendMidiMessage on the
+// scheduler and the scheduler's worker thread. Producers only ever touch the
+// enqueue position and the cell they reserve, so a send never waits on the worker
+// while it is dispatching. The consumer side merges what it pops into the timing
+// wheel. That is normally the worker, but a cancel merges too, so consumer calls
+// only need to be serialized (the scheduler does it with its queue lock), not
+// made from a single thread.
+//
+// Each cell carries a sequence number which says whether it is free for the
+// producer of a given lap, or holds data for the consumer. A producer reserves a
+// cell with a compare-exchange on the enqueue position, fills it in, and then
+// publishes it by bumping the cell's sequence number. Entries come out in the order
+// the producers reserved their cells.
+//
+// Capacity must be a power of two.
+
+template <typename TEntry, uint32_t Capacity>
+class MidiMpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MidiMpscQueue() :
+        m_cells(new Cell[Capacity])
+    {
+        for (uint32_t i = 0; i < Capacity; i++)
+        {
+            m_cells[i].Sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MidiMpscQueue(MidiMpscQueue const&) = delete;
+    MidiMpscQueue& operator=(MidiMpscQueue const&) = delete;
+
+    // Safe to call from any number of threads. Returns false if the ring is full.
+    template <typename... TArgs>
+    bool TryPush(TArgs&&... args)
+    {
+        uint64_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+        Cell* cell{ nullptr };
+
+        for (;;)
+        {
+            cell = &m_cells[position & (Capacity - 1)];
+
+            uint64_t sequence = cell->Sequence.load(std::memory_order_acquire);
+            int64_t difference = (int64_t)sequence - (int64_t)position;
+
+            if (difference == 0)
+            {
+                // cell is free for this lap. Try to claim it. On failure, position
+                // is updated to the current enqueue position and we go around again
+                if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                // the consumer hasn't freed this cell from the previous lap yet
+                return false;
+            }
+            else
+            {
+                // another producer got here first
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->Entry = TEntry(std::forward<TArgs>(args)...);
+        cell->Sequence.store(position + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Safe to call from any number of threads. Claims count cells in a row, so either
+    // all of the entries go in, one after the other, or none do. makeEntry(i) builds
+    // entry i. Returns false if there isn't room for all of them.
+    //
+    // The consumer frees cells in order, so if the last of the cells is free for this
+    // lap, the ones before it are too.
+    template <typename TMakeEntry>
+    bool TryPushMany(_In_ uint32_t count, _In_ TMakeEntry&& makeEntry)
+    {
+        if (count == 0)
+        {
+            return true;
+        }
+
+        if (count > Capacity)
+        {
+            return false;
+        }
+
+        uint64_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            uint64_t last = position + count - 1;
+            uint64_t sequence = m_cells[last & (Capacity - 1)].Sequence.load(std::memory_order_acquire);
+            int64_t difference = (int64_t)sequence - (int64_t)last;
+
+            if (difference == 0)
+            {
+                if (m_enqueuePosition.compare_exchange_weak(position, position + count, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                // the consumer hasn't freed all of the cells from the previous lap yet
+                return false;
+            }
+            else
+            {
+                // another producer got here first
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            Cell& cell = m_cells[(position + i) & (Capacity - 1)];
+
+            cell.Entry = makeEntry(i);
+            cell.Sequence.store(position + i + 1, std::memory_order_release);
+        }
+
+        return true;
+    }
+
+    // Consumer only. Returns false if there is nothing published to pop. An
+    // entry which has been reserved but not yet published holds up the entries
+    // behind it, which keeps them in order.
+    bool TryPop(_Out_ TEntry& entry)
+    {
+        uint64_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+        Cell& cell = m_cells[position & (Capacity - 1)];
+
+        if (cell.Sequence.load(std::memory_order_acquire) != position + 1)
+        {
+            return false;
+        }
+
+        entry = std::move(cell.Entry);
+        cell.Sequence.store(position + Capacity, std::memory_order_release);
+
+        m_dequeuePosition.store(position + 1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    // Safe to call from any thread, but only a hint while a pop may be in progress.
+    bool Empty() const
+    {
+        uint64_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+
+        return m_cells[position & (Capacity - 1)].Sequence.load(std::memory_order_acquire) != position + 1;
+    }
+
+    static constexpr uint32_t MaxSize() { return Capacity; }
+
+private:
+    struct Cell
+    {
+        std::atomic<uint64_t> Sequence{ 0 };
+        TEntry Entry{};
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+
+    // producers and the consumer are kept on separate cache lines. This is padding
+    // rather than alignas so the owning class doesn't need over-aligned allocation
+    uint8_t m_leadingPadding[64]{};
+    std::atomic<uint64_t> m_enqueuePosition{ 0 };
+    uint8_t m_enqueuePadding[64 - sizeof(std::atomic<uint64_t>)]{};
+    std::atomic<uint64_t> m_dequeuePosition{ 0 };
+    uint8_t m_dequeuePadding[64 - sizeof(std::atomic<uint64_t>)]{};
+};
@@ -0,0 +1,417 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "MidiSlabPool.h"
+
+// Secondary index of the scheduler's queued messages, used to cancel them.
+//
+// The timing wheel can only hand messages back in time order, so finding "this
+// client's group 3 notes" there means walking the whole queue. This index keeps one
+// list per source and per message type, group and channel, each sorted by timestamp.
+// A cancel only visits the lists its filter selects, and within a list walks in from
+// whichever end the timestamp range is open at, so clearing everything, or everything
+// from a given time on, touches only the messages it removes. A range bounded on
+// both ends also steps over the messages after its end.
+//
+// Messages are normally scheduled in time order, so an add is O(1): the new entry
+// goes on the end of its list. An entry which is earlier than the end of its list is
+// walked back into place.
+//
+// Values are opaque to the index. The scheduler uses the payload slot, and gets it
+// back for each message a cancel removes.
+//
+// A source is dropped from the index as soon as its last message is removed, whether
+// sent or cancelled, so clients coming and going don't leave anything behind. Its
+// buckets go on a free list for the next source, and a few emptied sources are kept
+// for reuse, so a client which sends one message at a time doesn't allocate a new
+// key table each time.
+//
+// This class is not thread safe. The owner is responsible for locking.
+//
+// TFilter must have USHORT-compatible GroupMask, ChannelMask and MessageTypeMask
+// members, and uint64_t-compatible EarliestTimestamp and LatestTimestamp members.
+
+template <uint32_t ChunkSize>
+class MidiScheduledMessageIndex
+{
+public:
+    static constexpr uint32_t InvalidHandle{ UINT32_MAX };
+
+    MidiScheduledMessageIndex() = default;
+
+    MidiScheduledMessageIndex(MidiScheduledMessageIndex const&) = delete;
+    MidiScheduledMessageIndex& operator=(MidiScheduledMessageIndex const&) = delete;
+
+    uint32_t Size() const noexcept { return m_nodes.Size(); }
+
+    // sources with messages in the index
+    uint32_t SourceCount() const noexcept { return (uint32_t)m_sources.size(); }
+
+    // buckets allocated, in use or free
+    uint32_t BucketCapacity() const noexcept { return (uint32_t)m_buckets.size(); }
+
+    void Reserve(_In_ uint32_t count) { m_nodes.Reserve(count); }
+
+    // firstWord is the first 32 bit word of the UMP, which is all we need to know
+    // its type, group and channel. Returns a handle for Remove.
+    uint32_t Add(_In_ uint64_t sourceId, _In_ uint32_t firstWord, _In_ uint64_t timestamp, _In_ uint32_t value)
+    {
+        // both of these can allocate, so they happen before anything is linked
+        auto& source = GetOrAddSource(sourceId);
+        uint32_t bucket = GetOrAddBucket(sourceId, source, BucketKey(firstWord));
+        uint32_t node = m_nodes.Allocate(Node{ timestamp, value, bucket, InvalidHandle, InvalidHandle });
+
+        InsertSorted(m_buckets[bucket], node);
+        source.NodeCount++;
+
+        return node;
+    }
+
+    // Removes a single entry. This is how the scheduler drops a message it has sent.
+    void Remove(_In_ uint32_t handle) noexcept
+    {
+        auto& bucket = m_buckets[m_nodes.Get(handle).Bucket];
+
+        Unlink(bucket, handle);
+        m_nodes.Free(handle);
+
+        auto source = m_sources.find(bucket.SourceId);
+
+        if (source != m_sources.end() && --source->second.NodeCount == 0)
+        {
+            ReleaseSource(source);
+        }
+    }
+
+    // Removes every entry from sourceId which the filter selects, calling onRemoved
+    // with the value of each one. Returns the number removed.
+    template <typename TFilter, typename TOnRemoved>
+    uint32_t RemoveMatching(_In_ uint64_t sourceId, _In_ TFilter const& filter, _In_ TOnRemoved&& onRemoved)
+    {
+        auto source = m_sources.find(sourceId);
+
+        if (source == m_sources.end() || filter.EarliestTimestamp > filter.LatestTimestamp)
+        {
+            return 0;
+        }
+
+        uint32_t removedCount{ 0 };
+
+        for (auto bucketIndex : source->second.Buckets)
+        {
+            auto& bucket = m_buckets[bucketIndex];
+
+            if (bucket.Head == InvalidHandle || !MatchesKey(filter, bucket.Key))
+            {
+                continue;
+            }
+
+            if (filter.EarliestTimestamp == 0)
+            {
+                // everything up to the end of the range is at the front
+                uint32_t node = bucket.Head;
+
+                while (node != InvalidHandle && m_nodes.Get(node).Timestamp <= filter.LatestTimestamp)
+                {
+                    uint32_t next = m_nodes.Get(node).Next;
+
+                    RemoveAndNotify(bucket, node, onRemoved);
+                    removedCount++;
+
+                    node = next;
+                }
+            }
+            else
+            {
+                uint32_t node = bucket.Tail;
+
+                while (node != InvalidHandle && m_nodes.Get(node).Timestamp >= filter.EarliestTimestamp)
+                {
+                    uint32_t prev = m_nodes.Get(node).Prev;
+
+                    if (m_nodes.Get(node).Timestamp <= filter.LatestTimestamp)
+                    {
+                        RemoveAndNotify(bucket, node, onRemoved);
+                        removedCount++;
+                    }
+
+                    node = prev;
+                }
+            }
+        }
+
+        // not while walking its buckets
+        source->second.NodeCount -= removedCount;
+
+        if (source->second.NodeCount == 0)
+        {
+            ReleaseSource(source);
+        }
+
+        return removedCount;
+    }
+
+    void Clear()
+    {
+        m_nodes.Clear();
+        m_buckets.clear();
+        m_freeBuckets.clear();
+        m_sources.clear();
+        m_spareSources.clear();
+    }
+
+    // bucket key for a message: its type, its group if it has one, and its channel if
+    // it is a channel voice message
+    static uint32_t BucketKey(_In_ uint32_t firstWord) noexcept
+    {
+        uint32_t messageType = firstWord >> 28;
+        uint32_t group = NoGroup;
+        uint32_t channel = NoChannel;
+
+        // utility and stream messages are not addressed to a group
+        if (messageType != 0x0 && messageType != 0xF)
+        {
+            group = (firstWord >> 24) & 0x0F;
+        }
+
+        // MIDI 1.0 and MIDI 2.0 channel voice messages
+        if (messageType == 0x2 || messageType == 0x4)
+        {
+            channel = (firstWord >> 16) & 0x0F;
+        }
+
+        return (messageType * (NoGroup + 1) + group) * (NoChannel + 1) + channel;
+    }
+
+    // A message with no group (or no channel) only matches a filter which selects all
+    // of them, so "cancel group 2" never takes out the stream messages.
+    template <typename TFilter>
+    static bool MatchesKey(_In_ TFilter const& filter, _In_ uint32_t key) noexcept
+    {
+        uint32_t channel = key % (NoChannel + 1);
+        uint32_t group = (key / (NoChannel + 1)) % (NoGroup + 1);
+        uint32_t messageType = key / ((NoChannel + 1) * (NoGroup + 1));
+
+        if (((uint32_t)filter.MessageTypeMask & (1u << messageType)) == 0)
+        {
+            return false;
+        }
+
+        if (group == NoGroup ? (uint16_t)filter.GroupMask != AllBits : ((uint32_t)filter.GroupMask & (1u << group)) == 0)
+        {
+            return false;
+        }
+
+        if (channel == NoChannel ? (uint16_t)filter.ChannelMask != AllBits : ((uint32_t)filter.ChannelMask & (1u << channel)) == 0)
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    static constexpr uint32_t NoGroup{ 16 };
+    static constexpr uint32_t NoChannel{ 16 };
+    static constexpr uint32_t BucketKeyCount{ 16 * (NoGroup + 1) * (NoChannel + 1) };
+    static constexpr uint16_t AllBits{ 0xFFFF };
+
+    // emptied sources kept for reuse, key table and all
+    static constexpr uint32_t MaximumSpareSourceCount{ 4 };
+
+    struct Node
+    {
+        uint64_t Timestamp;
+        uint32_t Value;
+        uint32_t Bucket;
+        uint32_t Prev;
+        uint32_t Next;
+    };
+
+    struct Bucket
+    {
+        uint32_t Key{ 0 };
+        uint32_t Head{ InvalidHandle };
+        uint32_t Tail{ InvalidHandle };
+        uint64_t SourceId{ 0 };
+    };
+
+    struct Source
+    {
+        // bucket for each key, indexed by key. Allocated the first time the source adds
+        std::vector<uint32_t> BucketByKey;
+
+        // buckets this source has used, so a cancel doesn't look at every key
+        std::vector<uint32_t> Buckets;
+
+        // entries in all of those buckets. The source is released when this gets to 0
+        uint32_t NodeCount{ 0 };
+    };
+
+    Source& GetOrAddSource(_In_ uint64_t sourceId)
+    {
+        auto existing = m_sources.find(sourceId);
+
+        if (existing != m_sources.end())
+        {
+            return existing->second;
+        }
+
+        if (!m_spareSources.empty())
+        {
+            auto& source = m_sources.emplace(sourceId, std::move(m_spareSources.back())).first->second;
+            m_spareSources.pop_back();
+
+            return source;
+        }
+
+        m_spareSources.reserve(MaximumSpareSourceCount);
+
+        auto& source = m_sources[sourceId];
+        source.BucketByKey.assign(BucketKeyCount, InvalidHandle);
+
+        return source;
+    }
+
+    uint32_t GetOrAddBucket(_In_ uint64_t sourceId, _In_ Source& source, _In_ uint32_t key)
+    {
+        if (source.BucketByKey[key] == InvalidHandle)
+        {
+            source.Buckets.reserve(source.Buckets.size() + 1);
+
+            uint32_t bucket{ 0 };
+
+            if (!m_freeBuckets.empty())
+            {
+                bucket = m_freeBuckets.back();
+                m_freeBuckets.pop_back();
+
+                m_buckets[bucket] = Bucket{ key, InvalidHandle, InvalidHandle, sourceId };
+            }
+            else
+            {
+                bucket = (uint32_t)m_buckets.size();
+
+                m_freeBuckets.reserve(m_buckets.size() + 1);
+                m_buckets.push_back(Bucket{ key, InvalidHandle, InvalidHandle, sourceId });
+            }
+
+            source.Buckets.push_back(bucket);
+            source.BucketByKey[key] = bucket;
+        }
+
+        return source.BucketByKey[key];
+    }
+
+    // Called once the source has nothing left in the index. Its buckets are all empty,
+    // so they go back on the free list.
+    void ReleaseSource(_In_ typename std::unordered_map<uint64_t, Source>::iterator source) noexcept
+    {
+        auto& released = source->second;
+
+        for (auto bucket : released.Buckets)
+        {
+            released.BucketByKey[m_buckets[bucket].Key] = InvalidHandle;
+
+            // reserved as buckets were added, so this doesn't allocate
+            m_freeBuckets.push_back(bucket);
+        }
+
+        released.Buckets.clear();
+
+        if (m_spareSources.size() < MaximumSpareSourceCount)
+        {
+            // spare capacity is reserved up front, so this doesn't allocate either
+            m_spareSources.push_back(std::move(released));
+        }
+
+        m_sources.erase(source);
+    }
+
+    void InsertSorted(_In_ Bucket& bucket, _In_ uint32_t node) noexcept
+    {
+        auto& entry = m_nodes.Get(node);
+
+        // find the last entry at or before the new one, starting from the end
+        uint32_t after = bucket.Tail;
+
+        while (after != InvalidHandle && m_nodes.Get(after).Timestamp > entry.Timestamp)
+        {
+            after = m_nodes.Get(after).Prev;
+        }
+
+        entry.Prev = after;
+        entry.Next = after == InvalidHandle ? bucket.Head : m_nodes.Get(after).Next;
+
+        if (entry.Prev == InvalidHandle)
+        {
+            bucket.Head = node;
+        }
+        else
+        {
+            m_nodes.Get(entry.Prev).Next = node;
+        }
+
+        if (entry.Next == InvalidHandle)
+        {
+            bucket.Tail = node;
+        }
+        else
+        {
+            m_nodes.Get(entry.Next).Prev = node;
+        }
+    }
+
+    void Unlink(_In_ Bucket& bucket, _In_ uint32_t node) noexcept
+    {
+        auto& entry = m_nodes.Get(node);
+
+        if (entry.Prev == InvalidHandle)
+        {
+            bucket.Head = entry.Next;
+        }
+        else
+        {
+            m_nodes.Get(entry.Prev).Next = entry.Next;
+        }
+
+        if (entry.Next == InvalidHandle)
+        {
+            bucket.Tail = entry.Prev;
+        }
+        else
+        {
+            m_nodes.Get(entry.Next).Prev = entry.Prev;
+        }
+    }
+
+    template <typename TOnRemoved>
+    void RemoveAndNotify(_In_ Bucket& bucket, _In_ uint32_t node, _In_ TOnRemoved& onRemoved)
+    {
+        uint32_t value = m_nodes.Get(node).Value;
+
+        Unlink(bucket, node);
+        m_nodes.Free(node);
+
+        onRemoved(value);
+    }
+
+    MidiSlabPool<Node, ChunkSize> m_nodes;
+    std::vector<Bucket> m_buckets;
+    std::vector<uint32_t> m_freeBuckets;
+    std::unordered_map<uint64_t, Source> m_sources;
+    std::vector<Source> m_spareSources;
+};
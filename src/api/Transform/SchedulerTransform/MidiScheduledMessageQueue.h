@@ -0,0 +1,224 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "MidiTimingWheel.h"
+#include "MidiSlabPool.h"
+#include "MidiScheduledMessageIndex.h"
+
+// The scheduler's queue of messages waiting for their send time, and the logic for
+// sending them once they're due.
+//
+// This knows nothing about threads, waiting or the clock. The caller says what time it
+// is when it asks for the due messages, and gets them back through a callback. The
+// scheduler transform wraps this with its staging queue, worker thread and timers, and
+// reads the time from its clock source. Tests drive it directly with a simulated clock,
+// so hours of traffic go through it in seconds with the exact same results every run.
+//
+// Messages come out in timestamp order, and in the order they were added for equal
+// timestamps.
+//
+// This class is not thread safe. The owner is responsible for locking.
+
+class MidiScheduledMessageQueue
+{
+public:
+    MidiScheduledMessageQueue() = default;
+
+    MidiScheduledMessageQueue(MidiScheduledMessageQueue const&) = delete;
+    MidiScheduledMessageQueue& operator=(MidiScheduledMessageQueue const&) = delete;
+
+    size_t Size() const noexcept { return m_messageQueue.Size(); }
+    bool Empty() const noexcept { return m_messageQueue.Empty(); }
+
+    // warm up the storage so typical queue sizes don't need to allocate
+    void Reserve(_In_ uint32_t count)
+    {
+        m_messageQueue.Reserve(count);
+        m_messagePayloads.Reserve(count);
+        m_messageIndex.Reserve(count);
+    }
+
+    // When set, due messages which share a timestamp and a sender are handed to the send
+    // callback together, one after another in a single buffer.
+    void SetCoalesceSameTimestamp(_In_ bool coalesce) noexcept { m_coalesceSameTimestamp = coalesce; }
+
+    // The message must be a whole UMP. Throws if the queue had to grow and couldn't, in
+    // which case the message isn't added.
+    void Add(_In_ ScheduledUmpMessage const& message)
+    {
+        // recycle the received index whenever the queue is empty. Prevents long-term wrapping
+        if (m_messageQueue.Empty())
+        {
+            m_currentReceivedIndex = 0;
+        }
+
+        uint32_t slot = m_messagePayloads.Allocate(message.ByteCount, message.Data, message.SourceId);
+        auto& payload = m_messagePayloads.Get(slot);
+
+        uint32_t firstWord{ 0 };
+        memcpy(&firstWord, message.Data, sizeof(firstWord));
+
+        // the index and the wheel only throw if they had to grow and couldn't
+        try
+        {
+            payload.IndexHandle = m_messageIndex.Add(message.SourceId, firstWord, message.Timestamp, slot);
+
+            try
+            {
+                payload.WheelHandle = m_messageQueue.Emplace(message.Timestamp, ++m_currentReceivedIndex, slot);
+            }
+            catch (...)
+            {
+                m_messageIndex.Remove(payload.IndexHandle);
+                throw;
+            }
+        }
+        catch (...)
+        {
+            m_messagePayloads.Free(slot);
+            throw;
+        }
+    }
+
+    // Earliest time at which a message could be due. See MidiTimingWheel::GetNextTimestamp
+    bool GetNextTimestamp(_Out_ uint64_t& timestamp) const
+    {
+        return m_messageQueue.GetNextTimestamp(timestamp);
+    }
+
+    // Sends messages with a timestamp at or before dueTimestamp, up to maximumMessageCount
+    // of them, calling
+    //
+    //   bool send(BYTE const* data, UINT byteCount, uint64_t timestamp, uint32_t messageCount, uint64_t sourceId)
+    //
+    // for each message, or each run of same-timestamp messages from one sender when
+    // coalescing. The device pipe needs to know who sent what, so runs never mix senders. Messages
+    // are removed once send returns true. If it returns false, they stay queued and this
+    // returns false. sentCount is the number of messages sent and removed.
+    template <typename TSend>
+    bool SendDueMessages(_In_ uint64_t dueTimestamp, _In_ uint32_t maximumMessageCount, _In_ TSend&& send, _Out_ uint32_t& sentCount)
+    {
+        sentCount = 0;
+
+        ScheduledUmpMessageKey const* message{ nullptr };
+
+        // If the top timestamp was only the start of a wheel slot, this may just cascade
+        // the slot and send nothing this time around.
+        while (sentCount < maximumMessageCount && (message = m_messageQueue.PeekDue(dueTimestamp)) != nullptr)
+        {
+            auto timestamp = message->Timestamp;
+
+            uint32_t messageCount{ 1 };
+            bool sent{ false };
+
+            if (m_coalesceSameTimestamp)
+            {
+                UINT byteCount{ 0 };
+                messageCount = CoalesceDueMessages(maximumMessageCount - sentCount, byteCount);
+
+                sent = send((BYTE const*)m_coalescedMessages, byteCount, timestamp, messageCount, m_messagePayloads.Get(message->Slot).SourceId);
+            }
+            else
+            {
+                auto& payload = m_messagePayloads.Get(message->Slot);
+
+                sent = send((BYTE const*)payload.Data, payload.ByteCount, timestamp, messageCount, payload.SourceId);
+            }
+
+            if (!sent)
+            {
+                return false;
+            }
+
+            // each message we sent is at the front of the queue in turn
+            for (uint32_t i = 0; i < messageCount; i++)
+            {
+                uint32_t slot = m_messageQueue.PeekDue(timestamp)->Slot;
+
+                m_messageQueue.Pop();
+                m_messageIndex.Remove(m_messagePayloads.Get(slot).IndexHandle);
+                m_messagePayloads.Free(slot);
+            }
+
+            sentCount += messageCount;
+        }
+
+        return true;
+    }
+
+    // Removes messages from sourceId which the filter selects. Returns the number removed.
+    // TFilter is as for MidiScheduledMessageIndex::RemoveMatching
+    template <typename TFilter>
+    uint32_t RemoveMatching(_In_ uint64_t sourceId, _In_ TFilter const& filter)
+    {
+        return m_messageIndex.RemoveMatching(sourceId, filter, [&](uint32_t slot)
+        {
+            m_messageQueue.Remove(m_messagePayloads.Get(slot).WheelHandle);
+            m_messagePayloads.Free(slot);
+        });
+    }
+
+private:
+    // Packs the due message PeekDue just returned, and the messages queued behind it with
+    // the same timestamp and sender, into m_coalescedMessages. Returns how many were
+    // packed, which is at least one.
+    uint32_t CoalesceDueMessages(_In_ uint32_t maximumMessageCount, _Out_ UINT& byteCount)
+    {
+        byteCount = 0;
+
+        uint64_t sourceId{ 0 };
+
+        return m_messageQueue.VisitDueRun([&](ScheduledUmpMessageKey const& key)
+        {
+            auto& payload = m_messagePayloads.Get(key.Slot);
+
+            if (byteCount == 0)
+            {
+                sourceId = payload.SourceId;
+            }
+
+            if (byteCount + payload.ByteCount > sizeof(m_coalescedMessages) || maximumMessageCount == 0 || payload.SourceId != sourceId)
+            {
+                return false;
+            }
+
+            memcpy(m_coalescedMessages + byteCount, payload.Data, payload.ByteCount);
+
+            byteCount += payload.ByteCount;
+            maximumMessageCount--;
+
+            return true;
+        });
+    }
+
+    // Messages are ordered by timestamp and, for duplicate timestamps, by the order they
+    // were received. This used to be a std::priority_queue, but the O(log n) insert and
+    // remove became a noticeable delay once thousands of messages were queued. The
+    // timing wheel gives us O(1) enqueue and amortized O(1) expiry at any queue size.
+    // The wheel only holds keys. The payloads stay put in m_messagePayloads, so
+    // cascading moves 32 byte nodes instead of whole messages.
+    MidiTimingWheel<ScheduledUmpMessageKey> m_messageQueue;
+
+    // payloads of the messages in m_messageQueue, indexed by ScheduledUmpMessageKey::Slot
+    MidiSlabPool<ScheduledUmpPayload, MIDI_SCHEDULER_PAYLOAD_POOL_CHUNK_SIZE> m_messagePayloads;
+
+    // the same messages again, by sender and by message type, group and channel, so a
+    // cancel only has to look at the messages it removes. Kept in step with m_messageQueue
+    MidiScheduledMessageIndex<MIDI_SCHEDULER_PAYLOAD_POOL_CHUNK_SIZE> m_messageIndex;
+
+    uint64_t m_currentReceivedIndex{ 0 };
+
+    bool m_coalesceSameTimestamp{ MIDI_SCHEDULER_DEFAULT_COALESCE_SAME_TIMESTAMP != 0 };
+    BYTE m_coalescedMessages[MIDI_SCHEDULER_MAX_COALESCED_BYTE_COUNT]{};
+};
@@ -0,0 +1,112 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Fixed-size slot pool for the scheduler's message payloads.
+//
+// Slots are handed out by index and live in chunks of ChunkSize entries. A chunk is
+// never moved or released until Clear, so an index, and a reference to its entry,
+// stay valid until the slot is freed. Freed slots go on a stack and are reused
+// most-recently-freed first, which keeps the working set warm.
+//
+// The pool only allocates when it has to add a chunk. Once it has grown to the
+// high-water mark of the queue (or been Reserved up front), allocating and freeing
+// slots never calls the allocator, and memory use is simply the number of chunks
+// times ChunkSize entries.
+//
+// This class is not thread safe. The owner is responsible for locking.
+
+template <typename TEntry, uint32_t ChunkSize>
+class MidiSlabPool
+{
+    static_assert(ChunkSize > 0 && (ChunkSize & (ChunkSize - 1)) == 0, "ChunkSize must be a power of two");
+
+public:
+    MidiSlabPool() = default;
+
+    MidiSlabPool(MidiSlabPool const&) = delete;
+    MidiSlabPool& operator=(MidiSlabPool const&) = delete;
+
+    uint32_t Size() const noexcept { return Capacity() - (uint32_t)m_freeSlots.size(); }
+    uint32_t Capacity() const noexcept { return (uint32_t)m_chunks.size() * ChunkSize; }
+
+    // make sure at least count slots exist, so the pool doesn't allocate while in use
+    void Reserve(_In_ uint32_t count)
+    {
+        while (Capacity() < count)
+        {
+            AddChunk();
+        }
+    }
+
+    template <typename... TArgs>
+    uint32_t Allocate(TArgs&&... args)
+    {
+        if (m_freeSlots.empty())
+        {
+            AddChunk();
+        }
+
+        uint32_t slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+
+        Get(slot) = TEntry(std::forward<TArgs>(args)...);
+
+        return slot;
+    }
+
+    void Free(_In_ uint32_t slot)
+    {
+        // capacity for every slot was reserved when its chunk was added
+        m_freeSlots.push_back(slot);
+    }
+
+    TEntry& Get(_In_ uint32_t slot) noexcept { return m_chunks[slot / ChunkSize][slot & (ChunkSize - 1)]; }
+    TEntry const& Get(_In_ uint32_t slot) const noexcept { return m_chunks[slot / ChunkSize][slot & (ChunkSize - 1)]; }
+
+    // releases all chunks
+    void Clear()
+    {
+        m_chunks.clear();
+        m_freeSlots.clear();
+    }
+
+private:
+    void AddChunk()
+    {
+        uint32_t firstSlot = Capacity();
+
+        // Free can't be allowed to throw, so there has to be room on the free stack for
+        // every slot. Grown geometrically, like the chunk list, so adding a chunk doesn't
+        // mean copying the whole stack each time. Everything which can throw happens
+        // before the pool changes
+        if (m_freeSlots.capacity() < firstSlot + ChunkSize)
+        {
+            m_freeSlots.reserve((std::max)((size_t)firstSlot + ChunkSize, m_freeSlots.capacity() * 2));
+        }
+
+        m_chunks.push_back(std::unique_ptr<TEntry[]>(new TEntry[ChunkSize]));
+
+        // pushed in reverse so the lowest slot is handed out first
+        for (uint32_t i = ChunkSize; i > 0; i--)
+        {
+            m_freeSlots.push_back(firstSlot + i - 1);
+        }
+    }
+
+    std::vector<std::unique_ptr<TEntry[]>> m_chunks;
+    std::vector<uint32_t> m_freeSlots;
+};
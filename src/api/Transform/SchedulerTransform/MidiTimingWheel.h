@@ -0,0 +1,490 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License
+// ============================================================================
+// This is part of the Windows MIDI Services App API and should be used
+// in your Windows application via an official binary distribution.
+// Further information: https://github.com/microsoft/MIDI/
+// ============================================================================
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Hierarchical timing wheel used as the scheduler's outbound message queue.
+//
+// The 64 bit timestamp is split into eight 8-bit digits, with one wheel level per
+// digit. An entry is stored at the level of the most significant digit in which its
+// timestamp differs from the wheel's current time, in the slot named by that digit.
+// That means every level 0 slot holds entries with exactly one timestamp, and a
+// slot at a higher level is cascaded down only once the current time reaches the
+// start of the range it covers. An entry can be cascaded at most once per level, so
+// enqueue is O(1) and expiry is amortized O(1) no matter how many entries are queued.
+//
+// Slots are FIFO lists and cascading walks them in order. Entries which share a
+// timestamp are always placed relative to the same current time, so they come back
+// out in the order they were added. The scheduler adds them in ReceivedIndex order.
+//
+// The current time is only ever advanced up to the due timestamp passed in to
+// PeekDue. If an entry is added with a timestamp before the current time, it is
+// already due and goes to a separate FIFO list which is always drained first.
+//
+// Emplace returns a handle for the entry, which stays valid until the entry is
+// popped or removed. Lists are doubly linked, and where an entry lives follows from
+// its timestamp and the current time, so Remove takes an entry out in O(1).
+//
+// This class is not thread safe. The owner is responsible for locking.
+//
+// TEntry must have a uint64_t-compatible Timestamp member.
+
+template <typename TEntry>
+class MidiTimingWheel
+{
+public:
+    MidiTimingWheel()
+    {
+        ResetSlots();
+    }
+
+    size_t Size() const noexcept { return m_count; }
+    bool Empty() const noexcept { return m_count == 0; }
+
+    // pre-allocate entry storage so the queue doesn't allocate while in use
+    void Reserve(_In_ size_t count) { m_nodes.reserve(count); }
+
+    template <typename... TArgs>
+    uint32_t Emplace(TArgs&&... args)
+    {
+        uint32_t node = AllocateNode(std::forward<TArgs>(args)...);
+
+        Place(node);
+        m_count++;
+
+        return node;
+    }
+
+    TEntry const& Get(_In_ uint32_t handle) const noexcept { return m_nodes[handle].Entry; }
+
+    // Removes an entry by the handle Emplace returned for it
+    void Remove(_In_ uint32_t handle) noexcept
+    {
+        uint32_t level{ 0 };
+        uint32_t slot{ 0 };
+
+        if (!Locate(m_nodes[handle].Entry.Timestamp, level, slot))
+        {
+            Unlink(m_overdue, handle);
+        }
+        else
+        {
+            Unlink(m_slots[level][slot], handle);
+
+            if (m_slots[level][slot].Head == InvalidIndex)
+            {
+                m_occupied[level][slot / 64] &= ~((uint64_t)1 << (slot % 64));
+            }
+        }
+
+        FreeNode(handle);
+        m_count--;
+    }
+
+    // Returns the earliest entry if its timestamp is at or before dueTimestamp, or
+    // nullptr if nothing is due yet. This advances the wheel (and cascades higher
+    // level slots) as needed, but never past dueTimestamp. The returned pointer is
+    // valid until the next call which modifies the wheel.
+    TEntry const* PeekDue(_In_ uint64_t dueTimestamp)
+    {
+        for (;;)
+        {
+            if (m_overdue.Head != InvalidIndex)
+            {
+                return &m_nodes[m_overdue.Head].Entry;
+            }
+
+            if (m_count == 0)
+            {
+                return nullptr;
+            }
+
+            uint32_t slot = FindOccupiedSlot(0, Digit(m_current, 0));
+
+            if (slot < SlotCount)
+            {
+                uint64_t timestamp = (m_current & ~(uint64_t)SlotMask) | slot;
+
+                if (timestamp > dueTimestamp)
+                {
+                    return nullptr;
+                }
+
+                m_current = timestamp;
+
+                return &m_nodes[m_slots[0][slot].Head].Entry;
+            }
+
+            // nothing left at level 0 for the current range, so the earliest entry is
+            // in the first occupied slot of the lowest occupied higher level
+            uint32_t level = 1;
+            for (; level < LevelCount; level++)
+            {
+                slot = FindOccupiedSlot(level, 0);
+
+                if (slot < SlotCount) break;
+            }
+
+            uint64_t rangeStart = RangeStart(level, slot);
+
+            if (rangeStart > dueTimestamp)
+            {
+                return nullptr;
+            }
+
+            m_current = rangeStart;
+            Cascade(level, slot);
+        }
+    }
+
+    // Calls visitor with the entry PeekDue just returned, and then with each entry
+    // queued directly behind it which has the same timestamp, in the order Pop will
+    // remove them, until the visitor returns false. Returns how many entries the
+    // visitor accepted, so the caller can Pop exactly those. Only valid straight after
+    // PeekDue returned an entry.
+    template <typename TVisitor>
+    uint32_t VisitDueRun(TVisitor&& visitor) const
+    {
+        uint32_t node = m_overdue.Head != InvalidIndex ? m_overdue.Head : m_slots[0][Digit(m_current, 0)].Head;
+        uint32_t acceptedCount{ 0 };
+
+        if (node == InvalidIndex)
+        {
+            return 0;
+        }
+
+        uint64_t timestamp = m_nodes[node].Entry.Timestamp;
+
+        while (node != InvalidIndex && m_nodes[node].Entry.Timestamp == timestamp && visitor(m_nodes[node].Entry))
+        {
+            acceptedCount++;
+            node = m_nodes[node].Next;
+        }
+
+        return acceptedCount;
+    }
+
+    // Removes the entry most recently returned by PeekDue
+    void Pop()
+    {
+        if (m_overdue.Head != InvalidIndex)
+        {
+            FreeNode(PopHead(m_overdue));
+        }
+        else
+        {
+            uint32_t slot = Digit(m_current, 0);
+
+            if (m_slots[0][slot].Head == InvalidIndex) return;
+
+            FreeNode(PopHead(m_slots[0][slot]));
+
+            if (m_slots[0][slot].Head == InvalidIndex)
+            {
+                m_occupied[0][slot / 64] &= ~((uint64_t)1 << (slot % 64));
+            }
+        }
+
+        m_count--;
+    }
+
+    // Provides the earliest time at which an entry could become due. This is exact
+    // when the earliest entry has already been cascaded down to level 0, and is the
+    // start of its slot's range otherwise. Returns false if the wheel is empty.
+    bool GetNextTimestamp(_Out_ uint64_t& timestamp) const
+    {
+        timestamp = 0;
+
+        if (m_overdue.Head != InvalidIndex)
+        {
+            timestamp = m_nodes[m_overdue.Head].Entry.Timestamp;
+            return true;
+        }
+
+        if (m_count == 0)
+        {
+            return false;
+        }
+
+        for (uint32_t level = 0; level < LevelCount; level++)
+        {
+            uint32_t slot = FindOccupiedSlot(level, level == 0 ? Digit(m_current, 0) : 0);
+
+            if (slot < SlotCount)
+            {
+                timestamp = RangeStart(level, slot);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Clear()
+    {
+        m_nodes.clear();
+        m_freeHead = InvalidIndex;
+        m_count = 0;
+
+        ResetSlots();
+    }
+
+private:
+    static constexpr uint32_t LevelCount{ 8 };
+    static constexpr uint32_t SlotBits{ 8 };
+    static constexpr uint32_t SlotCount{ 1 << SlotBits };
+    static constexpr uint32_t SlotMask{ SlotCount - 1 };
+    static constexpr uint32_t OccupancyWordCount{ SlotCount / 64 };
+    static constexpr uint32_t InvalidIndex{ UINT32_MAX };
+
+    struct Node
+    {
+        TEntry Entry;
+        uint32_t Next;
+        uint32_t Prev;
+    };
+
+    struct SlotList
+    {
+        uint32_t Head{ InvalidIndex };
+        uint32_t Tail{ InvalidIndex };
+    };
+
+    static uint32_t Digit(_In_ uint64_t timestamp, _In_ uint32_t level) noexcept
+    {
+        return (uint32_t)(timestamp >> (level * SlotBits)) & SlotMask;
+    }
+
+    static uint32_t CountTrailingZeros(_In_ uint64_t value) noexcept
+    {
+#ifdef _MSC_VER
+        unsigned long index{ 0 };
+        _BitScanForward64(&index, value);
+        return (uint32_t)index;
+#else
+        return (uint32_t)__builtin_ctzll(value);
+#endif
+    }
+
+    // timestamp at which the given slot's range begins, relative to the current time
+    uint64_t RangeStart(_In_ uint32_t level, _In_ uint32_t slot) const noexcept
+    {
+        uint32_t shift = level * SlotBits;
+        uint64_t upperDigits = (level + 1 < LevelCount) ? (m_current & (~(uint64_t)0 << (shift + SlotBits))) : 0;
+
+        return upperDigits | ((uint64_t)slot << shift);
+    }
+
+    // first occupied slot at or after firstSlot, or SlotCount if there are none
+    uint32_t FindOccupiedSlot(_In_ uint32_t level, _In_ uint32_t firstSlot) const noexcept
+    {
+        for (uint32_t word = firstSlot / 64; word < OccupancyWordCount; word++)
+        {
+            uint64_t bits = m_occupied[level][word];
+
+            if (word == firstSlot / 64)
+            {
+                bits &= ~(uint64_t)0 << (firstSlot % 64);
+            }
+
+            if (bits != 0)
+            {
+                return word * 64 + CountTrailingZeros(bits);
+            }
+        }
+
+        return SlotCount;
+    }
+
+    template <typename... TArgs>
+    uint32_t AllocateNode(TArgs&&... args)
+    {
+        uint32_t node;
+
+        if (m_freeHead != InvalidIndex)
+        {
+            node = m_freeHead;
+            m_freeHead = m_nodes[node].Next;
+            m_nodes[node].Entry = TEntry(std::forward<TArgs>(args)...);
+        }
+        else
+        {
+            node = (uint32_t)m_nodes.size();
+            m_nodes.push_back(Node{ TEntry(std::forward<TArgs>(args)...), InvalidIndex, InvalidIndex });
+        }
+
+        m_nodes[node].Next = InvalidIndex;
+        m_nodes[node].Prev = InvalidIndex;
+
+        return node;
+    }
+
+    void FreeNode(_In_ uint32_t node) noexcept
+    {
+        m_nodes[node].Next = m_freeHead;
+        m_freeHead = node;
+    }
+
+    void Append(_In_ SlotList& list, _In_ uint32_t node) noexcept
+    {
+        m_nodes[node].Next = InvalidIndex;
+        m_nodes[node].Prev = list.Tail;
+
+        if (list.Tail == InvalidIndex)
+        {
+            list.Head = node;
+        }
+        else
+        {
+            m_nodes[list.Tail].Next = node;
+        }
+
+        list.Tail = node;
+    }
+
+    uint32_t PopHead(_In_ SlotList& list) noexcept
+    {
+        uint32_t node = list.Head;
+
+        list.Head = m_nodes[node].Next;
+
+        if (list.Head == InvalidIndex)
+        {
+            list.Tail = InvalidIndex;
+        }
+        else
+        {
+            m_nodes[list.Head].Prev = InvalidIndex;
+        }
+
+        return node;
+    }
+
+    void Unlink(_In_ SlotList& list, _In_ uint32_t node) noexcept
+    {
+        uint32_t next = m_nodes[node].Next;
+        uint32_t prev = m_nodes[node].Prev;
+
+        if (prev == InvalidIndex)
+        {
+            list.Head = next;
+        }
+        else
+        {
+            m_nodes[prev].Next = next;
+        }
+
+        if (next == InvalidIndex)
+        {
+            list.Tail = prev;
+        }
+        else
+        {
+            m_nodes[next].Prev = prev;
+        }
+    }
+
+    // Finds the level and slot an entry with this timestamp belongs in, relative to
+    // the current time. Returns false if it belongs in the overdue list instead.
+    // Entries are only cascaded once the current time reaches their slot's range, so
+    // this is also where an entry which is already in the wheel can be found.
+    bool Locate(_In_ uint64_t timestamp, _Out_ uint32_t& level, _Out_ uint32_t& slot) const noexcept
+    {
+        level = 0;
+        slot = 0;
+
+        if (timestamp < m_current)
+        {
+            return false;
+        }
+
+        uint64_t differentBits = timestamp ^ m_current;
+
+        while (level + 1 < LevelCount && (differentBits >> ((level + 1) * SlotBits)) != 0)
+        {
+            level++;
+        }
+
+        slot = Digit(timestamp, level);
+
+        return true;
+    }
+
+    void Place(_In_ uint32_t node) noexcept
+    {
+        uint32_t level{ 0 };
+        uint32_t slot{ 0 };
+
+        if (!Locate(m_nodes[node].Entry.Timestamp, level, slot))
+        {
+            Append(m_overdue, node);
+            return;
+        }
+
+        Append(m_slots[level][slot], node);
+        m_occupied[level][slot / 64] |= (uint64_t)1 << (slot % 64);
+    }
+
+    // move every entry in the slot down to the levels below, preserving order
+    void Cascade(_In_ uint32_t level, _In_ uint32_t slot) noexcept
+    {
+        uint32_t node = m_slots[level][slot].Head;
+
+        m_slots[level][slot] = SlotList{};
+        m_occupied[level][slot / 64] &= ~((uint64_t)1 << (slot % 64));
+
+        while (node != InvalidIndex)
+        {
+            uint32_t next = m_nodes[node].Next;
+
+            Place(node);
+
+            node = next;
+        }
+    }
+
+    void ResetSlots() noexcept
+    {
+        for (uint32_t level = 0; level < LevelCount; level++)
+        {
+            for (uint32_t slot = 0; slot < SlotCount; slot++)
+            {
+                m_slots[level][slot] = SlotList{};
+            }
+
+            for (uint32_t word = 0; word < OccupancyWordCount; word++)
+            {
+                m_occupied[level][word] = 0;
+            }
+        }
+
+        m_overdue = SlotList{};
+    }
+
+    std::vector<Node> m_nodes;
+    uint32_t m_freeHead{ InvalidIndex };
+    size_t m_count{ 0 };
+
+    // the wheel only moves forward, and never past a due timestamp passed to PeekDue
+    uint64_t m_current{ 0 };
+
+    SlotList m_slots[LevelCount][SlotCount];
+    uint64_t m_occupied[LevelCount][OccupancyWordCount];
+
+    SlotList m_overdue;
+};
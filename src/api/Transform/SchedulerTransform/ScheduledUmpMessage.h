@@ -13,11 +13,13 @@ struct ScheduledUmpMessage
 {
     internal::MidiTimestamp Timestamp{ 0 };
     uint64_t ReceivedIndex{ 0 };            // this allows us to preserve order for messages with the same timestamp
+    uint64_t SourceId{ 0 };                 // client which sent the message, or 0 if not known
     UINT ByteCount{ 0 };
     BYTE Data[MAXIMUM_UMP_DATASIZE];        // pre-define this array to avoid another allocation/indirection
 
+    ScheduledUmpMessage() = default;
     
-    ScheduledUmpMessage(_In_ internal::MidiTimestamp timestamp, _In_ uint64_t receivedIndex, _In_ UINT byteCount, _In_ BYTE* data)
+    ScheduledUmpMessage(_In_ internal::MidiTimestamp timestamp, _In_ uint64_t receivedIndex, _In_ uint64_t sourceId, _In_ UINT byteCount, _In_ BYTE* data)
     {
         if (byteCount <= MAXIMUM_UMP_DATASIZE)
         {
@@ -32,7 +34,48 @@ struct ScheduledUmpMessage
 
         Timestamp = timestamp;
         ReceivedIndex = receivedIndex;
+        SourceId = sourceId;
     }
 
 };
 
+
+// The payload of a message which has been merged into the scheduler's queue. These
+// live in a slab pool so the timing wheel only has to move the small key below.
+// The handles are how a cancel finds the message in the wheel, and how a send
+// finds it in the cancel index.
+struct ScheduledUmpPayload
+{
+    UINT ByteCount{ 0 };
+    BYTE Data[MAXIMUM_UMP_DATASIZE];
+    uint32_t WheelHandle{ 0 };
+    uint32_t IndexHandle{ 0 };
+    uint64_t SourceId{ 0 };                 // passed along with the message when it's sent
+
+    ScheduledUmpPayload() = default;
+
+    ScheduledUmpPayload(_In_ UINT byteCount, _In_ BYTE const* data, _In_ uint64_t sourceId)
+    {
+        ByteCount = byteCount <= MAXIMUM_UMP_DATASIZE ? byteCount : MAXIMUM_UMP_DATASIZE;
+        memcpy(Data, data, ByteCount);
+        SourceId = sourceId;
+    }
+};
+
+// What the timing wheel holds for each queued message. Slot is the payload's index
+// in the scheduler's slab pool.
+struct ScheduledUmpMessageKey
+{
+    internal::MidiTimestamp Timestamp{ 0 };
+    uint64_t ReceivedIndex{ 0 };
+    uint32_t Slot{ 0 };
+
+    ScheduledUmpMessageKey() = default;
+
+    ScheduledUmpMessageKey(_In_ internal::MidiTimestamp timestamp, _In_ uint64_t receivedIndex, _In_ uint32_t slot)
+    {
+        Timestamp = timestamp;
+        ReceivedIndex = receivedIndex;
+        Slot = slot;
+    }
+};
@@ -25,6 +25,7 @@
 #include <wil\com.h>
 #include <wil\resource.h>
 #include <wil\result_macros.h>
+#include <wil\registry.h>
 #include <wil\tracelogging.h>
 #include <ppltasks.h>
 
@@ -45,11 +46,11 @@
 #include <winmeta.h>
 #include <TraceLoggingProvider.h>
 
-#include <queue>
 #include <thread>
 
 #include "midi_ump.h"
 #include "midi_timestamp.h"
+#include "ump_helpers.h"
 
 namespace internal = ::Windows::Devices::Midi2::Internal;
 namespace shared = ::Windows::Devices::Midi2::Internal::Shared;
@@ -57,6 +58,12 @@ namespace shared = ::Windows::Devices::Midi2::Internal::Shared;
 #include "MidiDefs.h"
 #include "plugin_defs.h"
 #include "ScheduledUmpMessage.h"
+#include "MidiTimingWheel.h"
+#include "MidiSlabPool.h"
+#include "MidiScheduledMessageIndex.h"
+#include "MidiScheduledMessageQueue.h"
+#include "MidiMpscQueue.h"
+#include "MidiDispatchJitterHistogram.h"
 
 #include "Midi2SchedulerTransform_i.c"
 #include "Midi2SchedulerTransform.h"
@@ -16,6 +16,32 @@
 #define MIDI_SCHEDULER_ENQUEUE_OVERHEAD_LATENCY_TICKS           10
 #define MIDI_SCHEDULER_MAX_MESSAGES_TO_PROCESS_AT_ONCE          100
 
+// size of the lock-free ring senders push into before the worker merges messages into
+// the timing wheel. Must be a power of two.
+#define MIDI_SCHEDULER_STAGING_QUEUE_SIZE                       4096
+
+// queued message payloads are pooled in chunks of this many. Must be a power of two.
+// The pool and the timing wheel are reserved up front for the initial count, so
+// typical queue sizes never allocate
+#define MIDI_SCHEDULER_PAYLOAD_POOL_CHUNK_SIZE                  1024
+#define MIDI_SCHEDULER_INITIAL_RESERVED_MESSAGE_COUNT           1024
+
+// the worker sleeps on a high resolution timer until this close to the next send time,
+// and then spins the rest of the way. Longer is more accurate but costs more CPU. Can
+// be overridden with the MIDI_SCHEDULER_SPIN_WINDOW_REG_VALUE registry value
+#define MIDI_SCHEDULER_DEFAULT_SPIN_WINDOW_MICROSECONDS         1000
+#define MIDI_SCHEDULER_MAXIMUM_SPIN_WINDOW_MICROSECONDS         20000
+
+// due messages which share a timestamp are sent downstream together, in one UMP batch
+// of up to this many bytes, instead of one callback each. Can be turned off with the
+// MIDI_SCHEDULER_COALESCE_REG_VALUE registry value
+#define MIDI_SCHEDULER_DEFAULT_COALESCE_SAME_TIMESTAMP          1
+#define MIDI_SCHEDULER_MAX_COALESCED_BYTE_COUNT                 MIDI_UMP_BATCH_MAXIMUM_SIZE
+
+// while it has been dispatching, the worker traces the jitter histogram and wait
+// counters at most this often, so they can be watched while the endpoint is open
+#define MIDI_SCHEDULER_STATISTICS_TRACE_INTERVAL_SECONDS        10
+
 
 #define MAXIMUM_UMP_DATASIZE 16
 #define MINIMUM_UMP_DATASIZE 4
@@ -55,29 +55,26 @@ CMidi2UMP2BSMidiTransform::SendMidiMessage(
 {
     OutputDebugString(L"" __FUNCTION__);
 
-    // Send the UMP(s) to the parser
+    // Send the UMP(s) to the parser a buffer at a time. The parser only
+    // writes whole messages, and stops when the next one might not fit.
     uint32_t *data = (uint32_t *)Data;
-    for (UINT i = 0; i < (Length / 4); i++)
-    {
-        m_UMP2BS.UMPStreamParse(data[i]);
-    }
+    size_t wordCount = Length / 4;
+    size_t consumed{ 0 };
+
+    auto lock = m_SendLock.lock();
 
-    // retrieve the bytestream message from the parser
-    // and send it on
-    while (m_UMP2BS.availableBS())
+    do
     {
         BYTE byteStream[MAXIMUM_LOOPED_DATASIZE];
-        UINT byteCount;
-        for(byteCount = 0; byteCount < _countof(byteStream) && m_UMP2BS.availableBS(); byteCount++)
-        {
-            byteStream[byteCount] = m_UMP2BS.readBS();
-        }
+        size_t byteCount{ 0 };
+
+        consumed += m_UMP2BS.UMPStreamParse(data + consumed, wordCount - consumed, byteStream, _countof(byteStream), byteCount);
 
         if (byteCount > 0)
         {
-            RETURN_IF_FAILED(m_Callback->Callback(&(byteStream[0]), byteCount, Position, m_Context));
+            RETURN_IF_FAILED(m_Callback->Callback(&(byteStream[0]), (UINT)byteCount, Position, m_Context));
         }
-    }
+    } while (consumed < wordCount);
 
     return S_OK;
 }
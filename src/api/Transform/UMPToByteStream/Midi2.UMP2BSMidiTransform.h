@@ -20,6 +20,10 @@ private:
     wil::com_ptr_nothrow<IMidiCallback> m_Callback;
     LONGLONG m_Context;
 
+    // The service shares one of these between all of an endpoint's clients, which can
+    // send at the same time. The parser keeps state from one call to the next, so
+    // sends are serialized, and each one's bytes go downstream before the next starts.
+    wil::critical_section m_SendLock;
     umpToBytestream m_UMP2BS;
 };
 
@@ -11,35 +11,196 @@
 #include "MidiMessageTranslator.h"
 #include "MidiMessageTranslator.g.cpp"
 
+#include <vector>
+
+// shared with the API, so apps get the same results from both
+#include "midi_message_translation.h"
+
+namespace translation = ::Windows::Devices::Midi2::Internal;
+
 
 namespace winrt::Microsoft::Devices::Midi2::implementation
 {
     com_array<uint32_t> MidiMessageTranslator::TranslateMidi1ByteCVToMidi2UmpCV(array_view<uint8_t const> midi1Bytes)
     {
-        throw hresult_not_implemented();
+        // the shortest channel voice message is one byte with running status, and every
+        // message is two words once translated
+        std::vector<uint32_t> midi2Words;
+        midi2Words.reserve(midi1Bytes.size() * 2);
+
+        uint8_t runningStatus{ 0 };
+        uint8_t dataBytes[2]{ 0, 0 };
+        uint8_t dataByteCount{ 0 };
+
+        for (auto const b : midi1Bytes)
+        {
+            if (b >= 0xF8)
+            {
+                // real time can show up anywhere, and doesn't change running status
+                continue;
+            }
+            else if (b >= 0xF0)
+            {
+                // system common and SysEx aren't channel voice, and cancel running status.
+                // Their data bytes are skipped until the next status byte.
+                runningStatus = 0;
+                dataByteCount = 0;
+                continue;
+            }
+            else if (b & 0x80)
+            {
+                runningStatus = b;
+                dataByteCount = 0;
+                continue;
+            }
+            else if (runningStatus == 0)
+            {
+                continue;
+            }
+
+            dataBytes[dataByteCount++] = b;
+
+            uint8_t status = runningStatus & 0xF0;
+            uint8_t messageDataByteCount = (status == 0xC0 || status == 0xD0) ? 1 : 2;
+
+            if (dataByteCount == messageDataByteCount)
+            {
+                uint32_t midi1Word = 0x20000000 |
+                    (uint32_t)runningStatus << 16 |
+                    (uint32_t)dataBytes[0] << 8 |
+                    (messageDataByteCount == 2 ? dataBytes[1] : 0);
+
+                uint32_t word0{ 0 };
+                uint32_t word1{ 0 };
+
+                if (translation::UpscaleMidi1ChannelVoiceMessage(midi1Word, word0, word1))
+                {
+                    midi2Words.push_back(word0);
+                    midi2Words.push_back(word1);
+                }
+
+                dataByteCount = 0;
+            }
+        }
+
+        return com_array<uint32_t>(midi2Words);
     }
+
     com_array<uint8_t> MidiMessageTranslator::TranslateMidi2UmpCVToMidi1ByteCV(array_view<uint32_t const> midi2Words)
     {
-        throw hresult_not_implemented();
+        std::vector<uint32_t> midi1Words(midi2Words.size() * 2);
+        uint32_t midi1WordCount{ 0 };
+
+        uint32_t translatedWordCount = translation::DownscaleMidi2ChannelVoiceMessages(
+            midi2Words.data(), midi2Words.size(),
+            midi1Words.data(), (uint32_t)midi1Words.size(),
+            midi1WordCount);
+
+        if (translatedWordCount != midi2Words.size())
+        {
+            // there's always room, so the last message was cut off
+            throw hresult_invalid_argument();
+        }
+
+        std::vector<uint8_t> midi1Bytes;
+        midi1Bytes.reserve(midi1WordCount * 3);
+
+        for (uint32_t i = 0; i < midi1WordCount; i++)
+        {
+            uint32_t word = midi1Words[i];
+
+            if ((word >> 28) != 0x2)
+            {
+                continue;
+            }
+
+            uint8_t status = (uint8_t)(word >> 16);
+
+            midi1Bytes.push_back(status);
+            midi1Bytes.push_back((uint8_t)(word >> 8));
+
+            if ((status & 0xF0) != 0xC0 && (status & 0xF0) != 0xD0)
+            {
+                midi1Bytes.push_back((uint8_t)word);
+            }
+        }
+
+        return com_array<uint8_t>(midi1Bytes);
     }
+
     com_array<uint32_t> MidiMessageTranslator::TranslateMidi1UmpCVToMidi2UmpCV(uint32_t midi1CVUmp)
     {
-        throw hresult_not_implemented();
+        uint32_t word0{ 0 };
+        uint32_t word1{ 0 };
+
+        if (!translation::UpscaleMidi1ChannelVoiceMessage(midi1CVUmp, word0, word1))
+        {
+            throw hresult_invalid_argument();
+        }
+
+        return com_array<uint32_t>{ word0, word1 };
     }
-    uint32_t MidiMessageTranslator::TranslateMidi2UmpCVToMidi1UmpCV(uint32_t midi2CVUmp)
+
+    uint32_t MidiMessageTranslator::TranslateMidi2UmpCVToMidi1UmpCV(uint32_t midi2CVUmpWord0, uint32_t midi2CVUmpWord1)
     {
-        throw hresult_not_implemented();
+        uint32_t word{ 0 };
+
+        if (!translation::DownscaleMidi2ChannelVoiceMessage(midi2CVUmpWord0, midi2CVUmpWord1, word))
+        {
+            throw hresult_invalid_argument();
+        }
+
+        return word;
     }
+
+    com_array<uint32_t> MidiMessageTranslator::TranslateMidi1UmpCVWordsToMidi2UmpCV(array_view<uint32_t const> midi1Words)
+    {
+        std::vector<uint32_t> midi2Words(midi1Words.size() * 2);
+        uint32_t midi2WordCount{ 0 };
+
+        uint32_t translatedWordCount = translation::UpscaleMidi1ChannelVoiceMessages(
+            midi1Words.data(), midi1Words.size(),
+            midi2Words.data(), (uint32_t)midi2Words.size(),
+            midi2WordCount);
+
+        if (translatedWordCount != midi1Words.size())
+        {
+            throw hresult_invalid_argument();
+        }
+
+        return com_array<uint32_t>(midi2Words.begin(), midi2Words.begin() + midi2WordCount);
+    }
+
+    com_array<uint32_t> MidiMessageTranslator::TranslateMidi2UmpCVWordsToMidi1UmpCV(array_view<uint32_t const> midi2Words)
+    {
+        std::vector<uint32_t> midi1Words(midi2Words.size() * 2);
+        uint32_t midi1WordCount{ 0 };
+
+        uint32_t translatedWordCount = translation::DownscaleMidi2ChannelVoiceMessages(
+            midi2Words.data(), midi2Words.size(),
+            midi1Words.data(), (uint32_t)midi1Words.size(),
+            midi1WordCount);
+
+        if (translatedWordCount != midi2Words.size())
+        {
+            throw hresult_invalid_argument();
+        }
+
+        return com_array<uint32_t>(midi1Words.begin(), midi1Words.begin() + midi1WordCount);
+    }
+
     uint16_t MidiMessageTranslator::Scale7BitValueto16BitValue(uint8_t sevenBitValue)
     {
-        throw hresult_not_implemented();
+        return translation::ScaleMidi7BitValueTo16Bit(sevenBitValue);
     }
+
     uint32_t MidiMessageTranslator::Scale14BitValueTo32BitValue(uint16_t fourteenBitValue)
     {
-        throw hresult_not_implemented();
+        return translation::ScaleMidi14BitValueTo32Bit(fourteenBitValue & 0x3FFF);
     }
+
     uint32_t MidiMessageTranslator::Scale14BitValueTo32BitValue(uint8_t fourteenBitValueMSB, uint8_t fourteenBitValueLSB)
     {
-        throw hresult_not_implemented();
+        return translation::ScaleMidi14BitValueTo32Bit((uint16_t)(((fourteenBitValueMSB & 0x7F) << 7) | (fourteenBitValueLSB & 0x7F)));
     }
 }
@@ -19,7 +19,9 @@ namespace winrt::Microsoft::Devices::Midi2::implementation
         static com_array<uint32_t> TranslateMidi1ByteCVToMidi2UmpCV(array_view<uint8_t const> midi1Bytes);
         static com_array<uint8_t> TranslateMidi2UmpCVToMidi1ByteCV(array_view<uint32_t const> midi2Words);
         static com_array<uint32_t> TranslateMidi1UmpCVToMidi2UmpCV(uint32_t midi1CVUmp);
-        static uint32_t TranslateMidi2UmpCVToMidi1UmpCV(uint32_t midi2CVUmp);
+        static uint32_t TranslateMidi2UmpCVToMidi1UmpCV(uint32_t midi2CVUmpWord0, uint32_t midi2CVUmpWord1);
+        static com_array<uint32_t> TranslateMidi1UmpCVWordsToMidi2UmpCV(array_view<uint32_t const> midi1Words);
+        static com_array<uint32_t> TranslateMidi2UmpCVWordsToMidi1UmpCV(array_view<uint32_t const> midi2Words);
         static uint16_t Scale7BitValueto16BitValue(uint8_t sevenBitValue);
         static uint32_t Scale14BitValueTo32BitValue(uint16_t fourteenBitValue);
         static uint32_t Scale14BitValueTo32BitValue(uint8_t fourteenBitValueMSB, uint8_t fourteenBitValueLSB);